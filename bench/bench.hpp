@@ -0,0 +1,68 @@
+#pragma once
+/**
+ * @brief timing helpers shared by the benchmarks
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @brief median wall time of `f` in milliseconds, after one warm up run
+ * @note runs at least `min_runs` times and until `min_seconds` elapsed
+*/
+template<typename F>
+double bench_median_ms(F&& f, size_t min_runs = 5, double min_seconds = 0.5){
+	f();
+	std::vector<double> times;
+	auto start = std::chrono::steady_clock::now();
+	while(times.size() < min_runs || std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < min_seconds){
+		auto begin = std::chrono::steady_clock::now();
+		f();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+		if(times.size() >= 1000) break;
+	}
+	std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+	return times[times.size() / 2];
+}
+
+/**
+ * @brief rows of median time and throughput, the first row is the baseline of the speedup column
+*/
+class BenchTable {
+	public:
+		BenchTable(std::string title):m_title(std::move(title)){}
+
+		/**
+		 * @param pixels work of one run, reported as MPix/s
+		 * @param note free text appended to the row (quality metrics ...)
+		 * @return the median time in milliseconds
+		*/
+		template<typename F>
+		double row(const std::string& name, double pixels, F&& f, std::string note = ""){
+			double ms = bench_median_ms(f);
+			m_rows.push_back({ name, ms, pixels, std::move(note) });
+			return ms;
+		}
+
+		void print() const {
+			std::printf("%-28s %12s %12s %9s\n", m_title.c_str(), "ms", "MPix/s", "speedup");
+			for(auto& row: m_rows){
+				double baseline = m_rows.front().ms;
+				std::printf("%-28s %12.3f %12.1f %8.2fx  %s\n", row.name.c_str(), row.ms, row.pixels / (row.ms * 1e3), baseline / row.ms, row.note.c_str());
+			}
+			std::printf("\n");
+		}
+
+	private:
+		struct Row {
+			std::string name;
+			double ms = 0.0;
+			double pixels = 0.0;
+			std::string note;
+		};
+
+		std::string m_title;
+		std::vector<Row> m_rows;
+};
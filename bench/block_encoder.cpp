@@ -0,0 +1,70 @@
+/**
+ * @brief BlockEncoder throughput and quality per format and preset, pure CPU
+ *
+ *   g++ -std=c++20 -O2 -fpermissive -Iinclude bench/block_encoder.cpp -o block_encoder_bench -lGLEW -lGL -pthread && ./block_encoder_bench [size]
+ *
+ * the source is a size² RGBA image of smooth gradients, edges and noise. PSNR is measured over the
+ * channels each format stores. nothing is sent to the GL, it is only linked for the shared headers.
+*/
+#include "bench.hpp"
+#include "opengl/block_encoder.hpp"
+
+static std::vector<uint8_t> test_image(size_t size){
+	std::vector<uint8_t> pixels(size * size * 4);
+	uint32_t noise = 0x2545f491u;
+	for(size_t y = 0; y < size; y++){
+		for(size_t x = 0; x < size; x++){
+			noise ^= noise << 13; noise ^= noise >> 17; noise ^= noise << 5;
+			uint8_t* pixel = &pixels[(y * size + x) * 4];
+			bool edge = ((x / 37) + (y / 53)) & 1; //hard edges between flat tiles
+			pixel[0] = (uint8_t)((x * 255 / size + (noise & 7)) & 0xff);
+			pixel[1] = (uint8_t)((y * 255 / size + ((noise >> 3) & 7)) & 0xff);
+			pixel[2] = edge ? 200 : 40;
+			pixel[3] = (uint8_t)(128 + 127 * std::sin((double)(x + y) / 23.0));
+		}
+	}
+	return pixels;
+}
+
+static const char* format_name(BlockFormat format){
+	switch(format){
+		case BlockFormat::BC1: return "bc1";
+		case BlockFormat::BC3: return "bc3";
+		case BlockFormat::BC4: return "bc4";
+		case BlockFormat::BC5: return "bc5";
+		default: return "bc7";
+	}
+}
+
+static const char* quality_name(BlockQuality quality){
+	switch(quality){
+		case BlockQuality::Fast: return "fast";
+		case BlockQuality::Normal: return "normal";
+		default: return "high";
+	}
+}
+
+int main(int argc, char** argv){
+	size_t size = argc > 1 ? (size_t)std::atoi(argv[1]) : 1024;
+	double pixels = (double)size * size;
+	std::vector<uint8_t> image = test_image(size);
+	ThreadPool pool;
+	BlockEncoder single;
+	BlockEncoder threaded(&pool);
+	std::printf("%zux%zu RGBA8, %zu threads\n\n", size, size, pool.size());
+
+	for(BlockFormat format: { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 }){
+		BenchTable table(format_name(format));
+		for(BlockQuality quality: { BlockQuality::Fast, BlockQuality::Normal, BlockQuality::High }){
+			CompressedImage encoded = single.encode(image.data(), size, size, 4, format, quality);
+			char psnr[32];
+			std::snprintf(psnr, sizeof(psnr), "%.2f dB", BlockEncoder::psnr(image.data(), 4, encoded));
+
+			std::string name = quality_name(quality);
+			table.row(name, pixels, [&]{ single.encode(image.data(), size, size, 4, format, quality); }, psnr);
+			table.row(name + ", pool", pixels, [&]{ threaded.encode(image.data(), size, size, 4, format, quality); }, psnr);
+		}
+		table.print();
+	}
+	return 0;
+}
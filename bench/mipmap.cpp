@@ -0,0 +1,106 @@
+/**
+ * @brief MipGenerator against its scalar reference and glGenerateMipmap
+ *
+ *   g++ -std=c++20 -O2 -fpermissive -Iinclude bench/mipmap.cpp -o mipmap_bench -lGLEW -lEGL -lGL -pthread && ./mipmap_bench [size]
+ *
+ * CPU rows time the whole chain below a size² base image, `+upload` adds the level uploads. the GPU
+ * rows are skipped when no GL context can be created.
+*/
+#include "../tests/gl_test.hpp"
+#include "bench.hpp"
+#include "opengl/mipmap.hpp"
+
+static std::vector<uint8_t> test_image(size_t size, size_t channels){
+	std::vector<uint8_t> pixels(size * size * channels);
+	uint32_t noise = 0x9e3779b9u;
+	for(size_t y = 0; y < size; y++){
+		for(size_t x = 0; x < size; x++){
+			for(size_t c = 0; c < channels; c++){
+				noise = noise * 1664525u + 1013904223u;
+				//smooth gradients with some noise, like a photo
+				pixels[(y * size + x) * channels + c] = (uint8_t)((x * (c + 1) + y * 3 + (noise >> 28)) & 0xff);
+			}
+		}
+	}
+	return pixels;
+}
+
+static size_t max_difference(const MipChain& a, const MipChain& b){
+	size_t difference = 0;
+	for(size_t level = 0; level < a.levels.size() && level < b.levels.size(); level++){
+		for(size_t i = 0; i < a.levels[level].data.size(); i++){
+			difference = std::max<size_t>(difference, (size_t)std::abs((int)a.levels[level].data[i] - (int)b.levels[level].data[i]));
+		}
+	}
+	return difference;
+}
+
+static const char* backend_name(MipGenerator::Backend backend){
+	switch(backend){
+		case MipGenerator::Backend::SSE4: return "sse4";
+		case MipGenerator::Backend::AVX2: return "avx2";
+		case MipGenerator::Backend::NEON: return "neon";
+		default: return "scalar";
+	}
+}
+
+int main(int argc, char** argv){
+	size_t size = argc > 1 ? (size_t)std::atoi(argv[1]) : 2048;
+	double pixels = (double)size * size;
+	std::vector<uint8_t> image = test_image(size, 4);
+	ThreadPool pool;
+
+	MipGenerator reference(nullptr, MipGenerator::Backend::Scalar);
+	MipGenerator simd(nullptr);
+	MipGenerator threaded(&pool);
+	std::printf("%zux%zu RGBA8, %s kernels, %zu threads\n\n", size, size, backend_name(MipGenerator::detect()), pool.size());
+
+	MipOptions srgb = { .filter = MipFilter::Box, .srgb = true };
+	MipOptions kaiser = { .filter = MipFilter::Kaiser, .srgb = true, .alpha_weighted = true };
+	std::printf("simd vs scalar max difference: box %zu, box srgb %zu, kaiser srgb %zu\n\n",
+		max_difference(reference.generate(image.data(), size, size, MipFormat::RGBA8), simd.generate(image.data(), size, size, MipFormat::RGBA8)),
+		max_difference(reference.generate(image.data(), size, size, MipFormat::RGBA8, srgb), simd.generate(image.data(), size, size, MipFormat::RGBA8, srgb)),
+		max_difference(reference.generate(image.data(), size, size, MipFormat::RGBA8, kaiser), simd.generate(image.data(), size, size, MipFormat::RGBA8, kaiser)));
+
+	//RGBA16F copy of the image, scaled up to HDR values
+	std::vector<uint16_t> hdr(image.size());
+	for(size_t i = 0; i < image.size(); i++) hdr[i] = mip_detail::float_to_half(image[i] / 32.0f);
+
+	BenchTable table("mip chain");
+	table.row("box scalar", pixels, [&]{ reference.generate(image.data(), size, size, MipFormat::RGBA8); });
+	table.row("box simd", pixels, [&]{ simd.generate(image.data(), size, size, MipFormat::RGBA8); });
+	table.row("box simd, pool", pixels, [&]{ threaded.generate(image.data(), size, size, MipFormat::RGBA8); });
+
+	table.row("box srgb scalar", pixels, [&]{ reference.generate(image.data(), size, size, MipFormat::RGBA8, srgb); });
+	table.row("box srgb simd", pixels, [&]{ simd.generate(image.data(), size, size, MipFormat::RGBA8, srgb); });
+	table.row("box srgb simd, pool", pixels, [&]{ threaded.generate(image.data(), size, size, MipFormat::RGBA8, srgb); });
+
+	table.row("kaiser srgb scalar", pixels, [&]{ reference.generate(image.data(), size, size, MipFormat::RGBA8, kaiser); });
+	table.row("kaiser srgb simd", pixels, [&]{ simd.generate(image.data(), size, size, MipFormat::RGBA8, kaiser); });
+	table.row("kaiser srgb simd, pool", pixels, [&]{ threaded.generate(image.data(), size, size, MipFormat::RGBA8, kaiser); });
+
+	table.row("rgba16f box scalar", pixels, [&]{ reference.generate(hdr.data(), size, size, MipFormat::RGBA16F); });
+	table.row("rgba16f box simd", pixels, [&]{ simd.generate(hdr.data(), size, size, MipFormat::RGBA16F); });
+	MipOptions lanczos = { .filter = MipFilter::Lanczos };
+	table.row("rgba16f lanczos scalar", pixels, [&]{ reference.generate(hdr.data(), size, size, MipFormat::RGBA16F, lanczos); });
+	table.row("rgba16f lanczos simd", pixels, [&]{ simd.generate(hdr.data(), size, size, MipFormat::RGBA16F, lanczos); });
+
+	if(try_create_test_context()){
+		std::printf("%s\n", (const char*)glGetString(GL_RENDERER));
+		TextureInstance texture(TextureType::Tex2D);
+		texture.storage(mip_levels(size, size), GL_RGBA8, size, size);
+		texture.update({ .width = size, .height = size, .format = GL_RGBA, .datatype = GL_UNSIGNED_BYTE }, image.data());
+		glFinish();
+
+		table.row("glGenerateMipmap", pixels, [&]{
+			texture.generate_mipmaps();
+			glFinish();
+		});
+		table.row("box simd, pool +upload", pixels, [&]{
+			threaded.generate(image.data(), size, size, MipFormat::RGBA8).upload(texture);
+			glFinish();
+		});
+	}
+	table.print();
+	return 0;
+}
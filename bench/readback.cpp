@@ -0,0 +1,73 @@
+/**
+ * @brief ReadbackQueue against a synchronous glReadPixels, at 1080p and 4K
+ *
+ *   g++ -std=c++20 -O2 -fpermissive -Iinclude bench/readback.cpp -o readback_bench -lGLEW -lEGL -lGL -pthread && ./readback_bench
+ *
+ * every run is one frame: a clear of the color target, then a read of all of it. the `ring` rows time
+ * the render thread only, reads are delivered by `update()` a few frames later, `ring + finish` waits
+ * for its own read like the synchronous one does. needs a GL context.
+ *
+ * on llvmpipe the pixels are copied on the CPU inside glReadPixels whether a pack buffer is bound or
+ * not, so the ring can't overlap anything and only adds the copy out of it. the render thread gain
+ * needs a driver that copies asynchronously (a GPU DMA), there the `ring` row is the issue cost alone.
+*/
+#include "../tests/gl_test.hpp"
+#include "bench.hpp"
+#include "opengl/framebuffer.hpp"
+#include "opengl/readback.hpp"
+#include <cstring>
+#include <string>
+
+static void frame(FramebufferInstance& framebuffer, uint32_t index){
+	framebuffer.bind_draw();
+	glClearColor((index & 0xff) / 255.0f, 0.5f, 0.25f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+static void bench_size(size_t width, size_t height){
+	RenderTargetPool targets;
+	RenderTarget& color = targets.acquire({ .width = width, .height = height, .internal_format = GL_RGBA8 });
+	FramebufferInstance& framebuffer = targets.framebuffer({ &color });
+	size_t bytes = width * height * 4;
+	std::vector<uint8_t> pixels(bytes);
+	uint32_t index = 0;
+	auto copy = [&](const void* data, size_t size){ std::memcpy(pixels.data(), data, size); };
+
+	BenchTable table(std::to_string(width) + "x" + std::to_string(height) + " RGBA8");
+	double frame_pixels = (double)width * height;
+	table.row("glReadPixels, sync", frame_pixels, [&]{
+		frame(framebuffer, index++);
+		framebuffer.bind_read();
+		glReadPixels(0, 0, (int32_t)width, (int32_t)height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	});
+
+	//three frames in flight
+	ReadbackQueue queue(3 * bytes);
+	table.row("ring", frame_pixels, [&]{
+		frame(framebuffer, index++);
+		framebuffer.bind_read();
+		queue.read_pixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, copy);
+		queue.update();
+	});
+	queue.finish();
+	const ReadbackQueue::Stats stats = queue.stats();
+	queue.reset_stats();
+
+	table.row("ring + finish", frame_pixels, [&]{
+		frame(framebuffer, index++);
+		framebuffer.bind_read();
+		queue.read_pixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, copy);
+		queue.finish();
+	});
+	table.print();
+	std::printf("ring: %.2f frames average latency, %llu of %llu reads stalled on a full ring\n\n",
+		stats.average_latency(), (unsigned long long)stats.stalls, (unsigned long long)stats.requested);
+}
+
+int main(){
+	if(!try_create_test_context()) return 1;
+	std::printf("%s\n\n", (const char*)glGetString(GL_RENDERER));
+	bench_size(1920, 1080);
+	bench_size(3840, 2160);
+	return 0;
+}
@@ -0,0 +1,815 @@
+#pragma once
+#include "texture.hpp"
+#include "utils/thread_pool.hpp"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_ENCODER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define BLOCK_ENCODER_NEON 1
+#include <arm_neon.h>
+#endif
+
+enum class BlockFormat: uint8_t {
+	BC1, //RGB, alpha is ignored
+	BC3, //RGBA
+	BC4, //R
+	BC5, //RG
+	BC7  //RGBA, mode 6
+};
+
+enum class BlockQuality: uint8_t {
+	Fast,   //bounding box endpoints
+	Normal, //principal axis endpoints
+	High    //principal axis plus least squares refinement and endpoint search
+};
+
+inline size_t block_format_bytes(BlockFormat format){
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+inline uint32_t block_format_gl(BlockFormat format, bool srgb = false){
+	switch(format){
+		case BlockFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+	return 0;
+}
+
+/**
+ * @brief block compressed image ready for `TextureInstance::compressed_update`
+*/
+struct CompressedImage {
+	BlockFormat format = BlockFormat::BC7;
+	bool srgb = false;
+	size_t width = 0, height = 0;
+	std::vector<uint8_t> data;
+
+	inline uint32_t gl_format() const { return block_format_gl(format, srgb); }
+
+	/**
+	 * @brief uploads into `level` of storage allocated with `gl_format()`
+	 * @param layer array layer (or cube face) receiving the image
+	*/
+	void upload(TextureInstance& texture, int level = 0, size_t layer = 0) const {
+		TextureRegion region = { .level = level, .width = width, .height = height, .format = gl_format() };
+		if(texture.texture_type() == TextureType::Tex1DArray) region.y = layer;
+		else region.z = layer;
+		texture.compressed_update(region, data.data(), data.size());
+	}
+};
+
+namespace bc_detail {
+	/**
+	 * @brief per channel minimum and maximum of a 4x4 RGBA block
+	*/
+	inline void block_bounds(const uint8_t block[64], uint8_t min[4], uint8_t max[4]){
+		#if defined(BLOCK_ENCODER_SSE2)
+		__m128i r0 = _mm_loadu_si128((const __m128i*)block), r1 = _mm_loadu_si128((const __m128i*)(block + 16));
+		__m128i r2 = _mm_loadu_si128((const __m128i*)(block + 32)), r3 = _mm_loadu_si128((const __m128i*)(block + 48));
+		__m128i lo = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+		__m128i hi = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+		lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+		hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+		lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+		hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+		uint32_t packed_min = (uint32_t)_mm_cvtsi128_si32(lo), packed_max = (uint32_t)_mm_cvtsi128_si32(hi);
+		memcpy(min, &packed_min, 4);
+		memcpy(max, &packed_max, 4);
+		#elif defined(BLOCK_ENCODER_NEON)
+		uint8x16_t r0 = vld1q_u8(block), r1 = vld1q_u8(block + 16), r2 = vld1q_u8(block + 32), r3 = vld1q_u8(block + 48);
+		uint8x16_t lo = vminq_u8(vminq_u8(r0, r1), vminq_u8(r2, r3));
+		uint8x16_t hi = vmaxq_u8(vmaxq_u8(r0, r1), vmaxq_u8(r2, r3));
+		uint8x8_t lo8 = vmin_u8(vget_low_u8(lo), vget_high_u8(lo));
+		uint8x8_t hi8 = vmax_u8(vget_low_u8(hi), vget_high_u8(hi));
+		lo8 = vmin_u8(lo8, vext_u8(lo8, lo8, 4));
+		hi8 = vmax_u8(hi8, vext_u8(hi8, hi8, 4));
+		uint8_t lanes[8];
+		vst1_u8(lanes, lo8);
+		memcpy(min, lanes, 4);
+		vst1_u8(lanes, hi8);
+		memcpy(max, lanes, 4);
+		#else
+		for(size_t c = 0; c < 4; c++){
+			min[c] = 255;
+			max[c] = 0;
+		}
+		for(size_t i = 0; i < 16; i++){
+			for(size_t c = 0; c < 4; c++){
+				min[c] = std::min(min[c], block[i * 4 + c]);
+				max[c] = std::max(max[c], block[i * 4 + c]);
+			}
+		}
+		#endif
+	}
+
+	/**
+	 * @brief bounding box corners, each channel is flipped to follow its correlation with the first one
+	*/
+	template<size_t N>
+	void box_endpoints(const float pixels[16][4], const uint8_t min[4], const uint8_t max[4], float inset, float e0[4], float e1[4]){
+		float center[4];
+		for(size_t c = 0; c < N; c++){
+			float range = (max[c] - min[c]) * inset;
+			e0[c] = max[c] - range;
+			e1[c] = min[c] + range;
+			center[c] = (min[c] + max[c]) * 0.5f;
+		}
+		for(size_t c = 1; c < N; c++){
+			float covariance = 0.0f;
+			for(size_t i = 0; i < 16; i++) covariance += (pixels[i][0] - center[0]) * (pixels[i][c] - center[c]);
+			if(covariance < 0.0f) std::swap(e0[c], e1[c]);
+		}
+	}
+
+	/**
+	 * @brief extremes of the block along its principal axis
+	*/
+	template<size_t N>
+	void principal_endpoints(const float pixels[16][4], const uint8_t min[4], const uint8_t max[4], float e0[4], float e1[4]){
+		float mean[N] = {};
+		for(size_t i = 0; i < 16; i++) for(size_t c = 0; c < N; c++) mean[c] += pixels[i][c];
+		for(size_t c = 0; c < N; c++) mean[c] /= 16.0f;
+
+		float covariance[N][N] = {};
+		for(size_t i = 0; i < 16; i++){
+			for(size_t a = 0; a < N; a++){
+				for(size_t b = a; b < N; b++) covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+			}
+		}
+		for(size_t a = 0; a < N; a++) for(size_t b = 0; b < a; b++) covariance[a][b] = covariance[b][a];
+
+		//power iteration seeded with the bounding box diagonal
+		float axis[N];
+		for(size_t c = 0; c < N; c++) axis[c] = (float)(max[c] - min[c]) + 1e-3f;
+		for(int iteration = 0; iteration < 8; iteration++){
+			float next[N] = {};
+			for(size_t a = 0; a < N; a++) for(size_t b = 0; b < N; b++) next[a] += covariance[a][b] * axis[b];
+			float length = 0.0f;
+			for(size_t c = 0; c < N; c++) length = std::max(length, std::abs(next[c]));
+			if(length < 1e-6f) break;
+			for(size_t c = 0; c < N; c++) axis[c] = next[c] / length;
+		}
+		float length = 0.0f;
+		for(size_t c = 0; c < N; c++) length += axis[c] * axis[c];
+		if(length < 1e-12f){
+			for(size_t c = 0; c < N; c++) e0[c] = e1[c] = mean[c];
+			return;
+		}
+		for(size_t c = 0; c < N; c++) axis[c] /= std::sqrt(length);
+
+		float low = 0.0f, high = 0.0f;
+		for(size_t i = 0; i < 16; i++){
+			float t = 0.0f;
+			for(size_t c = 0; c < N; c++) t += (pixels[i][c] - mean[c]) * axis[c];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+		for(size_t c = 0; c < N; c++){
+			e0[c] = std::clamp(mean[c] + axis[c] * high, 0.0f, 255.0f);
+			e1[c] = std::clamp(mean[c] + axis[c] * low, 0.0f, 255.0f);
+		}
+	}
+
+	/**
+	 * @brief endpoints minimizing the squared error for fixed interpolation weights (0 is `e0`, 1 is `e1`)
+	 * @return false if the system is degenerate
+	*/
+	template<size_t N>
+	bool least_squares(const float pixels[16][4], const float weights[16], float e0[4], float e1[4]){
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+		float x[N] = {}, y[N] = {};
+		for(size_t i = 0; i < 16; i++){
+			float t = weights[i], s = 1.0f - t;
+			a += s * s;
+			b += s * t;
+			c += t * t;
+			for(size_t k = 0; k < N; k++){
+				x[k] += s * pixels[i][k];
+				y[k] += t * pixels[i][k];
+			}
+		}
+		float determinant = a * c - b * b;
+		if(std::abs(determinant) < 1e-6f) return false;
+		for(size_t k = 0; k < N; k++){
+			e0[k] = std::clamp((c * x[k] - b * y[k]) / determinant, 0.0f, 255.0f);
+			e1[k] = std::clamp((a * y[k] - b * x[k]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	inline uint16_t pack565(const float color[4]){
+		uint32_t r = (uint32_t)std::lround(color[0] * 31.0f / 255.0f);
+		uint32_t g = (uint32_t)std::lround(color[1] * 63.0f / 255.0f);
+		uint32_t b = (uint32_t)std::lround(color[2] * 31.0f / 255.0f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	inline void unpack565(uint16_t value, int32_t color[3]){
+		int32_t r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	/**
+	 * @brief nearest of `count` palette entries for each texel, by squared distance over the first N channels
+	 * @return the summed squared error of the block
+	 * @note ties go to the lower entry. the SIMD paths square 16 bit differences four texels at a time
+	 * and pair the channel sums (`_mm_madd_epi16`, `vpaddq_s32`), the results match the scalar loop
+	*/
+	template<size_t N>
+	uint32_t nearest_entries(const float pixels[16][4], const int32_t palette[][N], size_t count, uint8_t indices[16]){
+		#if defined(BLOCK_ENCODER_SSE2) || defined(BLOCK_ENCODER_NEON)
+		int16_t texels[16][4] = {}; //channels past N stay 0 on both sides of the difference
+		for(size_t i = 0; i < 16; i++) for(size_t c = 0; c < N; c++) texels[i][c] = (int16_t)pixels[i][c];
+		int16_t entries[16][4] = {};
+		for(size_t k = 0; k < count; k++) for(size_t c = 0; c < N; c++) entries[k][c] = (int16_t)palette[k][c];
+		#endif
+
+		#if defined(BLOCK_ENCODER_SSE2)
+		__m128i rows[8], best[4], index[4];
+		for(size_t r = 0; r < 8; r++) rows[r] = _mm_loadu_si128((const __m128i*)texels[2 * r]);
+		for(size_t k = 0; k < count; k++){
+			__m128i color = _mm_loadl_epi64((const __m128i*)entries[k]);
+			color = _mm_unpacklo_epi64(color, color);
+			__m128i number = _mm_set1_epi32((int)k);
+			for(size_t g = 0; g < 4; g++){
+				__m128i d0 = _mm_sub_epi16(rows[2 * g], color), d1 = _mm_sub_epi16(rows[2 * g + 1], color);
+				//texel pairs of channel pairs, the even and odd lanes add up to one error per texel
+				__m128 s0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0)), s1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+				__m128i error = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))), _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+				if(k == 0){
+					best[g] = error;
+					index[g] = _mm_setzero_si128();
+					continue;
+				}
+				__m128i closer = _mm_cmplt_epi32(error, best[g]);
+				best[g] = _mm_or_si128(_mm_and_si128(closer, error), _mm_andnot_si128(closer, best[g]));
+				index[g] = _mm_or_si128(_mm_and_si128(closer, number), _mm_andnot_si128(closer, index[g]));
+			}
+		}
+		_mm_storeu_si128((__m128i*)indices, _mm_packus_epi16(_mm_packs_epi32(index[0], index[1]), _mm_packs_epi32(index[2], index[3])));
+		__m128i sum = _mm_add_epi32(_mm_add_epi32(best[0], best[1]), _mm_add_epi32(best[2], best[3]));
+		sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+		sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+		return (uint32_t)_mm_cvtsi128_si32(sum);
+		#elif defined(BLOCK_ENCODER_NEON)
+		int16x8_t rows[8];
+		uint32x4_t best[4], index[4];
+		for(size_t r = 0; r < 8; r++) rows[r] = vld1q_s16(texels[2 * r]);
+		for(size_t k = 0; k < count; k++){
+			int16x4_t entry = vld1_s16(entries[k]);
+			int16x8_t color = vcombine_s16(entry, entry);
+			uint32x4_t number = vdupq_n_u32((uint32_t)k);
+			for(size_t g = 0; g < 4; g++){
+				int16x8_t d0 = vsubq_s16(rows[2 * g], color), d1 = vsubq_s16(rows[2 * g + 1], color);
+				int32x4_t s0 = vpaddq_s32(vmull_s16(vget_low_s16(d0), vget_low_s16(d0)), vmull_high_s16(d0, d0));
+				int32x4_t s1 = vpaddq_s32(vmull_s16(vget_low_s16(d1), vget_low_s16(d1)), vmull_high_s16(d1, d1));
+				uint32x4_t error = vreinterpretq_u32_s32(vpaddq_s32(s0, s1));
+				if(k == 0){
+					best[g] = error;
+					index[g] = vdupq_n_u32(0);
+					continue;
+				}
+				uint32x4_t closer = vcltq_u32(error, best[g]);
+				best[g] = vminq_u32(error, best[g]);
+				index[g] = vbslq_u32(closer, number, index[g]);
+			}
+		}
+		uint16x8_t low = vcombine_u16(vmovn_u32(index[0]), vmovn_u32(index[1])), high = vcombine_u16(vmovn_u32(index[2]), vmovn_u32(index[3]));
+		vst1q_u8(indices, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+		return vaddvq_u32(vaddq_u32(vaddq_u32(best[0], best[1]), vaddq_u32(best[2], best[3])));
+		#else
+		uint32_t total = 0;
+		for(size_t i = 0; i < 16; i++){
+			uint32_t best = ~0u;
+			for(size_t k = 0; k < count; k++){
+				uint32_t error = 0;
+				for(size_t c = 0; c < N; c++){
+					int32_t d = (int32_t)pixels[i][c] - palette[k][c];
+					error += d * d;
+				}
+				if(error < best){
+					best = error;
+					indices[i] = (uint8_t)k;
+				}
+			}
+			total += best;
+		}
+		return total;
+		#endif
+	}
+
+	struct BC1Fit {
+		uint16_t c0 = 0, c1 = 0;
+		uint8_t indices[16] = {};
+		uint32_t error = ~0u;
+	};
+
+	/**
+	 * @brief quantizes endpoints and picks indices, always in 4 color mode (c0 > c1)
+	*/
+	inline BC1Fit bc1_fit(const float pixels[16][4], const float e0[4], const float e1[4]){
+		BC1Fit fit;
+		fit.c0 = pack565(e0);
+		fit.c1 = pack565(e1);
+		if(fit.c0 < fit.c1) std::swap(fit.c0, fit.c1);
+
+		int32_t palette[4][3];
+		unpack565(fit.c0, palette[0]);
+		unpack565(fit.c1, palette[1]);
+		for(size_t c = 0; c < 3; c++){
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		//equal endpoints mean 3 color mode, where index 3 is black
+		size_t colors = fit.c0 == fit.c1 ? 1 : 4;
+
+		fit.error = nearest_entries<3>(pixels, palette, colors, fit.indices);
+		return fit;
+	}
+
+	inline void bc1_encode(const uint8_t block[64], BlockQuality quality, uint8_t out[8]){
+		float pixels[16][4];
+		for(size_t i = 0; i < 16; i++) for(size_t c = 0; c < 4; c++) pixels[i][c] = block[i * 4 + c];
+		uint8_t min[4], max[4];
+		block_bounds(block, min, max);
+
+		float e0[4], e1[4];
+		if(quality == BlockQuality::Fast) box_endpoints<3>(pixels, min, max, 1.0f / 16.0f, e0, e1);
+		else principal_endpoints<3>(pixels, min, max, e0, e1);
+		BC1Fit best = bc1_fit(pixels, e0, e1);
+
+		if(quality == BlockQuality::High){
+			static constexpr float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for(int iteration = 0; iteration < 2 && best.error > 0; iteration++){
+				float t[16];
+				for(size_t i = 0; i < 16; i++) t[i] = weights[best.indices[i]];
+				if(!least_squares<3>(pixels, t, e0, e1)) break;
+				BC1Fit fit = bc1_fit(pixels, e0, e1);
+				if(fit.error >= best.error) break;
+				best = fit;
+			}
+		}
+
+		uint32_t indices = 0;
+		for(size_t i = 0; i < 16; i++) indices |= (uint32_t)best.indices[i] << (2 * i);
+		memcpy(out, &best.c0, 2);
+		memcpy(out + 2, &best.c1, 2);
+		memcpy(out + 4, &indices, 4);
+	}
+
+	inline void bc4_palette(uint8_t a0, uint8_t a1, int32_t palette[8]){
+		palette[0] = a0;
+		palette[1] = a1;
+		if(a0 > a1){
+			for(int32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+		} else {
+			for(int32_t i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	struct BC4Fit {
+		uint8_t a0 = 0, a1 = 0;
+		uint8_t indices[16] = {};
+		uint32_t error = ~0u;
+	};
+
+	inline BC4Fit bc4_fit(const uint8_t values[16], uint8_t a0, uint8_t a1){
+		BC4Fit fit = { .a0 = a0, .a1 = a1, .error = 0 };
+		int32_t palette[8];
+		bc4_palette(a0, a1, palette);
+		#if defined(BLOCK_ENCODER_SSE2)
+		//the nearest value by absolute difference is the nearest by squared one, 16 texels per register
+		__m128i v = _mm_loadu_si128((const __m128i*)values), ones = _mm_set1_epi8(-1);
+		__m128i best = _mm_setzero_si128(), index = _mm_setzero_si128();
+		for(size_t k = 0; k < 8; k++){
+			__m128i entry = _mm_set1_epi8((char)palette[k]);
+			__m128i distance = _mm_or_si128(_mm_subs_epu8(v, entry), _mm_subs_epu8(entry, v));
+			__m128i closer = k == 0 ? ones : _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(distance, best), distance), ones);
+			best = _mm_min_epu8(distance, k == 0 ? distance : best);
+			index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)k)), _mm_andnot_si128(closer, index));
+		}
+		_mm_storeu_si128((__m128i*)fit.indices, index);
+		__m128i low = _mm_unpacklo_epi8(best, _mm_setzero_si128()), high = _mm_unpackhi_epi8(best, _mm_setzero_si128());
+		__m128i sum = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+		sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+		sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+		fit.error = (uint32_t)_mm_cvtsi128_si32(sum);
+		#elif defined(BLOCK_ENCODER_NEON)
+		uint8x16_t v = vld1q_u8(values), best = vdupq_n_u8(255), index = vdupq_n_u8(0);
+		for(size_t k = 0; k < 8; k++){
+			uint8x16_t distance = vabdq_u8(v, vdupq_n_u8((uint8_t)palette[k]));
+			uint8x16_t closer = k == 0 ? vdupq_n_u8(255) : vcltq_u8(distance, best);
+			best = vminq_u8(distance, best);
+			index = vbslq_u8(closer, vdupq_n_u8((uint8_t)k), index);
+		}
+		vst1q_u8(fit.indices, index);
+		uint16x8_t low = vmull_u8(vget_low_u8(best), vget_low_u8(best)), high = vmull_high_u8(best, best);
+		fit.error = vaddvq_u32(vaddq_u32(vpaddlq_u16(low), vpaddlq_u16(high)));
+		#else
+		for(size_t i = 0; i < 16; i++){
+			uint32_t best = ~0u;
+			for(size_t k = 0; k < 8; k++){
+				int32_t d = (int32_t)values[i] - palette[k];
+				if((uint32_t)(d * d) < best){
+					best = d * d;
+					fit.indices[i] = (uint8_t)k;
+				}
+			}
+			fit.error += best;
+		}
+		#endif
+		return fit;
+	}
+
+	/**
+	 * @brief one 8 byte single channel block, shared by BC3 alpha, BC4 and BC5
+	*/
+	inline void bc4_encode(const uint8_t values[16], BlockQuality quality, uint8_t out[8]){
+		uint8_t min = 255, max = 0;
+		#if defined(BLOCK_ENCODER_SSE2)
+		__m128i v = _mm_loadu_si128((const __m128i*)values);
+		__m128i lo = _mm_min_epu8(v, _mm_srli_si128(v, 8)), hi = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+		lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+		hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+		lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 2));
+		hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 2));
+		lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 1));
+		hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 1));
+		min = (uint8_t)_mm_cvtsi128_si32(lo);
+		max = (uint8_t)_mm_cvtsi128_si32(hi);
+		#elif defined(BLOCK_ENCODER_NEON)
+		uint8x16_t v = vld1q_u8(values);
+		min = vminvq_u8(v);
+		max = vmaxvq_u8(v);
+		#else
+		for(size_t i = 0; i < 16; i++){
+			min = std::min(min, values[i]);
+			max = std::max(max, values[i]);
+		}
+		#endif
+
+		BC4Fit best;
+		if(min == max){
+			best = { .a0 = min, .a1 = min, .error = 0 };
+		} else {
+			best = bc4_fit(values, max, min);
+			if(quality == BlockQuality::High){
+				//endpoint neighbourhood in 8 value mode
+				for(int32_t d0 = 0; d0 <= 2 && best.error > 0; d0++){
+					for(int32_t d1 = 0; d1 <= 2; d1++){
+						int32_t a0 = max - d0, a1 = min + d1;
+						if(a0 <= a1 || (d0 == 0 && d1 == 0)) continue;
+						BC4Fit fit = bc4_fit(values, (uint8_t)a0, (uint8_t)a1);
+						if(fit.error < best.error) best = fit;
+					}
+				}
+				//6 value mode keeps exact 0 and 255 next to a tighter range
+				uint8_t inner_min = 255, inner_max = 0;
+				for(size_t i = 0; i < 16; i++){
+					if(values[i] == 0 || values[i] == 255) continue;
+					inner_min = std::min(inner_min, values[i]);
+					inner_max = std::max(inner_max, values[i]);
+				}
+				if(inner_min <= inner_max && (min == 0 || max == 255)){
+					BC4Fit fit = bc4_fit(values, inner_min, inner_max);
+					if(fit.error < best.error) best = fit;
+				}
+			}
+		}
+
+		uint64_t bits = 0;
+		for(size_t i = 0; i < 16; i++) bits |= (uint64_t)best.indices[i] << (3 * i);
+		out[0] = best.a0;
+		out[1] = best.a1;
+		for(size_t i = 0; i < 6; i++) out[2 + i] = (uint8_t)(bits >> (8 * i));
+	}
+
+	static constexpr int32_t bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct BC7Fit {
+		uint8_t q0[4] = {}, q1[4] = {}; //7 bit endpoints
+		uint8_t p0 = 0, p1 = 0;
+		uint8_t indices[16] = {};
+		uint32_t error = ~0u;
+	};
+
+	/**
+	 * @brief 7 bit endpoint and p-bit closest to an 8 bit RGBA color
+	*/
+	inline void bc7_quantize(const float color[4], uint8_t q[4], uint8_t& p){
+		uint32_t best = ~0u;
+		for(uint8_t bit = 0; bit < 2; bit++){
+			uint8_t candidate[4];
+			uint32_t error = 0;
+			for(size_t c = 0; c < 4; c++){
+				candidate[c] = (uint8_t)std::clamp<long>(std::lround((color[c] - bit) * 0.5f), 0, 127);
+				int32_t d = (candidate[c] * 2 + bit) - (int32_t)std::lround(color[c]);
+				error += d * d;
+			}
+			if(error < best){
+				best = error;
+				memcpy(q, candidate, 4);
+				p = bit;
+			}
+		}
+	}
+
+	inline BC7Fit bc7_fit(const float pixels[16][4], const float e0[4], const float e1[4]){
+		BC7Fit fit;
+		bc7_quantize(e0, fit.q0, fit.p0);
+		bc7_quantize(e1, fit.q1, fit.p1);
+
+		int32_t a[4], b[4], palette[16][4];
+		for(size_t c = 0; c < 4; c++){
+			a[c] = fit.q0[c] * 2 + fit.p0;
+			b[c] = fit.q1[c] * 2 + fit.p1;
+		}
+		for(size_t k = 0; k < 16; k++){
+			for(size_t c = 0; c < 4; c++) palette[k][c] = ((64 - bc7_weights[k]) * a[c] + bc7_weights[k] * b[c] + 32) >> 6;
+		}
+
+		fit.error = nearest_entries<4>(pixels, palette, 16, fit.indices);
+		return fit;
+	}
+
+	struct BitWriter {
+		uint8_t* out;
+		size_t position = 0;
+
+		inline void put(uint32_t value, size_t bits){
+			for(size_t i = 0; i < bits; i++, position++){
+				if((value >> i) & 1) out[position >> 3] |= (uint8_t)(1 << (position & 7));
+			}
+		}
+	};
+
+	struct BitReader {
+		const uint8_t* in;
+		size_t position = 0;
+
+		inline uint32_t get(size_t bits){
+			uint32_t value = 0;
+			for(size_t i = 0; i < bits; i++, position++) value |= (uint32_t)((in[position >> 3] >> (position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	inline void bc7_encode(const uint8_t block[64], BlockQuality quality, uint8_t out[16]){
+		float pixels[16][4];
+		for(size_t i = 0; i < 16; i++) for(size_t c = 0; c < 4; c++) pixels[i][c] = block[i * 4 + c];
+		uint8_t min[4], max[4];
+		block_bounds(block, min, max);
+
+		float e0[4], e1[4];
+		if(quality == BlockQuality::Fast) box_endpoints<4>(pixels, min, max, 0.0f, e0, e1);
+		else principal_endpoints<4>(pixels, min, max, e0, e1);
+		BC7Fit best = bc7_fit(pixels, e0, e1);
+
+		if(quality == BlockQuality::High){
+			for(int iteration = 0; iteration < 2 && best.error > 0; iteration++){
+				float t[16];
+				for(size_t i = 0; i < 16; i++) t[i] = bc7_weights[best.indices[i]] / 64.0f;
+				if(!least_squares<4>(pixels, t, e0, e1)) break;
+				BC7Fit fit = bc7_fit(pixels, e0, e1);
+				if(fit.error >= best.error) break;
+				best = fit;
+			}
+		}
+
+		//the anchor index is stored without its high bit
+		if(best.indices[0] & 8){
+			std::swap(best.q0, best.q1);
+			std::swap(best.p0, best.p1);
+			for(auto& index: best.indices) index = 15 - index;
+		}
+
+		memset(out, 0, 16);
+		BitWriter writer = { out };
+		writer.put(1 << 6, 7);
+		for(size_t c = 0; c < 4; c++){
+			writer.put(best.q0[c], 7);
+			writer.put(best.q1[c], 7);
+		}
+		writer.put(best.p0, 1);
+		writer.put(best.p1, 1);
+		writer.put(best.indices[0], 3);
+		for(size_t i = 1; i < 16; i++) writer.put(best.indices[i], 4);
+	}
+
+	inline void bc1_decode(const uint8_t in[8], uint8_t block[64], bool force_four_colors){
+		uint16_t c0, c1;
+		uint32_t indices;
+		memcpy(&c0, in, 2);
+		memcpy(&c1, in + 2, 2);
+		memcpy(&indices, in + 4, 4);
+		int32_t palette[4][4];
+		unpack565(c0, palette[0]);
+		unpack565(c1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+		for(size_t c = 0; c < 3; c++){
+			if(c0 > c1 || force_four_colors){
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			} else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		if(c0 <= c1 && !force_four_colors) palette[3][3] = 0;
+		for(size_t i = 0; i < 16; i++) for(size_t c = 0; c < 4; c++) block[i * 4 + c] = (uint8_t)palette[(indices >> (2 * i)) & 3][c];
+	}
+
+	inline void bc4_decode(const uint8_t in[8], uint8_t* values, size_t stride){
+		int32_t palette[8];
+		bc4_palette(in[0], in[1], palette);
+		uint64_t bits = 0;
+		for(size_t i = 0; i < 6; i++) bits |= (uint64_t)in[2 + i] << (8 * i);
+		for(size_t i = 0; i < 16; i++) values[i * stride] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+	}
+
+	/**
+	 * @return false for modes other than 6
+	*/
+	inline bool bc7_decode(const uint8_t in[16], uint8_t block[64]){
+		if((in[0] & 0x7f) != (1 << 6)) return false;
+		BitReader reader = { in, 7 };
+		int32_t e[2][4];
+		for(size_t c = 0; c < 4; c++){
+			e[0][c] = reader.get(7) << 1;
+			e[1][c] = reader.get(7) << 1;
+		}
+		uint32_t p0 = reader.get(1), p1 = reader.get(1);
+		for(size_t c = 0; c < 4; c++){
+			e[0][c] |= p0;
+			e[1][c] |= p1;
+		}
+		for(size_t i = 0; i < 16; i++){
+			uint32_t index = reader.get(i == 0 ? 3 : 4);
+			for(size_t c = 0; c < 4; c++) block[i * 4 + c] = (uint8_t)(((64 - bc7_weights[index]) * e[0][c] + bc7_weights[index] * e[1][c] + 32) >> 6);
+		}
+		return true;
+	}
+}
+
+/**
+ * @brief encodes images produced at runtime (baked lightmaps, generated atlases) into BC blocks
+ *
+ * pure CPU code, so it runs and is testable without a GL context. block rows are split over the
+ * thread pool when one is given. BC7 is written in mode 6 (one subset, RGBA, 4 bit indices).
+ *
+ * SSE2 or NEON cover the block bounds and the per texel index search with its error sum (BC1 and
+ * BC7 over every palette entry, BC4/BC5 and BC3 alpha 16 texels per register). endpoint fitting
+ * (principal axis, least squares, quantization) stays scalar float code, it's most of the BC7 time.
+*/
+class BlockEncoder {
+	public:
+		/**
+		 * @param pool optional, the calling thread works as well so it's safe to call from a task of the same pool
+		*/
+		BlockEncoder(ThreadPool* pool = nullptr):m_pool(pool){}
+
+		/**
+		 * @param pixels tightly packed rows of `channels` (1 to 4) 8 bit components, missing ones read as 0 (alpha 255)
+		*/
+		CompressedImage encode(const void* pixels, size_t width, size_t height, size_t channels, BlockFormat format, BlockQuality quality = BlockQuality::Normal, bool srgb = false) const {
+			CompressedImage image = { .format = format, .srgb = srgb, .width = width, .height = height, .data = {} };
+			image.data.resize(encoded_size(format, width, height));
+			encode(pixels, width, height, channels, format, quality, image.data.data());
+			return image;
+		}
+
+		/**
+		 * @param out `encoded_size(format, width, height)` bytes
+		*/
+		void encode(const void* pixels, size_t width, size_t height, size_t channels, BlockFormat format, BlockQuality quality, uint8_t* out) const {
+			if(channels < 1 || channels > 4) throw std::invalid_argument("BlockEncoder: channels must be between 1 and 4");
+			size_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+			size_t block_bytes = block_format_bytes(format);
+			parallel_for(m_pool, blocks_y, 4, [&](size_t y0, size_t y1){
+				uint8_t block[64];
+				for(size_t by = y0; by < y1; by++){
+					for(size_t bx = 0; bx < blocks_x; bx++){
+						load_block((const uint8_t*)pixels, width, height, channels, bx, by, block);
+						encode_block(block, format, quality, out + (by * blocks_x + bx) * block_bytes);
+					}
+				}
+			});
+		}
+
+		/**
+		 * @brief encodes one 4x4 RGBA block, BC4 reads red and BC5 red and green
+		*/
+		static void encode_block(const uint8_t block[64], BlockFormat format, BlockQuality quality, uint8_t* out){
+			uint8_t channel[16];
+			switch(format){
+				case BlockFormat::BC1:
+					bc_detail::bc1_encode(block, quality, out);
+					break;
+				case BlockFormat::BC3:
+					for(size_t i = 0; i < 16; i++) channel[i] = block[i * 4 + 3];
+					bc_detail::bc4_encode(channel, quality, out);
+					bc_detail::bc1_encode(block, quality, out + 8);
+					break;
+				case BlockFormat::BC4:
+					for(size_t i = 0; i < 16; i++) channel[i] = block[i * 4];
+					bc_detail::bc4_encode(channel, quality, out);
+					break;
+				case BlockFormat::BC5:
+					for(size_t c = 0; c < 2; c++){
+						for(size_t i = 0; i < 16; i++) channel[i] = block[i * 4 + c];
+						bc_detail::bc4_encode(channel, quality, out + c * 8);
+					}
+					break;
+				case BlockFormat::BC7:
+					bc_detail::bc7_encode(block, quality, out);
+					break;
+			}
+		}
+
+		/**
+		 * @brief decodes one block to RGBA, channels the format lacks read as 0 (alpha 255)
+		 * @return false for BC7 modes other than 6, which this encoder doesn't produce
+		*/
+		static bool decode_block(const uint8_t* in, BlockFormat format, uint8_t block[64]){
+			switch(format){
+				case BlockFormat::BC1:
+					bc_detail::bc1_decode(in, block, false);
+					return true;
+				case BlockFormat::BC3:
+					bc_detail::bc1_decode(in + 8, block, true);
+					bc_detail::bc4_decode(in, block + 3, 4);
+					return true;
+				case BlockFormat::BC4:
+				case BlockFormat::BC5:
+					for(size_t i = 0; i < 16; i++){
+						block[i * 4 + 1] = block[i * 4 + 2] = 0;
+						block[i * 4 + 3] = 255;
+					}
+					bc_detail::bc4_decode(in, block, 4);
+					if(format == BlockFormat::BC5) bc_detail::bc4_decode(in + 8, block + 1, 4);
+					return true;
+				case BlockFormat::BC7:
+					return bc_detail::bc7_decode(in, block);
+			}
+			return false;
+		}
+
+		/**
+		 * @brief peak signal to noise ratio in dB of `image` against its source, over the channels the format stores
+		*/
+		static double psnr(const void* pixels, size_t channels, const CompressedImage& image){
+			size_t blocks_x = (image.width + 3) / 4;
+			size_t stored = image.format == BlockFormat::BC4 ? 1 : image.format == BlockFormat::BC5 ? 2 : image.format == BlockFormat::BC1 ? 3 : 4;
+			size_t compared = std::min(stored, channels);
+			size_t block_bytes = block_format_bytes(image.format);
+			double error = 0.0;
+			uint8_t source[64], decoded[64];
+			for(size_t by = 0; by < (image.height + 3) / 4; by++){
+				for(size_t bx = 0; bx < blocks_x; bx++){
+					load_block((const uint8_t*)pixels, image.width, image.height, channels, bx, by, source);
+					if(!decode_block(image.data.data() + (by * blocks_x + bx) * block_bytes, image.format, decoded)) return 0.0;
+					for(size_t i = 0; i < 16; i++){
+						size_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+						if(x >= image.width || y >= image.height) continue;
+						for(size_t c = 0; c < compared; c++){
+							double d = (double)source[i * 4 + c] - decoded[i * 4 + c];
+							error += d * d;
+						}
+					}
+				}
+			}
+			double mse = error / ((double)image.width * image.height * compared);
+			return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+		}
+
+		static size_t encoded_size(BlockFormat format, size_t width, size_t height){
+			return (width + 3) / 4 * ((height + 3) / 4) * block_format_bytes(format);
+		}
+
+	private:
+		ThreadPool* m_pool = nullptr;
+
+		/**
+		 * @brief expands a 4x4 block to RGBA, edge pixels are repeated past the image border
+		*/
+		static void load_block(const uint8_t* pixels, size_t width, size_t height, size_t channels, size_t bx, size_t by, uint8_t block[64]){
+			for(size_t i = 0; i < 16; i++){
+				size_t x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+				const uint8_t* pixel = pixels + (y * width + x) * channels;
+				uint8_t* out = block + i * 4;
+				out[0] = pixel[0];
+				out[1] = channels > 1 ? pixel[1] : 0;
+				out[2] = channels > 2 ? pixel[2] : 0;
+				out[3] = channels > 3 ? pixel[3] : 255;
+			}
+		}
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include "core.hpp"
+#include "state.hpp"
 
 enum class BufferTarget: uint32_t{
 	None,
@@ -7,6 +7,10 @@ enum class BufferTarget: uint32_t{
 	Element = GL_ELEMENT_ARRAY_BUFFER,
 	Uniform = GL_UNIFORM_BUFFER,
 	ShaderStorage = GL_SHADER_STORAGE_BUFFER,
+	DrawIndirect = GL_DRAW_INDIRECT_BUFFER,
+	Parameter = GL_PARAMETER_BUFFER,
+	PixelUnpack = GL_PIXEL_UNPACK_BUFFER,
+	PixelPack = GL_PIXEL_PACK_BUFFER,
 	Max
 };
 
@@ -35,6 +39,31 @@ enum class BufferUsage: uint32_t{
 	Max
 };
 
+enum class BufferStorageFlags: uint32_t{
+	None = 0,
+	Dynamic = GL_DYNAMIC_STORAGE_BIT,
+	Read = GL_MAP_READ_BIT,
+	Write = GL_MAP_WRITE_BIT,
+	Persistent = GL_MAP_PERSISTENT_BIT,
+	Coherent = GL_MAP_COHERENT_BIT,
+	Client = GL_CLIENT_STORAGE_BIT
+};
+
+enum class BufferMapFlags: uint32_t{
+	None = 0,
+	Read = GL_MAP_READ_BIT,
+	Write = GL_MAP_WRITE_BIT,
+	Persistent = GL_MAP_PERSISTENT_BIT,
+	Coherent = GL_MAP_COHERENT_BIT,
+	InvalidateRange = GL_MAP_INVALIDATE_RANGE_BIT,
+	InvalidateBuffer = GL_MAP_INVALIDATE_BUFFER_BIT,
+	FlushExplicit = GL_MAP_FLUSH_EXPLICIT_BIT,
+	Unsynchronized = GL_MAP_UNSYNCHRONIZED_BIT
+};
+
+inline BufferStorageFlags operator|(BufferStorageFlags a, BufferStorageFlags b){ return (BufferStorageFlags)((uint32_t)a | (uint32_t)b); }
+inline BufferMapFlags operator|(BufferMapFlags a, BufferMapFlags b){ return (BufferMapFlags)((uint32_t)a | (uint32_t)b); }
+
 struct BufferDescriptor{
 	BufferTarget target;
 	BufferUsage usage;
@@ -62,6 +91,7 @@ class BufferInstance: public Instance{
 
 		~BufferInstance(){
 			if(need_destroy()){
+				GlobalBindingCache.forget_buffer(id());
 				glDeleteBuffers(1,id_ref());
 			}
 		}
@@ -69,21 +99,36 @@ class BufferInstance: public Instance{
 		template<typename T, typename... Args>
 		void operator<<(const std::vector<T,Args...>& container){
 			#ifdef GL_LATEST_FEATURES
-				SAFE_CALL(BufferData, glNameBufferData(id(),sizeof(T)*container.size(),(void*)container.data(),(uint32_t)m_descriptor.usage) );
+				SAFE_CALL(BufferData, glNamedBufferData(id(),sizeof(T)*container.size(),(void*)container.data(),(uint32_t)m_descriptor.usage) );
 			#else
 				bind();
 				SAFE_CALL(BufferData, glBufferData((uint32_t)m_descriptor.target,sizeof(T)*container.size(),(void*)container.data(),(uint32_t)m_descriptor.usage) );
 			#endif
-			
+			m_size = sizeof(T)*container.size();
 		}
 
 		void storage(size_t sz_bytes){
 			#ifdef GL_LATEST_FEATURES
-				SAFE_CALL(BufferStorage, glNameBufferData(id(),sz_bytes,nullptr,(uint32_t)m_descriptor.usage) );
+				SAFE_CALL(BufferStorage, glNamedBufferData(id(),sz_bytes,nullptr,(uint32_t)m_descriptor.usage) );
 			#else
 				bind();
 				SAFE_CALL(BufferStorage, glBufferData((uint32_t)m_descriptor.target,sz_bytes,nullptr,(uint32_t)m_descriptor.usage) );
 			#endif
+			m_size = sz_bytes;
+		}
+
+		/**
+		 * @brief allocates storage that can't be resized later (glBufferStorage)
+		 * @note once allocated neither `storage` nor `operator<<` may be used
+		*/
+		void immutable_storage(size_t sz_bytes, BufferStorageFlags flags, const void* data = nullptr){
+			#ifdef GL_LATEST_FEATURES
+				SAFE_CALL(BufferImmutableStorage, glNamedBufferStorage(id(),sz_bytes,data,(uint32_t)flags) );
+			#else
+				bind();
+				SAFE_CALL(BufferImmutableStorage, glBufferStorage((uint32_t)m_descriptor.target,sz_bytes,data,(uint32_t)flags) );
+			#endif
+			m_size = sz_bytes;
 		}
 
 		void sub_data(void* data, size_t sz, std::ptrdiff_t offset){
@@ -106,6 +151,76 @@ class BufferInstance: public Instance{
 			return data;
 		}
 
+		/**
+		 * @brief fills the whole storage with zeros on the GPU
+		*/
+		void clear(){
+			#ifdef GL_LATEST_FEATURES
+				SAFE_CALL( BufferClear, glClearNamedBufferData(id(),GL_R8UI,GL_RED_INTEGER,GL_UNSIGNED_BYTE,nullptr) );
+			#else
+				bind();
+				SAFE_CALL( BufferClear, glClearBufferData((uint32_t)m_descriptor.target,GL_R8UI,GL_RED_INTEGER,GL_UNSIGNED_BYTE,nullptr) );
+			#endif
+		}
+
+		/**
+		 * @brief binds the whole buffer to an indexed binding point of its target (uniform, shader storage ...)
+		*/
+		inline void bind_base(uint32_t index){ bind_base(m_descriptor.target, index); }
+
+		/**
+		 * @brief binds the whole buffer to an indexed binding point of another target
+		*/
+		void bind_base(BufferTarget target, uint32_t index){
+			SAFE_CALL( BufferBindBase, glBindBufferBase((uint32_t)target, index, id()) );
+			//indexed binds also change the generic binding point
+			GlobalBindingCache.record_buffer((uint32_t)target, id());
+		}
+
+		inline void bind_range(uint32_t index, std::ptrdiff_t offset, size_t sz){ bind_range(m_descriptor.target, index, offset, sz); }
+
+		void bind_range(BufferTarget target, uint32_t index, std::ptrdiff_t offset, size_t sz){
+			SAFE_CALL( BufferBindRange, glBindBufferRange((uint32_t)target, index, id(), offset, sz) );
+			GlobalBindingCache.record_buffer((uint32_t)target, id());
+		}
+
+		/**
+		 * @brief copies a range of another buffer (or of this one if ranges don't overlap) on the GPU
+		*/
+		void copy_from(const BufferInstance& source, std::ptrdiff_t read_offset, std::ptrdiff_t write_offset, size_t sz){
+			#ifdef GL_LATEST_FEATURES
+				SAFE_CALL( BufferCopy, glCopyNamedBufferSubData(source.id(),id(),read_offset,write_offset,sz) );
+			#else
+				GlobalBindingCache.bind_buffer(GL_COPY_READ_BUFFER, source.id());
+				GlobalBindingCache.bind_buffer(GL_COPY_WRITE_BUFFER, id());
+				SAFE_CALL( BufferCopy, glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,read_offset,write_offset,sz) );
+			#endif
+		}
+
+		void* map_range(std::ptrdiff_t offset, size_t length, BufferMapFlags flags){
+			void* data = nullptr;
+			#ifdef GL_LATEST_FEATURES
+				SAFE_CALL(BufferMapRange,  data = glMapNamedBufferRange(id(),offset,length,(uint32_t)flags) );
+			#else
+				bind();
+				SAFE_CALL(BufferMapRange,  data = glMapBufferRange((uint32_t)m_descriptor.target,offset,length,(uint32_t)flags) );
+			#endif
+			return data;
+		}
+
+		/**
+		 * @brief makes writes to a range mapped with BufferMapFlags::FlushExplicit visible to the GL
+		 * @param offset relative to the start of the mapped range
+		*/
+		void flush_range(std::ptrdiff_t offset, size_t length){
+			#ifdef GL_LATEST_FEATURES
+				SAFE_CALL( BufferFlushRange, glFlushMappedNamedBufferRange(id(),offset,length) );
+			#else
+				bind();
+				SAFE_CALL( BufferFlushRange, glFlushMappedBufferRange((uint32_t)m_descriptor.target,offset,length) );
+			#endif
+		}
+
 		void unmap_memory(){
 			#ifdef GL_LATEST_FEATURES
 				SAFE_CALL( BufferUnmapMemory, glUnmapNamedBuffer(id()) );
@@ -115,8 +230,12 @@ class BufferInstance: public Instance{
 			#endif			
 		}
 
+		inline const BufferDescriptor& descriptor() const { return m_descriptor; }
+		inline size_t size() const { return m_size; }
+
 	private:
 	protected:
+		size_t m_size = 0;
 		BufferDescriptor m_descriptor = {
 			.target = BufferTarget::None,
 			.usage = BufferUsage::None,
@@ -126,28 +245,18 @@ class BufferInstance: public Instance{
 		bool validate() const override { return m_descriptor.is_valid(); }
 
 		void t_bind() override { 
-			SAFE_CALL( BufferBind, glBindBuffer( (uint32_t)m_descriptor.target, id()) );
+			if(GlobalBindingCache.update_buffer((uint32_t)m_descriptor.target, id())){
+				SAFE_CALL( BufferBind, glBindBuffer( (uint32_t)m_descriptor.target, id()) );
+			}
 		}
 
 		void t_unbind() override { 
-			SAFE_CALL( BufferUnbind,  glBindBuffer((uint32_t)m_descriptor.target, 0) ); 
+			if(GlobalBindingCache.update_buffer((uint32_t)m_descriptor.target, 0)){
+				SAFE_CALL( BufferUnbind,  glBindBuffer((uint32_t)m_descriptor.target, 0) ); 
+			}
 		}
 };
 
-//@TODO: add a simple way to stream data in and out of the buffer
-// class BufferStream {
-// 	public:
-// 		bool garante_all_access_rights = false;
-// 		BufferStream():m_access(BufferAccess::WRITE_ONLY){}
-// 		BufferStream(BufferAccess access):m_access(access){}
-// 		BufferStream operator<<(){
-// 		}
-// 		BufferStream operator>>(){
-// 		}
-// 	protected:
-// 		BufferAccess m_access;
-// };
-
 class VertexArrayInstance: public Instance{
 	public:
 		VertexArrayInstance():Instance(InstanceType::VertexArray){
@@ -157,6 +266,7 @@ class VertexArrayInstance: public Instance{
 
 		~VertexArrayInstance(){
 			if(need_destroy()){
+				GlobalBindingCache.forget_vertex_array(id());
 				glDeleteVertexArrays(1,id_ref());
 			}
 		}
@@ -164,10 +274,14 @@ class VertexArrayInstance: public Instance{
 	private:
 	protected:
 		virtual void t_bind(){ 
-			SAFE_CALL( VertexArrayBind, glBindVertexArray(id()) );
+			if(GlobalBindingCache.update_vertex_array(id())){
+				SAFE_CALL( VertexArrayBind, glBindVertexArray(id()) );
+			}
 		}
 		virtual void t_unbind(){ 
-			SAFE_CALL( VertexArrayUnbind, glBindVertexArray(0) );
+			if(GlobalBindingCache.update_vertex_array(0)){
+				SAFE_CALL( VertexArrayUnbind, glBindVertexArray(0) );
+			}
 		}
 };
 
@@ -185,6 +299,7 @@ class BufferArray: public InstanceArray<BufferInstance>{
 		}
 
 		~BufferArray(){
+			for(size_t i = 0; i < size(); i++) GlobalBindingCache.forget_buffer(ids_ref()[i]);
 			glDeleteBuffers(size(), ids_ref());
 			delete[] p_descriptors;
 		}
@@ -211,6 +326,7 @@ class VertexArrays: public InstanceArray<VertexArrayInstance>{
 		}
 
 		~VertexArrays(){
+			for(size_t i = 0; i < size(); i++) GlobalBindingCache.forget_vertex_array(ids_ref()[i]);
 			glDeleteVertexArrays(size(), ids_ref());
 		}
 
@@ -0,0 +1,293 @@
+#pragma once
+#include "draw.hpp"
+#include "shader.hpp"
+#include "texture.hpp"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 64 bit draw sort key: [ program:16 | vertex array:16 | texture set:16 | depth:16 ]
+ *
+ * sorting by the key groups draws by the most expensive state first,
+ * object names are truncated to 16 bits, which may only merge groups but never breaks replay
+*/
+namespace SortKey {
+	inline uint16_t quantize_depth(float depth){
+		if(!(depth > 0.0f)) return 0;
+		if(depth >= 1.0f) return 0xffff;
+		return (uint16_t)(depth * 65535.0f);
+	}
+
+	inline uint64_t make(uint32_t program, uint32_t vertex_array, uint16_t texture_set, float depth){
+		return ((uint64_t)(program & 0xffff) << 48) |
+			((uint64_t)(vertex_array & 0xffff) << 32) |
+			((uint64_t)texture_set << 16) |
+			(uint64_t)quantize_depth(depth);
+	}
+
+	inline uint32_t program(uint64_t key){ return (uint32_t)(key >> 48); }
+	inline uint32_t vertex_array(uint64_t key){ return (uint32_t)(key >> 32) & 0xffff; }
+	inline uint16_t texture_set(uint64_t key){ return (uint16_t)(key >> 16); }
+}
+
+/**
+ * @brief records draws and their state without touching GL
+ *
+ * state is set with the `set_*` functions and captured by `draw()`; program and vertex array
+ * stay set between draws while textures and uniforms are cleared after each draw.
+ * records live in a linear arena that keeps its memory between frames, each thread should record
+ * into its own buffer and submit it to a CommandQueue on the GL thread
+*/
+class CommandBuffer {
+	public:
+		static constexpr size_t max_textures = 16;
+
+		CommandBuffer() = default;
+		CommandBuffer(size_t reserve_bytes, size_t reserve_draws){
+			m_arena.reserve(reserve_bytes);
+			m_packets.reserve(reserve_draws);
+		}
+
+		inline void set_program(uint32_t program){ m_program = program; }
+		inline void set_program(const ShaderProgramInstance& program){ m_program = program.id(); }
+
+		inline void set_vertex_array(uint32_t vertex_array){ m_vertex_array = vertex_array; }
+		inline void set_vertex_array(const VertexArrayInstance& vertex_array){ m_vertex_array = vertex_array.id(); }
+
+		void set_texture(uint8_t unit, uint32_t target, uint32_t texture){
+			for(uint8_t i = 0; i < m_texture_count; i++){
+				if(m_textures[i].unit == unit){ m_textures[i] = { unit, target, texture }; return; }
+			}
+			if(m_texture_count == max_textures) throw std::length_error("CommandBuffer: too many textures for a single draw");
+			m_textures[m_texture_count++] = { unit, target, texture };
+		}
+		inline void set_texture(uint8_t unit, const TextureInstance& texture){ set_texture(unit, texture.target(), texture.id()); }
+
+		/**
+		 * @brief copies `count` elements of the uniform type into the record
+		*/
+		void set_uniform(const ShaderUniform& uniform, const void* data, size_t count = 1, bool transpose = false){
+			size_t bytes = uniform_type_size(uniform.type) * count;
+			if(bytes == 0){
+				LOG_ERROR( CommandBufferUniform, "No uniform type was provided");
+				return;
+			}
+			UniformRecord record = {
+				.location = uniform.id,
+				.type = uniform.type,
+				.transpose = transpose,
+				.count = (uint32_t)count,
+				.size = (uint32_t)bytes,
+				.cache = uniform.cache
+			};
+			size_t offset = m_uniforms.size();
+			m_uniforms.resize(offset + sizeof(UniformRecord) + align(bytes));
+			memcpy(m_uniforms.data() + offset, &record, sizeof(UniformRecord));
+			memcpy(m_uniforms.data() + offset + sizeof(UniformRecord), data, bytes);
+			m_uniform_count++;
+		}
+
+		template<typename T, typename... Args>
+		inline void set_uniform(const ShaderUniform& uniform, const std::vector<T,Args...>& data, bool transpose = false){
+			set_uniform(uniform, data.data(), data.size(), transpose);
+		}
+
+		/**
+		 * @brief captures the current state and the call into a sortable record
+		 * @param depth normalized [0,1] view depth, used as the last sorting criteria
+		*/
+		void draw(const DrawCall& call, float depth = 0.0f){
+			size_t offset = m_arena.size();
+			size_t textures_bytes = sizeof(TextureRecord) * m_texture_count;
+			m_arena.resize(offset + sizeof(DrawRecord) + align(textures_bytes) + m_uniforms.size());
+
+			DrawRecord record = {
+				.program = m_program,
+				.vertex_array = m_vertex_array,
+				.texture_count = m_texture_count,
+				.uniform_count = m_uniform_count,
+				.call = call
+			};
+			uint8_t* dst = m_arena.data() + offset;
+			memcpy(dst, &record, sizeof(DrawRecord));
+			dst += sizeof(DrawRecord);
+			memcpy(dst, m_textures.data(), textures_bytes);
+			dst += align(textures_bytes);
+			if(!m_uniforms.empty()) memcpy(dst, m_uniforms.data(), m_uniforms.size());
+
+			m_packets.push_back({
+				.key = SortKey::make(m_program, m_vertex_array, texture_set_hash(), depth),
+				.offset = (uint32_t)offset
+			});
+
+			m_texture_count = 0;
+			m_uniform_count = 0;
+			m_uniforms.clear();
+		}
+
+		/**
+		 * @brief drops every record keeping the allocated memory
+		*/
+		void reset(){
+			m_arena.clear();
+			m_packets.clear();
+			m_uniforms.clear();
+			m_texture_count = 0;
+			m_uniform_count = 0;
+			m_program = 0;
+			m_vertex_array = 0;
+		}
+
+		inline size_t draw_count() const { return m_packets.size(); }
+		inline size_t memory_used() const { return m_arena.size(); }
+
+	private:
+		struct TextureRecord {
+			uint8_t unit;
+			uint32_t target;
+			uint32_t id;
+		};
+
+		struct UniformRecord {
+			uint32_t location;
+			UniformType type;
+			bool transpose;
+			uint32_t count;
+			uint32_t size;
+			UniformCache* cache;
+		};
+
+		struct DrawRecord {
+			uint32_t program;
+			uint32_t vertex_array;
+			uint8_t texture_count;
+			uint16_t uniform_count;
+			DrawCall call;
+		};
+
+		struct Packet {
+			uint64_t key;
+			uint32_t offset;
+		};
+
+		static_assert(sizeof(DrawRecord) % 8 == 0 && sizeof(UniformRecord) % 8 == 0, "arena records must keep 8 byte alignment");
+
+		std::vector<uint8_t> m_arena;
+		std::vector<Packet> m_packets;
+
+		//pending state
+		uint32_t m_program = 0;
+		uint32_t m_vertex_array = 0;
+		std::array<TextureRecord, max_textures> m_textures;
+		uint8_t m_texture_count = 0;
+		std::vector<uint8_t> m_uniforms;
+		uint16_t m_uniform_count = 0;
+
+		//keeps doubles in the arena aligned
+		static inline size_t align(size_t bytes){ return (bytes + 7) & ~(size_t)7; }
+
+		uint16_t texture_set_hash() const {
+			if(m_texture_count == 0) return 0;
+			uint32_t hash = 2166136261u;
+			for(uint8_t i = 0; i < m_texture_count; i++){
+				hash = (hash ^ m_textures[i].unit) * 16777619u;
+				hash = (hash ^ m_textures[i].id) * 16777619u;
+			}
+			return (uint16_t)((hash >> 16) ^ hash) | 1;
+		}
+
+		friend class CommandQueue;
+};
+
+/**
+ * @brief merges command buffers, sorts their draws by key and replays them on the GL thread
+*/
+class CommandQueue {
+	public:
+		struct Stats {
+			size_t draws = 0;
+			size_t program_changes = 0;
+			size_t vertex_array_changes = 0;
+			size_t texture_changes = 0;
+			size_t uniform_uploads = 0;
+		};
+
+		/**
+		 * @brief queues a recorded buffer, it must stay alive and untouched until `execute()`
+		*/
+		void submit(CommandBuffer& buffer){ m_buffers.push_back(&buffer); }
+
+		/**
+		 * @brief sorts every queued draw and issues it, then resets the submitted buffers
+		 * @note the binding cache must be in sync with the context (see `BindingCache::invalidate`)
+		*/
+		const Stats& execute(){
+			m_stats = Stats{};
+
+			m_sorted.clear();
+			for(uint32_t b = 0; b < m_buffers.size(); b++){
+				const auto& packets = m_buffers[b]->m_packets;
+				for(uint32_t i = 0; i < packets.size(); i++){
+					m_sorted.push_back({ packets[i].key, b, i });
+				}
+			}
+			//submission order breaks ties so equal keys keep a deterministic order
+			std::sort(m_sorted.begin(), m_sorted.end(), [](const Entry& a, const Entry& b){
+				if(a.key != b.key) return a.key < b.key;
+				if(a.buffer != b.buffer) return a.buffer < b.buffer;
+				return a.index < b.index;
+			});
+
+			for(const Entry& entry: m_sorted){
+				const CommandBuffer& buffer = *m_buffers[entry.buffer];
+				replay(buffer.m_arena.data() + buffer.m_packets[entry.index].offset);
+			}
+
+			for(CommandBuffer* buffer: m_buffers) buffer->reset();
+			m_buffers.clear();
+			return m_stats;
+		}
+
+		inline const Stats& stats() const { return m_stats; }
+
+	private:
+		struct Entry {
+			uint64_t key;
+			uint32_t buffer;
+			uint32_t index;
+		};
+
+		std::vector<CommandBuffer*> m_buffers;
+		std::vector<Entry> m_sorted;
+		Stats m_stats;
+
+		void replay(const uint8_t* data){
+			CommandBuffer::DrawRecord record;
+			memcpy(&record, data, sizeof(record));
+			data += sizeof(record);
+
+			if(GlobalBindingCache.use_program(record.program)) m_stats.program_changes++;
+			if(GlobalBindingCache.bind_vertex_array(record.vertex_array)) m_stats.vertex_array_changes++;
+
+			size_t textures_bytes = sizeof(CommandBuffer::TextureRecord) * record.texture_count;
+			for(uint8_t i = 0; i < record.texture_count; i++){
+				CommandBuffer::TextureRecord texture;
+				memcpy(&texture, data + i * sizeof(texture), sizeof(texture));
+				if(GlobalBindingCache.bind_texture(texture.unit, texture.target, texture.id)) m_stats.texture_changes++;
+			}
+			data += CommandBuffer::align(textures_bytes);
+
+			for(uint16_t i = 0; i < record.uniform_count; i++){
+				CommandBuffer::UniformRecord uniform;
+				memcpy(&uniform, data, sizeof(uniform));
+				data += sizeof(uniform);
+				//the program is already bound, only the value cache is carried over
+				ShaderUniform target{ .type = uniform.type, .id = uniform.location, .cache = uniform.cache };
+				if(target.set_data((void*)data, uniform.count, uniform.transpose)) m_stats.uniform_uploads++;
+				data += CommandBuffer::align(uniform.size);
+			}
+
+			record.call.submit();
+			m_stats.draws++;
+		}
+};
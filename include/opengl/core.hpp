@@ -14,6 +14,18 @@ namespace g_utils {
 
 	inline bool is_error(uint32_t error){  return error != no_error; }
 
+	/**
+	 * @brief 64 bit FNV-1a, pass a previous result as `h` to hash several pieces
+	*/
+	inline uint64_t hash_bytes(const void* data, size_t sz, uint64_t h = 0xcbf29ce484222325ull){
+		const uint8_t* bytes = (const uint8_t*)data;
+		for(size_t i = 0; i < sz; i++){
+			h ^= bytes[i];
+			h *= 0x100000001b3ull;
+		}
+		return h;
+	}
+
 	inline bool has_error(uint32_t* error){ 
 		uint32_t e = glGetError();
 		if(error) *error = e;
@@ -81,6 +93,9 @@ enum class InstanceType: uint8_t {
 	VertexArray,
 	Buffer,
 	Texture,
+	Sampler,
+	Framebuffer,
+	Renderbuffer,
 	MaxType
 };
 
@@ -97,7 +112,8 @@ enum class InstanceErrorType: uint8_t {
 	Bind,
 	Unbind,
 	Attach,
-	Info
+	Info,
+	Dispatch
 };
 
 struct InstanceError: public std::exception {
@@ -111,7 +127,10 @@ struct InstanceError: public std::exception {
 			case InstanceType::ShaderProgram: buffer<<"Shader Program";break;
 			case InstanceType::VertexArray: buffer<<"Vertex Array";break;
 			case InstanceType::Buffer: buffer<<"Buffer";break;
-			case InstanceType::Texture: buffer<<"Texture";break;		
+			case InstanceType::Texture: buffer<<"Texture";break;
+			case InstanceType::Sampler: buffer<<"Sampler";break;
+			case InstanceType::Framebuffer: buffer<<"Framebuffer";break;
+			case InstanceType::Renderbuffer: buffer<<"Renderbuffer";break;
 			default: buffer<<"Unknown source";break;
 		}
 		buffer<<" during ";
@@ -128,6 +147,7 @@ struct InstanceError: public std::exception {
 			case InstanceErrorType::Attach: buffer<<"Attachment";break;
 			case InstanceErrorType::Info: buffer<<"Information aquisition";break;
 			case InstanceErrorType::Link: buffer<<"Linking";break;
+			case InstanceErrorType::Dispatch: buffer<<"Dispatch";break;
 			default:buffer<<"Unknown";break;
 		}
 		buffer<<" stage: "<<e<<"\n";
@@ -185,8 +205,26 @@ static struct {
 
 	int flags = 0x0;
 	uint8_t max_texture_slots = 32;
+	int32_t major_version = 0;
+	int32_t minor_version = 0;
+	int32_t uniform_offset_alignment = 256;
+	int32_t storage_offset_alignment = 256;
+	bool program_uniforms = false;
+	bool invalidate_subdata = false;
 
 	void load(){
+		//load context version
+		SAFE_CALL( ConfigMajorVersion, glGetIntegerv(GL_MAJOR_VERSION, &major_version) );
+		SAFE_CALL( ConfigMinorVersion, glGetIntegerv(GL_MINOR_VERSION, &minor_version) );
+		//load buffer range alignments
+		SAFE_CALL( ConfigUniformAlignment, glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_offset_alignment) );
+		if(supports(4,3)){
+			SAFE_CALL( ConfigStorageAlignment, glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_offset_alignment) );
+		}
+		//glProgramUniform* is core since 4.1
+		program_uniforms = supports(4,1) || has_extension("GL_ARB_separate_shader_objects");
+		//glInvalidateTexImage and glInvalidateFramebuffer are core since 4.3
+		invalidate_subdata = supports(4,3) || has_extension("GL_ARB_invalidate_subdata");
 		//load max_texture_slots
 		{
 			int32_t MAX_COMBINED_TEXTURE_IMAGE_UNITS;
@@ -198,6 +236,12 @@ static struct {
 	};
 
 
+	inline bool supports(int32_t major, int32_t minor) const {
+		return major_version > major || (major_version == major && minor_version >= minor);
+	}
+
+	inline bool has_extension(const char* name) const { return glewIsSupported(name); }
+
 	bool enableDebug(){
 		if (flags & GL_CONTEXT_FLAG_DEBUG_BIT)
 		{
@@ -0,0 +1,323 @@
+#pragma once
+#include "draw.hpp"
+#include "shader.hpp"
+#include "sync.hpp"
+#include <array>
+#include <cmath>
+
+/**
+ * @brief object consumed by the culling shader (std430 layout)
+ * @note `center`/`radius` is the bounding sphere in model space
+*/
+struct CullObject {
+	float model[16];
+	float center[3];
+	float radius;
+	DrawElementsIndirectCommand command;
+	uint32_t padding[3] = {0,0,0};
+};
+static_assert(sizeof(CullObject) == 112, "CullObject must match the std430 layout of the culling shader");
+
+/**
+ * @brief normalized clip planes (left, right, bottom, top, near, far) pointing inwards
+*/
+struct Frustum {
+	std::array<std::array<float,4>,6> planes;
+
+	/**
+	 * @param m column major view projection matrix (as glm stores it)
+	*/
+	static Frustum from_matrix(const float* m){
+		auto row = [m](int r){ return std::array<float,4>{ m[r], m[4+r], m[8+r], m[12+r] }; };
+		std::array<float,4> r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+		Frustum frustum;
+		for(int i = 0; i < 4; i++){
+			frustum.planes[0][i] = r3[i] + r0[i];
+			frustum.planes[1][i] = r3[i] - r0[i];
+			frustum.planes[2][i] = r3[i] + r1[i];
+			frustum.planes[3][i] = r3[i] - r1[i];
+			frustum.planes[4][i] = r3[i] + r2[i];
+			frustum.planes[5][i] = r3[i] - r2[i];
+		}
+		for(auto& plane: frustum.planes){
+			float length = std::sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+			if(length > 0.0f) for(float& value: plane) value /= length;
+		}
+		return frustum;
+	}
+};
+
+/**
+ * @brief culls objects on the GPU and compacts the visible draws into an indirect buffer
+ *
+ * the shader writes the object index into the base instance of every surviving draw, so vertex
+ * shaders can fetch per object data with `gl_BaseInstance` (objects stay bound at binding 0).
+ * a custom compute shader can replace the default one as long as it keeps the same interface
+*/
+class CullingPipeline {
+	public:
+		static constexpr uint32_t group_size = 64;
+		static constexpr uint32_t objects_binding = 0;
+		static constexpr uint32_t commands_binding = 1;
+		static constexpr uint32_t counter_binding = 2;
+		static constexpr size_t stats_latency = 4;
+
+		static constexpr const char* default_source = R"(
+#version 430
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int  baseVertex;
+	uint baseInstance;
+};
+
+struct CullObject {
+	mat4 model;
+	vec4 sphere;
+	DrawCommand command;
+	uint pad0, pad1, pad2;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { CullObject objects[]; };
+layout(std430, binding = 1) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 2) buffer Counter { uint visible; };
+
+uniform vec4 u_planes[6];
+uniform mat4 u_view_projection;
+uniform int u_object_count;
+uniform int u_occlusion;
+uniform sampler2D u_hiz;
+uniform vec2 u_hiz_size;
+uniform int u_hiz_levels;
+
+//the hi-z pyramid stores the farthest depth of every texel footprint
+bool occluded(vec3 center, float radius){
+	vec3 box_min = vec3(1.0), box_max = vec3(-1.0);
+	for(int i = 0; i < 8; i++){
+		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = u_view_projection * vec4(corner, 1.0);
+		if(clip.w <= 0.0) return false;
+		vec3 ndc = clip.xyz / clip.w;
+		box_min = min(box_min, ndc);
+		box_max = max(box_max, ndc);
+	}
+	vec2 uv_min = clamp(box_min.xy * 0.5 + 0.5, 0.0, 1.0);
+	vec2 uv_max = clamp(box_max.xy * 0.5 + 0.5, 0.0, 1.0);
+	vec2 extent = (uv_max - uv_min) * u_hiz_size;
+	float level = clamp(ceil(log2(max(max(extent.x, extent.y), 1.0))), 0.0, float(u_hiz_levels - 1));
+
+	float depth = textureLod(u_hiz, uv_min, level).r;
+	depth = max(depth, textureLod(u_hiz, vec2(uv_max.x, uv_min.y), level).r);
+	depth = max(depth, textureLod(u_hiz, vec2(uv_min.x, uv_max.y), level).r);
+	depth = max(depth, textureLod(u_hiz, uv_max, level).r);
+	return box_min.z * 0.5 + 0.5 > depth;
+}
+
+void main(){
+	uint index = gl_GlobalInvocationID.x;
+	if(index >= uint(u_object_count)) return;
+
+	CullObject object = objects[index];
+	vec3 center = (object.model * vec4(object.sphere.xyz, 1.0)).xyz;
+	float scale = max(length(object.model[0].xyz), max(length(object.model[1].xyz), length(object.model[2].xyz)));
+	float radius = object.sphere.w * scale;
+
+	for(int i = 0; i < 6; i++){
+		if(dot(u_planes[i].xyz, center) + u_planes[i].w < -radius) return;
+	}
+	if(u_occlusion != 0 && occluded(center, radius)) return;
+
+	uint slot = atomicAdd(visible, 1u);
+	DrawCommand command = object.command;
+	command.baseInstance = index;
+	commands[slot] = command;
+}
+)";
+
+		struct Stats {
+			uint32_t objects = 0;
+			uint32_t visible = 0;
+			inline uint32_t culled() const { return objects - visible; }
+		};
+
+		CullingPipeline(const std::string& source = default_source)
+			:m_objects(storage_descriptor(BufferTarget::ShaderStorage)),
+			m_commands(storage_descriptor(BufferTarget::DrawIndirect)),
+			m_counter(storage_descriptor(BufferTarget::ShaderStorage)),
+			m_readback(BufferDescriptor{
+				.target = BufferTarget::Array,
+				.usage = BufferUsage::StreamRead,
+				.access = BufferAccess::ReadOnly
+			}){
+			ShaderInstance shader(ShaderType::Compute);
+			shader << source;
+			if(!shader.compile() || !shader.check_compile_status()){
+				throw InstanceError(InstanceErrorType::Compile, InstanceType::Shader, shader.error());
+			}
+			m_program << shader;
+			if(!m_program.link() || !m_program.check_link_status()){
+				throw InstanceError(InstanceErrorType::Link, InstanceType::ShaderProgram, m_program.error());
+			}
+
+			u_planes = m_program.get_uniform("u_planes", UniformType::FVec4);
+			u_view_projection = m_program.get_uniform("u_view_projection", UniformType::FMat4);
+			u_object_count = m_program.get_uniform("u_object_count", UniformType::Int);
+			u_occlusion = m_program.get_uniform("u_occlusion", UniformType::Int);
+			u_hiz = m_program.get_uniform("u_hiz", UniformType::Int);
+			u_hiz_size = m_program.get_uniform("u_hiz_size", UniformType::FVec2);
+			u_hiz_levels = m_program.get_uniform("u_hiz_levels", UniformType::Int);
+
+			m_counter.storage(sizeof(uint32_t));
+			//counters are copied here every frame and read once their fence signals
+			m_readback.immutable_storage(sizeof(uint32_t) * stats_latency, BufferStorageFlags::Read | BufferStorageFlags::Persistent | BufferStorageFlags::Coherent);
+			p_readback = (const uint32_t*)m_readback.map_range(0, sizeof(uint32_t) * stats_latency, BufferMapFlags::Read | BufferMapFlags::Persistent | BufferMapFlags::Coherent);
+
+			b_count_draws = GlobalContextConfig.supports(4,6) || GlobalContextConfig.has_extension("GL_ARB_indirect_parameters");
+		}
+
+		/**
+		 * @brief uploads the objects to cull, the command buffer is sized to hold all of them
+		*/
+		void set_objects(const std::vector<CullObject>& objects){
+			m_objects << objects;
+			if(objects.size() > m_capacity){
+				m_commands.storage(sizeof(DrawElementsIndirectCommand) * objects.size());
+				m_capacity = objects.size();
+			}
+			m_object_count = (uint32_t)objects.size();
+		}
+
+		/**
+		 * @brief enables occlusion culling against a hi-z depth pyramid (farthest depth per texel)
+		 * @param texture 2D texture name, zero disables occlusion culling
+		*/
+		void set_hiz(uint32_t texture, uint32_t width, uint32_t height, uint32_t levels, uint8_t unit = 0){
+			m_hiz = texture;
+			m_hiz_size = { (float)width, (float)height };
+			m_hiz_levels = (int32_t)levels;
+			m_hiz_unit = unit;
+		}
+
+		/**
+		 * @brief writes the visible draws into the command buffer
+		 * @param view_projection column major matrix
+		*/
+		void cull(const float* view_projection){
+			if(m_object_count == 0) return;
+			Frustum frustum = Frustum::from_matrix(view_projection);
+
+			m_counter.clear();
+			//without draw count support the culled slots must read as empty draws
+			if(!b_count_draws) m_commands.clear();
+
+			//commands and counter are written as storage buffers, not through their own targets
+			m_objects.bind_base(objects_binding);
+			m_commands.bind_base(BufferTarget::ShaderStorage, commands_binding);
+			m_counter.bind_base(BufferTarget::ShaderStorage, counter_binding);
+
+			m_program.bind();
+			u_planes.set_data(frustum.planes.data(), 6);
+			u_view_projection.set_data((void*)view_projection, 1);
+			int32_t count = (int32_t)m_object_count;
+			u_object_count.set_data(&count, 1);
+			int32_t occlusion = m_hiz != 0;
+			u_occlusion.set_data(&occlusion, 1);
+			if(occlusion){
+				GlobalBindingCache.bind_texture(m_hiz_unit, GL_TEXTURE_2D, m_hiz);
+				int32_t unit = m_hiz_unit;
+				u_hiz.set_data(&unit, 1);
+				u_hiz_size.set_data(m_hiz_size.data(), 1);
+				u_hiz_levels.set_data(&m_hiz_levels, 1);
+			}
+
+			m_program.dispatch((m_object_count + group_size - 1) / group_size);
+			memory_barrier(MemoryBarrier::Command | MemoryBarrier::ShaderStorage | MemoryBarrier::BufferUpdate);
+
+			//keep the visible count around without stalling
+			size_t slot = m_frame % stats_latency;
+			m_readback.copy_from(m_counter, 0, slot * sizeof(uint32_t), sizeof(uint32_t));
+			m_pending[slot].count = m_object_count;
+			m_pending[slot].fence.insert();
+			m_frame++;
+		}
+
+		/**
+		 * @brief draws the visible commands, the vertex array and the drawing program must be bound
+		*/
+		void draw(DrawMode mode, IndexType index_type){
+			if(m_object_count == 0) return;
+			m_commands.bind();
+			if(b_count_draws){
+				//GL_PARAMETER_BUFFER only exists with 4.6 or ARB_indirect_parameters, the counter is bound to it here only
+				GlobalBindingCache.bind_buffer(GL_PARAMETER_BUFFER_ARB, m_counter.id());
+				if(GlobalContextConfig.supports(4,6)){
+					SAFE_CALL( MultiDrawElementsIndirectCount, glMultiDrawElementsIndirectCount((uint32_t)mode, (uint32_t)index_type, nullptr, 0, (int32_t)m_object_count, 0) );
+				} else {
+					SAFE_CALL( MultiDrawElementsIndirectCount, glMultiDrawElementsIndirectCountARB((uint32_t)mode, (uint32_t)index_type, nullptr, 0, (int32_t)m_object_count, 0) );
+				}
+			} else {
+				SAFE_CALL( MultiDrawElementsIndirect, glMultiDrawElementsIndirect((uint32_t)mode, (uint32_t)index_type, nullptr, (int32_t)m_object_count, 0) );
+			}
+		}
+
+		/**
+		 * @brief counts of the latest culled frame the GPU already finished, never blocks
+		*/
+		const Stats& stats(){
+			for(size_t i = 0; i < stats_latency && m_frame > i; i++){
+				//newest first
+				size_t slot = (m_frame - 1 - i) % stats_latency;
+				Pending& pending = m_pending[slot];
+				if(!pending.fence.valid() || !pending.fence.signaled()) continue;
+				m_stats.objects = pending.count;
+				m_stats.visible = p_readback[slot];
+				break;
+			}
+			return m_stats;
+		}
+
+		inline bool counts_draws() const { return b_count_draws; }
+		inline BufferInstance& objects(){ return m_objects; }
+		inline BufferInstance& commands(){ return m_commands; }
+		inline BufferInstance& counter(){ return m_counter; }
+		inline ShaderProgramInstance& program(){ return m_program; }
+
+	private:
+		struct Pending {
+			Fence fence;
+			uint32_t count = 0;
+		};
+
+		ShaderProgramInstance m_program;
+		BufferInstance m_objects;
+		BufferInstance m_commands;
+		BufferInstance m_counter;
+		BufferInstance m_readback;
+		const uint32_t* p_readback = nullptr;
+
+		ShaderUniform u_planes, u_view_projection, u_object_count, u_occlusion, u_hiz, u_hiz_size, u_hiz_levels;
+
+		uint32_t m_object_count = 0;
+		size_t m_capacity = 0;
+		bool b_count_draws = false;
+
+		uint32_t m_hiz = 0;
+		std::array<float,2> m_hiz_size = {0.0f, 0.0f};
+		int32_t m_hiz_levels = 1;
+		uint8_t m_hiz_unit = 0;
+
+		std::array<Pending, stats_latency> m_pending;
+		size_t m_frame = 0;
+		Stats m_stats;
+
+		static BufferDescriptor storage_descriptor(BufferTarget target){
+			return {
+				.target = target,
+				.usage = BufferUsage::DynamicCopy,
+				.access = BufferAccess::ReadWrite
+			};
+		}
+};
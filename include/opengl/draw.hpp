@@ -0,0 +1,213 @@
+#pragma once
+#include "buffer.hpp"
+#include <type_traits>
+
+enum class DrawMode: uint32_t {
+	Points = GL_POINTS,
+	Lines = GL_LINES,
+	LineStrip = GL_LINE_STRIP,
+	LineLoop = GL_LINE_LOOP,
+	Triangles = GL_TRIANGLES,
+	TriangleStrip = GL_TRIANGLE_STRIP,
+	TriangleFan = GL_TRIANGLE_FAN,
+	Patches = GL_PATCHES
+};
+
+enum class IndexType: uint32_t {
+	None = 0,
+	UnsignedByte = GL_UNSIGNED_BYTE,
+	UnsignedShort = GL_UNSIGNED_SHORT,
+	UnsignedInt = GL_UNSIGNED_INT
+};
+
+inline size_t index_type_size(IndexType type){
+	switch(type){
+		case IndexType::UnsignedByte: return 1;
+		case IndexType::UnsignedShort: return 2;
+		case IndexType::UnsignedInt: return 4;
+		default: return 0;
+	}
+}
+
+/**
+ * @brief a single draw call, indexed when `index_type` is set
+ * @note `first` is the first vertex for array draws and the first index for indexed ones
+*/
+struct DrawCall {
+	DrawMode mode = DrawMode::Triangles;
+	IndexType index_type = IndexType::None;
+	uint32_t count = 0;
+	uint32_t first = 0;
+	uint32_t instances = 1;
+	int32_t base_vertex = 0;
+	uint32_t base_instance = 0;
+
+	inline bool indexed() const { return index_type != IndexType::None; }
+
+	/**
+	 * @brief issues the call, the vertex array (and program) must be already bound
+	*/
+	void submit() const {
+		uint32_t gl_mode = (uint32_t)mode;
+		if(!indexed()){
+			if(instances == 1 && base_instance == 0){
+				SAFE_CALL( DrawArrays, glDrawArrays(gl_mode, first, count) );
+			} else {
+				SAFE_CALL( DrawArraysInstanced, glDrawArraysInstancedBaseInstance(gl_mode, first, count, instances, base_instance) );
+			}
+			return;
+		}
+
+		void* offset = (void*)(uintptr_t)(first * index_type_size(index_type));
+		if(instances == 1 && base_instance == 0){
+			if(base_vertex == 0){
+				SAFE_CALL( DrawElements, glDrawElements(gl_mode, count, (uint32_t)index_type, offset) );
+			} else {
+				SAFE_CALL( DrawElementsBaseVertex, glDrawElementsBaseVertex(gl_mode, count, (uint32_t)index_type, offset, base_vertex) );
+			}
+		} else {
+			SAFE_CALL( DrawElementsInstanced, glDrawElementsInstancedBaseVertexBaseInstance(gl_mode, count, (uint32_t)index_type, offset, instances, base_vertex, base_instance) );
+		}
+	}
+};
+
+//layouts defined by GL for indirect draws
+struct DrawElementsIndirectCommand {
+	uint32_t count = 0;
+	uint32_t instance_count = 1;
+	uint32_t first_index = 0;
+	int32_t base_vertex = 0;
+	uint32_t base_instance = 0;
+};
+
+struct DrawArraysIndirectCommand {
+	uint32_t count = 0;
+	uint32_t instance_count = 1;
+	uint32_t first = 0;
+	uint32_t base_instance = 0;
+};
+
+/**
+ * @brief how shaders find the per draw data of a batch
+ * @note DrawID needs GL 4.6 (or ARB_shader_draw_parameters), BaseInstance overwrites the draw base instance
+*/
+enum class DrawIndexSource: uint8_t {
+	DrawID,
+	BaseInstance
+};
+
+/**
+ * @brief collects draws sharing a vertex array into an indirect buffer and issues them with one multi draw call
+ *
+ * per draw data is packed into a shader storage buffer bound at `storage_binding`, entry `i`
+ * belongs to the i-th draw:
+ * ```glsl
+ * layout(std430, binding = 0) buffer PerDraw { DrawData draws[]; };
+ * DrawData data = draws[gl_DrawID]; //or draws[gl_BaseInstance]
+ * ```
+*/
+class DrawBatch {
+	public:
+		DrawBatch(DrawMode mode, IndexType index_type, size_t per_draw_size = 0, uint32_t storage_binding = 0, DrawIndexSource source = DrawIndexSource::DrawID)
+			:m_mode(mode),m_index_type(index_type),m_per_draw_size(per_draw_size),m_storage_binding(storage_binding),m_source(source),
+			m_commands(BufferDescriptor{
+				.target = BufferTarget::DrawIndirect,
+				.usage = BufferUsage::StreamDraw,
+				.access = BufferAccess::WriteOnly
+			}),
+			m_storage(BufferDescriptor{
+				.target = BufferTarget::ShaderStorage,
+				.usage = BufferUsage::StreamDraw,
+				.access = BufferAccess::WriteOnly
+			}){}
+
+		/**
+		 * @brief adds a draw, `call` must match the batch mode and index type
+		 * @param per_draw `per_draw_size` bytes copied into the storage buffer
+		*/
+		void add(const DrawCall& call, const void* per_draw = nullptr){
+			if(call.mode != m_mode || call.index_type != m_index_type) throw std::invalid_argument("DrawBatch: draw doesn't match the batch mode or index type");
+
+			uint32_t base_instance = m_source == DrawIndexSource::BaseInstance ? (uint32_t)size() : call.base_instance;
+			if(call.indexed()){
+				m_elements.push_back({
+					.count = call.count,
+					.instance_count = call.instances,
+					.first_index = call.first,
+					.base_vertex = call.base_vertex,
+					.base_instance = base_instance
+				});
+			} else {
+				m_arrays.push_back({
+					.count = call.count,
+					.instance_count = call.instances,
+					.first = call.first,
+					.base_instance = base_instance
+				});
+			}
+
+			if(m_per_draw_size){
+				size_t offset = m_per_draw.size();
+				m_per_draw.resize(offset + m_per_draw_size);
+				if(per_draw) memcpy(m_per_draw.data() + offset, per_draw, m_per_draw_size);
+			}
+		}
+
+		//pointers (and nullptr) go to the overload above, they would otherwise be copied as the data
+		template<typename T> requires (!std::is_pointer_v<T> && !std::is_null_pointer_v<T>)
+		inline void add(const DrawCall& call, const T& per_draw){
+			static_assert(std::is_trivially_copyable_v<T>, "DrawBatch: per draw data is copied bytewise, it must be trivially copyable");
+			if(sizeof(T) != m_per_draw_size) throw std::invalid_argument("DrawBatch: per draw data size mismatch");
+			add(call, (const void*)&per_draw);
+		}
+
+		/**
+		 * @brief uploads the commands and issues them, the vertex array (and program) must be bound
+		*/
+		void submit(){
+			if(empty()) return;
+			if(m_per_draw_size){
+				m_storage << m_per_draw;
+				m_storage.bind_base(m_storage_binding);
+			}
+
+			if(m_index_type != IndexType::None){
+				m_commands << m_elements;
+				m_commands.bind();
+				SAFE_CALL( MultiDrawElementsIndirect, glMultiDrawElementsIndirect((uint32_t)m_mode, (uint32_t)m_index_type, nullptr, (int32_t)m_elements.size(), 0) );
+			} else {
+				m_commands << m_arrays;
+				m_commands.bind();
+				SAFE_CALL( MultiDrawArraysIndirect, glMultiDrawArraysIndirect((uint32_t)m_mode, nullptr, (int32_t)m_arrays.size(), 0) );
+			}
+		}
+
+		/**
+		 * @brief drops every draw, memory is kept for the next frame
+		*/
+		void clear(){
+			m_elements.clear();
+			m_arrays.clear();
+			m_per_draw.clear();
+		}
+
+		inline size_t size() const { return m_index_type != IndexType::None ? m_elements.size() : m_arrays.size(); }
+		inline bool empty() const { return size() == 0; }
+
+		inline BufferInstance& commands(){ return m_commands; }
+		inline BufferInstance& storage(){ return m_storage; }
+
+	private:
+		DrawMode m_mode;
+		IndexType m_index_type;
+		size_t m_per_draw_size = 0;
+		uint32_t m_storage_binding = 0;
+		DrawIndexSource m_source;
+
+		std::vector<DrawElementsIndirectCommand> m_elements;
+		std::vector<DrawArraysIndirectCommand> m_arrays;
+		std::vector<uint8_t> m_per_draw;
+
+		BufferInstance m_commands;
+		BufferInstance m_storage;
+};
@@ -0,0 +1,477 @@
+#pragma once
+#include "texture.hpp"
+#include <initializer_list>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+class RenderbufferInstance: public Instance {
+	public:
+		RenderbufferInstance():Instance(InstanceType::Renderbuffer){
+			THIS_INSTANCE_CALL( InstanceErrorType::Create, glGenRenderbuffers(1, id_ref()) );
+		}
+
+		RenderbufferInstance(uint32_t internal_format, size_t width, size_t height, uint32_t samples = 0):RenderbufferInstance(){
+			storage(internal_format, width, height, samples);
+		}
+
+		~RenderbufferInstance(){
+			glDeleteRenderbuffers(1, id_ref());
+		}
+
+		/**
+		 * @brief (re)allocates the storage, `samples` 0 for a single sampled renderbuffer
+		*/
+		void storage(uint32_t internal_format, size_t width, size_t height, uint32_t samples = 0){
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glNamedRenderbufferStorageMultisample(id(), samples, internal_format, width, height), RenderbufferStorage );
+			#else
+				bind();
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internal_format, width, height), RenderbufferStorage );
+			#endif
+			m_internal_format = internal_format;
+			m_width = width;
+			m_height = height;
+			m_samples = samples;
+		}
+
+		inline size_t memory_size() const { return m_width * m_height * internal_format_size(m_internal_format) * std::max<uint32_t>(m_samples, 1); }
+
+		inline uint32_t internal_format() const { return m_internal_format; }
+		inline size_t width() const { return m_width; }
+		inline size_t height() const { return m_height; }
+		inline uint32_t samples() const { return m_samples; }
+
+	private:
+		uint32_t m_internal_format = 0;
+		size_t m_width = 0, m_height = 0;
+		uint32_t m_samples = 0;
+
+	protected:
+		virtual void t_bind(){
+			THIS_INSTANCE_CALL( InstanceErrorType::Bind, glBindRenderbuffer(GL_RENDERBUFFER, id()) );
+		}
+
+		virtual void t_unbind(){
+			THIS_INSTANCE_CALL( InstanceErrorType::Unbind, glBindRenderbuffer(GL_RENDERBUFFER, 0) );
+		}
+};
+
+/**
+ * @brief an object attached to a framebuffer, texture and renderbuffer names are separate namespaces
+ * so the kind is part of its identity
+*/
+struct AttachedObject {
+	enum class Kind: uint8_t { Texture, Renderbuffer };
+
+	Kind kind = Kind::Texture;
+	uint32_t name = 0;
+
+	bool operator==(const AttachedObject& other) const = default;
+};
+
+class FramebufferInstance: public Instance {
+	public:
+		FramebufferInstance():Instance(InstanceType::Framebuffer){
+			THIS_INSTANCE_CALL( InstanceErrorType::Create, glGenFramebuffers(1, id_ref()) );
+		}
+
+		~FramebufferInstance(){
+			GlobalBindingCache.forget_framebuffer(id());
+			glDeleteFramebuffers(1, id_ref());
+		}
+
+		/**
+		 * @brief attaches a level of a texture, `layer` selects one layer (or cube face) of layered textures,
+		 * -1 attaches them all for layered rendering
+		*/
+		void attach(uint32_t attachment, TextureInstance& texture, int level = 0, int layer = -1){
+			#ifdef GL_LATEST_FEATURES
+				if(layer < 0){
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glNamedFramebufferTexture(id(), attachment, texture.id(), level), FramebufferTexture );
+				} else {
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glNamedFramebufferTextureLayer(id(), attachment, texture.id(), level, layer), FramebufferTextureLayer );
+				}
+			#else
+				bind_draw();
+				if(layer < 0){
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, texture.id(), level), FramebufferTexture );
+				} else {
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, attachment, texture.id(), level, layer), FramebufferTextureLayer );
+				}
+			#endif
+			record(attachment, { .kind = AttachedObject::Kind::Texture, .name = texture.id() });
+		}
+
+		void attach(uint32_t attachment, RenderbufferInstance& renderbuffer){
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glNamedFramebufferRenderbuffer(id(), attachment, GL_RENDERBUFFER, renderbuffer.id()), FramebufferRenderbuffer );
+			#else
+				bind_draw();
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer.id()), FramebufferRenderbuffer );
+			#endif
+			record(attachment, { .kind = AttachedObject::Kind::Renderbuffer, .name = renderbuffer.id() });
+		}
+
+		void detach(uint32_t attachment){
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glNamedFramebufferRenderbuffer(id(), attachment, GL_RENDERBUFFER, 0), FramebufferDetach );
+			#else
+				bind_draw();
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Attach, glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, attachment, GL_RENDERBUFFER, 0), FramebufferDetach );
+			#endif
+			std::erase_if(m_attachments, [attachment](const std::pair<uint32_t, AttachedObject>& entry){ return entry.first == attachment; });
+		}
+
+		/**
+		 * @brief selects the color attachments fragment outputs write to, in output order
+		*/
+		void draw_buffers(std::initializer_list<uint32_t> buffers){
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glNamedFramebufferDrawBuffers(id(), (int32_t)buffers.size(), buffers.begin()), FramebufferDrawBuffers );
+			#else
+				bind_draw();
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glDrawBuffers((int32_t)buffers.size(), buffers.begin()), FramebufferDrawBuffers );
+			#endif
+		}
+
+		/**
+		 * @return true if the framebuffer can be rendered to, `status()` tells why not
+		*/
+		bool complete(){
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Check, m_status = glCheckNamedFramebufferStatus(id(), GL_DRAW_FRAMEBUFFER), FramebufferStatus );
+			#else
+				bind_draw();
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Check, m_status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER), FramebufferStatus );
+			#endif
+			return m_status == GL_FRAMEBUFFER_COMPLETE;
+		}
+
+		const char* status() const {
+			switch(m_status){
+				case GL_FRAMEBUFFER_COMPLETE: return "complete";
+				case GL_FRAMEBUFFER_UNDEFINED: return "undefined";
+				case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "incomplete attachment";
+				case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: return "missing attachment";
+				case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: return "incomplete draw buffer";
+				case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: return "incomplete read buffer";
+				case GL_FRAMEBUFFER_UNSUPPORTED: return "unsupported format combination";
+				case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: return "sample counts don't match";
+				case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS: return "layered and non layered attachments mixed";
+				default: return "unchecked";
+			}
+		}
+
+		/**
+		 * @brief tells the driver the contents of `attachments` aren't needed anymore, so tiled and
+		 * compressing GPUs can skip storing (or loading) them. does nothing without GL 4.3 or ARB_invalidate_subdata
+		*/
+		void invalidate(std::initializer_list<uint32_t> attachments){ invalidate(attachments.begin(), attachments.size()); }
+
+		void invalidate(const uint32_t* attachments, size_t count){
+			if(count == 0 || !GlobalContextConfig.invalidate_subdata) return;
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glInvalidateNamedFramebufferData(id(), (int32_t)count, attachments), FramebufferInvalidate );
+			#else
+				bind_draw();
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, (int32_t)count, attachments), FramebufferInvalidate );
+			#endif
+		}
+
+		/**
+		 * @brief copies (and resolves multisampled) contents into another framebuffer, nullptr for the default one
+		*/
+		void blit(FramebufferInstance* target, int32_t width, int32_t height, uint32_t mask = GL_COLOR_BUFFER_BIT, uint32_t filter = GL_NEAREST){
+			uint32_t target_id = target ? target->id() : 0;
+			#ifdef GL_LATEST_FEATURES
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glBlitNamedFramebuffer(id(), target_id, 0, 0, width, height, 0, 0, width, height, mask, filter), FramebufferBlit );
+			#else
+				bind_read();
+				GlobalBindingCache.bind_framebuffer(GL_DRAW_FRAMEBUFFER, target_id);
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, mask, filter), FramebufferBlit );
+			#endif
+		}
+
+		inline void bind_draw(){
+			if(GlobalBindingCache.update_framebuffer(GL_DRAW_FRAMEBUFFER, id())){
+				THIS_INSTANCE_CALL( InstanceErrorType::Bind, glBindFramebuffer(GL_DRAW_FRAMEBUFFER, id()) );
+			}
+		}
+
+		inline void bind_read(){
+			if(GlobalBindingCache.update_framebuffer(GL_READ_FRAMEBUFFER, id())){
+				THIS_INSTANCE_CALL( InstanceErrorType::Bind, glBindFramebuffer(GL_READ_FRAMEBUFFER, id()) );
+			}
+		}
+
+		static void bind_default(){ GlobalBindingCache.bind_framebuffer(GL_FRAMEBUFFER, 0); }
+
+		//attachment points and the objects attached to them
+		inline const std::vector<std::pair<uint32_t, AttachedObject>>& attachments() const { return m_attachments; }
+
+	private:
+		uint32_t m_status = 0;
+		std::vector<std::pair<uint32_t, AttachedObject>> m_attachments;
+
+		void record(uint32_t attachment, AttachedObject object){
+			for(auto& entry: m_attachments){
+				if(entry.first == attachment){
+					entry.second = object;
+					return;
+				}
+			}
+			m_attachments.emplace_back(attachment, object);
+		}
+
+	protected:
+		virtual void t_bind(){
+			if(GlobalBindingCache.update_framebuffer(GL_FRAMEBUFFER, id())){
+				THIS_INSTANCE_CALL( InstanceErrorType::Bind, glBindFramebuffer(GL_FRAMEBUFFER, id()) );
+			}
+		}
+
+		virtual void t_unbind(){
+			if(GlobalBindingCache.update_framebuffer(GL_FRAMEBUFFER, 0)){
+				THIS_INSTANCE_CALL( InstanceErrorType::Unbind, glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+			}
+		}
+};
+
+/**
+ * @brief size, format and sample count of a pooled render target
+ * @note multisampled targets are renderbuffers (resolve them with `FramebufferInstance::blit`), single
+ * sampled ones are 2D textures unless `sampled` is false
+*/
+struct RenderTargetDesc {
+	uint32_t width = 0, height = 0;
+	uint32_t internal_format = GL_RGBA8;
+	uint32_t samples = 0;
+	bool sampled = true; //read by later passes as a texture
+
+	bool operator==(const RenderTargetDesc& other) const = default;
+
+	inline bool renderbuffer() const { return samples > 0 || !sampled; }
+	inline size_t memory_size() const { return (size_t)width * height * internal_format_size(internal_format) * std::max<uint32_t>(samples, 1); }
+
+	uint64_t hash() const {
+		uint32_t fields[5] = { width, height, internal_format, samples, sampled };
+		return g_utils::hash_bytes(fields, sizeof(fields));
+	}
+};
+
+template<>
+struct std::hash<RenderTargetDesc> {
+	inline size_t operator()(const RenderTargetDesc& desc) const { return (size_t)desc.hash(); }
+};
+
+struct RenderTarget {
+	RenderTargetDesc desc;
+	std::unique_ptr<TextureInstance> texture;
+	std::unique_ptr<RenderbufferInstance> renderbuffer;
+	uint64_t last_use = 0;
+	bool in_use = false;
+
+	inline uint32_t id() const { return texture ? texture->id() : renderbuffer->id(); }
+
+	inline AttachedObject object() const {
+		return { .kind = texture ? AttachedObject::Kind::Texture : AttachedObject::Kind::Renderbuffer, .name = id() };
+	}
+
+	void attach(FramebufferInstance& framebuffer, uint32_t attachment){
+		if(texture) framebuffer.attach(attachment, *texture);
+		else framebuffer.attach(attachment, *renderbuffer);
+	}
+};
+
+/**
+ * @brief recycles transient render targets across passes and frames
+ *
+ * passes `acquire` the targets they render to and `release` them once the last reader is done, so
+ * passes that don't overlap share the same memory. released contents are invalidated. targets idle
+ * for `max_idle_frames` are freed at `end_frame`. framebuffers are cached by attachment set.
+*/
+class RenderTargetPool {
+	public:
+		struct Stats {
+			size_t bytes = 0; //allocated, in use or free
+			size_t peak_bytes = 0;
+			size_t in_use_bytes = 0;
+			size_t peak_in_use_bytes = 0;
+			uint64_t allocations = 0;
+			uint64_t reuses = 0;
+			uint64_t frees = 0;
+			size_t targets = 0;
+			size_t framebuffers = 0;
+		};
+
+		RenderTargetPool(uint32_t max_idle_frames = 3):m_max_idle_frames(max_idle_frames){}
+		RenderTargetPool(const RenderTargetPool& other) = delete;
+
+		/**
+		 * @brief a free target matching `desc`, allocated when there's none
+		*/
+		RenderTarget& acquire(const RenderTargetDesc& desc){
+			auto range = m_targets.equal_range(desc);
+			for(auto it = range.first; it != range.second; ++it){
+				RenderTarget& target = *it->second;
+				if(target.in_use) continue;
+				m_stats.reuses++;
+				return use(target);
+			}
+
+			auto target = std::make_unique<RenderTarget>();
+			target->desc = desc;
+			if(desc.renderbuffer()){
+				target->renderbuffer = std::make_unique<RenderbufferInstance>(desc.internal_format, desc.width, desc.height, desc.samples);
+			} else {
+				target->texture = std::make_unique<TextureInstance>(TextureType::Tex2D);
+				target->texture->storage(1, desc.internal_format, desc.width, desc.height);
+			}
+			m_stats.allocations++;
+			m_stats.targets++;
+			m_stats.bytes += desc.memory_size();
+			m_stats.peak_bytes = std::max(m_stats.peak_bytes, m_stats.bytes);
+			return use(*m_targets.emplace(desc, std::move(target))->second);
+		}
+
+		/**
+		 * @brief returns the target to the pool, its contents are discarded
+		*/
+		void release(RenderTarget& target){
+			if(!target.in_use) return;
+			target.in_use = false;
+			m_stats.in_use_bytes -= target.desc.memory_size();
+			//invalidating is only a hint, the contents are overwritten anyway when it's unavailable
+			if(!GlobalContextConfig.invalidate_subdata) return;
+			if(target.texture){
+				SAFE_CALL( RenderTargetInvalidate, glInvalidateTexImage(target.texture->id(), 0) );
+				return;
+			}
+			//renderbuffers can only be invalidated through a framebuffer holding them
+			for(auto& [hash, cached]: m_framebuffers){
+				for(auto& [attachment, object]: cached.framebuffer->attachments()){
+					if(object == target.object()){
+						cached.framebuffer->invalidate(&attachment, 1);
+						return;
+					}
+				}
+			}
+		}
+
+		/**
+		 * @brief cached framebuffer with `targets` attached, the first depth (or depth stencil) format goes to
+		 * the depth attachment and the others to consecutive color attachments, which are all drawn to
+		*/
+		inline FramebufferInstance& framebuffer(std::initializer_list<RenderTarget*> targets){ return framebuffer(targets.begin(), targets.size()); }
+
+		FramebufferInstance& framebuffer(RenderTarget* const* targets, size_t count){
+			std::vector<AttachedObject> key;
+			uint64_t hash = g_utils::hash_bytes(&count, sizeof(count));
+			for(size_t i = 0; i < count; i++){
+				AttachedObject object = targets[i]->object();
+				key.push_back(object);
+				hash = g_utils::hash_bytes(&object.name, sizeof(object.name), hash);
+				hash = g_utils::hash_bytes(&object.kind, sizeof(object.kind), hash);
+			}
+			auto range = m_framebuffers.equal_range(hash);
+			for(auto it = range.first; it != range.second; ++it){
+				if(it->second.key == key) return *it->second.framebuffer;
+			}
+
+			auto framebuffer = std::make_unique<FramebufferInstance>();
+			std::vector<uint32_t> colors;
+			for(size_t i = 0; i < count; i++){
+				RenderTarget* target = targets[i];
+				uint32_t attachment = depth_attachment(target->desc.internal_format);
+				if(!attachment){
+					attachment = GL_COLOR_ATTACHMENT0 + (uint32_t)colors.size();
+					colors.push_back(attachment);
+				}
+				target->attach(*framebuffer, attachment);
+			}
+			#ifdef GL_LATEST_FEATURES
+				SAFE_CALL( RenderTargetDrawBuffers, glNamedFramebufferDrawBuffers(framebuffer->id(), (int32_t)colors.size(), colors.data()) );
+			#else
+				framebuffer->bind_draw();
+				SAFE_CALL( RenderTargetDrawBuffers, glDrawBuffers((int32_t)colors.size(), colors.data()) );
+			#endif
+			if(!framebuffer->complete()) throw GLError("RenderTargetPool", std::string("framebuffer ") + framebuffer->status());
+			m_stats.framebuffers++;
+			return *m_framebuffers.emplace(hash, CachedFramebuffer{ std::move(key), std::move(framebuffer) })->second.framebuffer;
+		}
+
+		void begin_frame(){ m_frame++; }
+
+		/**
+		 * @brief frees targets idle for too long, with the framebuffers using them
+		*/
+		void end_frame(){
+			for(auto it = m_targets.begin(); it != m_targets.end();){
+				RenderTarget& target = *it->second;
+				if(target.in_use || m_frame - target.last_use < m_max_idle_frames){
+					++it;
+					continue;
+				}
+				forget_framebuffers(target.object());
+				m_stats.bytes -= target.desc.memory_size();
+				m_stats.targets--;
+				m_stats.frees++;
+				it = m_targets.erase(it);
+			}
+		}
+
+		//frees every target not in use
+		void trim(){
+			uint32_t idle = m_max_idle_frames;
+			m_max_idle_frames = 0;
+			end_frame();
+			m_max_idle_frames = idle;
+		}
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_peaks(){ m_stats.peak_bytes = m_stats.bytes; m_stats.peak_in_use_bytes = m_stats.in_use_bytes; }
+
+		static uint32_t depth_attachment(uint32_t internal_format){
+			switch(internal_format){
+				case GL_DEPTH_COMPONENT: case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24:
+				case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F:
+					return GL_DEPTH_ATTACHMENT;
+				case GL_DEPTH_STENCIL: case GL_DEPTH24_STENCIL8: case GL_DEPTH32F_STENCIL8:
+					return GL_DEPTH_STENCIL_ATTACHMENT;
+				case GL_STENCIL_INDEX8:
+					return GL_STENCIL_ATTACHMENT;
+				default: return 0;
+			}
+		}
+
+	private:
+		uint32_t m_max_idle_frames = 3;
+		uint64_t m_frame = 0;
+		std::unordered_multimap<RenderTargetDesc, std::unique_ptr<RenderTarget>> m_targets;
+		struct CachedFramebuffer {
+			std::vector<AttachedObject> key; //attached targets in order, hashes of different sets may collide
+			std::unique_ptr<FramebufferInstance> framebuffer;
+		};
+
+		std::unordered_multimap<uint64_t, CachedFramebuffer> m_framebuffers; //by hash of the attached objects
+		Stats m_stats;
+
+		RenderTarget& use(RenderTarget& target){
+			target.in_use = true;
+			target.last_use = m_frame;
+			m_stats.in_use_bytes += target.desc.memory_size();
+			m_stats.peak_in_use_bytes = std::max(m_stats.peak_in_use_bytes, m_stats.in_use_bytes);
+			return target;
+		}
+
+		void forget_framebuffers(AttachedObject object){
+			for(auto it = m_framebuffers.begin(); it != m_framebuffers.end();){
+				bool attached = std::find(it->second.key.begin(), it->second.key.end(), object) != it->second.key.end();
+				if(attached){
+					it = m_framebuffers.erase(it);
+					m_stats.framebuffers--;
+				} else ++it;
+			}
+		}
+};
@@ -0,0 +1,513 @@
+#pragma once
+#include "buffer.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <stdexcept>
+
+/**
+ * @brief two level segregated fit allocator, only does the bookkeeping of offsets in abstract units
+ *
+ * blocks are referenced by stable indices, allocation and free are O(1)
+*/
+class TlsfAllocator {
+	public:
+		static constexpr uint32_t invalid = ~0u;
+
+		struct Stats {
+			uint32_t capacity = 0;
+			uint32_t used = 0;
+			uint32_t free = 0;
+			uint32_t largest_free = 0;
+			uint32_t free_blocks = 0;
+			uint32_t allocations = 0;
+
+			//0 when the free space is a single block, close to 1 when it is scattered
+			inline float fragmentation() const { return free ? 1.0f - (float)largest_free / (float)free : 0.0f; }
+		};
+
+		TlsfAllocator(uint32_t capacity):m_capacity(capacity){ reset(); }
+
+		/**
+		 * @brief frees every block
+		*/
+		void reset(){
+			m_blocks.clear();
+			m_unused_nodes.clear();
+			clear_lists();
+			m_used = 0;
+			m_allocations = 0;
+			m_first = invalid;
+			if(m_capacity){
+				m_first = new_node();
+				m_blocks[m_first] = Block{ .offset = 0, .size = m_capacity };
+				insert_free(m_first);
+			}
+		}
+
+		/**
+		 * @return the block index or `invalid` if there is no space
+		*/
+		uint32_t allocate(uint32_t size){
+			if(size == 0 || size > m_capacity) return invalid;
+			uint32_t fl, sl;
+			mapping_search(size, fl, sl);
+			uint32_t index = find_suitable(fl, sl);
+			if(index == invalid) index = find_exact(size);
+			if(index == invalid) return invalid;
+
+			remove_free(index);
+			Block& block = m_blocks[index];
+			if(block.size > size){
+				uint32_t rest = new_node();
+				Block& remainder = m_blocks[rest];
+				Block& split = m_blocks[index]; //new_node may reallocate
+				remainder = Block{
+					.offset = split.offset + size,
+					.size = split.size - size,
+					.prev_phys = index,
+					.next_phys = split.next_phys
+				};
+				if(split.next_phys != invalid) m_blocks[split.next_phys].prev_phys = rest;
+				split.next_phys = rest;
+				split.size = size;
+				insert_free(rest);
+			}
+			m_blocks[index].used = true;
+			m_used += size;
+			m_allocations++;
+			return index;
+		}
+
+		void free(uint32_t index){
+			if(index >= m_blocks.size() || !m_blocks[index].used) throw std::invalid_argument("TlsfAllocator: block is not allocated");
+			m_blocks[index].used = false;
+			m_used -= m_blocks[index].size;
+			m_allocations--;
+
+			//merge with physical neighbours
+			uint32_t prev = m_blocks[index].prev_phys;
+			if(prev != invalid && is_free(prev)){
+				remove_free(prev);
+				absorb(prev, index);
+				index = prev;
+			}
+			uint32_t next = m_blocks[index].next_phys;
+			if(next != invalid && is_free(next)){
+				remove_free(next);
+				absorb(index, next);
+			}
+			insert_free(index);
+		}
+
+		inline uint32_t offset(uint32_t index) const { return m_blocks[index].offset; }
+		inline uint32_t size(uint32_t index) const { return m_blocks[index].size; }
+		inline uint32_t capacity() const { return m_capacity; }
+		inline uint32_t used() const { return m_used; }
+
+		Stats stats() const {
+			Stats stats = {
+				.capacity = m_capacity,
+				.used = m_used,
+				.free = m_capacity - m_used,
+				.allocations = m_allocations
+			};
+			for(uint32_t index = m_first; index != invalid; index = m_blocks[index].next_phys){
+				const Block& block = m_blocks[index];
+				if(block.used) continue;
+				stats.free_blocks++;
+				stats.largest_free = std::max(stats.largest_free, block.size);
+			}
+			return stats;
+		}
+
+		/**
+		 * @brief packs every allocated block at the start of the space keeping their order
+		 * @param move called as move(block, old_offset, new_offset, size) before the block is relocated
+		 * @return amount of units moved
+		*/
+		template<typename F>
+		uint64_t compact(F&& move){
+			uint64_t moved = 0;
+			uint32_t cursor = 0;
+			uint32_t last = invalid;
+			uint32_t index = m_first;
+			clear_lists();
+			m_first = invalid;
+
+			while(index != invalid){
+				uint32_t next = m_blocks[index].next_phys;
+				Block& block = m_blocks[index];
+				if(!block.used){
+					release_node(index);
+				} else {
+					if(block.offset != cursor){
+						move(index, block.offset, cursor, block.size);
+						moved += block.size;
+						block.offset = cursor;
+					}
+					cursor += block.size;
+					block.prev_phys = last;
+					block.next_phys = invalid;
+					if(last != invalid) m_blocks[last].next_phys = index;
+					else m_first = index;
+					last = index;
+				}
+				index = next;
+			}
+
+			if(cursor < m_capacity){
+				uint32_t rest = new_node();
+				m_blocks[rest] = Block{ .offset = cursor, .size = m_capacity - cursor, .prev_phys = last };
+				if(last != invalid) m_blocks[last].next_phys = rest;
+				else m_first = rest;
+				insert_free(rest);
+			}
+			return moved;
+		}
+
+	private:
+		static constexpr uint32_t sl_log2 = 4;
+		static constexpr uint32_t sl_count = 1u << sl_log2;
+		static constexpr uint32_t fl_count = 32;
+
+		struct Block {
+			uint32_t offset = 0;
+			uint32_t size = 0;
+			uint32_t prev_phys = invalid;
+			uint32_t next_phys = invalid;
+			uint32_t prev_free = invalid;
+			uint32_t next_free = invalid;
+			bool used = false;
+			bool listed = false;
+		};
+
+		uint32_t m_capacity = 0;
+		uint32_t m_used = 0;
+		uint32_t m_allocations = 0;
+		uint32_t m_first = invalid;
+		std::vector<Block> m_blocks;
+		std::vector<uint32_t> m_unused_nodes;
+
+		uint32_t m_fl_bitmap = 0;
+		std::array<uint32_t, fl_count> m_sl_bitmap;
+		std::array<std::array<uint32_t, sl_count>, fl_count> m_heads;
+
+		inline bool is_free(uint32_t index) const { return !m_blocks[index].used && m_blocks[index].listed; }
+
+		void clear_lists(){
+			m_fl_bitmap = 0;
+			m_sl_bitmap.fill(0);
+			for(auto& row: m_heads) row.fill(invalid);
+			for(auto& block: m_blocks) block.listed = false;
+		}
+
+		uint32_t new_node(){
+			if(!m_unused_nodes.empty()){
+				uint32_t index = m_unused_nodes.back();
+				m_unused_nodes.pop_back();
+				m_blocks[index] = Block{};
+				return index;
+			}
+			m_blocks.push_back(Block{});
+			return (uint32_t)m_blocks.size() - 1;
+		}
+
+		void release_node(uint32_t index){
+			m_blocks[index] = Block{};
+			m_unused_nodes.push_back(index);
+		}
+
+		//merges `second` (the next physical block) into `first`
+		void absorb(uint32_t first, uint32_t second){
+			Block& a = m_blocks[first];
+			Block& b = m_blocks[second];
+			a.size += b.size;
+			a.next_phys = b.next_phys;
+			if(b.next_phys != invalid) m_blocks[b.next_phys].prev_phys = first;
+			release_node(second);
+		}
+
+		static void mapping_insert(uint32_t size, uint32_t& fl, uint32_t& sl){
+			if(size < sl_count){
+				fl = 0;
+				sl = size;
+			} else {
+				uint32_t msb = std::bit_width(size) - 1;
+				sl = (size >> (msb - sl_log2)) ^ sl_count;
+				fl = msb - sl_log2 + 1;
+			}
+		}
+
+		//rounds up so that every block of the found list is big enough
+		static void mapping_search(uint32_t size, uint32_t& fl, uint32_t& sl){
+			uint64_t rounded = size;
+			if(size >= sl_count){
+				uint32_t msb = std::bit_width(size) - 1;
+				rounded += (1ull << (msb - sl_log2)) - 1;
+			}
+			if(rounded > 0xffffffffull){ fl = fl_count; sl = 0; return; }
+			mapping_insert((uint32_t)rounded, fl, sl);
+		}
+
+		uint32_t find_suitable(uint32_t fl, uint32_t sl) const {
+			if(fl >= fl_count) return invalid;
+			uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+			if(!sl_map){
+				uint32_t fl_map = fl + 1 < fl_count ? m_fl_bitmap & (~0u << (fl + 1)) : 0;
+				if(!fl_map) return invalid;
+				fl = std::countr_zero(fl_map);
+				sl_map = m_sl_bitmap[fl];
+			}
+			sl = std::countr_zero(sl_map);
+			return m_heads[fl][sl];
+		}
+
+		/**
+		 * @brief scans the class `size` falls in, which the rounded search skips, for a block big enough
+		*/
+		uint32_t find_exact(uint32_t size) const {
+			uint32_t fl, sl;
+			mapping_insert(size, fl, sl);
+			for(uint32_t index = m_heads[fl][sl]; index != invalid; index = m_blocks[index].next_free){
+				if(m_blocks[index].size >= size) return index;
+			}
+			return invalid;
+		}
+
+		void insert_free(uint32_t index){
+			uint32_t fl, sl;
+			mapping_insert(m_blocks[index].size, fl, sl);
+			Block& block = m_blocks[index];
+			block.used = false;
+			block.listed = true;
+			block.prev_free = invalid;
+			block.next_free = m_heads[fl][sl];
+			if(block.next_free != invalid) m_blocks[block.next_free].prev_free = index;
+			m_heads[fl][sl] = index;
+			m_fl_bitmap |= 1u << fl;
+			m_sl_bitmap[fl] |= 1u << sl;
+		}
+
+		void remove_free(uint32_t index){
+			uint32_t fl, sl;
+			mapping_insert(m_blocks[index].size, fl, sl);
+			Block& block = m_blocks[index];
+			if(block.prev_free != invalid) m_blocks[block.prev_free].next_free = block.next_free;
+			else m_heads[fl][sl] = block.next_free;
+			if(block.next_free != invalid) m_blocks[block.next_free].prev_free = block.prev_free;
+			block.prev_free = block.next_free = invalid;
+			block.listed = false;
+
+			if(m_heads[fl][sl] == invalid){
+				m_sl_bitmap[fl] &= ~(1u << sl);
+				if(!m_sl_bitmap[fl]) m_fl_bitmap &= ~(1u << fl);
+			}
+		}
+};
+
+/**
+ * @brief handle to a range of a BufferHeap, stays valid across defragmentation
+*/
+struct HeapAllocation {
+	uint32_t page = TlsfAllocator::invalid;
+	uint32_t block = TlsfAllocator::invalid;
+
+	inline bool valid() const { return page != TlsfAllocator::invalid && block != TlsfAllocator::invalid; }
+};
+
+struct BufferRange {
+	uint32_t buffer = 0;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+/**
+ * @brief sub allocates ranges of a few big buffers instead of creating one buffer per mesh
+ *
+ * every offset is a multiple of `unit` bytes, using the vertex stride (or index size) as unit
+ * makes `first()` usable as base vertex (or first index) so meshes sharing a layout can be drawn
+ * from the same vertex array
+*/
+class BufferHeap {
+	public:
+		struct Stats {
+			size_t pages = 0;
+			size_t capacity = 0;
+			size_t used = 0;
+			size_t free = 0;
+			size_t largest_free = 0;
+			size_t free_blocks = 0;
+			size_t allocations = 0;
+
+			inline float fragmentation() const { return free ? 1.0f - (float)largest_free / (float)free : 0.0f; }
+		};
+
+		/**
+		 * @param page_bytes size of each buffer the heap creates
+		 * @param unit allocation granularity in bytes
+		*/
+		BufferHeap(BufferDescriptor desc, size_t page_bytes, size_t unit = 1)
+			:m_descriptor(desc),m_unit(unit ? unit : 1){
+			m_page_units = (uint32_t)std::min<size_t>(page_bytes / m_unit, TlsfAllocator::invalid - 1);
+			if(m_page_units == 0) throw std::invalid_argument("BufferHeap: page size is smaller than the unit");
+		}
+
+		/**
+		 * @brief reserves a range of at least `bytes`, creating a new page when no page has room
+		*/
+		HeapAllocation allocate(size_t bytes){
+			size_t units = (bytes + m_unit - 1) / m_unit;
+			if(units == 0 || units >= TlsfAllocator::invalid) throw std::invalid_argument("BufferHeap: invalid allocation size");
+
+			for(uint32_t i = 0; i < m_pages.size(); i++){
+				uint32_t block = m_pages[i]->allocator.allocate((uint32_t)units);
+				if(block != TlsfAllocator::invalid) return { i, block };
+			}
+
+			//oversized requests get a page of their own
+			uint32_t page = add_page(std::max<uint32_t>(m_page_units, (uint32_t)units));
+			uint32_t block = m_pages[page]->allocator.allocate((uint32_t)units);
+			if(block == TlsfAllocator::invalid){
+				m_pages.pop_back();
+				throw std::length_error("BufferHeap: a new page can't hold " + std::to_string(bytes) + " bytes");
+			}
+			return { page, block };
+		}
+
+		void free(HeapAllocation& allocation){
+			if(!allocation.valid()) return;
+			m_pages.at(allocation.page)->allocator.free(allocation.block);
+			allocation = HeapAllocation{};
+		}
+
+		BufferRange range(const HeapAllocation& allocation) const {
+			const Page& page = *m_pages.at(allocation.page);
+			return {
+				.buffer = page.buffer.id(),
+				.offset = (size_t)page.allocator.offset(allocation.block) * m_unit,
+				.size = (size_t)page.allocator.size(allocation.block) * m_unit
+			};
+		}
+
+		/**
+		 * @brief offset of the allocation in units (base vertex or first index)
+		*/
+		inline uint32_t first(const HeapAllocation& allocation) const {
+			return m_pages.at(allocation.page)->allocator.offset(allocation.block);
+		}
+
+		void upload(const HeapAllocation& allocation, const void* data, size_t bytes, size_t offset = 0){
+			BufferRange dst = range(allocation);
+			if(offset + bytes > dst.size) throw std::out_of_range("BufferHeap: upload outside of the allocation");
+			m_pages[allocation.page]->buffer.sub_data((void*)data, bytes, dst.offset + offset);
+		}
+
+		template<typename T, typename... Args>
+		inline void upload(const HeapAllocation& allocation, const std::vector<T,Args...>& container){
+			upload(allocation, container.data(), sizeof(T)*container.size());
+		}
+
+		inline BufferInstance& page(const HeapAllocation& allocation){ return m_pages.at(allocation.page)->buffer; }
+		inline BufferInstance& page(size_t index){ return m_pages.at(index)->buffer; }
+		inline size_t page_count() const { return m_pages.size(); }
+		inline size_t unit() const { return m_unit; }
+
+		/**
+		 * @brief packs every page moving the data with glCopyBufferSubData
+		 *
+		 * buffer names don't change so vertex arrays stay valid, offsets do: ranges and `first()`
+		 * must be queried again for every allocation afterwards
+		 * @return amount of bytes moved on the GPU
+		*/
+		size_t defragment(){
+			size_t moved = 0;
+			for(auto& page: m_pages){
+				if(page->allocator.stats().free_blocks <= 1) continue;
+				BufferInstance& buffer = page->buffer;
+				moved += (size_t)page->allocator.compact([&](uint32_t, uint32_t from, uint32_t to, uint32_t size){
+					move(buffer, (size_t)from * m_unit, (size_t)to * m_unit, (size_t)size * m_unit);
+				}) * m_unit;
+			}
+			return moved;
+		}
+
+		Stats page_stats(size_t index) const {
+			return to_bytes(m_pages.at(index)->allocator.stats());
+		}
+
+		Stats stats() const {
+			Stats total;
+			for(auto& page: m_pages){
+				Stats page_stats = to_bytes(page->allocator.stats());
+				total.capacity += page_stats.capacity;
+				total.used += page_stats.used;
+				total.free += page_stats.free;
+				total.free_blocks += page_stats.free_blocks;
+				total.allocations += page_stats.allocations;
+				total.largest_free = std::max(total.largest_free, page_stats.largest_free);
+			}
+			total.pages = m_pages.size();
+			return total;
+		}
+
+	private:
+		struct Page {
+			BufferInstance buffer;
+			TlsfAllocator allocator;
+
+			Page(BufferDescriptor desc, uint32_t units):buffer(desc),allocator(units){}
+		};
+
+		BufferDescriptor m_descriptor;
+		size_t m_unit = 1;
+		uint32_t m_page_units = 0;
+		std::vector<std::unique_ptr<Page>> m_pages;
+		std::unique_ptr<BufferInstance> p_scratch;
+
+		uint32_t add_page(uint32_t units){
+			m_pages.push_back(std::make_unique<Page>(m_descriptor, units));
+			m_pages.back()->buffer.storage((size_t)units * m_unit);
+			return (uint32_t)m_pages.size() - 1;
+		}
+
+		Stats to_bytes(const TlsfAllocator::Stats& stats) const {
+			return {
+				.pages = 1,
+				.capacity = (size_t)stats.capacity * m_unit,
+				.used = (size_t)stats.used * m_unit,
+				.free = (size_t)stats.free * m_unit,
+				.largest_free = (size_t)stats.largest_free * m_unit,
+				.free_blocks = stats.free_blocks,
+				.allocations = stats.allocations
+			};
+		}
+
+		//blocks only move towards the start of the page
+		void move(BufferInstance& buffer, size_t from, size_t to, size_t size){
+			size_t gap = from - to;
+			if(gap >= size){
+				buffer.copy_from(buffer, from, to, size);
+				return;
+			}
+			//overlapping copies within a buffer are undefined, chunks no bigger than the gap are safe
+			if(size / gap <= 8){
+				for(size_t done = 0; done < size; done += gap){
+					buffer.copy_from(buffer, from + done, to + done, std::min(gap, size - done));
+				}
+				return;
+			}
+			//too many chunks, go through a scratch buffer instead
+			if(!p_scratch || p_scratch->size() < size){
+				p_scratch = std::make_unique<BufferInstance>(BufferDescriptor{
+					.target = BufferTarget::Array,
+					.usage = BufferUsage::StreamCopy,
+					.access = BufferAccess::ReadWrite
+				});
+				p_scratch->storage(size);
+			}
+			p_scratch->copy_from(buffer, from, 0, size);
+			buffer.copy_from(*p_scratch, 0, to, size);
+		}
+};
@@ -0,0 +1,814 @@
+#pragma once
+#include "texture.hpp"
+#include "utils/thread_pool.hpp"
+#include <cfloat>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MIPMAP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MIPMAP_TARGET(T)
+#else
+#define MIPMAP_TARGET(T) __attribute__((target(T)))
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define MIPMAP_NEON 1
+#include <arm_neon.h>
+#endif
+
+enum class MipFormat: uint8_t {
+	R8,
+	RGB8,
+	RGBA8,
+	RGBA16F
+};
+
+inline size_t mip_format_channels(MipFormat format){
+	switch(format){
+		case MipFormat::R8: return 1;
+		case MipFormat::RGB8: return 3;
+		default: return 4;
+	}
+}
+
+inline size_t mip_format_pixel_size(MipFormat format){
+	return format == MipFormat::RGBA16F ? 8 : mip_format_channels(format);
+}
+
+enum class MipFilter: uint8_t {
+	Box,
+	Kaiser,
+	Lanczos
+};
+
+struct MipOptions {
+	MipFilter filter = MipFilter::Box;
+	bool srgb = false; //8 bit color channels are sRGB encoded, filtering happens in linear space
+	bool alpha_weighted = false; //straight alpha: colors are weighted by alpha so transparent texels don't bleed
+	uint32_t max_levels = 0; //including the base level, 0 for the full chain
+};
+
+struct MipLevel {
+	size_t width = 0, height = 0;
+	std::vector<uint8_t> data; //tightly packed rows
+};
+
+/**
+ * @brief levels generated for a base image, `levels[0]` is level 1
+*/
+struct MipChain {
+	MipFormat format = MipFormat::RGBA8;
+	std::vector<MipLevel> levels;
+
+	inline uint32_t gl_format() const {
+		switch(format){
+			case MipFormat::R8: return GL_RED;
+			case MipFormat::RGB8: return GL_RGB;
+			default: return GL_RGBA;
+		}
+	}
+
+	inline uint32_t gl_datatype() const { return format == MipFormat::RGBA16F ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE; }
+
+	/**
+	 * @brief uploads every level starting at `first_level`, the texture storage must already hold them
+	 * @param layer array layer (or cube face) receiving the levels
+	*/
+	void upload(TextureInstance& texture, int first_level = 1, size_t layer = 0) const {
+		int32_t alignment = 4;
+		SAFE_CALL( MipChainUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+		SAFE_CALL( MipChainUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+		TextureType type = texture.texture_type();
+		for(size_t i = 0; i < levels.size(); i++){
+			TextureRegion region = {
+				.level = first_level + (int)i,
+				.width = levels[i].width,
+				.height = levels[i].height,
+				.format = gl_format(),
+				.datatype = gl_datatype()
+			};
+			if(type == TextureType::Tex1DArray) region.y = layer;
+			else region.z = layer;
+			texture.update(region, levels[i].data.data());
+		}
+		SAFE_CALL( MipChainUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, alignment) );
+	}
+};
+
+namespace mip_detail {
+	inline float srgb_to_linear(float v){ return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f); }
+
+	struct SrgbTables {
+		float to_linear[256];
+		float unorm[256]; //i / 255, for the channels that aren't sRGB encoded
+		float thresholds[256]; //linear value halfway between two consecutive sRGB codes, and a sentinel
+		uint8_t encode_start[4100]; //code of the lower bound of each 1/4096 step of linear values, 1.0 included, padded for 4 byte gathers
+
+		SrgbTables(){
+			for(int i = 0; i < 256; i++) to_linear[i] = srgb_to_linear(i / 255.0f);
+			for(int i = 0; i < 256; i++) unorm[i] = i / 255.0f;
+			for(int i = 0; i < 255; i++) thresholds[i] = srgb_to_linear((i + 0.5f) / 255.0f);
+			thresholds[255] = 2.0f;
+			memset(encode_start, 0, sizeof(encode_start));
+			for(int i = 0; i <= 4096; i++) encode_start[i] = (uint8_t)(std::upper_bound(thresholds, thresholds + 255, i / 4096.0f) - thresholds);
+		}
+
+		/**
+		 * @brief nearest code of a linear value. thresholds are at least 1 / (255 * 12.92) apart, more than a
+		 * step, so one comparison finishes the lookup exactly. branch free, nan encodes to 0
+		*/
+		inline uint8_t encode(float linear) const {
+			linear = linear > 0.0f ? (linear < 1.0f ? linear : 1.0f) : 0.0f;
+			uint32_t code = encode_start[(uint32_t)(linear * 4096.0f)];
+			return (uint8_t)(code + (thresholds[code] <= linear));
+		}
+	};
+
+	inline const SrgbTables& srgb_tables(){
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	inline float half_to_float(uint16_t h){
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+		uint32_t bits;
+		if(exponent == 0){
+			if(mantissa == 0) bits = sign;
+			else {
+				//denormal, normalized for the float exponent
+				exponent = 113;
+				while(!(mantissa & 0x400)){
+					mantissa <<= 1;
+					exponent--;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+			}
+		} else if(exponent == 31) bits = sign | 0x7f800000 | (mantissa << 13);
+		else bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	inline uint16_t float_to_half(float f){
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		uint16_t sign = (bits >> 16) & 0x8000;
+		int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 112;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if(((bits >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mantissa ? 0x200 : 0); //inf, nan
+		if(exponent >= 31) return sign | 0x7c00; //overflow
+		if(exponent <= 0){
+			if(exponent < -10) return sign; //underflow
+			mantissa |= 0x800000;
+			uint32_t shift = 14 - exponent;
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t middle = 1u << (shift - 1);
+			if(rest > middle || (rest == middle && (half & 1))) half++;
+			return sign | (uint16_t)half;
+		}
+		uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fff;
+		if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; //may carry into the exponent, still correct
+		return sign | (uint16_t)half;
+	}
+
+	inline double sinc(double x){
+		if(std::abs(x) < 1e-9) return 1.0;
+		x *= 3.14159265358979323846;
+		return std::sin(x) / x;
+	}
+
+	inline double bessel_i0(double x){
+		double sum = 1.0, term = 1.0, q = x * x / 4.0;
+		for(int k = 1; k < 32; k++){
+			term *= q / ((double)k * k);
+			sum += term;
+			if(term < sum * 1e-12) break;
+		}
+		return sum;
+	}
+
+	/**
+	 * @brief weights of the 2:1 downsampling filter, output i reads input 2 * i + first + t
+	*/
+	struct Kernel {
+		int32_t first = 0;
+		std::vector<float> weights;
+
+		Kernel(MipFilter filter){
+			if(filter == MipFilter::Box){
+				first = 0;
+				weights = { 0.5f, 0.5f };
+				return;
+			}
+			//windowed sincs of radius 3 in output texels
+			constexpr double radius = 3.0, alpha = 4.0;
+			first = 1 - (int32_t)(radius * 2);
+			double sum = 0.0;
+			std::vector<double> raw;
+			for(int32_t t = first; t <= (int32_t)(radius * 2); t++){
+				double d = (t - 0.5) / 2.0;
+				double window = filter == MipFilter::Lanczos ? sinc(d / radius) : bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - (d / radius) * (d / radius)))) / bessel_i0(alpha);
+				raw.push_back(std::abs(d) < radius ? sinc(d) * window : 0.0);
+				sum += raw.back();
+			}
+			for(double w: raw) weights.push_back((float)(w / sum));
+		}
+	};
+
+	inline void box_rows_scalar(const uint8_t* src, size_t w, size_t h, uint8_t* dst, size_t channels, size_t y0, size_t y1){
+		size_t w2 = std::max<size_t>(w / 2, 1);
+		size_t stride = w * channels;
+		for(size_t y = y0; y < y1; y++){
+			const uint8_t* r0 = src + std::min(2 * y, h - 1) * stride;
+			const uint8_t* r1 = src + std::min(2 * y + 1, h - 1) * stride;
+			uint8_t* out = dst + y * w2 * channels;
+			for(size_t x = 0; x < w2; x++){
+				size_t x0 = std::min(2 * x, w - 1) * channels, x1 = std::min(2 * x + 1, w - 1) * channels;
+				for(size_t c = 0; c < channels; c++){
+					out[x * channels + c] = (uint8_t)((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief scalar columns [x, w2) of one output row
+	*/
+	inline void box_tail(const uint8_t* r0, const uint8_t* r1, size_t w, uint8_t* out, size_t channels, size_t x, size_t w2){
+		for(; x < w2; x++){
+			size_t x0 = std::min(2 * x, w - 1) * channels, x1 = std::min(2 * x + 1, w - 1) * channels;
+			for(size_t c = 0; c < channels; c++){
+				out[x * channels + c] = (uint8_t)((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+
+	#ifdef MIPMAP_X86
+	//pairs the same channel of two neighbouring texels so maddubs sums them
+	MIPMAP_TARGET("sse4.1") inline __m128i box_mask(size_t channels){
+		if(channels == 4) return _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+		if(channels == 3) return _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1);
+		return _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	}
+
+	/**
+	 * @brief every 16 loaded bytes produce `out_bytes` bytes: 2 texels for RGBA8 and RGB8 (12 bytes used), 8 for R8
+	*/
+	MIPMAP_TARGET("sse4.1") inline void box_rows_sse4(const uint8_t* src, size_t w, size_t h, uint8_t* dst, size_t channels, size_t y0, size_t y1){
+		const __m128i mask = box_mask(channels);
+		const __m128i ones = _mm_set1_epi8(1);
+		const __m128i round = _mm_set1_epi16(2);
+		size_t in_bytes = channels == 3 ? 12 : 16;
+		size_t out_texels = in_bytes / channels / 2;
+		size_t out_bytes = out_texels * channels;
+		size_t w2 = std::max<size_t>(w / 2, 1);
+		size_t stride = w * channels;
+
+		for(size_t y = y0; y < y1; y++){
+			const uint8_t* r0 = src + std::min(2 * y, h - 1) * stride;
+			const uint8_t* r1 = src + std::min(2 * y + 1, h - 1) * stride;
+			uint8_t* out = dst + y * w2 * channels;
+			size_t x = 0;
+			if(w >= 2){
+				for(; 2 * x * channels + 16 <= stride && x + out_texels <= w2; x += out_texels){
+					__m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(r0 + 2 * x * channels)), mask);
+					__m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(r1 + 2 * x * channels)), mask);
+					__m128i sum = _mm_add_epi16(_mm_maddubs_epi16(a, ones), _mm_maddubs_epi16(b, ones));
+					sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+					alignas(16) uint8_t packed[16];
+					_mm_store_si128((__m128i*)packed, _mm_packus_epi16(sum, sum));
+					memcpy(out + x * channels, packed, out_bytes);
+				}
+			}
+			box_tail(r0, r1, w, out, channels, x, w2);
+		}
+	}
+
+	MIPMAP_TARGET("avx2") inline void box_rows_avx2(const uint8_t* src, size_t w, size_t h, uint8_t* dst, size_t channels, size_t y0, size_t y1){
+		const __m256i mask = _mm256_broadcastsi128_si256(box_mask(channels));
+		const __m256i ones = _mm256_set1_epi8(1);
+		const __m256i round = _mm256_set1_epi16(2);
+		size_t in_bytes = channels == 3 ? 12 : 16;
+		size_t out_texels = in_bytes / channels / 2;
+		size_t out_bytes = out_texels * channels;
+		size_t w2 = std::max<size_t>(w / 2, 1);
+		size_t stride = w * channels;
+
+		for(size_t y = y0; y < y1; y++){
+			const uint8_t* r0 = src + std::min(2 * y, h - 1) * stride;
+			const uint8_t* r1 = src + std::min(2 * y + 1, h - 1) * stride;
+			uint8_t* out = dst + y * w2 * channels;
+			size_t x = 0;
+			if(w >= 2){
+				//each 128 bit lane handles `in_bytes` of input
+				for(; 2 * x * channels + in_bytes + 16 <= stride && x + 2 * out_texels <= w2; x += 2 * out_texels){
+					const uint8_t* p0 = r0 + 2 * x * channels;
+					const uint8_t* p1 = r1 + 2 * x * channels;
+					__m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p0)), _mm_loadu_si128((const __m128i*)(p0 + in_bytes)), 1);
+					__m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p1)), _mm_loadu_si128((const __m128i*)(p1 + in_bytes)), 1);
+					a = _mm256_shuffle_epi8(a, mask);
+					b = _mm256_shuffle_epi8(b, mask);
+					__m256i sum = _mm256_add_epi16(_mm256_maddubs_epi16(a, ones), _mm256_maddubs_epi16(b, ones));
+					sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 2);
+					alignas(32) uint8_t packed[32];
+					_mm256_store_si256((__m256i*)packed, _mm256_packus_epi16(sum, sum));
+					memcpy(out + x * channels, packed, out_bytes);
+					memcpy(out + (x + out_texels) * channels, packed + 16, out_bytes);
+				}
+			}
+			box_tail(r0, r1, w, out, channels, x, w2);
+		}
+	}
+	#endif
+
+	#ifdef MIPMAP_NEON
+	/**
+	 * @brief de-interleaving loads put each channel in its own register, every step writes 8 texels
+	*/
+	inline void box_rows_neon(const uint8_t* src, size_t w, size_t h, uint8_t* dst, size_t channels, size_t y0, size_t y1){
+		size_t w2 = std::max<size_t>(w / 2, 1);
+		size_t stride = w * channels;
+		for(size_t y = y0; y < y1; y++){
+			const uint8_t* r0 = src + std::min(2 * y, h - 1) * stride;
+			const uint8_t* r1 = src + std::min(2 * y + 1, h - 1) * stride;
+			uint8_t* out = dst + y * w2 * channels;
+			size_t x = 0;
+			if(w >= 2){
+				for(; 2 * x + 16 <= w && x + 8 <= w2; x += 8){
+					const uint8_t* p0 = r0 + 2 * x * channels;
+					const uint8_t* p1 = r1 + 2 * x * channels;
+					if(channels == 4){
+						uint8x16x4_t a = vld4q_u8(p0), b = vld4q_u8(p1);
+						uint8x8x4_t result;
+						for(int c = 0; c < 4; c++) result.val[c] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c])), 2);
+						vst4_u8(out + x * 4, result);
+					} else if(channels == 3){
+						uint8x16x3_t a = vld3q_u8(p0), b = vld3q_u8(p1);
+						uint8x8x3_t result;
+						for(int c = 0; c < 3; c++) result.val[c] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c])), 2);
+						vst3_u8(out + x * 3, result);
+					} else {
+						vst1_u8(out + x, vrshrn_n_u16(vaddq_u16(vpaddlq_u8(vld1q_u8(p0)), vpaddlq_u8(vld1q_u8(p1))), 2));
+					}
+				}
+			}
+			box_tail(r0, r1, w, out, channels, x, w2);
+		}
+	}
+	#endif
+
+	/*
+	 * float path kernels, 4 floats per register on SSE (baseline on x86-64) or NEON. they add the taps
+	 * in the order of the scalar loops with separate multiplies and adds, so results match it bit for bit
+	*/
+	#if defined(MIPMAP_X86) || defined(MIPMAP_NEON)
+	#define MIPMAP_FLOAT4 1
+	#ifdef MIPMAP_X86
+	using float4 = __m128;
+	inline float4 zero4(){ return _mm_setzero_ps(); }
+	inline float4 load4(const float* p){ return _mm_loadu_ps(p); }
+	inline void store4(float* p, float4 v){ _mm_storeu_ps(p, v); }
+	inline float4 madd4(float4 sum, float weight, float4 v){ return _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight), v)); }
+	inline float4 evens4(const float* p){ return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2, 0, 2, 0)); }
+	#else
+	using float4 = float32x4_t;
+	inline float4 zero4(){ return vdupq_n_f32(0.0f); }
+	inline float4 load4(const float* p){ return vld1q_f32(p); }
+	inline void store4(float* p, float4 v){ vst1q_f32(p, v); }
+	inline float4 madd4(float4 sum, float weight, float4 v){ return vaddq_f32(sum, vmulq_n_f32(v, weight)); }
+	inline float4 evens4(const float* p){ return vld2q_f32(p).val[0]; }
+	#endif
+
+	/**
+	 * @brief horizontal pass of one row, 4 channel texels one per register, single channels 4 outputs
+	 * at a time. columns whose taps leave the row are clamped texel by texel
+	*/
+	inline void filter_row4(const float* row, size_t w, size_t channels, const Kernel& kernel, float* dst, size_t w2){
+		size_t taps = kernel.weights.size();
+		const float* weights = kernel.weights.data();
+		auto clamped = [&](size_t x, size_t c){
+			float sum = 0.0f;
+			for(size_t t = 0; t < taps; t++){
+				int64_t sx = std::clamp<int64_t>((int64_t)(2 * x) + kernel.first + (int64_t)t, 0, (int64_t)w - 1);
+				sum += weights[t] * row[sx * channels + c];
+			}
+			return sum;
+		};
+
+		for(size_t x = 0; x < w2;){
+			int64_t start = (int64_t)(2 * x) + kernel.first;
+			if(channels == 4 && start >= 0 && start + (int64_t)taps <= (int64_t)w){
+				const float* p = row + start * 4;
+				float4 sum = zero4();
+				for(size_t t = 0; t < taps; t++) sum = madd4(sum, weights[t], load4(p + t * 4));
+				store4(dst + x * 4, sum);
+				x++;
+			} else if(channels == 1 && x + 4 <= w2 && start >= 0 && start + (int64_t)taps + 7 <= (int64_t)w){
+				const float* p = row + start;
+				float4 sum = zero4();
+				for(size_t t = 0; t < taps; t++) sum = madd4(sum, weights[t], evens4(p + t));
+				store4(dst + x, sum);
+				x += 4;
+			} else {
+				for(size_t c = 0; c < channels; c++) dst[x * channels + c] = clamped(x, c);
+				x++;
+			}
+		}
+	}
+
+	/**
+	 * @brief vertical pass of one output row from the `taps` source rows it reads
+	*/
+	inline void filter_column4(const float* const* rows, const float* weights, size_t taps, size_t count, float* dst){
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4){
+			float4 sum = zero4();
+			for(size_t t = 0; t < taps; t++) sum = madd4(sum, weights[t], load4(rows[t] + i));
+			store4(dst + i, sum);
+		}
+		for(; i < count; i++){
+			float sum = 0.0f;
+			for(size_t t = 0; t < taps; t++) sum += weights[t] * rows[t][i];
+			dst[i] = sum;
+		}
+	}
+	#endif
+
+	#ifdef MIPMAP_X86
+	inline bool has_f16c(){
+		#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 29)) && (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6);
+		#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+		#endif
+	}
+
+	//hardware conversions round to nearest even like float_to_half, only nan payloads may differ
+	MIPMAP_TARGET("avx,f16c") inline void half_to_float_f16c(const uint16_t* in, float* out, size_t count){
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in + i))));
+		for(; i < count; i++) out[i] = half_to_float(in[i]);
+	}
+
+	MIPMAP_TARGET("avx,f16c") inline void float_to_half_f16c(const float* in, uint16_t* out, size_t count){
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8) _mm_storeu_si128((__m128i*)(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+		for(; i < count; i++) out[i] = float_to_half(in[i]);
+	}
+
+	/**
+	 * @brief 1 and 4 channel texels to floats, 8 channels per gather with the alpha lanes offset onto `unorm`
+	 * @return texels converted, the caller finishes the rest
+	*/
+	MIPMAP_TARGET("avx2") inline size_t decode_avx2(const uint8_t* in, float* out, size_t count, size_t channels, const float* color, const float* unorm){
+		int32_t alpha = (int32_t)(unorm - color);
+		__m256i offset = channels == 4 ? _mm256_setr_epi32(0, 0, 0, alpha, 0, 0, 0, alpha) : _mm256_setzero_si256();
+		size_t values = count * channels / 8 * 8;
+		for(size_t i = 0; i < values; i += 8){
+			__m256i index = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i))), offset);
+			_mm256_storeu_ps(out + i, _mm256_i32gather_ps(color, index, 4));
+		}
+		return values / channels;
+	}
+
+	/**
+	 * @brief 1 and 4 channel texels back to bytes with the same operations as the scalar path, so results match it bit for bit
+	 * @return texels converted, the caller finishes the rest
+	*/
+	MIPMAP_TARGET("avx2") inline size_t encode_avx2(const float* in, uint8_t* out, size_t count, size_t channels, bool srgb, bool weighted, const SrgbTables& tables){
+		bool rgba = channels == 4;
+		__m256 alpha_lanes = _mm256_castsi256_ps(rgba ? _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1) : _mm256_setzero_si256());
+		__m256 color_lanes = _mm256_xor_ps(alpha_lanes, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+		__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+		size_t values = count * channels / 8 * 8;
+		for(size_t i = 0; i < values; i += 8){
+			__m256 v = _mm256_loadu_ps(in + i);
+			if(weighted && rgba){
+				__m256 alpha = _mm256_min_ps(_mm256_max_ps(_mm256_permute_ps(v, 0xff), zero), one);
+				__m256 straight = _mm256_div_ps(v, _mm256_max_ps(alpha, _mm256_set1_ps(FLT_MIN)));
+				straight = _mm256_and_ps(straight, _mm256_cmp_ps(alpha, zero, _CMP_GT_OQ));
+				v = _mm256_blendv_ps(straight, v, alpha_lanes);
+			}
+			__m256 c = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+			__m256i result = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+			if(srgb){
+				__m256i code = _mm256_i32gather_epi32((const int*)tables.encode_start, _mm256_cvttps_epi32(_mm256_mul_ps(c, _mm256_set1_ps(4096.0f))), 1);
+				code = _mm256_and_si256(code, _mm256_set1_epi32(0xff));
+				__m256 threshold = _mm256_i32gather_ps(tables.thresholds, code, 4);
+				code = _mm256_sub_epi32(code, _mm256_castps_si256(_mm256_cmp_ps(threshold, c, _CMP_LE_OQ)));
+				result = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(result), _mm256_castsi256_ps(code), color_lanes));
+			}
+			__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+			_mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(words, words));
+		}
+		return values / channels;
+	}
+	#endif
+}
+
+/**
+ * @brief builds mip chains on the CPU, ahead of time and off the render thread
+ *
+ * plain 8 bit box filtering runs on SIMD kernels (AVX2, SSE4.1 or NEON, picked at runtime). sRGB,
+ * alpha weighted, windowed sinc (Kaiser, Lanczos) and RGBA16F chains go through a float path that
+ * keeps full precision between levels: its separable filter passes run 4 floats at a time (SSE or
+ * NEON), half floats convert with F16C when present, sRGB decodes through a table and encodes through
+ * a 12 bit table refined against the exact thresholds; with AVX2 both table lookups, the alpha
+ * weighting and the 8 bit quantization use gathers, elsewhere they stay scalar. the source is
+ * converted row by row as the filter reads it and only a ring of filtered rows is kept. every SIMD
+ * path matches the Scalar backend bit for bit (nan payloads of half floats aside). rows are split
+ * over the thread pool when one is given.
+ *
+ * limitation: the float path still trails the driver. on one core at 512x512 an sRGB box chain takes
+ * about twice as long as glGenerateMipmap on llvmpipe (Kaiser about 6x), see bench/mipmap.cpp. use it
+ * for the filters and off-thread work the driver can't do, not to beat a plain sRGB box chain on the GPU.
+*/
+class MipGenerator {
+	public:
+		enum class Backend: uint8_t {
+			Scalar,
+			SSE4,
+			AVX2,
+			NEON
+		};
+
+		/**
+		 * @param pool optional, the calling thread works as well so it's safe to call from a task of the same pool
+		*/
+		MipGenerator(ThreadPool* pool = nullptr, Backend backend = detect()):m_pool(pool){ set_backend(backend); }
+
+		/**
+		 * @brief generates the levels below `pixels` (tightly packed rows)
+		*/
+		MipChain generate(const void* pixels, size_t width, size_t height, MipFormat format, const MipOptions& options = {}) const {
+			MipChain chain = { .format = format, .levels = {} };
+			uint32_t count = mip_levels(width, height);
+			if(options.max_levels) count = std::min(count, options.max_levels);
+			if(count <= 1) return chain;
+			chain.levels.resize(count - 1);
+
+			size_t channels = mip_format_channels(format);
+			bool simd_box = options.filter == MipFilter::Box && format != MipFormat::RGBA16F && !options.srgb && !(options.alpha_weighted && channels == 4);
+			if(simd_box){
+				const uint8_t* source = (const uint8_t*)pixels;
+				size_t w = width, h = height;
+				for(auto& level: chain.levels){
+					level.width = std::max<size_t>(w / 2, 1);
+					level.height = std::max<size_t>(h / 2, 1);
+					level.data.resize(level.width * level.height * channels);
+					parallel_rows(level.height, [&](size_t y0, size_t y1){ box_rows(source, w, h, level.data.data(), channels, y0, y1); });
+					source = level.data.data();
+					w = level.width;
+					h = level.height;
+				}
+				return chain;
+			}
+
+			mip_detail::Kernel kernel(options.filter);
+			size_t stride = float_channels(channels);
+			std::vector<float> current, next;
+			size_t w = width, h = height;
+			for(auto& level: chain.levels){
+				level.width = std::max<size_t>(w / 2, 1);
+				level.height = std::max<size_t>(h / 2, 1);
+				if(&level == &chain.levels.front()){
+					//the base image is converted row by row as the first pass reads it
+					downsample([&](size_t y, float* buffer){
+						to_float(pixels, y * width, width, format, options, buffer);
+						return (const float*)buffer;
+					}, w, h, stride, kernel, next);
+				} else downsample([&](size_t y, float*){ return (const float*)&current[y * w * stride]; }, w, h, stride, kernel, next);
+				from_float(next, level, format, options);
+				current.swap(next);
+				w = level.width;
+				h = level.height;
+			}
+			return chain;
+		}
+
+		inline Backend backend() const { return m_backend; }
+
+		/**
+		 * @brief forces a backend, Scalar is the reference the SIMD kernels must match
+		*/
+		inline void set_backend(Backend backend){
+			m_backend = backend;
+			#ifdef MIPMAP_X86
+			b_f16c = backend != Backend::Scalar && mip_detail::has_f16c();
+			#endif
+		}
+
+		static Backend detect(){
+			#ifdef MIPMAP_X86
+			#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			bool sse4 = info[2] & (1 << 19);
+			bool os_avx = (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6);
+			__cpuidex(info, 7, 0);
+			if(os_avx && (info[1] & (1 << 5))) return Backend::AVX2;
+			if(sse4) return Backend::SSE4;
+			#else
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("avx2")) return Backend::AVX2;
+			if(__builtin_cpu_supports("sse4.1")) return Backend::SSE4;
+			#endif
+			#elif defined(MIPMAP_NEON)
+			return Backend::NEON;
+			#endif
+			return Backend::Scalar;
+		}
+
+	private:
+		ThreadPool* m_pool = nullptr;
+		Backend m_backend = Backend::Scalar;
+		bool b_f16c = false; //half conversions in hardware
+
+		//RGB is filtered as RGBA so its texels fill a SIMD register
+		static constexpr size_t float_channels(size_t channels){ return channels == 3 ? 4 : channels; }
+
+		template<size_t C>
+		static void decode_texels(const uint8_t* in, float* out, size_t count, const float* color, const float* unorm){
+			for(size_t i = 0; i < count; i++){
+				for(size_t c = 0; c < C; c++) out[i * float_channels(C) + c] = (C != 4 || c < 3 ? color : unorm)[in[i * C + c]];
+			}
+		}
+
+		//straight colors back from alpha weighted ones
+		static inline void unweight(float texel[4]){
+			float alpha = std::clamp(texel[3], 0.0f, 1.0f);
+			float divisor = std::max(alpha, FLT_MIN); //the select below stays branch free
+			for(size_t c = 0; c < 3; c++) texel[c] = alpha > 0.0f ? texel[c] / divisor : 0.0f;
+		}
+
+		template<size_t C>
+		static void encode_texels(const float* in, uint8_t* out, size_t count, bool srgb, bool weighted, const mip_detail::SrgbTables& tables){
+			for(size_t i = 0; i < count; i++){
+				float texel[4];
+				for(size_t c = 0; c < C; c++) texel[c] = in[i * float_channels(C) + c];
+				if(C == 4 && weighted) unweight(texel);
+				for(size_t c = 0; c < C; c++){
+					float v = std::clamp(texel[c], 0.0f, 1.0f);
+					out[i * C + c] = srgb && (C != 4 || c < 3) ? tables.encode(v) : (uint8_t)(v * 255.0f + 0.5f);
+				}
+			}
+		}
+
+		void box_rows(const uint8_t* src, size_t w, size_t h, uint8_t* dst, size_t channels, size_t y0, size_t y1) const {
+			switch(m_backend){
+				#ifdef MIPMAP_X86
+				case Backend::AVX2: mip_detail::box_rows_avx2(src, w, h, dst, channels, y0, y1); return;
+				case Backend::SSE4: mip_detail::box_rows_sse4(src, w, h, dst, channels, y0, y1); return;
+				#endif
+				#ifdef MIPMAP_NEON
+				case Backend::NEON: mip_detail::box_rows_neon(src, w, h, dst, channels, y0, y1); return;
+				#endif
+				default: mip_detail::box_rows_scalar(src, w, h, dst, channels, y0, y1); return;
+			}
+		}
+
+		template<typename F>
+		inline void parallel_rows(size_t rows, F&& f) const { parallel_for(m_pool, rows, 16, f); }
+
+		/**
+		 * @brief converts `count` texels of `pixels` from texel `first` on to linear (and alpha weighted) floats
+		*/
+		void to_float(const void* pixels, size_t first, size_t count, MipFormat format, const MipOptions& options, float* out) const {
+			size_t channels = mip_format_channels(format);
+			const mip_detail::SrgbTables& tables = mip_detail::srgb_tables();
+			if(format == MipFormat::RGBA16F){
+				const uint16_t* in = (const uint16_t*)pixels + first * 4;
+				#ifdef MIPMAP_X86
+				if(b_f16c) mip_detail::half_to_float_f16c(in, out, count * 4);
+				else
+				#endif
+				for(size_t i = 0; i < count * 4; i++) out[i] = mip_detail::half_to_float(in[i]);
+			} else {
+				const uint8_t* in = (const uint8_t*)pixels + first * channels;
+				const float* color = options.srgb ? tables.to_linear : tables.unorm;
+				size_t done = 0;
+				#ifdef MIPMAP_X86
+				if(m_backend == Backend::AVX2 && channels != 3) done = mip_detail::decode_avx2(in, out, count, channels, color, tables.unorm);
+				#endif
+				in += done * channels;
+				float* rest = out + done * float_channels(channels);
+				if(channels == 4) decode_texels<4>(in, rest, count - done, color, tables.unorm);
+				else if(channels == 3) decode_texels<3>(in, rest, count - done, color, tables.unorm);
+				else decode_texels<1>(in, rest, count - done, color, tables.unorm);
+			}
+			if(options.alpha_weighted && channels == 4){
+				for(size_t i = 0; i < count; i++) for(size_t c = 0; c < 3; c++) out[i * 4 + c] *= out[i * 4 + 3];
+			}
+		}
+
+		void from_float(const std::vector<float>& pixels, MipLevel& level, MipFormat format, const MipOptions& options) const {
+			size_t channels = mip_format_channels(format);
+			size_t stride = float_channels(channels);
+			level.data.resize(level.width * level.height * mip_format_pixel_size(format));
+			const mip_detail::SrgbTables& tables = mip_detail::srgb_tables();
+			bool weighted = options.alpha_weighted && channels == 4;
+
+			parallel_rows(level.height, [&](size_t y0, size_t y1){
+				size_t first = y0 * level.width, count = (y1 - y0) * level.width;
+				const float* in = &pixels[first * stride];
+				std::vector<float> texels(format == MipFormat::RGBA16F ? count * 4 : 0);
+
+				if(format != MipFormat::RGBA16F){
+					uint8_t* out = level.data.data() + first * channels;
+					size_t done = 0;
+					#ifdef MIPMAP_X86
+					if(m_backend == Backend::AVX2 && channels != 3) done = mip_detail::encode_avx2(in, out, count, channels, options.srgb, weighted, tables);
+					#endif
+					in += done * stride;
+					out += done * channels;
+					if(channels == 4) encode_texels<4>(in, out, count - done, options.srgb, weighted, tables);
+					else if(channels == 3) encode_texels<3>(in, out, count - done, options.srgb, weighted, tables);
+					else encode_texels<1>(in, out, count - done, options.srgb, weighted, tables);
+				} else {
+					for(size_t i = 0; i < count; i++){
+						float texel[4];
+						memcpy(texel, &in[i * 4], sizeof(texel));
+						if(weighted) unweight(texel);
+						texel[3] = std::clamp(texel[3], 0.0f, 1.0f);
+						memcpy(&texels[i * 4], texel, sizeof(texel));
+					}
+
+					uint16_t* out = (uint16_t*)level.data.data() + first * 4;
+					#ifdef MIPMAP_X86
+					if(b_f16c) mip_detail::float_to_half_f16c(texels.data(), out, count * 4);
+					else
+					#endif
+					for(size_t i = 0; i < count * 4; i++) out[i] = mip_detail::float_to_half(texels[i]);
+				}
+			});
+		}
+
+		/**
+		 * @brief separable 2:1 reduction, each output row filters its source rows horizontally into a small ring then vertically into `out`
+		 * @param source_row `(y, buffer)` returns row `y` of the source, it may fill the `w * channels` floats of `buffer`
+		*/
+		template<typename SourceRow>
+		void downsample(SourceRow&& source_row, size_t w, size_t h, size_t channels, const mip_detail::Kernel& kernel, std::vector<float>& out) const {
+			size_t w2 = std::max<size_t>(w / 2, 1), h2 = std::max<size_t>(h / 2, 1);
+			out.resize(w2 * h2 * channels);
+			size_t taps = kernel.weights.size(), span = w2 * channels;
+			#ifdef MIPMAP_FLOAT4
+			bool simd = m_backend != Backend::Scalar;
+			#endif
+
+			parallel_rows(h2, [&](size_t y0, size_t y1){
+				//a window of `taps` consecutive source rows never shares a slot, the ring keeps rows overlapping windows reuse
+				std::vector<float> buffer(w * channels), ring(taps * span);
+				std::vector<int64_t> slots(taps, -1);
+				std::vector<const float*> rows(taps);
+				for(size_t y = y0; y < y1; y++){
+					for(size_t t = 0; t < taps; t++){
+						int64_t sy = std::clamp<int64_t>((int64_t)(2 * y) + kernel.first + (int64_t)t, 0, (int64_t)h - 1);
+						float* filtered = &ring[(sy % taps) * span];
+						rows[t] = filtered;
+						if(slots[sy % taps] == sy) continue;
+						slots[sy % taps] = sy;
+						filter_row(source_row(sy, buffer.data()), w, channels, kernel, filtered, w2);
+					}
+
+					float* dst = &out[y * span];
+					#ifdef MIPMAP_FLOAT4
+					if(simd){
+						mip_detail::filter_column4(rows.data(), kernel.weights.data(), taps, span, dst);
+						continue;
+					}
+					#endif
+					std::fill(dst, dst + span, 0.0f);
+					for(size_t t = 0; t < taps; t++){
+						float weight = kernel.weights[t];
+						for(size_t i = 0; i < span; i++) dst[i] += weight * rows[t][i];
+					}
+				}
+			});
+		}
+
+		void filter_row(const float* row, size_t w, size_t channels, const mip_detail::Kernel& kernel, float* dst, size_t w2) const {
+			#ifdef MIPMAP_FLOAT4
+			if(m_backend != Backend::Scalar) return mip_detail::filter_row4(row, w, channels, kernel, dst, w2);
+			#endif
+			std::fill(dst, dst + w2 * channels, 0.0f);
+			for(size_t x = 0; x < w2; x++){
+				for(size_t t = 0; t < kernel.weights.size(); t++){
+					int64_t sx = std::clamp<int64_t>((int64_t)(2 * x) + kernel.first + (int64_t)t, 0, (int64_t)w - 1);
+					float weight = kernel.weights[t];
+					for(size_t c = 0; c < channels; c++) dst[x * channels + c] += weight * row[sx * channels + c];
+				}
+			}
+		}
+};
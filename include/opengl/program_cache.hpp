@@ -0,0 +1,210 @@
+#pragma once
+#include "shader.hpp"
+#include "utils/mapped_file.hpp"
+#include <chrono>
+#include <algorithm>
+
+struct ShaderSource {
+	ShaderType type = ShaderType::None;
+	std::string_view source;
+};
+
+/**
+ * @brief disk cache of linked program binaries
+ *
+ * programs are keyed by a hash of their sources, defines and driver (vendor, renderer and version
+ * strings), so GPUs sharing a directory keep separate entries. each entry also records the driver it
+ * was built with and is dropped on a mismatch.
+ * entries are memory mapped on load and written atomically, so concurrent processes never read partial files.
+ * @note disabled (every build compiles) when the driver exposes no binary formats
+*/
+class ProgramCache {
+	public:
+		struct Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t stores = 0;
+			uint64_t rejected = 0; //entries dropped for a driver change, corruption or refused by the driver
+			double load_ms = 0.0; //spent loading hits
+			double build_ms = 0.0; //spent compiling and linking misses
+			double saved_ms = 0.0; //recorded build time of hits minus their load time
+		};
+
+		ProgramCache(const std::filesystem::path& directory):m_directory(directory){
+			std::error_code error;
+			std::filesystem::create_directories(m_directory, error);
+
+			for(uint32_t name: { GL_VENDOR, GL_RENDERER, GL_VERSION }){
+				const char* value = (const char*)glGetString(name);
+				if(value) m_driver = g_utils::hash_bytes(value, strlen(value) + 1, m_driver);
+			}
+
+			int32_t count = 0;
+			SAFE_CALL( ProgramCacheFormats, glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count) );
+			if(count > 0){
+				m_formats.resize(count);
+				SAFE_CALL( ProgramCacheFormats, glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, (int32_t*)m_formats.data()) );
+			}
+		}
+
+		/**
+		 * @brief hash identifying a program built from `sources` and `defines` by this driver
+		*/
+		uint64_t key(const std::vector<ShaderSource>& sources, const std::vector<std::string>& defines = {}) const {
+			uint64_t h = g_utils::hash_bytes(&format_version, sizeof(format_version), m_driver);
+			for(auto& source: sources){
+				uint64_t sz = source.source.size();
+				h = g_utils::hash_bytes(&source.type, sizeof(source.type), h);
+				h = g_utils::hash_bytes(&sz, sizeof(sz), h);
+				h = g_utils::hash_bytes(source.source.data(), source.source.size(), h);
+			}
+			for(auto& define: defines) h = g_utils::hash_bytes(define.c_str(), define.size() + 1, h);
+			return h;
+		}
+
+		/**
+		 * @brief loads `program` from the cache or compiles, links and stores it
+		 * @param defines inserted after the `#version` line of every stage, see `shader_with_defines`
+		 * @return false on compile or link errors, see `error()`
+		*/
+		bool build(ShaderProgramInstance& program, const std::vector<ShaderSource>& sources, const std::vector<std::string>& defines = {}){
+			uint64_t program_key = key(sources, defines);
+			if(load(program, program_key)) return true;
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::unique_ptr<ShaderInstance>> shaders;
+			for(auto& source: sources){
+				auto shader = std::make_unique<ShaderInstance>(source.type);
+				if(!(*shader << shader_with_defines(source.source, defines)) || !shader->compile() || !shader->check_compile_status()){
+					m_error = shader->error();
+					return false;
+				}
+				program.attach(*shader);
+				shaders.push_back(std::move(shader));
+			}
+
+			if(enabled()) program.set_binary_retrievable();
+			bool linked = program.link() && program.check_link_status();
+			for(auto& shader: shaders) program.detach(*shader);
+			if(!linked){
+				m_error = program.error();
+				return false;
+			}
+
+			store(program, program_key, elapsed_ms(start));
+			return true;
+		}
+
+		/**
+		 * @brief loads the entry of `program_key` into `program`, counts a miss when there's no usable entry
+		*/
+		bool load(ShaderProgramInstance& program, uint64_t program_key){
+			if(!enabled()){
+				m_stats.misses++;
+				return false;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			std::filesystem::path file = entry_path(program_key);
+			MappedFile mapped;
+			if(mapped.open(file)){
+				Header header;
+				bool valid = mapped.size() >= sizeof(Header);
+				if(valid){
+					memcpy(&header, mapped.data(), sizeof(Header));
+					valid = memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == format_version &&
+						header.driver == m_driver && header.key == program_key &&
+						header.size == mapped.size() - sizeof(Header) &&
+						std::find(m_formats.begin(), m_formats.end(), header.format) != m_formats.end();
+				}
+				if(valid && program.load_binary(header.format, mapped.data() + sizeof(Header), header.size)){
+					double ms = elapsed_ms(start);
+					m_stats.hits++;
+					m_stats.load_ms += ms;
+					m_stats.saved_ms += std::max(0.0, (double)header.build_ms - ms);
+					return true;
+				}
+				m_stats.rejected++;
+				mapped.close();
+				std::error_code error;
+				std::filesystem::remove(file, error);
+			}
+			m_stats.misses++;
+			return false;
+		}
+
+		/**
+		 * @brief stores the binary of a freshly linked `program`, it must have been linked with `set_binary_retrievable`
+		 * @param build_ms time spent building it, reported as saved by later hits
+		*/
+		void store(ShaderProgramInstance& program, uint64_t program_key, double build_ms){
+			m_stats.build_ms += build_ms;
+			if(!enabled()) return;
+
+			Header header = {
+				.magic = { magic[0], magic[1], magic[2], magic[3] },
+				.version = format_version,
+				.driver = m_driver,
+				.key = program_key,
+				.format = 0,
+				.size = 0,
+				.build_ms = (float)build_ms,
+				.reserved = 0
+			};
+			if(!program.get_binary(header.format, m_binary)) return;
+			header.size = (uint32_t)m_binary.size();
+
+			if(write_file_atomic(entry_path(program_key), { { &header, sizeof(header) }, { m_binary.data(), m_binary.size() } })) m_stats.stores++;
+		}
+
+		/**
+		 * @brief removes every entry of the cache directory
+		*/
+		void clear(){
+			std::error_code error;
+			for(auto& entry: std::filesystem::directory_iterator(m_directory, error)){
+				if(entry.path().extension() == extension) std::filesystem::remove(entry.path(), error);
+			}
+		}
+
+		inline bool enabled() const { return !m_formats.empty(); }
+		inline const std::filesystem::path& directory() const { return m_directory; }
+		inline uint64_t driver() const { return m_driver; }
+
+		inline const std::string& error() const { return m_error; }
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		static constexpr char magic[4] = { 'G', 'L', 'P', 'B' };
+		static constexpr uint32_t format_version = 1;
+		static constexpr const char* extension = ".glbin";
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint64_t driver;
+			uint64_t key;
+			uint32_t format;
+			uint32_t size;
+			float build_ms;
+			uint32_t reserved;
+		};
+
+		std::filesystem::path m_directory;
+		uint64_t m_driver = g_utils::hash_bytes(nullptr, 0);
+		std::vector<uint32_t> m_formats;
+		std::vector<uint8_t> m_binary;
+		std::string m_error;
+		Stats m_stats;
+
+		std::filesystem::path entry_path(uint64_t program_key) const {
+			char name[32];
+			snprintf(name, sizeof(name), "%016" PRIx64 "%s", program_key, extension);
+			return m_directory / name;
+		}
+
+		static double elapsed_ms(std::chrono::steady_clock::time_point start){
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+};
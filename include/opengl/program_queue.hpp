@@ -0,0 +1,358 @@
+#pragma once
+#include "program_cache.hpp"
+#include "sync.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <thread>
+
+enum class BuildState: uint8_t {
+	Pending,
+	Compiling,
+	Linking,
+	Ready,
+	Failed
+};
+
+/**
+ * @brief result of an asynchronous program build, resolved by `ProgramBuildQueue::poll`
+*/
+class ProgramBuild {
+	public:
+		inline BuildState state() const { return m_state; }
+		inline bool ready() const { return m_state == BuildState::Ready; }
+		inline bool failed() const { return m_state == BuildState::Failed; }
+		inline bool done() const { return ready() || failed(); }
+
+		/**
+		 * @note only usable once `ready()`
+		*/
+		inline ShaderProgramInstance& program(){ return *m_program; }
+		inline const std::string& error() const { return m_error; }
+
+		/**
+		 * @brief time from submission to resolution
+		*/
+		inline double build_ms() const { return m_build_ms; }
+
+	private:
+		friend class ProgramBuildQueue;
+
+		std::vector<std::pair<ShaderType, std::string>> m_sources; //defines already inserted
+		uint64_t m_key = 0;
+		std::unique_ptr<ShaderProgramInstance> m_program;
+		std::vector<std::unique_ptr<ShaderInstance>> m_shaders;
+		BuildState m_state = BuildState::Pending;
+		std::string m_error;
+		std::chrono::steady_clock::time_point m_start;
+		double m_build_ms = 0.0;
+
+		//worker builds
+		Fence m_fence;
+		bool m_built = false;
+		bool m_linked = false;
+};
+
+using ProgramHandle = std::shared_ptr<ProgramBuild>;
+
+/**
+ * @brief builds many programs without stalling the render loop
+ *
+ * depending on the context the queue runs in one of three modes:
+ * - Parallel: KHR/ARB_parallel_shader_compile is present, compiles and links are issued at once and
+ * `poll` advances builds whose `GL_COMPLETION_STATUS_KHR` is set
+ * - Worker: the extension is missing and a `make_worker_current` callback was given, builds run on a
+ * thread owning a context that shares objects with the render context, completion is signaled through fences
+ * - Synchronous: neither, `poll` builds programs one after another until its time budget is spent
+ *
+ * every call but the worker thread itself must happen on the render context thread.
+*/
+class ProgramBuildQueue {
+	public:
+		enum class Mode: uint8_t {
+			Parallel,
+			Worker,
+			Synchronous
+		};
+
+		struct Stats {
+			uint64_t submitted = 0;
+			uint64_t ready = 0;
+			uint64_t failed = 0;
+			uint64_t cache_hits = 0;
+			double poll_ms = 0.0; //render thread time spent in poll
+		};
+
+		/**
+		 * @param cache optional, hits resolve on submit and fresh builds are stored
+		 * @param make_worker_current called once on the worker thread, must make a shared context current
+		 * @param compiler_threads forwarded to glMaxShaderCompilerThreadsKHR, ~0u lets the driver decide
+		*/
+		ProgramBuildQueue(ProgramCache* cache = nullptr, std::function<void()> make_worker_current = {}, uint32_t compiler_threads = ~0u)
+			:m_cache(cache){
+			if(GlobalContextConfig.has_extension("GL_KHR_parallel_shader_compile")){
+				m_mode = Mode::Parallel;
+				SAFE_CALL( MaxShaderCompilerThreads, glMaxShaderCompilerThreadsKHR(compiler_threads) );
+			} else if(GlobalContextConfig.has_extension("GL_ARB_parallel_shader_compile")){
+				m_mode = Mode::Parallel;
+				SAFE_CALL( MaxShaderCompilerThreads, glMaxShaderCompilerThreadsARB(compiler_threads) );
+			} else if(make_worker_current){
+				m_mode = Mode::Worker;
+				m_worker = std::thread([this, make_current = std::move(make_worker_current)](){
+					make_current();
+					worker_loop();
+				});
+			} else {
+				m_mode = Mode::Synchronous;
+			}
+		}
+
+		ProgramBuildQueue(const ProgramBuildQueue& other) = delete;
+
+		~ProgramBuildQueue(){
+			if(m_worker.joinable()){
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_stop = true;
+				}
+				m_condition.notify_one();
+				m_worker.join();
+			}
+			for(auto& build: m_active){
+				build->m_error = "build queue destroyed";
+				build->m_state = BuildState::Failed;
+			}
+		}
+
+		/**
+		 * @brief queues a program build, the handle resolves in a later `poll`, or right away on a cache hit
+		 * @param defines inserted after the `#version` line of every stage, see `shader_with_defines`
+		*/
+		ProgramHandle submit(const std::vector<ShaderSource>& sources, const std::vector<std::string>& defines = {}){
+			auto build = std::make_shared<ProgramBuild>();
+			build->m_start = std::chrono::steady_clock::now();
+			build->m_program = std::make_unique<ShaderProgramInstance>();
+			for(auto& source: sources) build->m_sources.push_back({ source.type, shader_with_defines(source.source, defines) });
+			m_stats.submitted++;
+
+			if(m_cache){
+				build->m_key = m_cache->key(sources, defines);
+				if(m_cache->load(*build->m_program, build->m_key)){
+					m_stats.cache_hits++;
+					build->m_build_ms = elapsed_ms(build->m_start);
+					build->m_state = BuildState::Ready;
+					m_stats.ready++;
+					return build;
+				}
+			}
+
+			switch(m_mode){
+				case Mode::Parallel:
+					for(auto& [type, source]: build->m_sources){
+						auto shader = std::make_unique<ShaderInstance>(type);
+						*shader << source;
+						shader->compile_async();
+						build->m_shaders.push_back(std::move(shader));
+					}
+					build->m_state = BuildState::Compiling;
+					break;
+				case Mode::Worker:
+					build->m_state = BuildState::Compiling;
+					{
+						std::lock_guard<std::mutex> lock(m_mutex);
+						m_jobs.push_back(build);
+					}
+					m_condition.notify_one();
+					break;
+				case Mode::Synchronous:
+					break;
+			}
+			m_active.push_back(build);
+			return build;
+		}
+
+		/**
+		 * @brief advances pending builds, call once per frame
+		 * @param budget_ms only bounds the synchronous mode, which still builds at least one program per call
+		 * @return number of builds resolved by this call
+		*/
+		size_t poll(double budget_ms = 2.0){
+			auto start = std::chrono::steady_clock::now();
+			if(m_mode == Mode::Worker){
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for(auto& build: m_finished) build->m_built = true;
+				m_finished.clear();
+			}
+
+			size_t resolved = 0;
+			for(auto it = m_active.begin(); it != m_active.end();){
+				ProgramBuild& build = **it;
+				bool done = false;
+				switch(m_mode){
+					case Mode::Parallel:
+						done = advance(build);
+						break;
+					case Mode::Worker:
+						if(build.m_built && build.m_fence.signaled()){
+							build.m_fence.reset();
+							resolve(build, build.m_linked);
+							done = true;
+						}
+						break;
+					case Mode::Synchronous:
+						if(resolved == 0 || elapsed_ms(start) < budget_ms){
+							resolve(build, compile_and_link(build));
+							done = true;
+						}
+						break;
+				}
+				if(done){
+					it = m_active.erase(it);
+					resolved++;
+				} else ++it;
+			}
+
+			m_stats.poll_ms += elapsed_ms(start);
+			return resolved;
+		}
+
+		/**
+		 * @brief blocks until `build` is resolved
+		*/
+		void wait(const ProgramHandle& build){
+			while(!build->done()){
+				if(!poll(std::numeric_limits<double>::infinity())) std::this_thread::yield();
+			}
+		}
+
+		/**
+		 * @brief blocks until every submitted build is resolved
+		*/
+		void finish(){
+			while(!m_active.empty()){
+				if(!poll(std::numeric_limits<double>::infinity())) std::this_thread::yield();
+			}
+		}
+
+		inline Mode mode() const { return m_mode; }
+		inline size_t pending() const { return m_active.size(); }
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		ProgramCache* m_cache = nullptr;
+		Mode m_mode = Mode::Synchronous;
+		std::list<ProgramHandle> m_active;
+		Stats m_stats;
+
+		//worker mode
+		std::thread m_worker;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::deque<ProgramHandle> m_jobs;
+		std::vector<ProgramHandle> m_finished;
+		bool m_stop = false;
+
+		inline bool retrievable() const { return m_cache && m_cache->enabled(); }
+
+		/**
+		 * @brief parallel mode step, never waits on the driver
+		*/
+		bool advance(ProgramBuild& build){
+			ShaderProgramInstance& program = *build.m_program;
+			if(build.m_state == BuildState::Compiling){
+				for(auto& shader: build.m_shaders) if(!shader->completed()) return false;
+				for(auto& shader: build.m_shaders){
+					if(!shader->check_compile_status()){
+						build.m_error = shader->error();
+						build.m_shaders.clear();
+						resolve(build, false);
+						return true;
+					}
+					program.attach(*shader);
+				}
+				if(retrievable()) program.set_binary_retrievable();
+				program.link_async();
+				build.m_state = BuildState::Linking;
+				return false;
+			}
+
+			if(!program.link_completed()) return false;
+			for(auto& shader: build.m_shaders) program.detach(*shader);
+			build.m_shaders.clear();
+			bool linked = program.check_link_status();
+			if(linked) program.reflect();
+			else build.m_error = program.error();
+			resolve(build, linked);
+			return true;
+		}
+
+		/**
+		 * @brief blocking build, used by the worker thread and the synchronous mode
+		*/
+		bool compile_and_link(ProgramBuild& build){
+			ShaderProgramInstance& program = *build.m_program;
+			for(auto& [type, source]: build.m_sources){
+				auto shader = std::make_unique<ShaderInstance>(type);
+				if(!(*shader << source) || !shader->compile() || !shader->check_compile_status()){
+					build.m_error = shader->error();
+					build.m_shaders.clear();
+					return false;
+				}
+				program.attach(*shader);
+				build.m_shaders.push_back(std::move(shader));
+			}
+
+			if(retrievable()) program.set_binary_retrievable();
+			bool linked = program.link() && program.check_link_status();
+			for(auto& shader: build.m_shaders) program.detach(*shader);
+			build.m_shaders.clear();
+			if(!linked) build.m_error = program.error();
+			return linked;
+		}
+
+		void resolve(ProgramBuild& build, bool linked){
+			build.m_build_ms = elapsed_ms(build.m_start);
+			if(linked){
+				if(m_cache) m_cache->store(*build.m_program, build.m_key, build.m_build_ms);
+				build.m_state = BuildState::Ready;
+				m_stats.ready++;
+			} else {
+				build.m_state = BuildState::Failed;
+				m_stats.failed++;
+			}
+		}
+
+		void worker_loop(){
+			while(true){
+				ProgramHandle build;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_condition.wait(lock, [this](){ return m_stop || !m_jobs.empty(); });
+					if(m_stop) return;
+					build = std::move(m_jobs.front());
+					m_jobs.pop_front();
+				}
+
+				try {
+					build->m_linked = compile_and_link(*build);
+				} catch(const std::exception& e){
+					build->m_error = e.what();
+					build->m_linked = false;
+				}
+				//makes the program visible to the render context once signaled
+				build->m_fence.insert();
+				glFlush();
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_finished.push_back(std::move(build));
+			}
+		}
+
+		static double elapsed_ms(std::chrono::steady_clock::time_point start){
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+};
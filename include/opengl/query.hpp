@@ -0,0 +1,83 @@
+#pragma once
+#include "core.hpp"
+#include <algorithm>
+
+/**
+ * @brief GPU timestamps of the last few frames, read back without stalling
+ *
+ * `stamp()` records the GPU time at which every command issued before it finished. each frame
+ * records into one of `frames` slots, `begin_frame()` reads back the timestamps last recorded in
+ * the slot it reuses, so results are `frames - 1` frames old. when the GPU is further behind the
+ * slot's timestamps are dropped instead of waited for.
+*/
+class TimestampQueries {
+	public:
+		TimestampQueries(uint32_t frames = 3):m_slots(std::max<uint32_t>(frames, 1)){}
+		TimestampQueries(const TimestampQueries& other) = delete;
+
+		~TimestampQueries(){
+			for(auto& slot: m_slots){
+				if(!slot.queries.empty()) glDeleteQueries((int32_t)slot.queries.size(), slot.queries.data());
+			}
+		}
+
+		/**
+		 * @brief moves to the next slot
+		 * @return true if the timestamps previously recorded in it were read, see `results()`
+		*/
+		bool begin_frame(){
+			m_current = (m_current + 1) % m_slots.size();
+			Slot& slot = m_slots[m_current];
+			bool read = false;
+			if(slot.used){
+				uint32_t available = 0;
+				SAFE_CALL( TimestampAvailable, glGetQueryObjectuiv(slot.queries[slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available) );
+				if(available){
+					m_results.resize(slot.used);
+					for(uint32_t i = 0; i < slot.used; i++){
+						SAFE_CALL( TimestampResult, glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &m_results[i]) );
+					}
+					m_result_frame = slot.frame;
+					read = true;
+				} else m_dropped++;
+			}
+			slot.used = 0;
+			slot.frame = m_frame++;
+			return read;
+		}
+
+		/**
+		 * @return index of the timestamp in the frame's `results()`
+		*/
+		uint32_t stamp(){
+			Slot& slot = m_slots[m_current];
+			if(slot.used == slot.queries.size()){
+				size_t grow = std::max<size_t>(slot.queries.size(), 16);
+				slot.queries.resize(slot.queries.size() + grow);
+				SAFE_CALL( TimestampCreate, glGenQueries((int32_t)grow, slot.queries.data() + slot.queries.size() - grow) );
+			}
+			SAFE_CALL( TimestampRecord, glQueryCounter(slot.queries[slot.used], GL_TIMESTAMP) );
+			return slot.used++;
+		}
+
+		//nanoseconds, indexed by `stamp()` return values of frame `result_frame()`
+		inline const std::vector<uint64_t>& results() const { return m_results; }
+		inline uint64_t result_frame() const { return m_result_frame; }
+		inline uint64_t dropped() const { return m_dropped; }
+		inline uint32_t frames() const { return (uint32_t)m_slots.size(); }
+		inline uint32_t slot() const { return m_current; }
+
+	private:
+		struct Slot {
+			std::vector<uint32_t> queries;
+			uint32_t used = 0;
+			uint64_t frame = 0;
+		};
+
+		std::vector<Slot> m_slots;
+		uint32_t m_current = 0;
+		uint64_t m_frame = 0;
+		std::vector<uint64_t> m_results;
+		uint64_t m_result_frame = 0;
+		uint64_t m_dropped = 0;
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include "texture.hpp"
+#include "buffer.hpp"
+#include "sync.hpp"
+#include <deque>
+#include <functional>
+#include <future>
+#include <stdexcept>
+
+/**
+ * @brief receives the read bytes on the render thread, `data` is only valid during the call
+*/
+using ReadbackCallback = std::function<void(const void* data, size_t bytes)>;
+
+/**
+ * @brief reads framebuffers, textures and buffers back to the CPU without waiting for the GPU
+ *
+ * every read is a GL copy into a persistently mapped pixel pack ring followed by a fence. `update()`
+ * delivers, in request order, the reads whose fence signaled, usually one or two frames later, so
+ * the render thread never blocks on a map. when the ring is full the oldest read is waited for
+ * (counted in `stats().stalls`), size the ring for the frames in flight to avoid it.
+*/
+class ReadbackQueue {
+	public:
+		struct Stats {
+			uint64_t requested = 0;
+			uint64_t completed = 0;
+			uint64_t bytes = 0; //delivered
+			uint64_t stalls = 0; //requests that waited for ring space
+			uint64_t latency_frames = 0; //sum over completed reads, divide by `completed`
+			uint64_t max_latency_frames = 0;
+
+			inline double average_latency() const { return completed ? (double)latency_frames / completed : 0.0; }
+		};
+
+		ReadbackQueue(size_t capacity = 64 << 20)
+			:m_buffer(BufferDescriptor{
+				.target = BufferTarget::PixelPack,
+				.usage = BufferUsage::StreamRead,
+				.access = BufferAccess::ReadOnly
+			}),m_capacity(capacity){
+			if(capacity == 0) throw std::invalid_argument("ReadbackQueue: capacity must not be zero");
+
+			m_buffer.immutable_storage(capacity, BufferStorageFlags::Read | BufferStorageFlags::Persistent | BufferStorageFlags::Coherent);
+			p_data = (const uint8_t*)m_buffer.map_range(0, capacity, BufferMapFlags::Read | BufferMapFlags::Persistent | BufferMapFlags::Coherent);
+			if(!p_data) throw GLError("ReadbackQueue", "could not map the pixel pack buffer");
+		}
+
+		ReadbackQueue(const ReadbackQueue& other) = delete;
+
+		~ReadbackQueue(){
+			m_pending.clear();
+			if(m_buffer.is_valid()) m_buffer.unmap_memory();
+		}
+
+		/**
+		 * @brief reads a rectangle of the color (or depth/stencil) buffer of the bound read framebuffer
+		*/
+		void read_pixels(int32_t x, int32_t y, size_t width, size_t height, uint32_t format, uint32_t datatype, ReadbackCallback callback){
+			size_t bytes = width * height * pixel_size(format, datatype);
+			size_t offset = reserve(bytes);
+			pack([&]{
+				SAFE_CALL( ReadbackReadPixels, glReadPixels(x, y, (int32_t)width, (int32_t)height, format, datatype, (void*)(uintptr_t)offset) );
+			});
+			push(offset, bytes, std::move(callback));
+		}
+
+		/**
+		 * @brief reads `region` of a texture, `region.format` and `region.datatype` are the client layout wanted
+		 * @note without GL 4.5 (or ARB_get_texture_sub_image) only whole levels can be read
+		*/
+		void read_texture(TextureInstance& texture, const TextureRegion& region, ReadbackCallback callback){
+			size_t bytes = region.width * region.height * region.depth * pixel_size(region.format, region.datatype);
+			bool sub_image = GlobalContextConfig.supports(4,5) || GlobalContextConfig.has_extension("GL_ARB_get_texture_sub_image");
+			if(!sub_image){
+				//glGetTexImage writes the whole level, every slice and layer of it, the region must cover exactly that
+				TextureType type = texture.texture_type();
+				size_t depth = 1;
+				if(type == TextureType::Tex3D) depth = std::max<size_t>(texture.depth() >> region.level, 1);
+				else if(type == TextureType::Tex2DArray) depth = texture.depth();
+				bool whole = region.x == 0 && region.y == 0 && region.z == 0 &&
+					region.width == std::max<size_t>(texture.width() >> region.level, 1) &&
+					region.height == (type == TextureType::Tex1DArray ? texture.height() : std::max<size_t>(texture.height() >> region.level, 1)) &&
+					region.depth == depth;
+				if(!whole || type == TextureType::CubeMap || type == TextureType::CubeMapArray) throw TextureError(TextureErrorType::NotImplementedFeature);
+			}
+
+			size_t offset = reserve(bytes);
+			pack([&]{
+				if(sub_image){
+					SAFE_CALL( ReadbackTextureSubImage, glGetTextureSubImage(texture.id(), region.level, region.x, region.y, region.z, region.width, region.height, region.depth, region.format, region.datatype, bytes, (void*)(uintptr_t)offset) );
+				} else {
+					texture.bind();
+					SAFE_CALL( ReadbackTextureImage, glGetTexImage(texture.target(), region.level, region.format, region.datatype, (void*)(uintptr_t)offset) );
+				}
+			});
+			push(offset, bytes, std::move(callback));
+		}
+
+		/**
+		 * @brief reads a range of a buffer, copied on the GPU into the ring
+		*/
+		void read_buffer(const BufferInstance& buffer, std::ptrdiff_t offset, size_t bytes, ReadbackCallback callback){
+			size_t destination = reserve(bytes);
+			m_buffer.copy_from(buffer, offset, (std::ptrdiff_t)destination, bytes);
+			push(destination, bytes, std::move(callback));
+		}
+
+		//future flavours, the data is copied out of the ring when the read completes
+		std::future<std::vector<uint8_t>> read_pixels(int32_t x, int32_t y, size_t width, size_t height, uint32_t format, uint32_t datatype){
+			auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+			read_pixels(x, y, width, height, format, datatype, fulfill(promise));
+			return promise->get_future();
+		}
+
+		std::future<std::vector<uint8_t>> read_texture(TextureInstance& texture, const TextureRegion& region){
+			auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+			read_texture(texture, region, fulfill(promise));
+			return promise->get_future();
+		}
+
+		std::future<std::vector<uint8_t>> read_buffer(const BufferInstance& buffer, std::ptrdiff_t offset, size_t bytes){
+			auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+			read_buffer(buffer, offset, bytes, fulfill(promise));
+			return promise->get_future();
+		}
+
+		/**
+		 * @brief delivers the completed reads, call once per frame on the render thread
+		 * @return reads delivered
+		*/
+		size_t update(){
+			size_t delivered = 0;
+			while(!m_pending.empty() && m_pending.front().fence.signaled()){
+				deliver();
+				delivered++;
+			}
+			m_frame++;
+			return delivered;
+		}
+
+		/**
+		 * @brief waits for and delivers every pending read
+		*/
+		void finish(){
+			while(!m_pending.empty()){
+				m_pending.front().fence.wait();
+				deliver();
+			}
+		}
+
+		inline size_t pending() const { return m_pending.size(); }
+		inline size_t used() const { return m_used; }
+		inline size_t capacity() const { return m_capacity; }
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		static constexpr size_t alignment = 16;
+
+		struct Read {
+			size_t offset = 0;
+			size_t bytes = 0;
+			size_t consumed = 0; //ring space, alignment padding and wrap tails included
+			uint64_t frame = 0;
+			Fence fence;
+			ReadbackCallback callback;
+		};
+
+		BufferInstance m_buffer;
+		const uint8_t* p_data = nullptr;
+		size_t m_capacity = 0;
+		size_t m_head = 0;
+		size_t m_used = 0;
+		size_t m_reserved = 0; //consumed by the last `reserve`
+		uint64_t m_frame = 0;
+		std::deque<Read> m_pending;
+		Stats m_stats;
+
+		static ReadbackCallback fulfill(std::shared_ptr<std::promise<std::vector<uint8_t>>> promise){
+			return [promise](const void* data, size_t bytes){
+				promise->set_value(std::vector<uint8_t>((const uint8_t*)data, (const uint8_t*)data + bytes));
+			};
+		}
+
+		size_t reserve(size_t bytes){
+			if(bytes == 0 || bytes > m_capacity) throw std::invalid_argument("ReadbackQueue: read of " + std::to_string(bytes) + " bytes doesn't fit in the ring");
+			while(true){
+				size_t start = (m_head + alignment - 1) / alignment * alignment;
+				if(start + bytes > m_capacity) start = 0; //the tail of the ring is wasted
+				size_t consumed = (start >= m_head ? start - m_head : m_capacity - m_head) + bytes;
+				if(m_used + consumed <= m_capacity){
+					m_head = start + bytes;
+					m_used += consumed;
+					m_reserved = consumed;
+					return start;
+				}
+				//the oldest reads free the space in front of the head
+				m_stats.stalls++;
+				m_pending.front().fence.wait();
+				deliver();
+			}
+		}
+
+		template<typename F>
+		void pack(F&& read){
+			int32_t pack_alignment = 4;
+			SAFE_CALL( ReadbackPackAlignment, glGetIntegerv(GL_PACK_ALIGNMENT, &pack_alignment) );
+			SAFE_CALL( ReadbackPackAlignment, glPixelStorei(GL_PACK_ALIGNMENT, 1) );
+			m_buffer.bind();
+			read();
+			//a bound pack buffer would turn later client memory reads into offsets
+			m_buffer.unbind();
+			SAFE_CALL( ReadbackPackAlignment, glPixelStorei(GL_PACK_ALIGNMENT, pack_alignment) );
+		}
+
+		void push(size_t offset, size_t bytes, ReadbackCallback callback){
+			Read& read = m_pending.emplace_back();
+			read.offset = offset;
+			read.bytes = bytes;
+			read.consumed = m_reserved;
+			read.frame = m_frame;
+			read.callback = std::move(callback);
+			read.fence.insert();
+			m_stats.requested++;
+		}
+
+		void deliver(){
+			Read read = std::move(m_pending.front());
+			m_pending.pop_front();
+			m_used -= read.consumed;
+			if(m_pending.empty()) m_head = m_used = 0;
+
+			uint64_t latency = m_frame - read.frame;
+			m_stats.completed++;
+			m_stats.bytes += read.bytes;
+			m_stats.latency_frames += latency;
+			m_stats.max_latency_frames = std::max(m_stats.max_latency_frames, latency);
+			if(read.callback) read.callback(p_data + read.offset, read.bytes);
+		}
+};
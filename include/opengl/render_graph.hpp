@@ -0,0 +1,596 @@
+#pragma once
+#include "framebuffer.hpp"
+#include "heap.hpp"
+#include "query.hpp"
+#include "sync.hpp"
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <stdexcept>
+
+/**
+ * @brief how a pass uses a resource, decides the memory barriers placed before the pass
+ * @note only `Image`, `Storage` and `AtomicCounter` writes are incoherent and need a barrier afterwards
+*/
+enum class ResourceAccess: uint8_t {
+	Sampled,         //texture fetches
+	Image,           //image load/store
+	ColorAttachment,
+	DepthAttachment, //depth, stencil or both, depending on the format
+	Storage,         //shader storage buffer
+	Uniform,
+	Vertex,
+	Index,
+	Indirect,        //draw or dispatch parameters
+	Transfer,        //copies, uploads and readbacks
+	AtomicCounter
+};
+
+/**
+ * @brief handle to a resource of the graph being built, valid until `execute()`
+*/
+struct RenderResource {
+	static constexpr uint32_t invalid = ~0u;
+	uint32_t index = invalid;
+
+	inline bool valid() const { return index != invalid; }
+};
+
+/**
+ * @brief frame organised as passes declaring the resources they read and write
+ *
+ * the graph is declared again every frame and run with `execute()`, which:
+ * - culls the passes whose writes aren't read by a kept pass, passes with side effects (`side_effects()`),
+ *   writing an imported resource or a resource marked with `output()` are always kept
+ * - allocates transient textures from a RenderTargetPool and transient buffers from ranges of a BufferHeap
+ *   right before their first use, and frees them right after their last one, so resources whose lifetimes
+ *   don't overlap share memory
+ * - places before each pass the memory barriers its accesses need, only for resources written incoherently
+ *   (image stores, storage buffers, atomic counters) since the last barrier with the same bits
+ * - binds a framebuffer with the attachments written by the pass, when they are all transient
+ * - times each pass on the GPU, `timings()` reports a frame once its timestamps are available
+ *
+ * a pass reading a resource depends on every earlier pass writing it, up to the last one that writes
+ * without reading it. transient resources must be written before being read.
+ * @note `targets.begin_frame()` and `targets.end_frame()` are left to the owner of the pool
+*/
+class RenderGraph {
+	public:
+		class Context;
+		using PassFunction = std::function<void(Context& context)>;
+
+		class Pass {
+			public:
+				inline Pass& read(RenderResource resource, ResourceAccess access){ return use(resource, access, true, false); }
+				inline Pass& write(RenderResource resource, ResourceAccess access){ return use(resource, access, false, true); }
+				inline Pass& read_write(RenderResource resource, ResourceAccess access){ return use(resource, access, true, true); }
+
+				//kept even when nothing reads what it writes, e.g. it draws to the default framebuffer
+				inline Pass& side_effects(){ m_side_effects = true; return *this; }
+				inline Pass& execute(PassFunction function){ m_function = std::move(function); return *this; }
+
+				inline const std::string& name() const { return m_name; }
+
+			private:
+				friend class RenderGraph;
+
+				struct Use {
+					uint32_t resource = 0;
+					ResourceAccess access = ResourceAccess::Sampled;
+					bool read = false;
+					bool write = false;
+				};
+
+				std::string m_name;
+				std::vector<Use> m_uses;
+				PassFunction m_function;
+				bool m_side_effects = false;
+
+				Pass& use(RenderResource resource, ResourceAccess access, bool read, bool write){
+					if(!resource.valid()) throw std::invalid_argument("RenderGraph: pass '" + m_name + "' uses an invalid resource");
+					for(auto& use: m_uses){
+						if(use.resource == resource.index && use.access == access){
+							use.read |= read;
+							use.write |= write;
+							return *this;
+						}
+					}
+					m_uses.push_back({ resource.index, access, read, write });
+					return *this;
+				}
+		};
+
+		/**
+		 * @brief resolves handles to GL objects while a pass executes
+		*/
+		class Context {
+			public:
+				TextureInstance& texture(RenderResource resource){
+					Resource& entry = m_graph.resource(resource);
+					if(entry.imported_texture) return *entry.imported_texture;
+					if(!entry.target || !entry.target->texture) throw std::invalid_argument("RenderGraph: '" + entry.name + "' is not a texture");
+					return *entry.target->texture;
+				}
+
+				//transient textures only, nullptr otherwise
+				inline RenderTarget* target(RenderResource resource){ return m_graph.resource(resource).target; }
+
+				BufferRange buffer(RenderResource resource){
+					Resource& entry = m_graph.resource(resource);
+					if(entry.imported_buffer) return { entry.imported_buffer->id(), 0, entry.imported_buffer->size() };
+					if(!entry.allocation.valid()) throw std::invalid_argument("RenderGraph: '" + entry.name + "' is not a buffer");
+					BufferRange range = m_graph.m_buffers.range(entry.allocation);
+					range.size = entry.bytes;
+					return range;
+				}
+
+				void bind_buffer(RenderResource resource, BufferTarget target, uint32_t index){
+					Resource& entry = m_graph.resource(resource);
+					if(entry.imported_buffer){
+						entry.imported_buffer->bind_range(target, index, 0, entry.imported_buffer->size());
+					} else {
+						BufferRange range = buffer(resource);
+						m_graph.m_buffers.page(entry.allocation).bind_range(target, index, (std::ptrdiff_t)range.offset, range.size);
+					}
+				}
+
+				//bound by the graph, nullptr when the pass has no (or imported) attachments
+				inline FramebufferInstance* framebuffer(){ return p_framebuffer; }
+				inline const std::string& pass() const { return m_pass.name(); }
+
+			private:
+				friend class RenderGraph;
+
+				RenderGraph& m_graph;
+				const Pass& m_pass;
+				FramebufferInstance* p_framebuffer = nullptr;
+
+				Context(RenderGraph& graph, const Pass& pass):m_graph(graph),m_pass(pass){}
+		};
+
+		struct PassTiming {
+			std::string name;
+			double gpu_ms = 0.0;
+			double cpu_ms = 0.0; //recording the pass, barriers and allocations included
+			MemoryBarrier barriers = MemoryBarrier::None; //placed before the pass
+			bool culled = false;
+		};
+
+		struct Stats {
+			size_t passes = 0; //of the last frame, culled included
+			size_t culled = 0;
+			size_t barriers = 0; //glMemoryBarrier calls
+			size_t transient_textures = 0;
+			size_t transient_buffers = 0;
+			size_t transient_bytes = 0; //every transient resource
+			size_t peak_bytes = 0; //transient resources alive at the same time
+			size_t pending_writes = 0; //incoherent writes some later use may still need a barrier for
+		};
+
+		/**
+		 * @param buffer_page_bytes size of the buffers transient buffers are sub allocated from
+		 * @param timing_frames frames in flight of the timestamp queries
+		*/
+		RenderGraph(RenderTargetPool& targets, size_t buffer_page_bytes = 16 << 20, uint32_t timing_frames = 3)
+			:m_targets(targets),
+			m_buffers(BufferDescriptor{
+				.target = BufferTarget::ShaderStorage,
+				.usage = BufferUsage::DynamicCopy,
+				.access = BufferAccess::ReadWrite
+			}, buffer_page_bytes, buffer_alignment),
+			m_timestamps(timing_frames),
+			m_records(m_timestamps.frames()){}
+
+		RenderGraph(const RenderGraph& other) = delete;
+
+		~RenderGraph(){ release_held(); }
+
+		RenderResource create_texture(const std::string& name, const RenderTargetDesc& desc){
+			Resource& resource = add_resource(name);
+			resource.desc = desc;
+			resource.texture = true;
+			resource.bytes = desc.memory_size();
+			return { (uint32_t)m_resources.size() - 1 };
+		}
+
+		RenderResource create_buffer(const std::string& name, size_t bytes){
+			if(bytes == 0) throw std::invalid_argument("RenderGraph: buffer '" + name + "' is empty");
+			Resource& resource = add_resource(name);
+			resource.bytes = bytes;
+			return { (uint32_t)m_resources.size() - 1 };
+		}
+
+		RenderResource import_texture(const std::string& name, TextureInstance& texture){
+			Resource& resource = add_resource(name);
+			resource.texture = true;
+			resource.imported_texture = &texture;
+			return { (uint32_t)m_resources.size() - 1 };
+		}
+
+		RenderResource import_buffer(const std::string& name, BufferInstance& buffer){
+			Resource& resource = add_resource(name);
+			resource.imported_buffer = &buffer;
+			return { (uint32_t)m_resources.size() - 1 };
+		}
+
+		/**
+		 * @brief keeps the passes writing a transient resource, which stays allocated until the next `execute()`
+		*/
+		inline void output(RenderResource resource){ this->resource(resource).output = true; }
+
+		Pass& add_pass(const std::string& name){
+			m_passes.push_back(std::make_unique<Pass>());
+			m_passes.back()->m_name = name;
+			return *m_passes.back();
+		}
+
+		/**
+		 * @brief culls, runs the passes in declaration order and clears the declarations for the next frame
+		*/
+		void execute(){
+			release_held();
+			resolve_timings();
+			std::vector<Record>& records = m_records[m_timestamps.slot()];
+			records.clear();
+
+			std::vector<bool> alive = cull();
+			lifetimes(alive);
+
+			m_stats = {};
+			m_stats.passes = m_passes.size();
+			size_t alive_bytes = 0;
+			for(auto& resource: m_resources){
+				if(resource.first == RenderResource::invalid || resource.imported()) continue;
+				(resource.texture ? m_stats.transient_textures : m_stats.transient_buffers)++;
+				m_stats.transient_bytes += resource.bytes;
+			}
+
+			for(uint32_t index = 0; index < m_passes.size(); index++){
+				Pass& pass = *m_passes[index];
+				Record& record = records.emplace_back();
+				record.timing.name = pass.name();
+				if(!alive[index]){
+					record.timing.culled = true;
+					m_stats.culled++;
+					continue;
+				}
+
+				auto start = std::chrono::steady_clock::now();
+				for(auto& use: pass.m_uses){
+					Resource& resource = m_resources[use.resource];
+					if(resource.first != index || resource.imported() || resource.target || resource.allocation.valid()) continue;
+					acquire(resource);
+					alive_bytes += resource.bytes;
+				}
+				m_stats.peak_bytes = std::max(m_stats.peak_bytes, alive_bytes);
+
+				MemoryBarrier bits = barriers(pass);
+				memory_barrier(bits);
+				if(bits != MemoryBarrier::None) m_stats.barriers++;
+				record.timing.barriers = bits;
+
+				Context context(*this, pass);
+				context.p_framebuffer = framebuffer(pass);
+
+				record.begin = m_timestamps.stamp();
+				if(pass.m_function) pass.m_function(context);
+				record.end = m_timestamps.stamp();
+
+				for(auto& use: pass.m_uses){
+					if(use.write && incoherent(use.access)) written(m_resources[use.resource]);
+				}
+				for(auto& use: pass.m_uses){
+					Resource& resource = m_resources[use.resource];
+					if(resource.last != index || resource.imported()) continue;
+					resource.last = RenderResource::invalid; //released once, even if used twice by the pass
+					alive_bytes -= resource.bytes;
+					if(resource.output) m_held.push_back(resource);
+					else release(resource);
+				}
+
+				record.timing.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			m_stats.pending_writes = m_writes.size();
+			m_passes.clear();
+			m_resources.clear();
+		}
+
+		/**
+		 * @brief passes of the latest frame whose GPU timestamps came back, in declaration order
+		*/
+		inline const std::vector<PassTiming>& timings() const { return m_timings; }
+
+		std::string report() const {
+			std::stringstream buffer;
+			double gpu = 0.0, cpu = 0.0;
+			buffer << std::fixed << std::setprecision(3);
+			for(auto& timing: m_timings){
+				buffer << std::left << std::setw(24) << timing.name << std::right;
+				if(timing.culled){
+					buffer << "    culled\n";
+					continue;
+				}
+				buffer << std::setw(10) << timing.gpu_ms << " ms gpu" << std::setw(10) << timing.cpu_ms << " ms cpu";
+				if(timing.barriers != MemoryBarrier::None) buffer << "  barrier 0x" << std::hex << (uint32_t)timing.barriers << std::dec;
+				buffer << '\n';
+				gpu += timing.gpu_ms;
+				cpu += timing.cpu_ms;
+			}
+			buffer << std::left << std::setw(24) << "total" << std::right << std::setw(10) << gpu << " ms gpu" << std::setw(10) << cpu << " ms cpu\n";
+			return buffer.str();
+		}
+
+		inline const Stats& stats() const { return m_stats; }
+		inline const BufferHeap& buffers() const { return m_buffers; }
+
+	private:
+		static constexpr size_t buffer_alignment = 256; //largest uniform and storage buffer offset alignment in practice
+
+		struct Resource {
+			std::string name;
+			bool texture = false;
+			bool output = false;
+			RenderTargetDesc desc;
+			size_t bytes = 0;
+			TextureInstance* imported_texture = nullptr;
+			BufferInstance* imported_buffer = nullptr;
+
+			//passes of the first and last use, invalid when unused
+			uint32_t first = RenderResource::invalid;
+			uint32_t last = RenderResource::invalid;
+			RenderTarget* target = nullptr;
+			HeapAllocation allocation;
+
+			inline bool imported() const { return imported_texture || imported_buffer; }
+		};
+
+		//incoherent write to a texture, or to a byte range of a buffer
+		struct PendingWrite {
+			uint32_t name = 0;
+			bool texture = false;
+			size_t begin = 0, end = 0;
+			uint32_t pending = 0; //barrier bits not placed since the write
+		};
+
+		struct Record {
+			PassTiming timing;
+			uint32_t begin = 0, end = 0; //timestamp indices
+		};
+
+		RenderTargetPool& m_targets;
+		BufferHeap m_buffers;
+		TimestampQueries m_timestamps;
+		std::vector<std::vector<Record>> m_records; //per timestamp slot
+		std::vector<PassTiming> m_timings;
+
+		std::vector<std::unique_ptr<Pass>> m_passes;
+		std::vector<Resource> m_resources;
+		std::vector<Resource> m_held; //outputs of the last frame
+
+		std::vector<PendingWrite> m_writes; //across frames, transient memory is reused by later resources
+		Stats m_stats;
+
+		Resource& add_resource(const std::string& name){
+			Resource& resource = m_resources.emplace_back();
+			resource.name = name;
+			return resource;
+		}
+
+		Resource& resource(RenderResource handle){
+			if(handle.index >= m_resources.size()) throw std::invalid_argument("RenderGraph: resource handle out of range");
+			return m_resources[handle.index];
+		}
+
+		static bool incoherent(ResourceAccess access){
+			return access == ResourceAccess::Image || access == ResourceAccess::Storage || access == ResourceAccess::AtomicCounter;
+		}
+
+		static MemoryBarrier barrier(ResourceAccess access, bool texture){
+			switch(access){
+				case ResourceAccess::Sampled: return MemoryBarrier::TextureFetch;
+				case ResourceAccess::Image: return MemoryBarrier::ShaderImageAccess;
+				case ResourceAccess::ColorAttachment:
+				case ResourceAccess::DepthAttachment: return MemoryBarrier::Framebuffer;
+				case ResourceAccess::Storage: return MemoryBarrier::ShaderStorage;
+				case ResourceAccess::Uniform: return MemoryBarrier::Uniform;
+				case ResourceAccess::Vertex: return MemoryBarrier::VertexAttribArray;
+				case ResourceAccess::Index: return MemoryBarrier::ElementArray;
+				case ResourceAccess::Indirect: return MemoryBarrier::Command;
+				case ResourceAccess::Transfer: return texture ? MemoryBarrier::TextureUpdate | MemoryBarrier::PixelBuffer : MemoryBarrier::BufferUpdate | MemoryBarrier::PixelBuffer;
+				case ResourceAccess::AtomicCounter: return MemoryBarrier::AtomicCounter;
+				default: return MemoryBarrier::All;
+			}
+		}
+
+		//every bit `barrier` returns, a write is forgotten once they were all placed after it
+		static uint32_t barrier_mask(){
+			uint32_t mask = 0;
+			for(uint32_t access = 0; access <= (uint32_t)ResourceAccess::AtomicCounter; access++){
+				mask |= (uint32_t)barrier((ResourceAccess)access, true) | (uint32_t)barrier((ResourceAccess)access, false);
+			}
+			return mask;
+		}
+
+		/**
+		 * @brief marks the passes to run, walking dependencies from the last pass back
+		*/
+		std::vector<bool> cull(){
+			std::vector<bool> alive(m_passes.size(), false);
+
+			auto keep_writers = [&](uint32_t resource, uint32_t before){
+				for(uint32_t index = before; index-- > 0;){
+					for(auto& use: m_passes[index]->m_uses){
+						if(use.resource != resource || !use.write) continue;
+						alive[index] = true;
+						if(!use.read) return;
+					}
+				}
+				if(!m_resources[resource].imported()){
+					throw std::invalid_argument("RenderGraph: '" + m_resources[resource].name + "' isn't written by any earlier pass");
+				}
+			};
+
+			for(uint32_t index = (uint32_t)m_passes.size(); index-- > 0;){
+				Pass& pass = *m_passes[index];
+				if(pass.m_side_effects) alive[index] = true;
+				for(auto& use: pass.m_uses){
+					Resource& resource = m_resources[use.resource];
+					if(use.write && (resource.imported() || resource.output)) alive[index] = true;
+				}
+			}
+
+			//outputs need their last writers even without readers
+			for(uint32_t resource = 0; resource < m_resources.size(); resource++){
+				if(m_resources[resource].output) keep_writers(resource, (uint32_t)m_passes.size());
+			}
+
+			for(uint32_t index = (uint32_t)m_passes.size(); index-- > 0;){
+				if(!alive[index]) continue;
+				for(auto& use: m_passes[index]->m_uses){
+					if(use.read) keep_writers(use.resource, index);
+				}
+			}
+			return alive;
+		}
+
+		void lifetimes(const std::vector<bool>& alive){
+			for(uint32_t index = 0; index < m_passes.size(); index++){
+				if(!alive[index]) continue;
+				for(auto& use: m_passes[index]->m_uses){
+					Resource& resource = m_resources[use.resource];
+					if(resource.first == RenderResource::invalid) resource.first = index;
+					resource.last = index;
+
+					bool needs_texture = use.access != ResourceAccess::ColorAttachment && use.access != ResourceAccess::DepthAttachment;
+					if(!resource.texture && (use.access == ResourceAccess::Sampled || use.access == ResourceAccess::Image ||
+						use.access == ResourceAccess::ColorAttachment || use.access == ResourceAccess::DepthAttachment)){
+						throw std::invalid_argument("RenderGraph: buffer '" + resource.name + "' used as a texture");
+					}
+					if(resource.texture && !resource.imported() && needs_texture && resource.desc.renderbuffer()){
+						throw std::invalid_argument("RenderGraph: '" + resource.name + "' is a renderbuffer, it can only be attached");
+					}
+				}
+			}
+		}
+
+		void acquire(Resource& resource){
+			if(resource.texture){
+				resource.target = &m_targets.acquire(resource.desc);
+				return;
+			}
+			try {
+				resource.allocation = m_buffers.allocate(resource.bytes);
+			} catch(const std::exception& error){
+				throw std::length_error("RenderGraph: can't allocate buffer '" + resource.name + "' (" + error.what() + ")");
+			}
+			if(!resource.allocation.valid()){
+				throw std::length_error("RenderGraph: can't allocate " + std::to_string(resource.bytes) + " bytes for buffer '" + resource.name + "'");
+			}
+		}
+
+		void release(Resource& resource){
+			if(resource.target){
+				m_targets.release(*resource.target);
+				resource.target = nullptr;
+			}
+			if(resource.allocation.valid()){
+				BufferRange range = m_buffers.range(resource.allocation);
+				SAFE_CALL( RenderGraphInvalidate, glInvalidateBufferSubData(range.buffer, (std::ptrdiff_t)range.offset, range.size) );
+				m_buffers.free(resource.allocation);
+			}
+		}
+
+		void release_held(){
+			for(auto& resource: m_held) release(resource);
+			m_held.clear();
+		}
+
+		PendingWrite location(const Resource& resource){
+			PendingWrite write;
+			write.texture = resource.texture;
+			if(resource.texture){
+				write.name = resource.imported_texture ? resource.imported_texture->id() : resource.target->id();
+				write.end = ~(size_t)0;
+			} else if(resource.imported_buffer){
+				write.name = resource.imported_buffer->id();
+				write.end = ~(size_t)0;
+			} else {
+				BufferRange range = m_buffers.range(resource.allocation);
+				write.name = range.buffer;
+				write.begin = range.offset;
+				write.end = range.offset + range.size;
+			}
+			return write;
+		}
+
+		/**
+		 * @brief barrier bits the pass needs, the memory a transient resource now lives in may have been
+		 * written incoherently by an earlier pass (or frame) through another resource
+		*/
+		MemoryBarrier barriers(const Pass& pass){
+			uint32_t bits = 0;
+			for(auto& use: pass.m_uses){
+				const Resource& resource = m_resources[use.resource];
+				if(resource.target && !resource.target->texture) continue; //renderbuffers are never written incoherently
+				PendingWrite target = location(resource);
+				uint32_t needed = (uint32_t)barrier(use.access, resource.texture);
+				for(auto& write: m_writes){
+					if(write.name != target.name || write.texture != target.texture || write.end <= target.begin || target.end <= write.begin) continue;
+					bits |= needed & write.pending;
+				}
+			}
+			//the placed bits cover every earlier write, the ones with nothing left pending are done
+			if(bits){
+				for(auto& write: m_writes) write.pending &= ~bits;
+				std::erase_if(m_writes, [](const PendingWrite& write){ return write.pending == 0; });
+			}
+			return (MemoryBarrier)bits;
+		}
+
+		void written(const Resource& resource){
+			PendingWrite write = location(resource);
+			write.pending = barrier_mask();
+			//overlapping writes merge, barriers placed for the union never miss one either needs
+			std::erase_if(m_writes, [&](const PendingWrite& pending){
+				if(pending.name != write.name || pending.texture != write.texture || pending.end < write.begin || write.end < pending.begin) return false;
+				write.begin = std::min(write.begin, pending.begin);
+				write.end = std::max(write.end, pending.end);
+				return true;
+			});
+			m_writes.push_back(write);
+		}
+
+		/**
+		 * @brief pool framebuffer of the transient attachments written by the pass, bound and sized
+		*/
+		FramebufferInstance* framebuffer(const Pass& pass){
+			std::vector<RenderTarget*> attachments;
+			for(auto& use: pass.m_uses){
+				if(!use.write || (use.access != ResourceAccess::ColorAttachment && use.access != ResourceAccess::DepthAttachment)) continue;
+				const Resource& resource = m_resources[use.resource];
+				if(resource.imported()) return nullptr;
+				attachments.push_back(resource.target);
+			}
+			if(attachments.empty()) return nullptr;
+
+			FramebufferInstance& framebuffer = m_targets.framebuffer(attachments.data(), attachments.size());
+			framebuffer.bind_draw();
+			SAFE_CALL( RenderGraphViewport, glViewport(0, 0, (int32_t)attachments[0]->desc.width, (int32_t)attachments[0]->desc.height) );
+			return &framebuffer;
+		}
+
+		/**
+		 * @brief turns the records of the frame whose timestamps came back into `timings()`
+		*/
+		void resolve_timings(){
+			const std::vector<Record>& records = m_records[(m_timestamps.slot() + 1) % m_timestamps.frames()];
+			if(!m_timestamps.begin_frame()) return;
+			const std::vector<uint64_t>& stamps = m_timestamps.results();
+			m_timings.clear();
+			for(auto& record: records){
+				PassTiming& timing = m_timings.emplace_back(record.timing);
+				if(!timing.culled && record.end < stamps.size()) timing.gpu_ms = (double)(stamps[record.end] - stamps[record.begin]) / 1e6;
+			}
+		}
+};
@@ -0,0 +1,255 @@
+#pragma once
+#include "texture.hpp"
+#include "buffer.hpp"
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+enum class MemoryCategory: uint8_t {
+	Texture,
+	RenderTarget,
+	Buffer,
+	Streaming,
+	Other,
+	Count
+};
+
+/**
+ * @brief full resolution storage of a tracked texture, what a re-stream must bring back
+*/
+struct TextureFootprint {
+	uint32_t levels = 0;
+	uint32_t internal_format = 0;
+	size_t width = 0, height = 0, depth = 0;
+	size_t bytes = 0;
+};
+
+struct ResidencyPolicy {
+	bool pinned = false; //never demoted nor dropped
+	bool droppable = true; //may lose its whole storage once it can't be demoted further
+	size_t min_size = 64; //demotion stops before the largest side goes below it
+	//called on the render thread when an evicted texture is used again, re-specifies the texture at full size
+	std::function<void(TextureInstance& texture, const TextureFootprint& full)> restream;
+};
+
+/**
+ * @brief accounts the GPU memory of textures and buffers against a budget
+ *
+ * objects are registered with `track` and marked with `touch` when used. `update()` ends the frame:
+ * it re-reads every size and, while the total exceeds the budget, evicts textures least recently
+ * used first. a texture first loses its largest levels (keeping its smaller mips, so it still draws
+ * blurry) and is dropped entirely when it can't shrink more. touching an evicted texture calls its
+ * `restream` callback once, the texture is considered resident again when it's back at full size.
+ *
+ * buffers are accounted but never evicted. tracked objects must be untracked before being destroyed.
+*/
+class ResidencyManager {
+	public:
+		struct CategoryStats {
+			size_t bytes = 0;
+			size_t objects = 0;
+			size_t evicted = 0; //objects currently below their full size
+			uint64_t demotions = 0;
+			uint64_t drops = 0;
+			uint64_t restreams = 0;
+			uint64_t evicted_bytes = 0;
+		};
+
+		struct Stats {
+			size_t used = 0;
+			size_t peak = 0;
+			uint64_t frames_over_budget = 0; //frames where eviction couldn't reach the budget
+			std::array<CategoryStats, (size_t)MemoryCategory::Count> categories;
+
+			inline const CategoryStats& category(MemoryCategory category) const { return categories[(size_t)category]; }
+		};
+
+		ResidencyManager(size_t budget_bytes):m_budget(budget_bytes){}
+
+		void track(TextureInstance& texture, MemoryCategory category = MemoryCategory::Texture, ResidencyPolicy policy = {}){
+			Entry& entry = m_entries[&texture];
+			entry.texture = &texture;
+			entry.buffer = nullptr;
+			entry.category = category;
+			entry.policy = std::move(policy);
+			entry.last_use = m_frame;
+			entry.full = footprint(texture);
+			entry.bytes = entry.full.bytes;
+		}
+
+		void track(const BufferInstance& buffer, MemoryCategory category = MemoryCategory::Buffer){
+			Entry& entry = m_entries[&buffer];
+			entry.texture = nullptr;
+			entry.buffer = &buffer;
+			entry.category = category;
+			entry.policy.pinned = true;
+			entry.last_use = m_frame;
+			entry.bytes = buffer.size();
+		}
+
+		inline void untrack(const TextureInstance& texture){ m_entries.erase(&texture); }
+		inline void untrack(const BufferInstance& buffer){ m_entries.erase(&buffer); }
+		inline bool tracked(const void* object) const { return m_entries.count(object) != 0; }
+
+		/**
+		 * @brief marks the texture as used this frame, asks for a re-stream when it was evicted
+		*/
+		void touch(TextureInstance& texture){
+			auto it = m_entries.find(&texture);
+			if(it == m_entries.end()) return;
+			Entry& entry = it->second;
+			entry.last_use = m_frame;
+			if(!entry.evicted || entry.restream_pending || !entry.policy.restream) return;
+			entry.restream_pending = true;
+			stats(entry).restreams++;
+			entry.policy.restream(texture, entry.full);
+		}
+
+		inline void touch(const BufferInstance& buffer){
+			auto it = m_entries.find(&buffer);
+			if(it != m_entries.end()) it->second.last_use = m_frame;
+		}
+
+		/**
+		 * @brief ends the frame, refreshes the accounting and evicts down to the budget
+		 * @return bytes freed
+		*/
+		size_t update(){
+			refresh();
+			size_t freed = 0;
+			if(m_stats.used > m_budget) freed = evict(m_stats.used - m_budget);
+			if(m_stats.used > m_budget) m_stats.frames_over_budget++;
+			m_frame++;
+			return freed;
+		}
+
+		/**
+		 * @brief evicts until `bytes` are freed or nothing evictable is left, regardless of the budget
+		*/
+		size_t evict(size_t bytes){
+			std::vector<Entry*> candidates;
+			for(auto& [object, entry]: m_entries){
+				if(entry.texture && !entry.policy.pinned && entry.bytes && m_frame - entry.last_use >= m_grace_frames) candidates.push_back(&entry);
+			}
+			//oldest first, larger first between textures last used on the same frame
+			std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b){
+				return a->last_use != b->last_use ? a->last_use < b->last_use : a->bytes > b->bytes;
+			});
+
+			//every candidate keeps its small mips before any of them is dropped
+			size_t freed = 0;
+			for(Entry* entry: candidates){
+				if(freed >= bytes) return freed;
+				freed += demote(*entry, bytes - freed);
+			}
+			for(Entry* entry: candidates){
+				if(freed >= bytes) return freed;
+				if(entry->policy.droppable && entry->bytes) freed += release(*entry, [&]{ entry->texture->reset(); stats(*entry).drops++; });
+			}
+			return freed;
+		}
+
+		void set_budget(size_t bytes){ m_budget = bytes; }
+		inline size_t budget() const { return m_budget; }
+		inline size_t used() const { return m_stats.used; }
+
+		//textures used within the last `frames` frames are never evicted (1 protects the current frame only)
+		inline void set_grace_frames(uint64_t frames){ m_grace_frames = std::max<uint64_t>(frames, 1); }
+
+		inline const Stats& stats() const { return m_stats; }
+		inline uint64_t frame() const { return m_frame; }
+
+	private:
+		struct Entry {
+			TextureInstance* texture = nullptr;
+			const BufferInstance* buffer = nullptr;
+			MemoryCategory category = MemoryCategory::Other;
+			ResidencyPolicy policy;
+			TextureFootprint full;
+			size_t bytes = 0;
+			uint64_t last_use = 0;
+			bool evicted = false;
+			bool restream_pending = false;
+		};
+
+		size_t m_budget = 0;
+		uint64_t m_frame = 1;
+		uint64_t m_grace_frames = 1;
+		std::unordered_map<const void*, Entry> m_entries;
+		Stats m_stats;
+
+		inline CategoryStats& stats(const Entry& entry){ return m_stats.categories[(size_t)entry.category]; }
+
+		static TextureFootprint footprint(const TextureInstance& texture){
+			return {
+				.levels = texture.levels(),
+				.internal_format = texture.internal_format(),
+				.width = texture.width(),
+				.height = texture.height(),
+				.depth = texture.depth(),
+				.bytes = texture.memory_size()
+			};
+		}
+
+		void refresh(){
+			for(auto& category: m_stats.categories){
+				category.bytes = 0;
+				category.objects = 0;
+				category.evicted = 0;
+			}
+			m_stats.used = 0;
+
+			for(auto& [object, entry]: m_entries){
+				if(entry.texture){
+					TextureFootprint current = footprint(*entry.texture);
+					//re-specified at (or above) its full size, by a re-stream or by its owner
+					if(!entry.evicted || (current.width >= entry.full.width && current.levels >= entry.full.levels)){
+						entry.full = current;
+						entry.evicted = false;
+						entry.restream_pending = false;
+					}
+					entry.bytes = current.bytes;
+				} else entry.bytes = entry.buffer->size();
+
+				CategoryStats& category = stats(entry);
+				category.bytes += entry.bytes;
+				category.objects++;
+				category.evicted += entry.evicted;
+				m_stats.used += entry.bytes;
+			}
+			m_stats.peak = std::max(m_stats.peak, m_stats.used);
+		}
+
+		/**
+		 * @brief drops the fewest levels that free `wanted` bytes, as many as `min_size` allows when that's not enough
+		*/
+		size_t demote(Entry& entry, size_t wanted){
+			TextureInstance& texture = *entry.texture;
+			//without image copies only whole textures can be dropped
+			if(!TextureInstance::can_drop_levels()) return 0;
+			size_t largest = std::max(texture.width(), texture.texture_type() == TextureType::Tex1DArray ? 1 : texture.height());
+			size_t freed = 0;
+			uint32_t count = 0;
+			while(count + 1 < texture.levels() && (largest >> (count + 1)) >= entry.policy.min_size && freed < wanted){
+				freed += texture.level_size(count);
+				count++;
+			}
+			if(!count) return 0;
+			return release(entry, [&]{ texture.drop_levels(count); stats(entry).demotions++; });
+		}
+
+		template<typename F>
+		size_t release(Entry& entry, F&& evict){
+			size_t before = entry.bytes;
+			evict();
+			entry.bytes = entry.texture->memory_size();
+			CategoryStats& category = stats(entry);
+			if(!entry.evicted) category.evicted++;
+			entry.evicted = true;
+			entry.restream_pending = false;
+			category.evicted_bytes += before - entry.bytes;
+			category.bytes -= before - entry.bytes;
+			m_stats.used -= before - entry.bytes;
+			return before - entry.bytes;
+		}
+};
@@ -0,0 +1,211 @@
+#pragma once
+#include "state.hpp"
+#include <memory>
+#include <unordered_map>
+
+enum class SamplerFilter: uint8_t {
+	Nearest,
+	Linear
+};
+
+enum class SamplerMipmap: uint8_t {
+	None,
+	Nearest,
+	Linear
+};
+
+enum class SamplerWrap: uint8_t {
+	Repeat,
+	MirroredRepeat,
+	ClampToEdge,
+	ClampToBorder,
+	MirrorClampToEdge
+};
+
+/**
+ * @brief every sampling parameter of a texture unit, compared and hashed by value
+*/
+struct SamplerDesc {
+	SamplerFilter min_filter = SamplerFilter::Linear;
+	SamplerFilter mag_filter = SamplerFilter::Linear;
+	SamplerMipmap mipmap = SamplerMipmap::Linear;
+	SamplerWrap wrap_s = SamplerWrap::Repeat;
+	SamplerWrap wrap_t = SamplerWrap::Repeat;
+	SamplerWrap wrap_r = SamplerWrap::Repeat;
+	uint8_t max_anisotropy = 1; //1 disables anisotropic filtering
+	uint32_t compare_func = 0; //GL_LEQUAL and others for shadow samplers, 0 disables depth comparison
+	float lod_bias = 0.0f;
+	float min_lod = -1000.0f;
+	float max_lod = 1000.0f;
+	std::array<float, 4> border = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	bool operator==(const SamplerDesc& other) const = default;
+
+	uint64_t hash() const {
+		uint8_t modes[7] = { (uint8_t)min_filter, (uint8_t)mag_filter, (uint8_t)mipmap, (uint8_t)wrap_s, (uint8_t)wrap_t, (uint8_t)wrap_r, max_anisotropy };
+		float values[7] = { hashed(lod_bias), hashed(min_lod), hashed(max_lod), hashed(border[0]), hashed(border[1]), hashed(border[2]), hashed(border[3]) };
+		uint64_t h = g_utils::hash_bytes(modes, sizeof(modes));
+		h = g_utils::hash_bytes(&compare_func, sizeof(compare_func), h);
+		return g_utils::hash_bytes(values, sizeof(values), h);
+	}
+
+	//-0.0f == 0.0f but their bytes differ, equal descriptions must hash the same
+	static constexpr float hashed(float value){ return value == 0.0f ? 0.0f : value; }
+
+	static constexpr SamplerDesc nearest_clamp(){
+		return {
+			.min_filter = SamplerFilter::Nearest,
+			.mag_filter = SamplerFilter::Nearest,
+			.mipmap = SamplerMipmap::None,
+			.wrap_s = SamplerWrap::ClampToEdge,
+			.wrap_t = SamplerWrap::ClampToEdge,
+			.wrap_r = SamplerWrap::ClampToEdge
+		};
+	}
+
+	static constexpr SamplerDesc linear_clamp(){
+		return {
+			.wrap_s = SamplerWrap::ClampToEdge,
+			.wrap_t = SamplerWrap::ClampToEdge,
+			.wrap_r = SamplerWrap::ClampToEdge
+		};
+	}
+
+	static constexpr SamplerDesc anisotropic(uint8_t anisotropy = 8){
+		return { .max_anisotropy = anisotropy };
+	}
+
+	static constexpr SamplerDesc shadow(){
+		return {
+			.mipmap = SamplerMipmap::None,
+			.wrap_s = SamplerWrap::ClampToBorder,
+			.wrap_t = SamplerWrap::ClampToBorder,
+			.wrap_r = SamplerWrap::ClampToBorder,
+			.compare_func = GL_LEQUAL,
+			.border = { 1.0f, 1.0f, 1.0f, 1.0f } //read through ClampToBorder, lookups outside the map are lit
+		};
+	}
+};
+
+template<>
+struct std::hash<SamplerDesc> {
+	inline size_t operator()(const SamplerDesc& desc) const { return (size_t)desc.hash(); }
+};
+
+class SamplerInstance: public Instance {
+	public:
+		SamplerInstance(const SamplerDesc& desc = {}):Instance(InstanceType::Sampler),m_desc(desc){
+			THIS_INSTANCE_CALL( InstanceErrorType::Create, glGenSamplers(1, id_ref()) );
+			apply();
+		}
+
+		~SamplerInstance(){
+			if(!b_detached) GlobalBindingCache.forget_sampler(id());
+			glDeleteSamplers(1, id_ref());
+		}
+
+		inline void setSlot(uint8_t slot){
+			if(slot >= GlobalContextConfig.max_texture_slots) throw InstanceError(InstanceErrorType::Bind, type(), "sampler unit out of range");
+			m_slot = slot;
+		}
+
+		inline uint8_t slot() const { return m_slot; }
+		inline const SamplerDesc& desc() const { return m_desc; }
+
+	private:
+		SamplerDesc m_desc;
+		uint8_t m_slot = 0;
+		bool b_detached = false; //the binding cache may be gone, don't touch it on destruction
+
+		friend class SamplerCache;
+
+		static uint32_t gl_wrap(SamplerWrap wrap){
+			switch(wrap){
+				case SamplerWrap::MirroredRepeat: return GL_MIRRORED_REPEAT;
+				case SamplerWrap::ClampToEdge: return GL_CLAMP_TO_EDGE;
+				case SamplerWrap::ClampToBorder: return GL_CLAMP_TO_BORDER;
+				case SamplerWrap::MirrorClampToEdge: return GL_MIRROR_CLAMP_TO_EDGE;
+				default: return GL_REPEAT;
+			}
+		}
+
+		uint32_t gl_min_filter() const {
+			bool linear = m_desc.min_filter == SamplerFilter::Linear;
+			switch(m_desc.mipmap){
+				case SamplerMipmap::Nearest: return linear ? GL_LINEAR_MIPMAP_NEAREST : GL_NEAREST_MIPMAP_NEAREST;
+				case SamplerMipmap::Linear: return linear ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_LINEAR;
+				default: return linear ? GL_LINEAR : GL_NEAREST;
+			}
+		}
+
+		void apply(){
+			uint32_t sampler = id();
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, gl_min_filter()), MinFilter );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, m_desc.mag_filter == SamplerFilter::Linear ? GL_LINEAR : GL_NEAREST), MagFilter );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, gl_wrap(m_desc.wrap_s)), WrapS );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, gl_wrap(m_desc.wrap_t)), WrapT );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, gl_wrap(m_desc.wrap_r)), WrapR );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, m_desc.lod_bias), LodBias );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameterf(sampler, GL_TEXTURE_MIN_LOD, m_desc.min_lod), MinLod );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameterf(sampler, GL_TEXTURE_MAX_LOD, m_desc.max_lod), MaxLod );
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR, m_desc.border.data()), BorderColor );
+			if(m_desc.compare_func){
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE), CompareMode );
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, m_desc.compare_func), CompareFunc );
+			}
+			if(m_desc.max_anisotropy > 1 && (GlobalContextConfig.supports(4,6) || GlobalContextConfig.has_extension("GL_EXT_texture_filter_anisotropic"))){
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Setup, glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, (float)m_desc.max_anisotropy), Anisotropy );
+			}
+		}
+
+	protected:
+		virtual void t_bind(){
+			GlobalBindingCache.bind_sampler(m_slot, id());
+		}
+
+		virtual void t_unbind(){
+			GlobalBindingCache.bind_sampler(m_slot, 0);
+		}
+};
+
+/**
+ * @brief one sampler object per distinct `SamplerDesc`
+ *
+ * thousands of textures sharing a handful of descriptions share that many GL objects, and texture
+ * setup becomes a lookup instead of per texture glTexParameter calls. samplers stay alive until
+ * `clear()`, which must run while the context is still current.
+*/
+class SamplerCache {
+	public:
+		struct Stats {
+			uint64_t requests = 0;
+			uint64_t created = 0;
+		};
+
+		SamplerInstance& get(const SamplerDesc& desc){
+			m_stats.requests++;
+			auto it = m_samplers.find(desc);
+			if(it != m_samplers.end()) return *it->second;
+			m_stats.created++;
+			return *m_samplers.emplace(desc, std::make_unique<SamplerInstance>(desc)).first->second;
+		}
+
+		~SamplerCache(){
+			//thread_locals are destroyed in reverse order of construction, which happens on first use. this cache
+			//may have been used before GlobalBindingCache was, then the binding cache is already destroyed here
+			for(auto& [desc, sampler]: m_samplers) sampler->b_detached = true;
+		}
+
+		inline size_t size() const { return m_samplers.size(); }
+		inline void clear(){ m_samplers.clear(); }
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		std::unordered_map<SamplerDesc, std::unique_ptr<SamplerInstance>> m_samplers;
+		Stats m_stats;
+};
+
+//like the binding cache, samplers belong to the context current on this thread
+inline thread_local SamplerCache GlobalSamplerCache;
@@ -1,5 +1,9 @@
 #pragma once
-#include "core.hpp"
+#include "state.hpp"
+#include <map>
+#include <memory>
+#include <string_view>
+#include <bit>
 
 enum class ShaderType: uint32_t {
 	None,
@@ -37,81 +41,509 @@ enum class UniformType: uint8_t {
 	DMat3,
 	DMat4,
 
+	UInt,
+	UVec2,
+	UVec3,
+	UVec4,
+
 	MaxType
 };
 
+inline size_t uniform_type_size(UniformType type){
+	switch(type){
+		case UniformType::Int: return sizeof(int32_t);
+		case UniformType::Float: return sizeof(float);
+		case UniformType::Double: return sizeof(double);
+		case UniformType::IVec2: return sizeof(int32_t)*2;
+		case UniformType::IVec3: return sizeof(int32_t)*3;
+		case UniformType::IVec4: return sizeof(int32_t)*4;
+		case UniformType::FVec2: return sizeof(float)*2;
+		case UniformType::FVec3: return sizeof(float)*3;
+		case UniformType::FVec4: return sizeof(float)*4;
+		case UniformType::DVec2: return sizeof(double)*2;
+		case UniformType::DVec3: return sizeof(double)*3;
+		case UniformType::DVec4: return sizeof(double)*4;
+		case UniformType::FMat2: return sizeof(float)*4;
+		case UniformType::FMat3: return sizeof(float)*9;
+		case UniformType::FMat4: return sizeof(float)*16;
+		case UniformType::DMat2: return sizeof(double)*4;
+		case UniformType::DMat3: return sizeof(double)*9;
+		case UniformType::DMat4: return sizeof(double)*16;
+		case UniformType::UInt: return sizeof(uint32_t);
+		case UniformType::UVec2: return sizeof(uint32_t)*2;
+		case UniformType::UVec3: return sizeof(uint32_t)*3;
+		case UniformType::UVec4: return sizeof(uint32_t)*4;
+		default: return 0;
+	}
+}
+
+/**
+ * @brief maps a GL uniform type to the type used to set it, bools and opaque types (samplers, images) are set as ints
+ * @note non square matrices and atomic counters have no settable type and map to None
+*/
+inline UniformType uniform_type_from_gl(uint32_t gl_type){
+	switch(gl_type){
+		case GL_INT: case GL_BOOL: return UniformType::Int;
+		case GL_FLOAT: return UniformType::Float;
+		case GL_DOUBLE: return UniformType::Double;
+		case GL_INT_VEC2: case GL_BOOL_VEC2: return UniformType::IVec2;
+		case GL_INT_VEC3: case GL_BOOL_VEC3: return UniformType::IVec3;
+		case GL_INT_VEC4: case GL_BOOL_VEC4: return UniformType::IVec4;
+		case GL_UNSIGNED_INT: return UniformType::UInt;
+		case GL_UNSIGNED_INT_VEC2: return UniformType::UVec2;
+		case GL_UNSIGNED_INT_VEC3: return UniformType::UVec3;
+		case GL_UNSIGNED_INT_VEC4: return UniformType::UVec4;
+		case GL_FLOAT_VEC2: return UniformType::FVec2;
+		case GL_FLOAT_VEC3: return UniformType::FVec3;
+		case GL_FLOAT_VEC4: return UniformType::FVec4;
+		case GL_DOUBLE_VEC2: return UniformType::DVec2;
+		case GL_DOUBLE_VEC3: return UniformType::DVec3;
+		case GL_DOUBLE_VEC4: return UniformType::DVec4;
+		case GL_FLOAT_MAT2: return UniformType::FMat2;
+		case GL_FLOAT_MAT3: return UniformType::FMat3;
+		case GL_FLOAT_MAT4: return UniformType::FMat4;
+		case GL_DOUBLE_MAT2: return UniformType::DMat2;
+		case GL_DOUBLE_MAT3: return UniformType::DMat3;
+		case GL_DOUBLE_MAT4: return UniformType::DMat4;
+
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW: case GL_SAMPLER_CUBE_MAP_ARRAY: case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+		case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+		case GL_INT_SAMPLER_1D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_2D_MULTISAMPLE:
+		case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_RECT: case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+		case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+		case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+		case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_IMAGE_1D: case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_2D_RECT: case GL_IMAGE_CUBE: case GL_IMAGE_BUFFER:
+		case GL_IMAGE_1D_ARRAY: case GL_IMAGE_2D_ARRAY: case GL_IMAGE_CUBE_MAP_ARRAY: case GL_IMAGE_2D_MULTISAMPLE: case GL_IMAGE_2D_MULTISAMPLE_ARRAY:
+		case GL_INT_IMAGE_1D: case GL_INT_IMAGE_2D: case GL_INT_IMAGE_3D: case GL_INT_IMAGE_2D_RECT: case GL_INT_IMAGE_CUBE: case GL_INT_IMAGE_BUFFER:
+		case GL_INT_IMAGE_1D_ARRAY: case GL_INT_IMAGE_2D_ARRAY: case GL_INT_IMAGE_CUBE_MAP_ARRAY: case GL_INT_IMAGE_2D_MULTISAMPLE: case GL_INT_IMAGE_2D_MULTISAMPLE_ARRAY:
+		case GL_UNSIGNED_INT_IMAGE_1D: case GL_UNSIGNED_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_3D: case GL_UNSIGNED_INT_IMAGE_2D_RECT:
+		case GL_UNSIGNED_INT_IMAGE_CUBE: case GL_UNSIGNED_INT_IMAGE_BUFFER: case GL_UNSIGNED_INT_IMAGE_1D_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D_ARRAY:
+		case GL_UNSIGNED_INT_IMAGE_CUBE_MAP_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE: case GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY:
+			return UniformType::Int;
+		default: return UniformType::None;
+	}
+}
+
+/**
+ * @brief 32 bit FNV-1a of a resource name, usable at compile time through `"u_mvp"_uh`
+*/
+constexpr uint32_t resource_hash(std::string_view name){
+	uint32_t h = 0x811c9dc5u;
+	for(char c: name){
+		h ^= (uint8_t)c;
+		h *= 0x01000193u;
+	}
+	return h;
+}
+
+consteval uint32_t operator""_uh(const char* name, size_t sz){ return resource_hash(std::string_view(name, sz)); }
+
+struct UniformInfo {
+	uint32_t hash = 0;
+	uint32_t name = 0; //index in ProgramReflection::names()
+	int32_t location = -1; //-1 for block members
+	UniformType type = UniformType::None;
+	uint32_t gl_type = 0;
+	uint32_t array_size = 1;
+	int32_t block_index = -1;
+	int32_t offset = -1; //offset inside the block, -1 outside blocks
+};
+
+struct BlockInfo {
+	uint32_t hash = 0;
+	uint32_t name = 0;
+	uint32_t index = 0;
+	uint32_t binding = 0;
+	uint32_t size = 0;
+};
+
+struct AttributeInfo {
+	uint32_t hash = 0;
+	uint32_t name = 0;
+	int32_t location = -1;
+	uint32_t gl_type = 0;
+	uint32_t array_size = 1;
+};
+
+/**
+ * @brief flat open addressing table of reflected resources keyed by their name hash
+*/
+template<typename T>
+class ReflectionTable {
+	public:
+		void build(std::vector<T>&& entries){
+			m_entries = std::move(entries);
+			m_slots.assign(std::bit_ceil(std::max<size_t>(m_entries.size() * 2, 8)), 0);
+			size_t mask = m_slots.size() - 1;
+			for(uint32_t i = 0; i < m_entries.size(); i++){
+				size_t slot = m_entries[i].hash & mask;
+				while(m_slots[slot]){
+					if(m_entries[m_slots[slot] - 1].hash == m_entries[i].hash){
+						LOG_ERROR( ReflectionTable, "resource name hash collision, only the first resource is reachable" );
+						break;
+					}
+					slot = (slot + 1) & mask;
+				}
+				if(!m_slots[slot]) m_slots[slot] = i + 1;
+			}
+		}
+
+		const T* find(uint32_t hash) const {
+			if(m_slots.empty()) return nullptr;
+			size_t mask = m_slots.size() - 1;
+			for(size_t slot = hash & mask; m_slots[slot]; slot = (slot + 1) & mask){
+				const T& entry = m_entries[m_slots[slot] - 1];
+				if(entry.hash == hash) return &entry;
+			}
+			return nullptr;
+		}
+
+		void clear(){
+			m_entries.clear();
+			m_slots.clear();
+		}
+
+		inline const std::vector<T>& entries() const { return m_entries; }
+		inline size_t size() const { return m_entries.size(); }
+
+	private:
+		std::vector<T> m_entries;
+		std::vector<uint32_t> m_slots; //entry index + 1, 0 is empty
+};
+
+/**
+ * @brief active resources of a linked program, filled through the program interface query (GL 4.3)
+ * @note array names are stored without the trailing `[0]`
+*/
+class ProgramReflection {
+	public:
+		void reflect(uint32_t program){
+			clear();
+			std::vector<char> name;
+
+			auto read_name = [&](uint32_t interface, uint32_t index, int32_t length) -> uint32_t {
+				name.resize(std::max(length, 1));
+				SAFE_CALL( ProgramResourceName, glGetProgramResourceName(program, interface, index, (int32_t)name.size(), nullptr, name.data()) );
+				std::string_view view(name.data(), std::max(length - 1, 0));
+				if(view.ends_with("[0]")) view.remove_suffix(3);
+				m_names.emplace_back(view);
+				return (uint32_t)m_names.size() - 1;
+			};
+			auto count = [&](uint32_t interface){
+				int32_t active = 0;
+				SAFE_CALL( ProgramInterface, glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &active) );
+				return active;
+			};
+
+			{
+				const uint32_t props[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET };
+				int32_t values[6];
+				std::vector<UniformInfo> uniforms;
+				for(int32_t i = 0, n = count(GL_UNIFORM); i < n; i++){
+					SAFE_CALL( ProgramResource, glGetProgramResourceiv(program, GL_UNIFORM, i, 6, props, 6, nullptr, values) );
+					UniformInfo info = {
+						.name = read_name(GL_UNIFORM, i, values[0]),
+						.location = values[3],
+						.type = uniform_type_from_gl(values[1]),
+						.gl_type = (uint32_t)values[1],
+						.array_size = (uint32_t)values[2],
+						.block_index = values[4],
+						.offset = values[4] >= 0 ? values[5] : -1
+					};
+					info.hash = resource_hash(m_names[info.name]);
+					uniforms.push_back(info);
+				}
+				m_uniforms.build(std::move(uniforms));
+			}
+
+			auto reflect_blocks = [&](uint32_t interface, ReflectionTable<BlockInfo>& table){
+				const uint32_t props[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+				int32_t values[3];
+				std::vector<BlockInfo> blocks;
+				for(int32_t i = 0, n = count(interface); i < n; i++){
+					SAFE_CALL( ProgramResource, glGetProgramResourceiv(program, interface, i, 3, props, 3, nullptr, values) );
+					BlockInfo info = {
+						.name = read_name(interface, i, values[0]),
+						.index = (uint32_t)i,
+						.binding = (uint32_t)values[1],
+						.size = (uint32_t)values[2]
+					};
+					info.hash = resource_hash(m_names[info.name]);
+					blocks.push_back(info);
+				}
+				table.build(std::move(blocks));
+			};
+			reflect_blocks(GL_UNIFORM_BLOCK, m_uniform_blocks);
+			reflect_blocks(GL_SHADER_STORAGE_BLOCK, m_storage_blocks);
+
+			{
+				const uint32_t props[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION };
+				int32_t values[4];
+				std::vector<AttributeInfo> attributes;
+				for(int32_t i = 0, n = count(GL_PROGRAM_INPUT); i < n; i++){
+					SAFE_CALL( ProgramResource, glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 4, props, 4, nullptr, values) );
+					if(values[3] < 0) continue; //built in inputs
+					AttributeInfo info = {
+						.name = read_name(GL_PROGRAM_INPUT, i, values[0]),
+						.location = values[3],
+						.gl_type = (uint32_t)values[1],
+						.array_size = (uint32_t)values[2]
+					};
+					info.hash = resource_hash(m_names[info.name]);
+					attributes.push_back(info);
+				}
+				m_attributes.build(std::move(attributes));
+			}
+			m_valid = true;
+		}
+
+		void clear(){
+			m_uniforms.clear();
+			m_uniform_blocks.clear();
+			m_storage_blocks.clear();
+			m_attributes.clear();
+			m_names.clear();
+			m_valid = false;
+		}
+
+		inline const UniformInfo* uniform(uint32_t hash) const { return m_uniforms.find(hash); }
+		inline const BlockInfo* uniform_block(uint32_t hash) const { return m_uniform_blocks.find(hash); }
+		inline const BlockInfo* storage_block(uint32_t hash) const { return m_storage_blocks.find(hash); }
+		inline const AttributeInfo* attribute(uint32_t hash) const { return m_attributes.find(hash); }
+
+		inline const std::vector<UniformInfo>& uniforms() const { return m_uniforms.entries(); }
+		inline const std::vector<BlockInfo>& uniform_blocks() const { return m_uniform_blocks.entries(); }
+		inline const std::vector<BlockInfo>& storage_blocks() const { return m_storage_blocks.entries(); }
+		inline const std::vector<AttributeInfo>& attributes() const { return m_attributes.entries(); }
+
+		template<typename T>
+		inline const std::string& name(const T& info) const { return m_names[info.name]; }
+
+		/**
+		 * @brief false until a successful reflection, lookups then always miss
+		*/
+		inline bool valid() const { return m_valid; }
+
+	private:
+		ReflectionTable<UniformInfo> m_uniforms;
+		ReflectionTable<BlockInfo> m_uniform_blocks;
+		ReflectionTable<BlockInfo> m_storage_blocks;
+		ReflectionTable<AttributeInfo> m_attributes;
+		std::vector<std::string> m_names;
+		bool m_valid = false;
+};
+
 //TODO: ShaderError structure
 
+/**
+ * @brief last values uploaded to the uniforms of a program, used to skip redundant uploads
+ * @note an array write covers one location per element, writes overlapping a recorded range forget it
+*/
+class UniformCache {
+	public:
+		struct Stats {
+			uint64_t uploads = 0;
+			uint64_t skipped = 0;
+
+			inline uint64_t requested() const { return uploads + skipped; }
+		};
+
+		/**
+		 * @brief records the value of the `locations` locations starting at `location`
+		 * @return true if it differs from the last recorded one and must be uploaded
+		*/
+		bool update(uint32_t location, const void* data, size_t sz, bool transpose = false, uint32_t locations = 1){
+			if(!m_enabled){
+				m_stats.uploads++;
+				return true;
+			}
+			locations = std::max<uint32_t>(locations, 1);
+
+			auto it = m_entries.find(location);
+			if(it != m_entries.end()){
+				const Entry& entry = it->second;
+				//recorded ranges never overlap, an exact match is the only value covering these locations
+				if(entry.locations == locations && entry.transpose == transpose && entry.value.size() == sz && memcmp(entry.value.data(), data, sz) == 0){
+					m_stats.skipped++;
+					return false;
+				}
+			}
+
+			forget(location, locations);
+			Entry& entry = m_entries[location];
+			entry.locations = locations;
+			entry.transpose = transpose;
+			entry.value.assign((const uint8_t*)data, (const uint8_t*)data + sz);
+			m_widest = std::max(m_widest, locations);
+			m_stats.uploads++;
+			return true;
+		}
+
+		/**
+		 * @brief forgets the values covering `location`, the next update always uploads
+		*/
+		inline void invalidate(uint32_t location){ forget(location, 1); }
+
+		/**
+		 * @brief forgets every value, required after a relink since it resets the uniforms
+		*/
+		inline void clear(){
+			m_entries.clear();
+			m_widest = 1;
+		}
+
+		inline void set_enabled(bool enabled){ m_enabled = enabled; if(!enabled) clear(); }
+		inline bool enabled() const { return m_enabled; }
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		struct Entry {
+			uint32_t locations = 1;
+			bool transpose = false;
+			std::vector<uint8_t> value;
+		};
+
+		std::map<uint32_t, Entry> m_entries; //by first location
+		uint32_t m_widest = 1; //most locations of an entry, bounds the backward search for overlaps
+		Stats m_stats;
+		bool m_enabled = true;
+
+		void forget(uint32_t location, uint32_t locations){
+			uint64_t end = (uint64_t)location + locations;
+			auto it = m_entries.lower_bound(location >= m_widest ? location - m_widest + 1 : 0);
+			while(it != m_entries.end() && it->first < end){
+				if(it->first + (uint64_t)it->second.locations > location) it = m_entries.erase(it);
+				else ++it;
+			}
+		}
+};
+
+//picks glProgramUniform* or glUniform* for the same suffix
+#define UNIFORM_CALL(F, ...) \
+	if(dsa){ SAFE_CALL( ShaderProgram##F, glProgram##F(program, id, __VA_ARGS__) ); }\
+	else { SAFE_CALL( Shader##F, gl##F(id, __VA_ARGS__) ); }
+
+/**
+ * @brief a uniform location of a program
+ * 
+ * when `program` is set the upload doesn't depend on the bound program: glProgramUniform* is used
+ * if the context supports it (4.1+), otherwise the program is bound through the binding cache for
+ * the upload and the previously used one is bound again.
+ * when `cache` is set unchanged values are skipped.
+*/
 struct ShaderUniform {
 	UniformType type = UniformType::None;
 	uint32_t id = 0;
+	uint32_t program = 0;
+	UniformCache* cache = nullptr;
+
+	/**
+	 * @return true if the value was sent to the driver
+	*/
+	bool set_data(void* data,size_t count, bool transpose = false){
+		if(id == ~0u) return false; //inactive or unknown uniform
+		if(type == UniformType::None){
+			LOG_ERROR( ShaderUniformNone, "No uniform type was provided");
+			return false;
+		}
+		if(cache && !cache->update(id, data, uniform_type_size(type) * count, transpose, (uint32_t)count)) return false;
+
+		#ifdef GL_LATEST_FEATURES
+		bool dsa = program != 0;
+		#else
+		bool dsa = program != 0 && GlobalContextConfig.program_uniforms;
+		uint32_t previous = GlobalBindingCache.program();
+		if(program != 0 && !dsa) GlobalBindingCache.use_program(program);
+		#endif
+		uint8_t t = transpose ? GL_TRUE : GL_FALSE;
 
-	void set_data(void* data,size_t count, bool transpose = false){
 		switch(type){
-			case UniformType::None:
-				LOG_ERROR( ShaderUniformNone, "No uniform type was provided");
-				break;
 			case UniformType::Int:
-				SAFE_CALL( ShaderUniform1iv, glUniform1iv(id,count,(int32_t*)data) );
+				UNIFORM_CALL( Uniform1iv, count, (int32_t*)data );
 				break;
 			case UniformType::Float:
-				SAFE_CALL( ShaderUniform1fv, glUniform1fv(id,count,(float*)data) );
+				UNIFORM_CALL( Uniform1fv, count, (float*)data );
 				break;
 			case UniformType::Double:
-				SAFE_CALL( ShaderUniform1dv, glUniform1dv(id,count,(double*)data) );
+				UNIFORM_CALL( Uniform1dv, count, (double*)data );
 				break;
 			case UniformType::IVec2:
-				SAFE_CALL( ShaderUniform2iv, glUniform2iv(id,count,(int32_t*)data) );
+				UNIFORM_CALL( Uniform2iv, count, (int32_t*)data );
 				break;
 			case UniformType::IVec3:
-				SAFE_CALL( ShaderUniform3iv, glUniform3iv(id,count,(int32_t*)data) );
+				UNIFORM_CALL( Uniform3iv, count, (int32_t*)data );
 				break;
 			case UniformType::IVec4:
-				SAFE_CALL( ShaderUniform4iv, glUniform4iv(id,count,(int32_t*)data) );
+				UNIFORM_CALL( Uniform4iv, count, (int32_t*)data );
 				break;
 			case UniformType::FVec2:
-				SAFE_CALL( ShaderUniform2fv, glUniform2fv(id,count,(float*)data) );
+				UNIFORM_CALL( Uniform2fv, count, (float*)data );
 				break;
 			case UniformType::FVec3:
-				SAFE_CALL( ShaderUniform3fv, glUniform3fv(id,count,(float*)data) );
+				UNIFORM_CALL( Uniform3fv, count, (float*)data );
 				break;
 			case UniformType::FVec4:
-				SAFE_CALL( ShaderUniform4fv, glUniform4fv(id,count,(float*)data) );
+				UNIFORM_CALL( Uniform4fv, count, (float*)data );
 				break;
 			case UniformType::DVec2:
-				SAFE_CALL( ShaderUniform2dv, glUniform2dv(id,count,(double*)data) );
+				UNIFORM_CALL( Uniform2dv, count, (double*)data );
 				break;
 			case UniformType::DVec3:
-				SAFE_CALL( ShaderUniform3dv, glUniform3dv(id,count,(double*)data) );
+				UNIFORM_CALL( Uniform3dv, count, (double*)data );
 				break;
 			case UniformType::DVec4:
-				SAFE_CALL( ShaderUniform4dv, glUniform4dv(id,count,(double*)data) );
+				UNIFORM_CALL( Uniform4dv, count, (double*)data );
+				break;
+			case UniformType::UInt:
+				UNIFORM_CALL( Uniform1uiv, count, (uint32_t*)data );
+				break;
+			case UniformType::UVec2:
+				UNIFORM_CALL( Uniform2uiv, count, (uint32_t*)data );
+				break;
+			case UniformType::UVec3:
+				UNIFORM_CALL( Uniform3uiv, count, (uint32_t*)data );
+				break;
+			case UniformType::UVec4:
+				UNIFORM_CALL( Uniform4uiv, count, (uint32_t*)data );
 				break;
 			case UniformType::FMat2:
-				SAFE_CALL( ShaderUniformMatrix2fv, glUniformMatrix2fv(id,count, transpose ? GL_TRUE:GL_FALSE ,(float*)data) );
+				UNIFORM_CALL( UniformMatrix2fv, count, t, (float*)data );
 				break;
 			case UniformType::FMat3:
-				SAFE_CALL( ShaderUniformMatrix3fv, glUniformMatrix3fv(id,count, transpose ? GL_TRUE:GL_FALSE ,(float*)data) );
+				UNIFORM_CALL( UniformMatrix3fv, count, t, (float*)data );
 				break;
 			case UniformType::FMat4:
-				SAFE_CALL( ShaderUniformMatrix4fv, glUniformMatrix4fv(id,count, transpose ? GL_TRUE:GL_FALSE ,(float*)data) );
+				UNIFORM_CALL( UniformMatrix4fv, count, t, (float*)data );
 				break;
 			case UniformType::DMat2:
-				SAFE_CALL( ShaderUniformMatrix2dv, glUniformMatrix2dv(id,count, transpose ? GL_TRUE:GL_FALSE ,(double*)data) );
+				UNIFORM_CALL( UniformMatrix2dv, count, t, (double*)data );
 				break;
 			case UniformType::DMat3:
-				SAFE_CALL( ShaderUniformMatrix3dv, glUniformMatrix3dv(id,count, transpose ? GL_TRUE:GL_FALSE ,(double*)data) );
+				UNIFORM_CALL( UniformMatrix3dv, count, t, (double*)data );
 				break;
 			case UniformType::DMat4:
-				SAFE_CALL( ShaderUniformMatrix4dv, glUniformMatrix4dv(id,count, transpose ? GL_TRUE:GL_FALSE ,(double*)data) );
+				UNIFORM_CALL( UniformMatrix4dv, count, t, (double*)data );
 				break;
 			default:break;
 		}
+		#ifndef GL_LATEST_FEATURES
+		//the program was only bound for the upload, the one in use for drawing is put back
+		if(program != 0 && !dsa && previous != BindingCache::unknown) GlobalBindingCache.use_program(previous);
+		#endif
+		return true;
 	}
 
 	template<typename T, typename... Args>
-	void set_data(const std::vector<T,Args...>& data, bool transposed = false){
-		set_data((void*)data.data(),data.size(),transposed);
+	bool set_data(const std::vector<T,Args...>& data, bool transposed = false){
+		return set_data((void*)data.data(),data.size(),transposed);
 	};
 
 	template<typename T, typename... Args>
@@ -120,6 +552,35 @@ struct ShaderUniform {
 	}
 };
 
+#undef UNIFORM_CALL
+
+/**
+ * @brief inserts a `#define` line per entry ("NAME" or "NAME VALUE") right after the `#version` line
+ * @note a `#line` directive keeps the compiler messages pointing at the original lines
+*/
+inline std::string shader_with_defines(std::string_view source, const std::vector<std::string>& defines){
+	if(defines.empty()) return std::string(source);
+
+	size_t insert = 0;
+	uint32_t line = 1;
+	size_t version = source.find("#version");
+	if(version != std::string_view::npos){
+		size_t end = source.find('\n', version);
+		insert = end == std::string_view::npos ? source.size() : end + 1;
+		for(size_t i = 0; i < insert; i++) if(source[i] == '\n') line++;
+	}
+
+	std::string result(source.substr(0, insert));
+	if(!result.empty() && result.back() != '\n'){
+		result += '\n';
+		line++;
+	}
+	for(auto& define: defines) result += "#define " + define + "\n";
+	result += "#line " + std::to_string(line) + "\n";
+	result += source.substr(insert);
+	return result;
+}
+
 class ShaderInstance: public Instance {
 	public:
 		ShaderInstance() = delete;
@@ -167,6 +628,22 @@ class ShaderInstance: public Instance {
 			return !g_utils::has_error(&m_last_error);
 		}
 
+		/**
+		 * @brief starts the compilation without querying errors, so the driver may compile in background
+		*/
+		void compile_async(){
+			THIS_INSTANCE_CALL( InstanceErrorType::Compile, glCompileShader(id()) );
+		}
+
+		/**
+		 * @brief non blocking completion check, needs KHR/ARB_parallel_shader_compile
+		*/
+		bool completed(){
+			int done = 0;
+			THIS_INSTANCE_CALL( InstanceErrorType::Check, glGetShaderiv(id(), GL_COMPLETION_STATUS_KHR, &done) );
+			return done;
+		}
+
 		bool check_compile_status(){
 			int success;
 			THIS_INSTANCE_CALL( InstanceErrorType::Check, glGetShaderiv(id(),GL_COMPILE_STATUS,&success) );
@@ -204,6 +681,7 @@ class ShaderProgramInstance: public Instance {
 
 		~ShaderProgramInstance(){
 			if(need_destroy()){
+				GlobalBindingCache.forget_program(id());
 				THIS_INSTANCE_CALL( InstanceErrorType::Destroy, glDeleteProgram(id()) );
 			}
 		}
@@ -218,6 +696,11 @@ class ShaderProgramInstance: public Instance {
 			return !g_utils::has_error(&m_last_error);
 		}
 
+		bool detach(const ShaderInstance& shader){
+			THIS_INSTANCE_CALL( InstanceErrorType::Attach, glDetachShader(id(),shader.id()));
+			return !g_utils::has_error(&m_last_error);
+		}
+
 		bool operator<<(const std::vector<ShaderInstance>& shaders){
 			for(auto &shader: shaders){
 				THIS_INSTANCE_CALL( InstanceErrorType::Attach, glAttachShader(id(),shader.id()) );
@@ -227,8 +710,86 @@ class ShaderProgramInstance: public Instance {
 		}
 
 		bool link(){
+			//linking resets every uniform to its default value
+			m_uniform_cache->clear();
+			m_reflection.clear();
+			m_locations.clear();
 			THIS_INSTANCE_CALL( InstanceErrorType::Link, glLinkProgram(id()) );
-			return !g_utils::has_error(&m_last_error);
+			if(g_utils::has_error(&m_last_error)) return false;
+
+			int linked = 0;
+			SAFE_CALL( ShaderProgramLinkStatus, glGetProgramiv(id(), GL_LINK_STATUS, &linked) );
+			if(linked) reflect();
+			return true;
+		}
+
+		/**
+		 * @brief starts linking without querying the result, finish with `check_link_status()` and `reflect()`
+		*/
+		void link_async(){
+			m_uniform_cache->clear();
+			m_reflection.clear();
+			m_locations.clear();
+			THIS_INSTANCE_CALL( InstanceErrorType::Link, glLinkProgram(id()) );
+		}
+
+		/**
+		 * @brief non blocking completion check, needs KHR/ARB_parallel_shader_compile
+		*/
+		bool link_completed(){
+			int done = 0;
+			THIS_INSTANCE_CALL( InstanceErrorType::Check, glGetProgramiv(id(), GL_COMPLETION_STATUS_KHR, &done) );
+			return done;
+		}
+
+		/**
+		 * @brief asks the driver to keep the linked binary, must be set before `link()` to use `get_binary`
+		*/
+		void set_binary_retrievable(bool retrievable = true){
+			THIS_INSTANCE_CALL( InstanceErrorType::Setup, glProgramParameteri(id(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, retrievable ? GL_TRUE : GL_FALSE) );
+		}
+
+		/**
+		 * @brief replaces the program with a binary from `get_binary`
+		 * @return false if the driver rejected it, the program must then be built from sources
+		*/
+		bool load_binary(uint32_t format, const void* data, size_t sz){
+			m_uniform_cache->clear();
+			m_reflection.clear();
+			m_locations.clear();
+			THIS_INSTANCE_CALL( InstanceErrorType::Link, glProgramBinary(id(), format, data, (int32_t)sz) );
+			//a rejected binary is reported through the link status, not as an error
+			g_utils::has_error(&m_last_error);
+
+			int linked = 0;
+			SAFE_CALL( ShaderProgramLinkStatus, glGetProgramiv(id(), GL_LINK_STATUS, &linked) );
+			if(linked) reflect();
+			return linked;
+		}
+
+		/**
+		 * @brief reads the linked program binary
+		 * @return false if the program has no retrievable binary
+		*/
+		bool get_binary(uint32_t& format, std::vector<uint8_t>& data){
+			int length = 0;
+			THIS_INSTANCE_CALL( InstanceErrorType::Info, glGetProgramiv(id(), GL_PROGRAM_BINARY_LENGTH, &length) );
+			if(length <= 0) return false;
+			data.resize(length);
+			THIS_INSTANCE_CALL( InstanceErrorType::Info, glGetProgramBinary(id(), length, &length, &format, data.data()) );
+			data.resize(length);
+			return !g_utils::has_error(&m_last_error) && length > 0;
+		}
+
+		/**
+		 * @brief fills the reflection tables, done by `link()`
+		 * @note needs GL 4.3 or ARB_program_interface_query, without it lookups go through glGetUniformLocation
+		*/
+		void reflect(){
+			#ifndef GL_LATEST_FEATURES
+			if(!GlobalContextConfig.supports(4,3) && !GlobalContextConfig.has_extension("GL_ARB_program_interface_query")) return;
+			#endif
+			m_reflection.reflect(id());
 		}
 
 		bool check_link_status(){
@@ -247,15 +808,72 @@ class ShaderProgramInstance: public Instance {
 			return success;
 		}
 
-		ShaderUniform get_uniform(const std::string& name, UniformType type = UniformType::None){
-			uint32_t location = 0;
-			SAFE_CALL( ShaderProgramUniformLocation, location = glGetUniformLocation(id(),name.c_str()) );
+		/**
+		 * @brief binds the program and launches a compute grid of work groups
+		*/
+		void dispatch(uint32_t groups_x, uint32_t groups_y = 1, uint32_t groups_z = 1){
+			bind();
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Dispatch, glDispatchCompute(groups_x, groups_y, groups_z), Dispatch );
+		}
+
+		/**
+		 * @brief looks a uniform up by name, the type is deduced from the reflection when not given
+		*/
+		ShaderUniform get_uniform(std::string_view name, UniformType type = UniformType::None){
+			if(m_reflection.valid()){
+				ShaderUniform found = uniform(resource_hash(name));
+				if(found.id != ~0u){
+					if(type != UniformType::None) found.type = type;
+					return found;
+				}
+				//array elements ("lights[2]") aren't reflected, their type is the one of the array
+				if(type == UniformType::None){
+					size_t bracket = name.find('[');
+					if(bracket != std::string_view::npos){
+						const UniformInfo* array = m_reflection.uniform(resource_hash(name.substr(0, bracket)));
+						if(array) type = array->type;
+					}
+				}
+			}
+
+			//names the reflection doesn't know are asked once to the driver
+			std::string key(name);
+			auto it = m_locations.find(key);
+			if(it == m_locations.end()){
+				int32_t location = -1;
+				SAFE_CALL( ShaderProgramUniformLocation, location = glGetUniformLocation(id(),key.c_str()) );
+				it = m_locations.emplace(std::move(key), location).first;
+			}
 			return {
 				.type = type,
-				.id = location
+				.id = (uint32_t)it->second,
+				.program = id(),
+				.cache = m_uniform_cache.get()
+			};
+		}
+
+		/**
+		 * @brief O(1) lookup of a reflected uniform: `program.uniform("u_mvp"_uh)`
+		 * @note an unknown name returns a uniform at location -1, which GL silently ignores
+		*/
+		ShaderUniform uniform(uint32_t hash) const {
+			const UniformInfo* info = m_reflection.uniform(hash);
+			return {
+				.type = info ? info->type : UniformType::None,
+				.id = info ? (uint32_t)info->location : ~0u,
+				.program = id(),
+				.cache = m_uniform_cache.get()
 			};
 		}
 
+		inline const ProgramReflection& reflection() const { return m_reflection; }
+
+		/**
+		 * @brief the value cache shared by every uniform returned from `get_uniform`
+		*/
+		inline UniformCache& uniform_cache(){ return *m_uniform_cache; }
+		inline const UniformCache::Stats& uniform_stats() const { return m_uniform_cache->stats(); }
+
 		inline uint32_t last_error() const { return m_last_error; }
 		
 		inline std::string error() const { return s_last_error; }
@@ -263,11 +881,19 @@ class ShaderProgramInstance: public Instance {
 	protected:
 		uint32_t m_last_error = g_utils::no_error;
 		std::string s_last_error;
+		//heap allocated so uniforms keep a stable pointer to it
+		std::unique_ptr<UniformCache> m_uniform_cache = std::make_unique<UniformCache>();
+		ProgramReflection m_reflection;
+		std::unordered_map<std::string, int32_t> m_locations; //driver lookups of `get_uniform`, -1 included
 
 		void t_bind() override {
-			THIS_INSTANCE_CALL( InstanceErrorType::Bind, glUseProgram(id()) );
+			if(GlobalBindingCache.update_program(id())){
+				THIS_INSTANCE_CALL( InstanceErrorType::Bind, glUseProgram(id()) );
+			}
 		}
 		void t_unbind() override {
-			THIS_INSTANCE_CALL( InstanceErrorType::Unbind, glUseProgram(0) );
+			if(GlobalBindingCache.update_program(0)){
+				THIS_INSTANCE_CALL( InstanceErrorType::Unbind, glUseProgram(0) );
+			}
 		}
 };
\ No newline at end of file
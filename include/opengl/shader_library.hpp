@@ -0,0 +1,360 @@
+#pragma once
+#include "program_queue.hpp"
+#include <unordered_set>
+
+/**
+ * @brief named shader sources with `#include` resolution and lazily built, deduplicated program variants
+ *
+ * a variant is a program plus a keyword set and extra defines. stages are hashed after expansion and
+ * normalization (comments and whitespace stripped), identical stages are compiled once and shared, and
+ * variants whose stages all match share the same program.
+ * ```cpp
+ * ShaderLibrary library;
+ * library.add_source("common.glsl", common);
+ * library.add_source("mesh.vert", vert); //may #include "common.glsl"
+ * library.add_source("mesh.frag", frag);
+ * uint32_t mesh = library.add_program("mesh", { { ShaderType::Vertex, "mesh.vert" }, { ShaderType::Fragment, "mesh.frag" } });
+ * uint64_t shadows = library.keyword("SHADOWS");
+ * library.get(mesh, shadows, { "MAX_LIGHTS 8" }).bind();
+ * ```
+*/
+class ShaderLibrary {
+	public:
+		static constexpr size_t max_keywords = 64;
+
+		struct Variant {
+			uint32_t program = 0;
+			uint64_t keywords = 0;
+			std::vector<std::string> defines;
+		};
+
+		struct Stats {
+			uint64_t variants = 0;
+			uint64_t programs_built = 0;
+			uint64_t programs_shared = 0; //variants resolved to an already built program
+			uint64_t stages_compiled = 0;
+			uint64_t stages_shared = 0; //stages reused from another program
+			double build_ms = 0.0; //spent building programs on first use
+		};
+
+		/**
+		 * @param cache optional, lazily built programs are loaded from and stored in it
+		*/
+		ShaderLibrary(ProgramCache* cache = nullptr):m_cache(cache){}
+
+		void add_source(const std::string& name, std::string source){ m_sources[name] = std::move(source); }
+
+		/**
+		 * @brief directory searched for sources and includes not added with `add_source`
+		*/
+		void add_include_path(const std::filesystem::path& path){ m_include_paths.push_back(path); }
+
+		/**
+		 * @return program index used by `get` and `Variant`
+		*/
+		uint32_t add_program(const std::string& name, const std::vector<std::pair<ShaderType, std::string>>& stages){
+			m_programs.push_back({ name, stages });
+			return (uint32_t)m_programs.size() - 1;
+		}
+
+		/**
+		 * @brief bit of a keyword, keywords are passed to the shaders as defines without value
+		*/
+		uint64_t keyword(std::string_view name){
+			for(size_t i = 0; i < m_keywords.size(); i++) if(m_keywords[i] == name) return 1ull << i;
+			if(m_keywords.size() == max_keywords) throw std::length_error("ShaderLibrary: too many keywords");
+			m_keywords.emplace_back(name);
+			return 1ull << (m_keywords.size() - 1);
+		}
+
+		/**
+		 * @brief program of a variant, built on first use, waits for it if it's being pre-warmed
+		 * @throw GLError on include, compile or link errors
+		*/
+		ShaderProgramInstance& get(uint32_t program, uint64_t keywords = 0, const std::vector<std::string>& defines = {}){
+			VariantEntry& entry = variant_entry(program, keywords, defines);
+			if(entry.program) return *entry.program;
+
+			if(entry.pending){
+				if(!entry.pending->done()) m_queue->wait(entry.pending);
+				adopt(entry);
+				return *entry.program;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<Stage> stages = expand_program(program, keywords, defines);
+			uint64_t key = program_key(stages);
+			auto shared = m_built.find(key);
+			if(shared != m_built.end()){
+				m_stats.programs_shared++;
+				entry.program = shared->second;
+				return *entry.program;
+			}
+
+			auto instance = std::make_shared<ShaderProgramInstance>();
+			if(!m_cache || !m_cache->load(*instance, key)){
+				std::vector<std::shared_ptr<ShaderInstance>> shaders;
+				for(auto& stage: stages){
+					shaders.push_back(compile_stage(stage));
+					instance->attach(*shaders.back());
+				}
+				if(m_cache && m_cache->enabled()) instance->set_binary_retrievable();
+				bool linked = instance->link() && instance->check_link_status();
+				for(auto& shader: shaders) instance->detach(*shader);
+				if(!linked) throw GLError("ShaderLibrary", m_programs[program].name + ": " + instance->error());
+				if(m_cache) m_cache->store(*instance, key, elapsed_ms(start));
+			}
+
+			m_stats.programs_built++;
+			m_stats.build_ms += elapsed_ms(start);
+			m_built[key] = instance;
+			entry.program = std::move(instance);
+			return *entry.program;
+		}
+
+		inline ShaderProgramInstance& get(const Variant& variant){ return get(variant.program, variant.keywords, variant.defines); }
+
+		/**
+		 * @brief submits the variants not built yet to `queue`, `get` adopts them once resolved
+		 * @note background builds compile their own stages, stage sharing only applies to `get`
+		*/
+		void prewarm(const std::vector<Variant>& variants, ProgramBuildQueue& queue){
+			m_queue = &queue;
+			for(auto& variant: variants){
+				VariantEntry& entry = variant_entry(variant.program, variant.keywords, variant.defines);
+				if(entry.program || entry.pending) continue;
+
+				std::vector<Stage> stages = expand_program(variant.program, variant.keywords, variant.defines);
+				entry.key = program_key(stages);
+				auto shared = m_built.find(entry.key);
+				if(shared != m_built.end()){
+					m_stats.programs_shared++;
+					entry.program = shared->second;
+					continue;
+				}
+
+				std::vector<ShaderSource> sources;
+				for(auto& stage: stages) sources.push_back({ stage.type, stage.source });
+				entry.pending = queue.submit(sources);
+			}
+		}
+
+		/**
+		 * @brief adopts the pre-warmed variants resolved by the queue, call after `ProgramBuildQueue::poll`
+		 * @return number of variants still building
+		*/
+		size_t update(){
+			size_t pending = 0;
+			for(auto& [key, entry]: m_variants){
+				if(!entry.pending) continue;
+				if(entry.pending->done()){
+					if(entry.pending->ready()) adopt(entry);
+				} else pending++;
+			}
+			return pending;
+		}
+
+		/**
+		 * @brief source with includes resolved and `defines` inserted after `#version`
+		*/
+		std::string expand(const std::string& name, const std::vector<std::string>& defines = {}){
+			std::unordered_set<std::string> included;
+			return shader_with_defines(resolve(name, included), defines);
+		}
+
+		/**
+		 * @brief drops the compiled stages kept for sharing, programs stay valid
+		*/
+		void release_stages(){ m_stages.clear(); }
+
+		inline size_t stage_count() const { return m_stages.size(); }
+		inline size_t program_count() const { return m_built.size(); }
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+		/**
+		 * @brief hash of a source ignoring comments, whitespace and #line directives
+		*/
+		static uint64_t normalized_hash(std::string_view source){
+			uint64_t h = g_utils::hash_bytes(nullptr, 0);
+			//separators are hashed lazily, right before the next kept character
+			bool line_start = true, skip_line = false, pending_space = false, pending_line = false;
+			for(size_t i = 0; i < source.size(); i++){
+				char c = source[i];
+				if(c == '/' && i + 1 < source.size() && source[i + 1] == '/'){
+					while(i + 1 < source.size() && source[i + 1] != '\n') i++;
+					continue;
+				}
+				if(c == '/' && i + 1 < source.size() && source[i + 1] == '*'){
+					size_t end = source.find("*/", i + 2);
+					i = end == std::string_view::npos ? source.size() : end + 1;
+					pending_space = !line_start;
+					continue;
+				}
+				if(c == '\n'){
+					line_start = true;
+					skip_line = pending_space = false;
+					continue;
+				}
+				if(c == ' ' || c == '\t' || c == '\r'){
+					pending_space = !line_start;
+					continue;
+				}
+				if(line_start) skip_line = source.substr(i).starts_with("#line");
+				if(!skip_line){
+					char separator = line_start ? '\n' : ' ';
+					if((line_start && pending_line) || pending_space) h = g_utils::hash_bytes(&separator, 1, h);
+					h = g_utils::hash_bytes(&c, 1, h);
+					pending_line = true;
+				}
+				line_start = pending_space = false;
+			}
+			return h;
+		}
+
+	private:
+		struct ProgramDesc {
+			std::string name;
+			std::vector<std::pair<ShaderType, std::string>> stages;
+		};
+
+		struct Stage {
+			ShaderType type;
+			std::string source;
+			uint64_t hash;
+		};
+
+		struct VariantEntry {
+			uint64_t key = 0;
+			std::shared_ptr<ShaderProgramInstance> program;
+			ProgramHandle pending;
+		};
+
+		ProgramCache* m_cache = nullptr;
+		ProgramBuildQueue* m_queue = nullptr;
+		std::unordered_map<std::string, std::string> m_sources;
+		std::vector<std::filesystem::path> m_include_paths;
+		std::vector<ProgramDesc> m_programs;
+		std::vector<std::string> m_keywords;
+
+		std::unordered_map<uint64_t, VariantEntry> m_variants;
+		std::unordered_map<uint64_t, std::shared_ptr<ShaderProgramInstance>> m_built; //by program key
+		std::unordered_map<uint64_t, std::shared_ptr<ShaderInstance>> m_stages; //by stage hash
+		Stats m_stats;
+
+		VariantEntry& variant_entry(uint32_t program, uint64_t keywords, const std::vector<std::string>& defines){
+			if(program >= m_programs.size()) throw std::out_of_range("ShaderLibrary: unknown program");
+			uint64_t h = g_utils::hash_bytes(&program, sizeof(program));
+			h = g_utils::hash_bytes(&keywords, sizeof(keywords), h);
+			for(auto& define: defines) h = g_utils::hash_bytes(define.c_str(), define.size() + 1, h);
+
+			auto [it, inserted] = m_variants.try_emplace(h);
+			if(inserted) m_stats.variants++;
+			return it->second;
+		}
+
+		std::vector<Stage> expand_program(uint32_t program, uint64_t keywords, const std::vector<std::string>& defines){
+			std::vector<std::string> all;
+			for(size_t i = 0; i < m_keywords.size(); i++) if(keywords & (1ull << i)) all.push_back(m_keywords[i]);
+			all.insert(all.end(), defines.begin(), defines.end());
+
+			std::vector<Stage> stages;
+			for(auto& [type, name]: m_programs[program].stages){
+				std::string source = expand(name, all);
+				uint64_t hash = g_utils::hash_bytes(&type, sizeof(type), normalized_hash(source));
+				stages.push_back({ type, std::move(source), hash });
+			}
+			return stages;
+		}
+
+		static uint64_t program_key(const std::vector<Stage>& stages){
+			uint64_t h = g_utils::hash_bytes(nullptr, 0);
+			for(auto& stage: stages) h = g_utils::hash_bytes(&stage.hash, sizeof(stage.hash), h);
+			return h;
+		}
+
+		std::shared_ptr<ShaderInstance> compile_stage(const Stage& stage){
+			auto found = m_stages.find(stage.hash);
+			if(found != m_stages.end()){
+				m_stats.stages_shared++;
+				return found->second;
+			}
+
+			auto shader = std::make_shared<ShaderInstance>(stage.type);
+			if(!(*shader << stage.source) || !shader->compile() || !shader->check_compile_status()){
+				throw GLError("ShaderLibrary", shader->error());
+			}
+			m_stats.stages_compiled++;
+			m_stages[stage.hash] = shader;
+			return shader;
+		}
+
+		void adopt(VariantEntry& entry){
+			ProgramHandle handle = std::move(entry.pending);
+			if(handle->failed()) throw GLError("ShaderLibrary", handle->error());
+			auto shared = m_built.find(entry.key);
+			if(shared != m_built.end()){
+				m_stats.programs_shared++;
+				entry.program = shared->second;
+				return;
+			}
+			//aliases the build so the handle keeps owning the program
+			entry.program = std::shared_ptr<ShaderProgramInstance>(handle, &handle->program());
+			m_built[entry.key] = entry.program;
+			m_stats.programs_built++;
+		}
+
+		const std::string& load(const std::string& name){
+			auto found = m_sources.find(name);
+			if(found != m_sources.end()) return found->second;
+
+			for(auto& path: m_include_paths){
+				std::ifstream file(path / name, std::ios::binary);
+				if(!file.is_open()) continue;
+				std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+				return m_sources[name] = std::move(source);
+			}
+			throw GLError("ShaderLibrary", "source not found: " + name);
+		}
+
+		/**
+		 * @brief inlines `#include "file"` lines, every file is included once per expansion so cycles are harmless
+		*/
+		std::string resolve(const std::string& name, std::unordered_set<std::string>& included){
+			included.insert(name);
+
+			const std::string& source = load(name);
+			std::string result;
+			result.reserve(source.size());
+			uint32_t line = 1;
+			for(size_t start = 0; start < source.size(); line++){
+				size_t end = source.find('\n', start);
+				if(end == std::string::npos) end = source.size();
+				std::string_view text(source.data() + start, end - start);
+				start = end + 1;
+
+				size_t first = text.find_first_not_of(" \t");
+				if(first != std::string_view::npos && text.substr(first).starts_with("#include")){
+					size_t open = text.find_first_of("\"<", first + 8);
+					size_t close = open == std::string_view::npos ? open : text.find_first_of("\">", open + 1);
+					if(close == std::string_view::npos) throw GLError("ShaderLibrary", name + ":" + std::to_string(line) + ": malformed #include");
+					std::string include(text.substr(open + 1, close - open - 1));
+					if(!included.count(include)){
+						result += "#line 1\n";
+						result += resolve(include, included);
+						if(!result.empty() && result.back() != '\n') result += '\n';
+					}
+					result += "#line " + std::to_string(line + 1) + "\n";
+					continue;
+				}
+				result.append(text);
+				result += '\n';
+			}
+
+			return result;
+		}
+
+		static double elapsed_ms(std::chrono::steady_clock::time_point start){
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+};
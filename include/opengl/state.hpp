@@ -0,0 +1,378 @@
+#pragma once
+#include "core.hpp"
+#include <array>
+
+/**
+ * @brief counters of a single binding category
+*/
+struct BindingStats {
+	uint64_t requested = 0;
+	uint64_t issued = 0;
+
+	inline uint64_t elided() const { return requested - issued; }
+
+	BindingStats& operator+=(const BindingStats& other){
+		requested += other.requested;
+		issued += other.issued;
+		return *this;
+	}
+};
+
+/**
+ * @brief shadow copy of the GL binding points of the current context
+ *
+ * every `update_*` function records the wanted binding and returns true only
+ * when it differs from the last known one, so the caller must issue the driver call.
+ * `bind_*` functions do both things at once for code that only holds raw object names.
+ *
+ * the cache can't see GL calls made outside of it, so `invalidate()` must be called
+ * whenever foreign code (other libraries, raw gl calls, context switches) touches the bindings
+*/
+class BindingCache {
+	public:
+		static constexpr uint32_t unknown = ~0u;
+		static constexpr uint8_t unknown_unit = 0xff;
+
+		BindingCache(){ invalidate(); }
+
+		/**
+		 * @brief forgets every known binding, next binds will always reach the driver
+		*/
+		void invalidate(){
+			m_buffers.fill(unknown);
+			m_vertex_array = unknown;
+			m_program = unknown;
+			m_active_unit = unknown_unit;
+			m_draw_framebuffer = unknown;
+			m_read_framebuffer = unknown;
+			for(auto& unit: m_units) unit.fill(unknown);
+			std::fill(m_samplers.begin(), m_samplers.end(), unknown);
+		}
+
+		inline void invalidate_buffer(uint32_t target){
+			int slot = buffer_slot(target);
+			if(slot >= 0) m_buffers[slot] = unknown;
+		}
+
+		//records a binding made by a call that isn't a plain bind (indexed binds for example)
+		inline void record_buffer(uint32_t target, uint32_t id){
+			int slot = buffer_slot(target);
+			if(slot >= 0) m_buffers[slot] = id;
+		}
+
+		inline void invalidate_texture_unit(uint8_t unit){
+			if(unit < m_units.size()) m_units[unit].fill(unknown);
+			if(unit < m_samplers.size()) m_samplers[unit] = unknown;
+		}
+
+		//disabling the cache makes every update report a change (useful to compare results)
+		inline void set_enabled(bool enabled){ b_enabled = enabled; if(!enabled) invalidate(); }
+		inline bool enabled() const { return b_enabled; }
+
+		bool update_buffer(uint32_t target, uint32_t id){
+			int slot = buffer_slot(target);
+			if(slot < 0) return issue(m_stats.buffers);
+			return update(m_buffers[slot], id, m_stats.buffers);
+		}
+
+		bool update_vertex_array(uint32_t id){
+			if(!update(m_vertex_array, id, m_stats.vertex_arrays)) return false;
+			//element array binding is part of the vertex array state
+			m_buffers[buffer_slot(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+			return true;
+		}
+
+		bool update_program(uint32_t id){
+			return update(m_program, id, m_stats.programs);
+		}
+
+		bool update_active_texture(uint8_t unit){
+			m_stats.texture_units.requested++;
+			if(b_enabled && m_active_unit == unit) return false;
+			m_active_unit = unit;
+			m_stats.texture_units.issued++;
+			return true;
+		}
+
+		/**
+		 * @brief records a texture binding on the currently active unit
+		*/
+		bool update_texture(uint32_t target, uint32_t id){
+			int slot = texture_slot(target);
+			if(slot < 0 || m_active_unit == unknown_unit) return issue(m_stats.textures);
+			return update(unit_bindings(m_active_unit)[slot], id, m_stats.textures);
+		}
+
+		/**
+		 * @brief records a framebuffer binding, GL_FRAMEBUFFER sets both the draw and the read binding
+		*/
+		bool update_framebuffer(uint32_t target, uint32_t id){
+			if(target == GL_READ_FRAMEBUFFER) return update(m_read_framebuffer, id, m_stats.framebuffers);
+			if(target == GL_DRAW_FRAMEBUFFER) return update(m_draw_framebuffer, id, m_stats.framebuffers);
+			m_stats.framebuffers.requested++;
+			if(b_enabled && m_draw_framebuffer == id && m_read_framebuffer == id) return false;
+			m_draw_framebuffer = m_read_framebuffer = id;
+			m_stats.framebuffers.issued++;
+			return true;
+		}
+
+		/**
+		 * @brief records a sampler binding, sampler units don't depend on the active texture unit
+		*/
+		bool update_sampler(uint8_t unit, uint32_t id){
+			return update(unit_sampler(unit), id, m_stats.samplers);
+		}
+
+		//raw binding helpers, return true when the driver call was issued
+		bool bind_buffer(uint32_t target, uint32_t id){
+			if(!update_buffer(target, id)) return false;
+			SAFE_CALL( CacheBufferBind, glBindBuffer(target, id) );
+			return true;
+		}
+
+		bool bind_vertex_array(uint32_t id){
+			if(!update_vertex_array(id)) return false;
+			SAFE_CALL( CacheVertexArrayBind, glBindVertexArray(id) );
+			return true;
+		}
+
+		bool use_program(uint32_t id){
+			if(!update_program(id)) return false;
+			SAFE_CALL( CacheUseProgram, glUseProgram(id) );
+			return true;
+		}
+
+		bool active_texture(uint8_t unit){
+			if(!update_active_texture(unit)) return false;
+			SAFE_CALL( CacheActiveTexture, glActiveTexture(GL_TEXTURE0 + unit) );
+			return true;
+		}
+
+		bool bind_texture(uint8_t unit, uint32_t target, uint32_t id){
+			//avoid switching the active unit when the binding is already there
+			int slot = texture_slot(target);
+			if(b_enabled && slot >= 0 && unit_bindings(unit)[slot] == id){
+				m_stats.textures.requested++;
+				return false;
+			}
+			active_texture(unit);
+			if(!update_texture(target, id)) return false;
+			SAFE_CALL( CacheTextureBind, glBindTexture(target, id) );
+			return true;
+		}
+
+		/**
+		 * @brief binds `count` textures from unit `first`, each to its own target, without touching the active unit.
+		 * only the range that changed reaches the driver, in a single glBindTextures call when multi bind is available
+		 * @return driver calls issued
+		*/
+		size_t bind_textures(uint8_t first, size_t count, const uint32_t* targets, const uint32_t* ids){
+			size_t begin = count, end = 0;
+			for(size_t i = 0; i < count; i++){
+				int slot = texture_slot(targets[i]);
+				bool changed = slot < 0 ? issue(m_stats.textures) : update(unit_bindings((uint8_t)(first + i))[slot], ids[i], m_stats.textures);
+				if(changed){
+					begin = std::min(begin, i);
+					end = i + 1;
+				}
+			}
+			if(begin >= end) return 0;
+			if(GlobalContextConfig.supports(4,4) || GlobalContextConfig.has_extension("GL_ARB_multi_bind")){
+				SAFE_CALL( CacheTexturesBind, glBindTextures(first + begin, end - begin, ids + begin) );
+				//a zero name unbinds every target of the unit
+				for(size_t i = begin; i < end; i++) if(ids[i] == 0) unit_bindings((uint8_t)(first + i)).fill(0);
+				return 1;
+			}
+			size_t calls = 0;
+			for(size_t i = begin; i < end; i++){
+				calls += active_texture((uint8_t)(first + i));
+				SAFE_CALL( CacheTextureBind, glBindTexture(targets[i], ids[i]) );
+				calls++;
+			}
+			return calls;
+		}
+
+		bool bind_framebuffer(uint32_t target, uint32_t id){
+			if(!update_framebuffer(target, id)) return false;
+			SAFE_CALL( CacheFramebufferBind, glBindFramebuffer(target, id) );
+			return true;
+		}
+
+		bool bind_sampler(uint8_t unit, uint32_t id){
+			if(!update_sampler(unit, id)) return false;
+			SAFE_CALL( CacheSamplerBind, glBindSampler(unit, id) );
+			return true;
+		}
+
+		/**
+		 * @brief binds `count` samplers from unit `first`, only the range that changed reaches the driver,
+		 * in a single glBindSamplers call when multi bind is available
+		 * @return driver calls issued
+		*/
+		size_t bind_samplers(uint8_t first, size_t count, const uint32_t* ids){
+			size_t begin = count, end = 0;
+			for(size_t i = 0; i < count; i++){
+				if(update_sampler((uint8_t)(first + i), ids[i])){
+					begin = std::min(begin, i);
+					end = i + 1;
+				}
+			}
+			if(begin >= end) return 0;
+			if(GlobalContextConfig.supports(4,4) || GlobalContextConfig.has_extension("GL_ARB_multi_bind")){
+				SAFE_CALL( CacheSamplersBind, glBindSamplers(first + begin, end - begin, ids + begin) );
+				return 1;
+			}
+			for(size_t i = begin; i < end; i++) SAFE_CALL( CacheSamplerBind, glBindSampler(first + i, ids[i]) );
+			return end - begin;
+		}
+
+		//deleted objects are unbound by the driver, so the bindings revert to zero
+		void forget_buffer(uint32_t id){
+			if(id == 0) return;
+			for(auto& binding: m_buffers) if(binding == id) binding = 0;
+		}
+
+		void forget_vertex_array(uint32_t id){
+			if(id == 0 || m_vertex_array != id) return;
+			m_vertex_array = 0;
+			m_buffers[buffer_slot(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+		}
+
+		void forget_program(uint32_t id){
+			//a program in use is only flagged for deletion, its name stays current
+			if(id != 0 && m_program == id) m_program = unknown;
+		}
+
+		void forget_texture(uint32_t id){
+			if(id == 0) return;
+			for(auto& unit: m_units){
+				for(auto& binding: unit) if(binding == id) binding = 0;
+			}
+		}
+
+		void forget_framebuffer(uint32_t id){
+			if(id == 0) return;
+			if(m_draw_framebuffer == id) m_draw_framebuffer = 0;
+			if(m_read_framebuffer == id) m_read_framebuffer = 0;
+		}
+
+		void forget_sampler(uint32_t id){
+			if(id == 0) return;
+			for(auto& binding: m_samplers) if(binding == id) binding = 0;
+		}
+
+		inline uint32_t buffer(uint32_t target) const {
+			int slot = buffer_slot(target);
+			return slot < 0 ? unknown : m_buffers[slot];
+		}
+		inline uint32_t vertex_array() const { return m_vertex_array; }
+		inline uint32_t program() const { return m_program; }
+		inline uint8_t active_unit() const { return m_active_unit; }
+		inline uint32_t draw_framebuffer() const { return m_draw_framebuffer; }
+		inline uint32_t read_framebuffer() const { return m_read_framebuffer; }
+		inline uint32_t sampler(uint8_t unit) const { return unit < m_samplers.size() ? m_samplers[unit] : unknown; }
+
+		struct Stats {
+			BindingStats buffers;
+			BindingStats vertex_arrays;
+			BindingStats programs;
+			BindingStats textures;
+			BindingStats texture_units;
+			BindingStats samplers;
+			BindingStats framebuffers;
+
+			BindingStats total() const {
+				BindingStats sum;
+				sum += buffers; sum += vertex_arrays; sum += programs; sum += textures; sum += texture_units; sum += samplers; sum += framebuffers;
+				return sum;
+			}
+		};
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = Stats{}; }
+
+		static int buffer_slot(uint32_t target){
+			switch(target){
+				case GL_ARRAY_BUFFER: return 0;
+				case GL_ELEMENT_ARRAY_BUFFER: return 1;
+				case GL_UNIFORM_BUFFER: return 2;
+				case GL_SHADER_STORAGE_BUFFER: return 3;
+				case GL_DRAW_INDIRECT_BUFFER: return 4;
+				case GL_DISPATCH_INDIRECT_BUFFER: return 5;
+				case GL_PARAMETER_BUFFER: return 6;
+				case GL_PIXEL_PACK_BUFFER: return 7;
+				case GL_PIXEL_UNPACK_BUFFER: return 8;
+				case GL_COPY_READ_BUFFER: return 9;
+				case GL_COPY_WRITE_BUFFER: return 10;
+				case GL_TEXTURE_BUFFER: return 11;
+				case GL_ATOMIC_COUNTER_BUFFER: return 12;
+				case GL_TRANSFORM_FEEDBACK_BUFFER: return 13;
+				case GL_QUERY_BUFFER: return 14;
+				default: return -1;
+			}
+		}
+
+		static int texture_slot(uint32_t target){
+			switch(target){
+				case GL_TEXTURE_1D: return 0;
+				case GL_TEXTURE_2D: return 1;
+				case GL_TEXTURE_3D: return 2;
+				case GL_TEXTURE_1D_ARRAY: return 3;
+				case GL_TEXTURE_2D_ARRAY: return 4;
+				case GL_TEXTURE_CUBE_MAP: return 5;
+				case GL_TEXTURE_CUBE_MAP_ARRAY: return 6;
+				case GL_TEXTURE_RECTANGLE: return 7;
+				case GL_TEXTURE_BUFFER: return 8;
+				case GL_TEXTURE_2D_MULTISAMPLE: return 9;
+				case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return 10;
+				default: return -1;
+			}
+		}
+
+	private:
+		static constexpr size_t buffer_slots = 15;
+		static constexpr size_t texture_slots = 11;
+		using UnitBindings = std::array<uint32_t, texture_slots>;
+
+		std::array<uint32_t, buffer_slots> m_buffers;
+		uint32_t m_vertex_array = unknown;
+		uint32_t m_program = unknown;
+		uint8_t m_active_unit = unknown_unit;
+		uint32_t m_draw_framebuffer = unknown;
+		uint32_t m_read_framebuffer = unknown;
+		std::vector<UnitBindings> m_units;
+		std::vector<uint32_t> m_samplers;
+		bool b_enabled = true;
+		Stats m_stats;
+
+		UnitBindings& unit_bindings(uint8_t unit){
+			if(unit >= m_units.size()){
+				size_t old_size = m_units.size();
+				m_units.resize((size_t)unit + 1);
+				for(size_t i = old_size; i < m_units.size(); i++) m_units[i].fill(unknown);
+			}
+			return m_units[unit];
+		}
+
+		uint32_t& unit_sampler(uint8_t unit){
+			if(unit >= m_samplers.size()) m_samplers.resize((size_t)unit + 1, unknown);
+			return m_samplers[unit];
+		}
+
+		inline bool issue(BindingStats& stats){
+			stats.requested++;
+			stats.issued++;
+			return true;
+		}
+
+		inline bool update(uint32_t& binding, uint32_t id, BindingStats& stats){
+			stats.requested++;
+			if(b_enabled && binding == id) return false;
+			binding = id;
+			stats.issued++;
+			return true;
+		}
+};
+
+//GL contexts are current per thread, so is the cache (call invalidate() after switching contexts)
+inline thread_local BindingCache GlobalBindingCache;
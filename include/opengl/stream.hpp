@@ -0,0 +1,213 @@
+#pragma once
+#include "buffer.hpp"
+#include "sync.hpp"
+#include <deque>
+#include <chrono>
+
+/**
+ * @brief a range handed out by StreamingRingBuffer, `data` points to persistently mapped memory
+*/
+struct StreamAllocation {
+	uint32_t buffer = 0;
+	size_t offset = 0;
+	size_t size = 0;
+	void* data = nullptr;
+
+	inline bool valid() const { return data != nullptr; }
+};
+
+/**
+ * @brief persistently mapped buffer used as a ring of per frame data
+ *
+ * allocations are bumped from the head of the ring, `end_frame()` fences everything allocated
+ * during the frame and the space is only reused once that fence signals.
+ * the CPU only blocks when the ring is full or when more than `frames_in_flight` frames are pending
+*/
+class StreamingRingBuffer {
+	public:
+		struct Stats {
+			uint64_t allocations = 0;
+			uint64_t bytes = 0;
+			uint64_t wasted_bytes = 0; //alignment padding and ring wrap tails
+			uint64_t waits = 0;
+			double wait_ms = 0.0;
+		};
+
+		/**
+		 * @param capacity size in bytes of the whole ring, should hold `frames_in_flight` frames of data
+		 * @param coherent when false writes must be flushed (`write` does it, raw allocations use `flush`)
+		*/
+		StreamingRingBuffer(BufferTarget target, size_t capacity, uint32_t frames_in_flight = 3, bool coherent = true)
+			:m_buffer(BufferDescriptor{
+				.target = target,
+				.usage = BufferUsage::StreamDraw,
+				.access = BufferAccess::WriteOnly
+			}),m_capacity(capacity),m_frames_in_flight(frames_in_flight),b_coherent(coherent){
+			if(capacity == 0) throw std::invalid_argument("StreamingRingBuffer: capacity must not be zero");
+
+			BufferStorageFlags storage = BufferStorageFlags::Write | BufferStorageFlags::Persistent;
+			BufferMapFlags map = BufferMapFlags::Write | BufferMapFlags::Persistent;
+			if(coherent){
+				storage = storage | BufferStorageFlags::Coherent;
+				map = map | BufferMapFlags::Coherent;
+			} else {
+				map = map | BufferMapFlags::FlushExplicit;
+			}
+			m_buffer.immutable_storage(capacity, storage);
+			p_data = (uint8_t*)m_buffer.map_range(0, capacity, map);
+			if(!p_data) throw GLError("StreamingRingBuffer", "could not map the buffer storage");
+		}
+
+		~StreamingRingBuffer(){
+			//pending fences are dropped with the frames, the storage is released with the buffer
+			m_frames.clear();
+			if(p_data && m_buffer.is_valid()) m_buffer.unmap_memory();
+		}
+
+		/**
+		 * @brief reserves `size` bytes aligned to `alignment`, waiting for the GPU if the ring is full
+		 * @throws std::length_error when the request can't fit even with every frame retired
+		*/
+		StreamAllocation allocate(size_t size, size_t alignment = 1){
+			StreamAllocation allocation = try_allocate(size, alignment);
+			while(!allocation.valid()){
+				if(m_frames.empty()) throw std::length_error("StreamingRingBuffer: allocation is bigger than the free space of the ring");
+				retire_oldest(true);
+				allocation = try_allocate(size, alignment);
+			}
+			return allocation;
+		}
+
+		/**
+		 * @brief same as `allocate` but never blocks, returns an invalid allocation instead
+		*/
+		StreamAllocation try_allocate(size_t size, size_t alignment = 1){
+			if(size == 0 || size > m_capacity) return {};
+			if(alignment == 0) alignment = 1;
+
+			size_t offset = 0, needed = 0;
+			if(!reserve(size, alignment, offset, needed)){
+				//only poll fences when the space is actually needed
+				retire_signaled();
+				if(!reserve(size, alignment, offset, needed)) return {};
+			}
+
+			m_stats.wasted_bytes += needed - size;
+			m_head = (offset + size == m_capacity) ? 0 : offset + size;
+			m_used += needed;
+			m_frame_bytes += needed;
+			m_stats.allocations++;
+			m_stats.bytes += size;
+
+			return {
+				.buffer = m_buffer.id(),
+				.offset = offset,
+				.size = size,
+				.data = p_data + offset
+			};
+		}
+
+		StreamAllocation write(const void* data, size_t size, size_t alignment = 1){
+			StreamAllocation allocation = allocate(size, alignment);
+			memcpy(allocation.data, data, size);
+			flush(allocation);
+			return allocation;
+		}
+
+		template<typename T, typename... Args>
+		StreamAllocation write(const std::vector<T,Args...>& container, size_t alignment = alignof(T)){
+			return write(container.data(), sizeof(T)*container.size(), alignment);
+		}
+
+		/**
+		 * @brief makes CPU writes visible, only does something for non coherent rings
+		*/
+		void flush(const StreamAllocation& allocation){
+			if(!b_coherent) m_buffer.flush_range(allocation.offset, allocation.size);
+		}
+
+		/**
+		 * @brief binds an allocation to an indexed target (uniform, shader storage ...)
+		*/
+		void bind_range(const StreamAllocation& allocation, uint32_t index){
+			bind_range(allocation, (uint32_t)m_buffer.descriptor().target, index);
+		}
+
+		void bind_range(const StreamAllocation& allocation, uint32_t target, uint32_t index){
+			SAFE_CALL( StreamBindRange, glBindBufferRange(target, index, allocation.buffer, allocation.offset, allocation.size) );
+			//indexed binds also change the generic binding point
+			GlobalBindingCache.record_buffer(target, allocation.buffer);
+		}
+
+		/**
+		 * @brief fences the frame data, waits for the oldest frame if too many are in flight
+		*/
+		void end_frame(){
+			if(m_frame_bytes == 0) return;
+			Frame frame;
+			frame.bytes = m_frame_bytes;
+			frame.fence.insert();
+			m_frames.push_back(std::move(frame));
+			m_frame_bytes = 0;
+
+			while(m_frames.size() > m_frames_in_flight) retire_oldest(true);
+		}
+
+		inline BufferInstance& buffer() { return m_buffer; }
+		inline size_t capacity() const { return m_capacity; }
+		inline size_t used() const { return m_used; }
+		inline size_t frames_pending() const { return m_frames.size(); }
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = Stats{}; }
+
+	private:
+		struct Frame {
+			Fence fence;
+			size_t bytes = 0;
+		};
+
+		BufferInstance m_buffer;
+		uint8_t* p_data = nullptr;
+		size_t m_capacity = 0;
+		size_t m_head = 0;
+		size_t m_used = 0; //bytes between the oldest pending frame and the head
+		size_t m_frame_bytes = 0;
+		uint32_t m_frames_in_flight = 3;
+		bool b_coherent = true;
+		std::deque<Frame> m_frames;
+		Stats m_stats;
+
+		static inline size_t align_up(size_t value, size_t alignment){
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		bool reserve(size_t size, size_t alignment, size_t& offset, size_t& needed){
+			//nothing is live, restart at the front rather than wrapping around a stale head
+			if(m_used == 0) m_head = 0;
+			offset = align_up(m_head, alignment);
+			if(offset + size <= m_capacity){
+				needed = offset - m_head + size;
+			} else {
+				//wrap around, the tail of the ring is wasted until this frame retires
+				offset = 0;
+				needed = m_capacity - m_head + size;
+			}
+			return m_used + needed <= m_capacity;
+		}
+
+		void retire_signaled(){
+			while(!m_frames.empty() && m_frames.front().fence.signaled()) retire_oldest(false);
+		}
+
+		void retire_oldest(bool wait){
+			Frame& frame = m_frames.front();
+			if(wait && !frame.fence.signaled()){
+				auto start = std::chrono::steady_clock::now();
+				frame.fence.wait();
+				m_stats.waits++;
+				m_stats.wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+			m_used -= frame.bytes;
+			m_frames.pop_front();
+		}
+};
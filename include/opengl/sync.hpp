@@ -0,0 +1,97 @@
+#pragma once
+#include "core.hpp"
+
+/**
+ * @brief owning wrapper of a GL fence sync object
+*/
+class Fence {
+	public:
+		Fence() = default;
+		Fence(const Fence& other) = delete;
+		Fence(Fence&& other):m_sync(other.m_sync){ other.m_sync = nullptr; }
+
+		Fence& operator=(Fence&& other){
+			if(this != &other){
+				reset();
+				m_sync = other.m_sync;
+				other.m_sync = nullptr;
+			}
+			return *this;
+		}
+
+		~Fence(){ reset(); }
+
+		/**
+		 * @brief places a new fence after every command issued so far
+		*/
+		void insert(){
+			reset();
+			SAFE_CALL( FenceSync, m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) );
+		}
+
+		/**
+		 * @brief non blocking check, flushes the command stream so the fence can eventually signal
+		 * @note an empty fence is always signaled
+		*/
+		bool signaled(){
+			if(!m_sync) return true;
+			uint32_t status = glClientWaitSync(m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if(status == GL_WAIT_FAILED) throw GLError("FenceSignaled", "glClientWaitSync failed");
+			return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+		}
+
+		/**
+		 * @brief blocks until the fence is signaled or the timeout expires
+		 * @return true if signaled
+		*/
+		bool wait(uint64_t timeout_ns = GL_TIMEOUT_IGNORED){
+			if(!m_sync) return true;
+			uint32_t status = glClientWaitSync(m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+			if(status == GL_WAIT_FAILED) throw GLError("FenceWait", "glClientWaitSync failed");
+			return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+		}
+
+		void reset(){
+			if(m_sync){
+				glDeleteSync(m_sync);
+				m_sync = nullptr;
+			}
+		}
+
+		inline bool valid() const { return m_sync != nullptr; }
+		inline GLsync handle() const { return m_sync; }
+
+	private:
+		GLsync m_sync = nullptr;
+};
+
+enum class MemoryBarrier: uint32_t {
+	None = 0,
+	VertexAttribArray = GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT,
+	ElementArray = GL_ELEMENT_ARRAY_BARRIER_BIT,
+	Uniform = GL_UNIFORM_BARRIER_BIT,
+	TextureFetch = GL_TEXTURE_FETCH_BARRIER_BIT,
+	ShaderImageAccess = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+	Command = GL_COMMAND_BARRIER_BIT,
+	PixelBuffer = GL_PIXEL_BUFFER_BARRIER_BIT,
+	TextureUpdate = GL_TEXTURE_UPDATE_BARRIER_BIT,
+	BufferUpdate = GL_BUFFER_UPDATE_BARRIER_BIT,
+	Framebuffer = GL_FRAMEBUFFER_BARRIER_BIT,
+	TransformFeedback = GL_TRANSFORM_FEEDBACK_BARRIER_BIT,
+	AtomicCounter = GL_ATOMIC_COUNTER_BARRIER_BIT,
+	ShaderStorage = GL_SHADER_STORAGE_BARRIER_BIT,
+	ClientMappedBuffer = GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT,
+	QueryBuffer = GL_QUERY_BUFFER_BARRIER_BIT,
+	All = GL_ALL_BARRIER_BITS
+};
+
+inline MemoryBarrier operator|(MemoryBarrier a, MemoryBarrier b){ return (MemoryBarrier)((uint32_t)a | (uint32_t)b); }
+inline MemoryBarrier operator&(MemoryBarrier a, MemoryBarrier b){ return (MemoryBarrier)((uint32_t)a & (uint32_t)b); }
+
+/**
+ * @brief orders incoherent shader writes (storage buffers, images, atomics) before the listed uses
+*/
+inline void memory_barrier(MemoryBarrier barriers){
+	if(barriers == MemoryBarrier::None) return;
+	SAFE_CALL( MemoryBarrier, glMemoryBarrier((uint32_t)barriers) );
+}
@@ -1,5 +1,5 @@
 #pragma once
-#include "core.hpp"
+#include "sampler.hpp"
 
 enum class TextureType: uint8_t {
 	None = 0,
@@ -28,6 +28,142 @@ struct TextureSpec
 	bool generate_mipmaps = false;
 };
 
+/**
+ * @brief a box inside one level of a texture, `y` is the layer of 1D arrays, `z` the layer of 2D arrays,
+ * the face of cube maps (+X, -X, +Y, -Y, +Z, -Z) and `layer * 6 + face` of cube map arrays
+*/
+struct TextureRegion
+{
+	int level = 0;
+	size_t x = 0, y = 0, z = 0;
+	size_t width = 1, height = 1, depth = 1;
+	uint32_t format = GL_RGB;
+	uint32_t datatype = GL_UNSIGNED_BYTE;
+};
+
+/**
+ * @brief bytes of one pixel of client data, 0 for unknown combinations
+*/
+inline size_t pixel_size(uint32_t format, uint32_t datatype){
+	switch(datatype){
+		case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+			return 1;
+		case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV:
+		case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+		case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+			return 2;
+		case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+		case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+		case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+			return 4;
+		case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+			return 8;
+		default: break;
+	}
+
+	size_t component = 0;
+	switch(datatype){
+		case GL_UNSIGNED_BYTE: case GL_BYTE: component = 1; break;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: component = 2; break;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: component = 4; break;
+		default: return 0;
+	}
+	switch(format){
+		case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER: case GL_GREEN_INTEGER: case GL_BLUE_INTEGER:
+		case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+			return component;
+		case GL_RG: case GL_RG_INTEGER: return component * 2;
+		case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER: return component * 3;
+		case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER: return component * 4;
+		default: return 0;
+	}
+}
+
+/**
+ * @brief bytes of one texel of an uncompressed internal format, 0 for unknown and compressed formats
+ * @note unsized formats are counted at 8 bits per component, drivers are free to store them otherwise
+*/
+inline size_t internal_format_size(uint32_t internal_format){
+	switch(internal_format){
+		case GL_R8: case GL_R8_SNORM: case GL_R8I: case GL_R8UI: case GL_RED: case GL_STENCIL_INDEX8: case GL_R3_G3_B2:
+			return 1;
+		case GL_R16: case GL_R16_SNORM: case GL_R16F: case GL_R16I: case GL_R16UI:
+		case GL_RG8: case GL_RG8_SNORM: case GL_RG8I: case GL_RG8UI: case GL_RG:
+		case GL_RGB565: case GL_RGB5_A1: case GL_RGBA4: case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGB8: case GL_RGB8_SNORM: case GL_SRGB8: case GL_RGB8I: case GL_RGB8UI: case GL_RGB:
+			return 3;
+		case GL_R32F: case GL_R32I: case GL_R32UI:
+		case GL_RG16: case GL_RG16_SNORM: case GL_RG16F: case GL_RG16I: case GL_RG16UI:
+		case GL_RGBA8: case GL_RGBA8_SNORM: case GL_SRGB8_ALPHA8: case GL_RGBA8I: case GL_RGBA8UI: case GL_RGBA:
+		case GL_RGB10_A2: case GL_RGB10_A2UI: case GL_R11F_G11F_B10F: case GL_RGB9_E5:
+		case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8: case GL_DEPTH_COMPONENT:
+			return 4;
+		case GL_RGB16: case GL_RGB16_SNORM: case GL_RGB16F: case GL_RGB16I: case GL_RGB16UI:
+			return 6;
+		case GL_RG32F: case GL_RG32I: case GL_RG32UI:
+		case GL_RGBA16: case GL_RGBA16_SNORM: case GL_RGBA16F: case GL_RGBA16I: case GL_RGBA16UI:
+		case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGB32F: case GL_RGB32I: case GL_RGB32UI:
+			return 12;
+		case GL_RGBA32F: case GL_RGBA32I: case GL_RGBA32UI:
+			return 16;
+		default: return 0;
+	}
+}
+
+/**
+ * @brief levels of a full mip chain
+*/
+inline uint32_t mip_levels(size_t width, size_t height = 1, size_t depth = 1){
+	size_t size = std::max(width, std::max(height, depth));
+	uint32_t levels = 1;
+	while(size > 1){
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+struct TextureBlock {
+	uint32_t width = 1, height = 1;
+	size_t bytes = 0; //0 for uncompressed formats
+};
+
+/**
+ * @brief block footprint of a compressed internal format (S3TC, RGTC, BPTC, ETC2/EAC, ASTC 4x4)
+*/
+inline TextureBlock compressed_block(uint32_t internal_format){
+	switch(internal_format){
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1: case GL_COMPRESSED_SIGNED_RED_RGTC1:
+		case GL_COMPRESSED_RGB8_ETC2: case GL_COMPRESSED_SRGB8_ETC2:
+		case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2: case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case GL_COMPRESSED_R11_EAC: case GL_COMPRESSED_SIGNED_R11_EAC:
+			return { 4, 4, 8 };
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2: case GL_COMPRESSED_SIGNED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT: case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		case GL_COMPRESSED_RGBA8_ETC2_EAC: case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+		case GL_COMPRESSED_RG11_EAC: case GL_COMPRESSED_SIGNED_RG11_EAC:
+		case GL_COMPRESSED_RGBA_ASTC_4x4_KHR: case GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR:
+			return { 4, 4, 16 };
+		default: return {};
+	}
+}
+
+/**
+ * @brief bytes of a `width` x `height` x `depth` compressed image, 0 for uncompressed formats
+*/
+inline size_t compressed_image_size(uint32_t internal_format, size_t width, size_t height = 1, size_t depth = 1){
+	TextureBlock block = compressed_block(internal_format);
+	return (width + block.width - 1) / block.width * ((height + block.height - 1) / block.height) * depth * block.bytes;
+}
+
 static uint32_t textureTypeToTarget(TextureType type){
 	switch (type){
 		case TextureType::Tex1D:return GL_TEXTURE_1D;
@@ -58,6 +194,8 @@ enum TextureErrorType: uint8_t {
 	InvalidIParam,
 	InvalidFParam,
 	InvalidSlotIndex,
+	ImmutableStorage,
+	UnitsExhausted,
 	NotImplementedFeature
 };
 
@@ -73,6 +211,8 @@ struct TextureError: public std::exception{
 			case TextureErrorType::InvalidIParam: return "InvalidIParam: the amount of parameters is less than the expected";
 			case TextureErrorType::InvalidFParam: return "InvalidFParam: the amount of parameters is less than the expected";
 			case TextureErrorType::InvalidSlotIndex: return "InvalidSlotIndex: the chosen index is greater than the maximum allowed by the graphics card";
+			case TextureErrorType::ImmutableStorage: return "ImmutableStorage: the texture storage is immutable and can't be specified again";
+			case TextureErrorType::UnitsExhausted: return "UnitsExhausted: a draw uses more textures than the units available";
 			default: throw TextureError(TextureErrorType::NotImplementedFeature);
 		}
 		return "An unknown error occurred!";
@@ -87,6 +227,7 @@ class TextureInstance: public Instance {
 
 		~TextureInstance(){
 			//TODO: levar em consideração TextureArrayInstance
+			GlobalBindingCache.forget_texture(id());
 			glDeleteTextures(1, id_ref());
 		}
 
@@ -97,7 +238,32 @@ class TextureInstance: public Instance {
 			m_slot = slot;
 		}
 
+		inline uint8_t slot() const { return m_slot; }
+		inline uint32_t target() const { return gl_target(); }
+
+		/**
+		 * @brief samples the texture through a shared sampler object bound to its slot, instead of its own parameters
+		 * @note `nullptr` binds sampler 0 so the texture parameters apply again
+		*/
+		inline void set_sampler(const SamplerInstance* sampler){ m_sampler = sampler ? sampler->id() : 0; }
+		inline void set_sampler(const SamplerDesc& desc){ set_sampler(&GlobalSamplerCache.get(desc)); }
+		inline uint32_t sampler() const { return m_sampler == BindingCache::unknown ? 0 : m_sampler; }
+
+		/**
+		 * @brief specifies one level, re-specifying the same size and format (or any level of an immutable
+		 * texture) only replaces the pixels
+		 * @note cube maps read the 6 faces one after another from `pixels`, cube map arrays take `spec.layers` cubes
+		*/
 		void source(const TextureSpec& spec, void* pixels){
+			size_t depth = m_type == TextureType::CubeMapArray ? spec.layers * 6 : m_type == TextureType::CubeMap ? 6 : spec.depth;
+			bool same_storage = m_immutable || (spec.level == 0 && m_width == spec.width && m_height == spec.height &&
+				m_depth == depth && m_internal_format == spec.internal_format);
+			if(same_storage){
+				if(pixels) update_level(spec.level, spec.format, spec.datatype, pixels);
+				if(spec.generate_mipmaps) generate_mipmaps();
+				return;
+			}
+
 			bind();
 			uint32_t target = gl_target();
 			//Note if target is zero should throw and error here, but bind already does it if so
@@ -112,19 +278,244 @@ class TextureInstance: public Instance {
 					break;
 				case TextureType::Tex2DArray:
 				case TextureType::Tex3D:
-					THIS_INSTANCE_CALL_M(InstanceErrorType::Source, glTexImage3D(target,spec.level,spec.internal_format,spec.width, spec.height,spec.depth,spec.border,spec.format,spec.datatype,pixels), Tex2DArray_Tex3D);
+				case TextureType::CubeMapArray:
+					THIS_INSTANCE_CALL_M(InstanceErrorType::Source, glTexImage3D(target,spec.level,spec.internal_format,spec.width, spec.height,depth,spec.border,spec.format,spec.datatype,pixels), Tex2DArray_Tex3D);
 					break;
-				//TODO: texture cube maps and texture
+				case TextureType::CubeMap:{
+					size_t face_bytes = image_bytes(spec.width, spec.height, spec.format, spec.datatype);
+					for(uint32_t face = 0; face < 6; face++){
+						uint8_t* face_pixels = pixels ? (uint8_t*)pixels + face * face_bytes : nullptr;
+						THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,spec.level,spec.internal_format,spec.width, spec.height,spec.border,spec.format,spec.datatype,face_pixels), CubeMapFace);
+					}
+					break;
+				}
 			default:
 				break;
 			}
 
+			if(spec.level == 0){
+				m_width = spec.width;
+				m_height = spec.height;
+				m_depth = depth;
+				m_internal_format = spec.internal_format;
+				m_levels = spec.generate_mipmaps ? mip_levels(spec.width, spec.height, m_type == TextureType::Tex3D ? depth : 1) : 1;
+			}
+
 			//apply other specifications
-			if(spec.generate_mipmaps){
-				THIS_INSTANCE_CALL_M( InstanceErrorType::Create, glGenerateMipmap(target), MipMapGeneration );
+			if(spec.generate_mipmaps) generate_mipmaps();
+		}
+
+		/**
+		 * @brief allocates immutable storage for `levels` levels, contents are then set with `update`
+		 * @param depth depth of 3D textures, layers of arrays and cubes of cube map arrays
+		*/
+		void storage(uint32_t levels, uint32_t internal_format, size_t width, size_t height = 1, size_t depth = 1){
+			if(m_immutable) throw TextureError(TextureErrorType::ImmutableStorage);
+			bind();
+			uint32_t target = gl_target();
+			size_t gl_depth = m_type == TextureType::CubeMapArray ? depth * 6 : m_type == TextureType::CubeMap ? 6 : depth;
+			switch (m_type)
+			{
+				case TextureType::Tex1D:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexStorage1D(target,levels,internal_format,width), Tex1DStorage );
+					break;
+				case TextureType::Tex1DArray:
+				case TextureType::Tex2D:
+				case TextureType::CubeMap:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexStorage2D(target,levels,internal_format,width,height), Tex2DStorage );
+					break;
+				case TextureType::Tex2DArray:
+				case TextureType::Tex3D:
+				case TextureType::CubeMapArray:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexStorage3D(target,levels,internal_format,width,height,gl_depth), Tex3DStorage );
+					break;
+				default:
+					throw TextureError(TextureErrorType::InvalidTypeBinding);
 			}
+
+			m_immutable = true;
+			m_levels = levels;
+			m_width = width;
+			m_height = height;
+			m_depth = gl_depth;
+			m_internal_format = internal_format;
 		}
 
+		/**
+		 * @brief replaces the pixels of `region`
+		 * @param pixels client memory, or an offset into the bound pixel unpack buffer
+		*/
+		void update(const TextureRegion& region, const void* pixels){
+			bind();
+			uint32_t target = gl_target();
+			switch (m_type)
+			{
+				case TextureType::Tex1D:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexSubImage1D(target,region.level,region.x,region.width,region.format,region.datatype,pixels), Tex1D );
+					break;
+				case TextureType::Tex1DArray:
+				case TextureType::Tex2D:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexSubImage2D(target,region.level,region.x,region.y,region.width,region.height,region.format,region.datatype,pixels), Tex1DArray_Tex2D );
+					break;
+				case TextureType::Tex2DArray:
+				case TextureType::Tex3D:
+				case TextureType::CubeMapArray:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexSubImage3D(target,region.level,region.x,region.y,region.z,region.width,region.height,region.depth,region.format,region.datatype,pixels), Tex2DArray_Tex3D );
+					break;
+				case TextureType::CubeMap:{
+					size_t face_bytes = image_bytes(region.width, region.height, region.format, region.datatype);
+					for(size_t face = region.z; face < region.z + region.depth; face++){
+						const uint8_t* face_pixels = (const uint8_t*)pixels + (face - region.z) * face_bytes;
+						THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,region.level,region.x,region.y,region.width,region.height,region.format,region.datatype,face_pixels), CubeMapFace );
+					}
+					break;
+				}
+				default:
+					throw TextureError(TextureErrorType::NotImplementedFeature);
+			}
+		}
+
+		/**
+		 * @brief replaces `region` with compressed blocks, `region.format` is the compressed internal format
+		 * @param bytes size of `data`, cube maps split it evenly between the faces
+		*/
+		void compressed_update(const TextureRegion& region, const void* data, size_t bytes){
+			bind();
+			uint32_t target = gl_target();
+			switch (m_type)
+			{
+				case TextureType::Tex1D:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glCompressedTexSubImage1D(target,region.level,region.x,region.width,region.format,bytes,data), CompressedTex1D );
+					break;
+				case TextureType::Tex1DArray:
+				case TextureType::Tex2D:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glCompressedTexSubImage2D(target,region.level,region.x,region.y,region.width,region.height,region.format,bytes,data), CompressedTex1DArray_Tex2D );
+					break;
+				case TextureType::Tex2DArray:
+				case TextureType::Tex3D:
+				case TextureType::CubeMapArray:
+					THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glCompressedTexSubImage3D(target,region.level,region.x,region.y,region.z,region.width,region.height,region.depth,region.format,bytes,data), CompressedTex2DArray_Tex3D );
+					break;
+				case TextureType::CubeMap:{
+					size_t face_bytes = bytes / std::max<size_t>(region.depth, 1);
+					for(size_t face = region.z; face < region.z + region.depth; face++){
+						const uint8_t* face_data = (const uint8_t*)data + (face - region.z) * face_bytes;
+						THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,region.level,region.x,region.y,region.width,region.height,region.format,face_bytes,face_data), CompressedCubeMapFace );
+					}
+					break;
+				}
+				default:
+					throw TextureError(TextureErrorType::NotImplementedFeature);
+			}
+		}
+
+		/**
+		 * @brief replaces a whole level, sizes come from the allocated storage
+		*/
+		void update_level(int level, uint32_t format, uint32_t datatype, const void* pixels){
+			update(level_region(level, format, datatype), pixels);
+		}
+
+		/**
+		 * @brief replaces one layer of an array (or one face of a cube map) at `level`
+		*/
+		void update_layer(size_t layer, int level, uint32_t format, uint32_t datatype, const void* pixels){
+			TextureRegion region = level_region(level, format, datatype);
+			if(m_type == TextureType::Tex1DArray){
+				region.y = layer;
+				region.height = 1;
+			} else {
+				region.z = layer;
+				region.depth = 1;
+			}
+			update(region, pixels);
+		}
+
+		void generate_mipmaps(){
+			bind();
+			THIS_INSTANCE_CALL_M( InstanceErrorType::Create, glGenerateMipmap(gl_target()), MipMapGeneration );
+		}
+
+		/**
+		 * @brief bytes of the allocated levels, from the internal format and the storage size
+		*/
+		size_t memory_size() const {
+			size_t total = 0;
+			for(uint32_t level = 0; level < m_levels; level++) total += level_size(level);
+			return total;
+		}
+
+		size_t level_size(uint32_t level) const {
+			TextureRegion region = level_region(level, 0, 0);
+			size_t compressed = compressed_image_size(m_internal_format, region.width, region.height, region.depth);
+			return compressed ? compressed : region.width * region.height * region.depth * internal_format_size(m_internal_format);
+		}
+
+		/**
+		 * @brief frees the `count` largest levels, the remaining ones move down and keep their contents
+		 * @note the texture gets a new name with immutable storage, parameters set with `setup` are lost
+		 * @return false when the texture doesn't have more than `count` levels or the context can't copy images,
+		 * the texture is left untouched then
+		*/
+		bool drop_levels(uint32_t count){
+			if(count == 0 || count >= m_levels || !can_drop_levels()) return false;
+			uint32_t old_id = id();
+			uint32_t target = gl_target();
+			uint32_t levels = m_levels - count;
+			size_t width = m_width, height = m_height, depth = m_depth;
+
+			uint32_t new_id = 0;
+			THIS_INSTANCE_CALL( InstanceErrorType::Create, glGenTextures(1, &new_id) );
+			*id_ref() = new_id;
+			m_immutable = false;
+			size_t layers = m_type == TextureType::CubeMapArray ? depth / 6 : depth;
+			storage(levels, m_internal_format, std::max<size_t>(width >> count, 1),
+				m_type == TextureType::Tex1DArray ? height : std::max<size_t>(height >> count, 1),
+				m_type == TextureType::Tex3D ? std::max<size_t>(depth >> count, 1) : layers);
+
+			for(uint32_t level = 0; level < levels; level++){
+				size_t source = level + count;
+				size_t level_width = std::max<size_t>(width >> source, 1);
+				size_t level_height = m_type == TextureType::Tex1DArray ? height : std::max<size_t>(height >> source, 1);
+				size_t level_depth = m_type == TextureType::Tex3D ? std::max<size_t>(depth >> source, 1) : std::max<size_t>(depth, 1);
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Source, glCopyImageSubData(old_id, target, source, 0, 0, 0, new_id, target, level, 0, 0, 0, level_width, level_height, level_depth), DropLevels );
+			}
+			GlobalBindingCache.forget_texture(old_id);
+			glDeleteTextures(1, &old_id);
+			return true;
+		}
+
+		/**
+		 * @brief `drop_levels` moves the levels with glCopyImageSubData, core in 4.3
+		*/
+		static bool can_drop_levels(){
+			return GlobalContextConfig.supports(4,3) || GlobalContextConfig.has_extension("GL_ARB_copy_image");
+		}
+
+		/**
+		 * @brief frees the storage, the texture gets a new empty name ready for `source` or `storage`
+		 * @note parameters set with `setup` are lost, the slot and the sampler are kept
+		*/
+		void reset(){
+			uint32_t old_id = id();
+			THIS_INSTANCE_CALL( InstanceErrorType::Create, glGenTextures(1, id_ref()) );
+			GlobalBindingCache.forget_texture(old_id);
+			glDeleteTextures(1, &old_id);
+			m_immutable = false;
+			m_levels = 0;
+			m_width = m_height = m_depth = 0;
+			m_internal_format = 0;
+		}
+
+		inline bool immutable() const { return m_immutable; }
+		inline uint32_t levels() const { return m_levels; }
+		inline size_t width() const { return m_width; }
+		inline size_t height() const { return m_height; }
+		inline size_t depth() const { return m_depth; }
+		inline uint32_t internal_format() const { return m_internal_format; }
+
+		inline TextureType texture_type() const { return m_type; }
+
 		void setup(const TextureConfig& config){
 			bind();
 			uint32_t target = gl_target();
@@ -144,6 +535,33 @@ class TextureInstance: public Instance {
 		TextureType m_type = TextureType::None;
 	protected:
 		uint8_t m_slot = -1;
+		uint32_t m_sampler = BindingCache::unknown; //unknown leaves the unit sampler untouched
+		bool m_immutable = false;
+		uint32_t m_levels = 0;
+		size_t m_width = 0, m_height = 0, m_depth = 0; //depth counts layer-faces for cube map arrays
+		uint32_t m_internal_format = 0;
+
+		/**
+		 * @brief bytes of a client image honoring the unpack row alignment
+		*/
+		static size_t image_bytes(size_t width, size_t height, uint32_t format, uint32_t datatype){
+			int32_t alignment = 4;
+			SAFE_CALL( TextureUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+			size_t row = width * pixel_size(format, datatype);
+			row = (row + alignment - 1) / alignment * alignment;
+			return row * height;
+		}
+
+		TextureRegion level_region(int level, uint32_t format, uint32_t datatype) const {
+			return {
+				.level = level,
+				.width = std::max<size_t>(m_width >> level, 1),
+				.height = m_type == TextureType::Tex1DArray ? m_height : std::max<size_t>(m_height >> level, 1),
+				.depth = m_type == TextureType::Tex3D ? std::max<size_t>(m_depth >> level, 1) : std::max<size_t>(m_depth, 1),
+				.format = format,
+				.datatype = datatype
+			};
+		}
 
 		inline uint32_t gl_target() const { 
 			uint32_t target = textureTypeToTarget(m_type);
@@ -152,21 +570,27 @@ class TextureInstance: public Instance {
 		}
 
 		inline void activeSlot() const {
-			if(m_slot != (uint8_t)-1){
+			if(m_slot != (uint8_t)-1 && GlobalBindingCache.update_active_texture(m_slot)){
 				THIS_INSTANCE_CALL_M( InstanceErrorType::Bind, glActiveTexture(GL_TEXTURE0 + m_slot), TextureSlot );
 			}
 		}
 
 		virtual void t_bind(){
 			activeSlot();
-			THIS_INSTANCE_CALL( InstanceErrorType::Bind,  glBindTexture(gl_target(), id()) );
+			if(GlobalBindingCache.update_texture(gl_target(), id())){
+				THIS_INSTANCE_CALL( InstanceErrorType::Bind,  glBindTexture(gl_target(), id()) );
+			}
+			if(m_sampler != BindingCache::unknown && m_slot != (uint8_t)-1 && GlobalBindingCache.update_sampler(m_slot, m_sampler)){
+				THIS_INSTANCE_CALL_M( InstanceErrorType::Bind, glBindSampler(m_slot, m_sampler), TextureSampler );
+			}
 
-			//TODO: implement array binding
-			//glBindTextures()
+			//sets of textures are bound with a single glBindTextures by TextureUnitManager
 		}
 
 		virtual void t_unbind(){
 			activeSlot();
-			THIS_INSTANCE_CALL( InstanceErrorType::Unbind,  glBindTexture(gl_target(), 0) );
+			if(GlobalBindingCache.update_texture(gl_target(), 0)){
+				THIS_INSTANCE_CALL( InstanceErrorType::Unbind,  glBindTexture(gl_target(), 0) );
+			}
 		}
 };
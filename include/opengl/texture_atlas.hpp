@@ -0,0 +1,550 @@
+#pragma once
+#include "texture.hpp"
+#include <algorithm>
+#include <memory>
+
+struct AtlasRect {
+	uint32_t x = 0, y = 0, width = 0, height = 0;
+
+	inline uint32_t right() const { return x + width; }
+	inline uint32_t bottom() const { return y + height; }
+	inline uint64_t area() const { return (uint64_t)width * height; }
+
+	inline bool contains(const AtlasRect& other) const {
+		return other.x >= x && other.y >= y && other.right() <= right() && other.bottom() <= bottom();
+	}
+
+	inline bool intersects(const AtlasRect& other) const {
+		return other.x < right() && other.right() > x && other.y < bottom() && other.bottom() > y;
+	}
+};
+
+/**
+ * @brief MaxRects bin packer (best short side fit) with online insertion and removal
+ *
+ * the free list holds the maximal free rectangles, they may overlap. a removed rectangle goes back to it
+ * grown across the free rectangles it touches, so neighbouring freed space joins up again without
+ * touching the rest of the list. an emptied packer is whole again, what the joins miss is left to repacking.
+*/
+class MaxRectsPacker {
+	public:
+		MaxRectsPacker(uint32_t width = 0, uint32_t height = 0){ reset(width, height); }
+
+		void reset(uint32_t width, uint32_t height){
+			m_width = width;
+			m_height = height;
+			m_used = 0;
+			m_rects.clear();
+			m_free.clear();
+			if(width && height) m_free.push_back({ 0, 0, width, height });
+		}
+
+		/**
+		 * @return false if no free rectangle fits `width` x `height`
+		*/
+		bool insert(uint32_t width, uint32_t height, AtlasRect& out){
+			if(width == 0 || height == 0) return false;
+			uint32_t best_short = ~0u, best_long = ~0u;
+			const AtlasRect* best = nullptr;
+			for(auto& free: m_free){
+				if(free.width < width || free.height < height) continue;
+				uint32_t dx = free.width - width, dy = free.height - height;
+				uint32_t short_side = std::min(dx, dy), long_side = std::max(dx, dy);
+				if(short_side < best_short || (short_side == best_short && long_side < best_long)){
+					best_short = short_side;
+					best_long = long_side;
+					best = &free;
+				}
+			}
+			if(!best) return false;
+
+			out = { best->x, best->y, width, height };
+			place(out);
+			m_rects.push_back(out);
+			m_used += out.area();
+			return true;
+		}
+
+		/**
+		 * @brief frees a rectangle returned by `insert`
+		*/
+		void remove(const AtlasRect& rect){
+			auto it = std::find_if(m_rects.begin(), m_rects.end(), [&](const AtlasRect& used){
+				return used.x == rect.x && used.y == rect.y && used.width == rect.width && used.height == rect.height;
+			});
+			if(it == m_rects.end()) return;
+			*it = m_rects.back();
+			m_rects.pop_back();
+			m_used -= rect.area();
+			if(m_rects.empty()) reset(m_width, m_height);
+			else release(rect);
+		}
+
+		inline uint32_t width() const { return m_width; }
+		inline uint32_t height() const { return m_height; }
+		inline uint64_t used_area() const { return m_used; }
+		inline bool empty() const { return m_used == 0; }
+		inline float occupancy() const { return m_width && m_height ? (float)((double)m_used / ((double)m_width * m_height)) : 0.0f; }
+
+	private:
+		uint32_t m_width = 0, m_height = 0;
+		uint64_t m_used = 0;
+		std::vector<AtlasRect> m_rects; //in use
+		std::vector<AtlasRect> m_free;
+
+		static constexpr size_t max_joins = 64; //rectangles grown out of one removal
+
+		void place(const AtlasRect& used){
+			std::vector<AtlasRect> split;
+			for(size_t i = 0; i < m_free.size();){
+				AtlasRect free = m_free[i];
+				if(!free.intersects(used)){
+					i++;
+					continue;
+				}
+				m_free[i] = m_free.back();
+				m_free.pop_back();
+				if(used.x > free.x) split.push_back({ free.x, free.y, used.x - free.x, free.height });
+				if(used.right() < free.right()) split.push_back({ used.right(), free.y, free.right() - used.right(), free.height });
+				if(used.y > free.y) split.push_back({ free.x, free.y, free.width, used.y - free.y });
+				if(used.bottom() < free.bottom()) split.push_back({ free.x, used.bottom(), free.width, free.bottom() - used.bottom() });
+			}
+			//an untouched rectangle can't lie inside a piece, only the pieces need pruning
+			size_t pieces = m_free.size();
+			m_free.insert(m_free.end(), split.begin(), split.end());
+			prune(pieces);
+		}
+
+		/**
+		 * @brief gives `freed` back, joined with the free rectangles it touches and the joins with theirs
+		*/
+		void release(const AtlasRect& freed){
+			std::vector<AtlasRect> added;
+			std::vector<AtlasRect> pending = { freed };
+			while(!pending.empty() && added.size() < max_joins){
+				AtlasRect rect = pending.back();
+				pending.pop_back();
+				if(covered(rect, added)) continue;
+				added.push_back(rect);
+				for(auto& free: m_free) join(rect, free, pending);
+				for(size_t i = 0; i + 1 < added.size(); i++) join(rect, added[i], pending);
+			}
+
+			//free rectangles inside a join aren't maximal anymore
+			std::erase_if(m_free, [&](const AtlasRect& free){
+				for(auto& rect: added) if(rect.contains(free)) return true;
+				return false;
+			});
+			size_t first = m_free.size();
+			m_free.insert(m_free.end(), added.begin(), added.end());
+			prune(first);
+		}
+
+		/**
+		 * @brief the rectangles spanning `a` and `b` across the rows (or columns) they share, when they touch
+		 * and the span is larger than both
+		*/
+		static void join(const AtlasRect& a, const AtlasRect& b, std::vector<AtlasRect>& out){
+			auto grown = [&](const AtlasRect& rect){
+				if(!a.contains(rect) && !b.contains(rect)) out.push_back(rect);
+			};
+			if(a.y < b.bottom() && b.y < a.bottom() && a.x <= b.right() && b.x <= a.right()){
+				uint32_t x = std::min(a.x, b.x), y = std::max(a.y, b.y);
+				grown({ x, y, std::max(a.right(), b.right()) - x, std::min(a.bottom(), b.bottom()) - y });
+			}
+			if(a.x < b.right() && b.x < a.right() && a.y <= b.bottom() && b.y <= a.bottom()){
+				uint32_t x = std::max(a.x, b.x), y = std::min(a.y, b.y);
+				grown({ x, y, std::min(a.right(), b.right()) - x, std::max(a.bottom(), b.bottom()) - y });
+			}
+		}
+
+		//inside a free rectangle or one of `others`
+		bool covered(const AtlasRect& rect, const std::vector<AtlasRect>& others) const {
+			for(auto& free: m_free) if(free.contains(rect)) return true;
+			for(auto& other: others) if(other.contains(rect)) return true;
+			return false;
+		}
+
+		/**
+		 * @brief removes the free rectangles from `first` on that are inside another one
+		*/
+		void prune(size_t first){
+			for(size_t i = first; i < m_free.size();){
+				bool inside = false;
+				for(size_t j = 0; j < m_free.size() && !inside; j++){
+					inside = j != i && m_free[j].contains(m_free[i]) && !(m_free[i].contains(m_free[j]) && j > i);
+				}
+				if(inside){
+					m_free[i] = m_free.back();
+					m_free.pop_back();
+				} else i++;
+			}
+		}
+};
+
+struct AtlasDescriptor {
+	uint32_t size = 2048; //width and height of every layer
+	uint32_t internal_format = GL_RGBA8;
+	uint32_t format = GL_RGBA; //client pixels given to `insert` and `update`
+	uint32_t datatype = GL_UNSIGNED_BYTE;
+	uint32_t padding = 1; //texels extruded around every image, raise it with mipmaps
+	uint32_t levels = 1;
+	uint32_t initial_layers = 1;
+	uint32_t max_layers = 0; //0 for GL_MAX_ARRAY_TEXTURE_LAYERS
+};
+
+/**
+ * @brief where an image lives in the atlas, `rect` excludes the padding
+*/
+struct AtlasRegion {
+	uint32_t layer = 0;
+	AtlasRect rect;
+	float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+};
+
+using AtlasHandle = uint32_t;
+static constexpr AtlasHandle InvalidAtlasHandle = ~0u;
+
+/**
+ * @brief packs many small images (sprites, glyphs) into the layers of one Tex2DArray
+ *
+ * everything drawn from the atlas shares a single texture binding, shaders sample it with the UV
+ * rect and layer of the image's `AtlasRegion`. the atlas grows by reallocating with more layers
+ * (contents moved with glCopyImageSubData), which replaces `texture()` and bumps `generation()`,
+ * as does `compact()`, which also moves regions.
+*/
+class TextureAtlas {
+	public:
+		struct Stats {
+			uint64_t inserts = 0;
+			uint64_t removals = 0;
+			uint64_t failed = 0; //images larger than a layer or past max_layers
+			uint64_t grows = 0;
+			uint64_t compactions = 0;
+		};
+
+		struct CompactionReport {
+			uint32_t layers_before = 0, layers_after = 0;
+			float occupancy_before = 0.0f, occupancy_after = 0.0f;
+			size_t moved = 0;
+		};
+
+		TextureAtlas(const AtlasDescriptor& descriptor = {}):m_descriptor(descriptor){
+			m_pixel_size = pixel_size(descriptor.format, descriptor.datatype);
+			if(m_pixel_size == 0) throw std::invalid_argument("TextureAtlas: unsupported format and datatype");
+			if(descriptor.size == 0 || descriptor.size <= descriptor.padding * 2) throw std::invalid_argument("TextureAtlas: layer size too small for the padding");
+
+			m_max_layers = descriptor.max_layers;
+			if(m_max_layers == 0){
+				int32_t max_layers = 256;
+				SAFE_CALL( AtlasMaxLayers, glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers) );
+				m_max_layers = (uint32_t)std::max(max_layers, 1);
+			}
+			uint32_t layers = std::clamp<uint32_t>(descriptor.initial_layers, 1, m_max_layers);
+			m_texture = allocate(layers);
+			m_packers.assign(layers, MaxRectsPacker(descriptor.size, descriptor.size));
+		}
+
+		TextureAtlas(const TextureAtlas& other) = delete;
+
+		/**
+		 * @brief packs an image, adding layers when none has room
+		 * @param pixels tightly packed in the descriptor format, nullptr only reserves the space
+		 * @return InvalidAtlasHandle if the image is larger than a layer or the layer limit is reached
+		*/
+		AtlasHandle insert(uint32_t width, uint32_t height, const void* pixels = nullptr){
+			uint32_t padding = m_descriptor.padding;
+			uint32_t padded_width = width + padding * 2, padded_height = height + padding * 2;
+			if(width == 0 || height == 0 || padded_width > m_descriptor.size || padded_height > m_descriptor.size){
+				m_stats.failed++;
+				return InvalidAtlasHandle;
+			}
+
+			AtlasRect rect;
+			uint32_t layer = 0;
+			for(; layer < m_packers.size(); layer++) if(m_packers[layer].insert(padded_width, padded_height, rect)) break;
+			if(layer == m_packers.size()){
+				if(layer >= m_max_layers){
+					m_stats.failed++;
+					return InvalidAtlasHandle;
+				}
+				grow(std::min<uint32_t>(m_max_layers, layer + std::max<uint32_t>(layer / 2, 1)));
+				m_packers[layer].insert(padded_width, padded_height, rect);
+			}
+
+			AtlasHandle handle;
+			if(!m_free_handles.empty()){
+				handle = m_free_handles.back();
+				m_free_handles.pop_back();
+			} else {
+				handle = (AtlasHandle)m_entries.size();
+				m_entries.emplace_back();
+			}
+			m_entries[handle] = { .region = make_region(layer, rect), .alive = true };
+			m_count++;
+			m_stats.inserts++;
+			if(pixels) update(handle, pixels);
+			return handle;
+		}
+
+		/**
+		 * @brief replaces the image of `handle`, the padding is extruded from its edges
+		*/
+		void update(AtlasHandle handle, const void* pixels){
+			const AtlasRegion& region = this->region(handle);
+			uint32_t padding = m_descriptor.padding;
+			uint32_t width = region.rect.width, height = region.rect.height;
+			const uint8_t* source = (const uint8_t*)pixels;
+
+			if(padding > 0){
+				uint32_t padded_width = width + padding * 2, padded_height = height + padding * 2;
+				m_scratch.resize((size_t)padded_width * padded_height * m_pixel_size);
+				for(uint32_t y = 0; y < padded_height; y++){
+					uint32_t sy = (uint32_t)std::clamp<int64_t>((int64_t)y - padding, 0, height - 1);
+					const uint8_t* row = source + (size_t)sy * width * m_pixel_size;
+					uint8_t* out = m_scratch.data() + (size_t)y * padded_width * m_pixel_size;
+					for(uint32_t x = 0; x < padding; x++) memcpy(out + x * m_pixel_size, row, m_pixel_size);
+					memcpy(out + padding * m_pixel_size, row, (size_t)width * m_pixel_size);
+					for(uint32_t x = padding + width; x < padded_width; x++) memcpy(out + x * m_pixel_size, row + (size_t)(width - 1) * m_pixel_size, m_pixel_size);
+				}
+				source = m_scratch.data();
+				width = padded_width;
+				height = padded_height;
+			}
+
+			int32_t alignment = 4;
+			SAFE_CALL( AtlasUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+			SAFE_CALL( AtlasUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+			m_texture->update({
+				.x = region.rect.x - padding,
+				.y = region.rect.y - padding,
+				.z = region.layer,
+				.width = width,
+				.height = height,
+				.format = m_descriptor.format,
+				.datatype = m_descriptor.datatype
+			}, source);
+			SAFE_CALL( AtlasUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, alignment) );
+		}
+
+		/**
+		 * @return false if `handle` isn't in the atlas
+		*/
+		bool remove(AtlasHandle handle){
+			if(!contains(handle)) return false;
+			Entry& entry = m_entries[handle];
+			m_packers[entry.region.layer].remove(padded(entry.region.rect));
+			entry.alive = false;
+			m_free_handles.push_back(handle);
+			m_count--;
+			m_stats.removals++;
+			return true;
+		}
+
+		inline bool contains(AtlasHandle handle) const { return handle < m_entries.size() && m_entries[handle].alive; }
+
+		const AtlasRegion& region(AtlasHandle handle) const {
+			if(!contains(handle)) throw std::out_of_range("TextureAtlas: invalid handle");
+			return m_entries[handle].region;
+		}
+
+		/**
+		 * @brief repacks every image from the tallest down into as few layers as possible
+		 * @note regions move and the texture is replaced, refetch them once `generation()` changes
+		*/
+		CompactionReport compact(){
+			CompactionReport report = { .layers_before = layers(), .occupancy_before = occupancy() };
+
+			std::vector<AtlasHandle> order;
+			for(AtlasHandle handle = 0; handle < m_entries.size(); handle++) if(m_entries[handle].alive) order.push_back(handle);
+			std::sort(order.begin(), order.end(), [this](AtlasHandle a, AtlasHandle b){
+				const AtlasRect& ra = m_entries[a].region.rect;
+				const AtlasRect& rb = m_entries[b].region.rect;
+				return ra.height != rb.height ? ra.height > rb.height : ra.width > rb.width;
+			});
+
+			std::vector<MaxRectsPacker> packers(1, MaxRectsPacker(m_descriptor.size, m_descriptor.size));
+			std::vector<AtlasRegion> placed(m_entries.size());
+			for(AtlasHandle handle: order){
+				AtlasRect rect = padded(m_entries[handle].region.rect);
+				uint32_t layer = 0;
+				AtlasRect target;
+				while(!packers[layer].insert(rect.width, rect.height, target)){
+					if(++layer == packers.size()) packers.emplace_back(m_descriptor.size, m_descriptor.size);
+				}
+				placed[handle] = make_region(layer, target);
+			}
+			//the greedy repack may not beat the online one, the atlas is left untouched then
+			if(packers.size() > layers() || packers.size() > m_max_layers){
+				report.layers_after = report.layers_before;
+				report.occupancy_after = report.occupancy_before;
+				return report;
+			}
+
+			uint32_t new_layers = std::max<uint32_t>((uint32_t)packers.size(), std::min(m_descriptor.initial_layers, m_max_layers));
+			auto texture = allocate(new_layers);
+			bool copy_image = can_copy_image();
+			std::vector<uint8_t> snapshot;
+			if(!copy_image) snapshot = read_level(*m_texture, 0, layers());
+
+			for(AtlasHandle handle: order){
+				AtlasRegion& from = m_entries[handle].region;
+				const AtlasRegion& to = placed[handle];
+				AtlasRect source = padded(from.rect), target = padded(to.rect);
+				if(from.layer != to.layer || source.x != target.x || source.y != target.y) report.moved++;
+				if(copy_image){
+					SAFE_CALL( AtlasCompactCopy, glCopyImageSubData(m_texture->id(), GL_TEXTURE_2D_ARRAY, 0, source.x, source.y, from.layer,
+						texture->id(), GL_TEXTURE_2D_ARRAY, 0, target.x, target.y, to.layer, source.width, source.height, 1) );
+				} else {
+					size_t offset = (((size_t)from.layer * m_descriptor.size + source.y) * m_descriptor.size + source.x) * m_pixel_size;
+					upload_rows(*texture, { .z = to.layer, .x = target.x, .y = target.y, .width = source.width, .height = source.height }, snapshot.data() + offset, m_descriptor.size);
+				}
+				from = to;
+			}
+			if(m_descriptor.levels > 1) texture->generate_mipmaps();
+
+			m_texture = std::move(texture);
+			packers.resize(new_layers, MaxRectsPacker(m_descriptor.size, m_descriptor.size));
+			m_packers = std::move(packers);
+			m_generation++;
+			m_stats.compactions++;
+
+			report.layers_after = layers();
+			report.occupancy_after = occupancy();
+			return report;
+		}
+
+		/**
+		 * @brief regenerates the mip levels, call after a batch of inserts when `levels` > 1
+		*/
+		inline void generate_mipmaps(){ m_texture->generate_mipmaps(); }
+
+		inline TextureInstance& texture(){ return *m_texture; }
+
+		/**
+		 * @brief bumped whenever the texture object is replaced or regions move
+		*/
+		inline uint64_t generation() const { return m_generation; }
+
+		inline uint32_t layers() const { return (uint32_t)m_packers.size(); }
+		inline size_t size() const { return m_count; }
+		inline const AtlasDescriptor& descriptor() const { return m_descriptor; }
+
+		/**
+		 * @brief packed area, padding included, over the area of every layer
+		*/
+		float occupancy() const {
+			uint64_t used = 0;
+			for(auto& packer: m_packers) used += packer.used_area();
+			return (float)((double)used / ((double)m_descriptor.size * m_descriptor.size * std::max<size_t>(m_packers.size(), 1)));
+		}
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		struct Entry {
+			AtlasRegion region;
+			bool alive = false;
+		};
+
+		struct RowCopy {
+			uint32_t z = 0, x = 0, y = 0, width = 0, height = 0;
+		};
+
+		AtlasDescriptor m_descriptor;
+		size_t m_pixel_size = 0;
+		uint32_t m_max_layers = 1;
+		std::unique_ptr<TextureInstance> m_texture;
+		std::vector<MaxRectsPacker> m_packers;
+		std::vector<Entry> m_entries;
+		std::vector<AtlasHandle> m_free_handles;
+		std::vector<uint8_t> m_scratch;
+		size_t m_count = 0;
+		uint64_t m_generation = 0;
+		Stats m_stats;
+
+		inline AtlasRect padded(const AtlasRect& rect) const {
+			uint32_t padding = m_descriptor.padding;
+			return { rect.x - padding, rect.y - padding, rect.width + padding * 2, rect.height + padding * 2 };
+		}
+
+		AtlasRegion make_region(uint32_t layer, const AtlasRect& padded_rect) const {
+			uint32_t padding = m_descriptor.padding;
+			float size = (float)m_descriptor.size;
+			AtlasRect rect = { padded_rect.x + padding, padded_rect.y + padding, padded_rect.width - padding * 2, padded_rect.height - padding * 2 };
+			return {
+				.layer = layer,
+				.rect = rect,
+				.u0 = rect.x / size,
+				.v0 = rect.y / size,
+				.u1 = rect.right() / size,
+				.v1 = rect.bottom() / size
+			};
+		}
+
+		std::unique_ptr<TextureInstance> allocate(uint32_t layers) const {
+			auto texture = std::make_unique<TextureInstance>(TextureType::Tex2DArray);
+			texture->storage(m_descriptor.levels, m_descriptor.internal_format, m_descriptor.size, m_descriptor.size, layers);
+			return texture;
+		}
+
+		static bool can_copy_image(){
+			return GlobalContextConfig.supports(4,3) || GlobalContextConfig.has_extension("GL_ARB_copy_image");
+		}
+
+		/**
+		 * @brief reallocates with `new_layers` layers and moves every level of the old ones
+		*/
+		void grow(uint32_t new_layers){
+			uint32_t old_layers = layers();
+			auto texture = allocate(new_layers);
+			for(uint32_t level = 0; level < m_descriptor.levels; level++){
+				uint32_t size = std::max<uint32_t>(m_descriptor.size >> level, 1);
+				if(can_copy_image()){
+					SAFE_CALL( AtlasGrowCopy, glCopyImageSubData(m_texture->id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+						texture->id(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, size, size, old_layers) );
+				} else {
+					std::vector<uint8_t> pixels = read_level(*m_texture, level, old_layers);
+					int32_t alignment = 4;
+					SAFE_CALL( AtlasUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+					SAFE_CALL( AtlasUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+					texture->update({ .level = (int)level, .width = size, .height = size, .depth = old_layers, .format = m_descriptor.format, .datatype = m_descriptor.datatype }, pixels.data());
+					SAFE_CALL( AtlasUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, alignment) );
+				}
+			}
+			m_texture = std::move(texture);
+			m_packers.resize(new_layers, MaxRectsPacker(m_descriptor.size, m_descriptor.size));
+			m_generation++;
+			m_stats.grows++;
+		}
+
+		/**
+		 * @brief client copy of one level, used without glCopyImageSubData
+		*/
+		std::vector<uint8_t> read_level(TextureInstance& texture, uint32_t level, uint32_t layers) const {
+			size_t size = std::max<uint32_t>(m_descriptor.size >> level, 1);
+			std::vector<uint8_t> pixels(size * size * layers * m_pixel_size);
+			int32_t alignment = 4;
+			texture.bind();
+			SAFE_CALL( AtlasPackAlignment, glGetIntegerv(GL_PACK_ALIGNMENT, &alignment) );
+			SAFE_CALL( AtlasPackAlignment, glPixelStorei(GL_PACK_ALIGNMENT, 1) );
+			SAFE_CALL( AtlasReadLevel, glGetTexImage(GL_TEXTURE_2D_ARRAY, level, m_descriptor.format, m_descriptor.datatype, pixels.data()) );
+			SAFE_CALL( AtlasPackAlignment, glPixelStorei(GL_PACK_ALIGNMENT, alignment) );
+			return pixels;
+		}
+
+		/**
+		 * @brief uploads a rect out of rows `row_length` pixels long
+		*/
+		void upload_rows(TextureInstance& texture, const RowCopy& copy, const uint8_t* pixels, uint32_t row_length) const {
+			int32_t alignment = 4, length = 0;
+			SAFE_CALL( AtlasUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+			SAFE_CALL( AtlasUnpackRowLength, glGetIntegerv(GL_UNPACK_ROW_LENGTH, &length) );
+			SAFE_CALL( AtlasUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+			SAFE_CALL( AtlasUnpackRowLength, glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length) );
+			texture.update({ .x = copy.x, .y = copy.y, .z = copy.z, .width = copy.width, .height = copy.height, .format = m_descriptor.format, .datatype = m_descriptor.datatype }, pixels);
+			SAFE_CALL( AtlasUnpackRowLength, glPixelStorei(GL_UNPACK_ROW_LENGTH, length) );
+			SAFE_CALL( AtlasUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, alignment) );
+		}
+};
@@ -0,0 +1,495 @@
+#pragma once
+#include "texture.hpp"
+#include "utils/mapped_file.hpp"
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief a run of consecutive layer-faces of one level, stored contiguously in the container
+*/
+struct ContainerImage {
+	int level = 0;
+	size_t first = 0; //layer-face, `layer * faces + face`
+	size_t count = 1;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+/**
+ * @brief KTX2 and DDS textures read in place from a memory mapped file
+ *
+ * opening only parses the headers and indexes where every level, layer and face lives inside the
+ * mapping, nothing is copied. `upload` allocates immutable storage and sends each image straight
+ * from the mapped pages, with `glCompressedTexSubImage*` for block compressed formats (S3TC, RGTC,
+ * BPTC, ETC2/EAC, ASTC 4x4). supercompressed KTX2 (Basis, zstd) is rejected.
+*/
+class TextureContainer {
+	public:
+		enum class Kind: uint8_t {
+			None,
+			KTX2,
+			DDS
+		};
+
+		TextureContainer() = default;
+		TextureContainer(const std::filesystem::path& path){ open(path); }
+		TextureContainer(const TextureContainer& other) = delete;
+
+		/**
+		 * @return false if the file can't be mapped or isn't a valid KTX2/DDS texture, see `error()`
+		*/
+		bool open(const std::filesystem::path& path){
+			close();
+			if(!m_file.open(path)) return fail("could not map " + path.string());
+			if(!open(m_file.data(), m_file.size())){
+				m_file.close();
+				return false;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief parses a container in memory, `data` must outlive the container
+		*/
+		bool open(const void* data, size_t size){
+			reset();
+			m_error.clear();
+			p_data = (const uint8_t*)data;
+			m_size = size;
+			bool parsed = false;
+			if(size >= sizeof(ktx2_identifier) && memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0) parsed = parse_ktx2();
+			else if(size >= 4 && memcmp(data, "DDS ", 4) == 0) parsed = parse_dds();
+			else return fail("not a KTX2 or DDS file");
+			if(!parsed) reset();
+			return parsed;
+		}
+
+		void close(){
+			reset();
+			m_file.close();
+		}
+
+		/**
+		 * @brief allocates immutable storage on `texture` and uploads every image
+		 * @note `texture` must have the container type, already immutable storage is reused when it matches
+		*/
+		bool upload(TextureInstance& texture){
+			if(m_kind == Kind::None) return fail("no texture loaded");
+			if(texture.texture_type() != m_type) return fail("texture type doesn't match the container");
+			if(!supported()) return fail("texture format isn't supported by the context");
+
+			bool generate = b_generate_mipmaps && !compressed();
+			uint32_t levels = generate ? mip_levels(m_width, m_height, m_type == TextureType::Tex3D ? m_depth : 1) : m_levels;
+			size_t height = m_type == TextureType::Tex1DArray ? m_layers : m_height;
+			size_t depth = m_type == TextureType::Tex3D ? m_depth : m_layers;
+			if(!texture.immutable()) texture.storage(levels, m_internal_format, m_width, height, depth);
+			else if(texture.internal_format() != m_internal_format || texture.width() != m_width || texture.levels() < m_levels){
+				return fail("texture storage doesn't match the container");
+			}
+
+			int32_t alignment = 4;
+			SAFE_CALL( TextureContainerUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+			SAFE_CALL( TextureContainerUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+			for(auto& image: m_images){
+				if(compressed()) texture.compressed_update(region(image), image.data, image.size);
+				else texture.update(region(image), image.data);
+			}
+			SAFE_CALL( TextureContainerUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, alignment) );
+
+			if(generate) texture.generate_mipmaps();
+			return true;
+		}
+
+		/**
+		 * @return a new texture holding the container, nullptr on failure
+		*/
+		std::unique_ptr<TextureInstance> create(){
+			if(m_kind == Kind::None){
+				fail("no texture loaded");
+				return nullptr;
+			}
+			auto texture = std::make_unique<TextureInstance>(m_type);
+			if(!upload(*texture)) return nullptr;
+			return texture;
+		}
+
+		/**
+		 * @brief mapped bytes of one layer-face of `level`, the whole level for 3D textures
+		*/
+		const uint8_t* image(int level, size_t layer_face, size_t& bytes) const {
+			for(auto& image: m_images){
+				if(image.level != level || layer_face < image.first || layer_face >= image.first + image.count) continue;
+				bytes = image.size / image.count;
+				return image.data + (layer_face - image.first) * bytes;
+			}
+			bytes = 0;
+			return nullptr;
+		}
+
+		/**
+		 * @brief every image region of a level, in upload order
+		*/
+		inline const std::vector<ContainerImage>& images() const { return m_images; }
+
+		inline Kind kind() const { return m_kind; }
+		inline bool is_open() const { return m_kind != Kind::None; }
+		inline TextureType type() const { return m_type; }
+		inline size_t width() const { return m_width; }
+		inline size_t height() const { return m_height; }
+		inline size_t depth() const { return m_depth; }
+		inline size_t layers() const { return m_layers; } //cubes for cube map arrays
+		inline size_t faces() const { return m_faces; }
+		inline uint32_t levels() const { return m_levels; }
+		inline uint32_t internal_format() const { return m_internal_format; }
+		inline uint32_t format() const { return m_format; }
+		inline uint32_t datatype() const { return m_datatype; }
+		inline bool compressed() const { return compressed_block(m_internal_format).bytes != 0; }
+		inline bool generates_mipmaps() const { return b_generate_mipmaps; }
+		inline const std::string& error() const { return m_error; }
+
+		/**
+		 * @brief bytes of one layer-face of `level`, 0 if they don't fit in a size_t
+		*/
+		size_t image_size(int level) const {
+			size_t bytes = 0;
+			level_size(level, 1, bytes);
+			return bytes;
+		}
+
+	private:
+		static constexpr uint8_t ktx2_identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		MappedFile m_file;
+		const uint8_t* p_data = nullptr;
+		size_t m_size = 0;
+
+		Kind m_kind = Kind::None;
+		TextureType m_type = TextureType::None;
+		size_t m_width = 0, m_height = 1, m_depth = 1, m_layers = 1, m_faces = 1;
+		uint32_t m_levels = 0;
+		uint32_t m_internal_format = 0, m_format = 0, m_datatype = 0;
+		bool b_generate_mipmaps = false;
+		std::vector<ContainerImage> m_images;
+		std::string m_error;
+
+		void reset(){
+			p_data = nullptr;
+			m_size = 0;
+			m_kind = Kind::None;
+			m_type = TextureType::None;
+			m_width = 0;
+			m_height = m_depth = m_layers = m_faces = 1;
+			m_levels = 0;
+			m_internal_format = m_format = m_datatype = 0;
+			b_generate_mipmaps = false;
+			m_images.clear();
+		}
+
+		/**
+		 * @brief bytes of `count` layer-faces of `level`, false when the dimensions of a corrupt header overflow them
+		*/
+		bool level_size(int level, size_t count, size_t& bytes) const {
+			size_t w = std::max<size_t>(m_width >> level, 1);
+			size_t h = m_type == TextureType::Tex1D || m_type == TextureType::Tex1DArray ? 1 : std::max<size_t>(m_height >> level, 1);
+			size_t d = m_type == TextureType::Tex3D ? std::max<size_t>(m_depth >> level, 1) : 1;
+			size_t unit = pixel_size(m_format, m_datatype);
+			if(compressed()){
+				TextureBlock block = compressed_block(m_internal_format);
+				w = (w + block.width - 1) / block.width;
+				h = (h + block.height - 1) / block.height;
+				unit = block.bytes;
+			}
+			bytes = 0;
+			size_t size = w;
+			for(size_t factor: { h, d, unit, count }){
+				if(factor != 0 && size > SIZE_MAX / factor) return false;
+				size *= factor;
+			}
+			bytes = size;
+			return true;
+		}
+
+		bool fail(const std::string& error){
+			m_error = error;
+			return false;
+		}
+
+		template<typename T>
+		inline T read(size_t offset) const {
+			T value;
+			memcpy(&value, p_data + offset, sizeof(T));
+			return value;
+		}
+
+		inline bool in_bounds(uint64_t offset, uint64_t size) const { return offset <= m_size && size <= m_size - offset; }
+
+		inline bool set_format(uint32_t internal_format, uint32_t format = 0, uint32_t datatype = 0){
+			m_internal_format = internal_format;
+			m_format = format;
+			m_datatype = datatype;
+			return internal_format != 0;
+		}
+
+		bool supported() const {
+			switch(m_internal_format){
+				case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+				case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+					return GlobalContextConfig.has_extension("GL_EXT_texture_compression_s3tc");
+				case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+				case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+					return GlobalContextConfig.has_extension("GL_EXT_texture_compression_s3tc") && GlobalContextConfig.has_extension("GL_EXT_texture_sRGB");
+				case GL_COMPRESSED_RGBA_ASTC_4x4_KHR: case GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR:
+					return GlobalContextConfig.has_extension("GL_KHR_texture_compression_astc_ldr");
+				default: return true;
+			}
+		}
+
+		TextureRegion region(const ContainerImage& image) const {
+			TextureRegion region = {
+				.level = image.level,
+				.width = std::max<size_t>(m_width >> image.level, 1),
+				.height = std::max<size_t>(m_height >> image.level, 1),
+				.format = compressed() ? m_internal_format : m_format,
+				.datatype = m_datatype
+			};
+			switch(m_type){
+				case TextureType::Tex1D: region.height = 1; break;
+				case TextureType::Tex1DArray:
+					region.y = image.first;
+					region.height = image.count;
+					break;
+				case TextureType::Tex3D: region.depth = std::max<size_t>(m_depth >> image.level, 1); break;
+				default:
+					region.z = image.first;
+					region.depth = image.count;
+					break;
+			}
+			return region;
+		}
+
+		//Vulkan formats used by KTX2
+		bool ktx2_format(uint32_t vk_format){
+			switch(vk_format){
+				case 9: return set_format(GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+				case 16: return set_format(GL_RG8, GL_RG, GL_UNSIGNED_BYTE);
+				case 23: return set_format(GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+				case 29: return set_format(GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE);
+				case 37: return set_format(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+				case 43: return set_format(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE);
+				case 44: return set_format(GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE);
+				case 50: return set_format(GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE);
+				case 64: return set_format(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+				case 76: return set_format(GL_R16F, GL_RED, GL_HALF_FLOAT);
+				case 83: return set_format(GL_RG16F, GL_RG, GL_HALF_FLOAT);
+				case 97: return set_format(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+				case 100: return set_format(GL_R32F, GL_RED, GL_FLOAT);
+				case 103: return set_format(GL_RG32F, GL_RG, GL_FLOAT);
+				case 109: return set_format(GL_RGBA32F, GL_RGBA, GL_FLOAT);
+				case 122: return set_format(GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV);
+				case 123: return set_format(GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV);
+				case 131: return set_format(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+				case 132: return set_format(GL_COMPRESSED_SRGB_S3TC_DXT1_EXT);
+				case 133: return set_format(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+				case 134: return set_format(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT);
+				case 135: return set_format(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT);
+				case 136: return set_format(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT);
+				case 137: return set_format(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+				case 138: return set_format(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT);
+				case 139: return set_format(GL_COMPRESSED_RED_RGTC1);
+				case 140: return set_format(GL_COMPRESSED_SIGNED_RED_RGTC1);
+				case 141: return set_format(GL_COMPRESSED_RG_RGTC2);
+				case 142: return set_format(GL_COMPRESSED_SIGNED_RG_RGTC2);
+				case 143: return set_format(GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT);
+				case 144: return set_format(GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT);
+				case 145: return set_format(GL_COMPRESSED_RGBA_BPTC_UNORM);
+				case 146: return set_format(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM);
+				case 147: return set_format(GL_COMPRESSED_RGB8_ETC2);
+				case 148: return set_format(GL_COMPRESSED_SRGB8_ETC2);
+				case 149: return set_format(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2);
+				case 150: return set_format(GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2);
+				case 151: return set_format(GL_COMPRESSED_RGBA8_ETC2_EAC);
+				case 152: return set_format(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC);
+				case 153: return set_format(GL_COMPRESSED_R11_EAC);
+				case 154: return set_format(GL_COMPRESSED_SIGNED_R11_EAC);
+				case 155: return set_format(GL_COMPRESSED_RG11_EAC);
+				case 156: return set_format(GL_COMPRESSED_SIGNED_RG11_EAC);
+				case 157: return set_format(GL_COMPRESSED_RGBA_ASTC_4x4_KHR);
+				case 158: return set_format(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR);
+				default: return false;
+			}
+		}
+
+		bool parse_ktx2(){
+			constexpr size_t header_size = 80;
+			if(m_size < header_size) return fail("truncated KTX2 header");
+			uint32_t vk_format = read<uint32_t>(12);
+			uint32_t width = read<uint32_t>(20), height = read<uint32_t>(24), depth = read<uint32_t>(28);
+			uint32_t layers = read<uint32_t>(32), faces = read<uint32_t>(36), levels = read<uint32_t>(40);
+			uint32_t supercompression = read<uint32_t>(44);
+
+			if(supercompression != 0) return fail("supercompressed KTX2 files are not supported");
+			if(!ktx2_format(vk_format)) return fail("unsupported KTX2 format " + std::to_string(vk_format));
+			if(width == 0 || (faces != 1 && faces != 6) || (depth > 0 && (layers > 0 || faces == 6))) return fail("invalid KTX2 dimensions");
+
+			if(faces == 6) m_type = layers ? TextureType::CubeMapArray : TextureType::CubeMap;
+			else if(depth > 0) m_type = TextureType::Tex3D;
+			else if(height == 0) m_type = layers ? TextureType::Tex1DArray : TextureType::Tex1D;
+			else m_type = layers ? TextureType::Tex2DArray : TextureType::Tex2D;
+
+			m_width = width;
+			m_height = std::max<uint32_t>(height, 1);
+			m_depth = std::max<uint32_t>(depth, 1);
+			m_layers = std::max<uint32_t>(layers, 1);
+			m_faces = faces;
+			b_generate_mipmaps = levels == 0;
+			m_levels = std::max<uint32_t>(levels, 1);
+			if(m_levels > mip_levels(m_width, m_height, m_depth)) return fail("too many KTX2 levels");
+			if(!in_bounds(header_size, (uint64_t)m_levels * 24)) return fail("truncated KTX2 level index");
+
+			//each level holds its layers, faces and depth slices contiguously, in that order
+			size_t count = m_layers * m_faces;
+			for(uint32_t level = 0; level < m_levels; level++){
+				uint64_t offset = read<uint64_t>(header_size + level * 24);
+				uint64_t length = read<uint64_t>(header_size + level * 24 + 8);
+				size_t expected;
+				if(!level_size(level, count, expected) || length < expected || !in_bounds(offset, length)) return fail("invalid KTX2 level " + std::to_string(level));
+				m_images.push_back({ .level = (int)level, .first = 0, .count = count, .data = p_data + offset, .size = expected });
+			}
+
+			m_kind = Kind::KTX2;
+			return true;
+		}
+
+		static constexpr uint32_t fourcc(const char (&code)[5]){
+			return (uint32_t)(uint8_t)code[0] | ((uint32_t)(uint8_t)code[1] << 8) | ((uint32_t)(uint8_t)code[2] << 16) | ((uint32_t)(uint8_t)code[3] << 24);
+		}
+
+		bool dxgi_format(uint32_t dxgi){
+			switch(dxgi){
+				case 2: return set_format(GL_RGBA32F, GL_RGBA, GL_FLOAT);
+				case 10: return set_format(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+				case 24: return set_format(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+				case 26: return set_format(GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV);
+				case 28: return set_format(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+				case 29: return set_format(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE);
+				case 34: return set_format(GL_RG16F, GL_RG, GL_HALF_FLOAT);
+				case 41: return set_format(GL_R32F, GL_RED, GL_FLOAT);
+				case 49: return set_format(GL_RG8, GL_RG, GL_UNSIGNED_BYTE);
+				case 54: return set_format(GL_R16F, GL_RED, GL_HALF_FLOAT);
+				case 61: return set_format(GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+				case 67: return set_format(GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV);
+				case 71: return set_format(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+				case 72: return set_format(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT);
+				case 74: return set_format(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT);
+				case 75: return set_format(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT);
+				case 77: return set_format(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+				case 78: return set_format(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT);
+				case 80: return set_format(GL_COMPRESSED_RED_RGTC1);
+				case 81: return set_format(GL_COMPRESSED_SIGNED_RED_RGTC1);
+				case 83: return set_format(GL_COMPRESSED_RG_RGTC2);
+				case 84: return set_format(GL_COMPRESSED_SIGNED_RG_RGTC2);
+				case 87: return set_format(GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE);
+				case 91: return set_format(GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE);
+				case 95: return set_format(GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT);
+				case 96: return set_format(GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT);
+				case 98: return set_format(GL_COMPRESSED_RGBA_BPTC_UNORM);
+				case 99: return set_format(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM);
+				default: return false;
+			}
+		}
+
+		//pixel formats of files without the DX10 extension
+		bool legacy_format(uint32_t flags, uint32_t code, uint32_t bits, uint32_t red, uint32_t alpha){
+			constexpr uint32_t alpha_pixels = 0x1, has_fourcc = 0x4, rgb = 0x40, luminance = 0x20000;
+			if(flags & has_fourcc){
+				switch(code){
+					case fourcc("DXT1"): return set_format(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT);
+					case fourcc("DXT3"): return set_format(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT);
+					case fourcc("DXT5"): return set_format(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+					case fourcc("ATI1"): case fourcc("BC4U"): return set_format(GL_COMPRESSED_RED_RGTC1);
+					case fourcc("BC4S"): return set_format(GL_COMPRESSED_SIGNED_RED_RGTC1);
+					case fourcc("ATI2"): case fourcc("BC5U"): return set_format(GL_COMPRESSED_RG_RGTC2);
+					case fourcc("BC5S"): return set_format(GL_COMPRESSED_SIGNED_RG_RGTC2);
+					//D3DFMT codes
+					case 111: return set_format(GL_R16F, GL_RED, GL_HALF_FLOAT);
+					case 112: return set_format(GL_RG16F, GL_RG, GL_HALF_FLOAT);
+					case 113: return set_format(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+					case 114: return set_format(GL_R32F, GL_RED, GL_FLOAT);
+					case 115: return set_format(GL_RG32F, GL_RG, GL_FLOAT);
+					case 116: return set_format(GL_RGBA32F, GL_RGBA, GL_FLOAT);
+					default: return false;
+				}
+			}
+			if((flags & rgb) && bits == 32){
+				uint32_t internal_format = (flags & alpha_pixels) && alpha ? GL_RGBA8 : GL_RGB8;
+				if(red == 0x000000ff) return set_format(internal_format, GL_RGBA, GL_UNSIGNED_BYTE);
+				if(red == 0x00ff0000) return set_format(internal_format, GL_BGRA, GL_UNSIGNED_BYTE);
+			}
+			if((flags & rgb) && bits == 24){
+				if(red == 0x000000ff) return set_format(GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE);
+				if(red == 0x00ff0000) return set_format(GL_RGB8, GL_BGR, GL_UNSIGNED_BYTE);
+			}
+			if((flags & luminance) && bits == 8) return set_format(GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+			return false;
+		}
+
+		bool parse_dds(){
+			constexpr size_t header_size = 128, dx10_size = 20;
+			constexpr uint32_t mipmap_count = 0x20000, cube_map = 0x200, all_faces = 0xFC00, volume = 0x200000;
+			if(m_size < header_size || read<uint32_t>(4) != 124) return fail("truncated DDS header");
+			uint32_t flags = read<uint32_t>(8);
+			uint32_t height = read<uint32_t>(12), width = read<uint32_t>(16), depth = read<uint32_t>(24);
+			uint32_t levels = (flags & mipmap_count) ? std::max<uint32_t>(read<uint32_t>(28), 1) : 1;
+			uint32_t pf_flags = read<uint32_t>(80), code = read<uint32_t>(84);
+			uint32_t caps2 = read<uint32_t>(112);
+
+			size_t offset = header_size;
+			size_t array_size = 1;
+			if((pf_flags & 0x4) && code == fourcc("DX10")){
+				if(m_size < header_size + dx10_size) return fail("truncated DDS DX10 header");
+				uint32_t dxgi = read<uint32_t>(128), dimension = read<uint32_t>(132), misc = read<uint32_t>(136);
+				array_size = std::max<uint32_t>(read<uint32_t>(140), 1);
+				offset += dx10_size;
+				if(!dxgi_format(dxgi)) return fail("unsupported DXGI format " + std::to_string(dxgi));
+				switch(dimension){
+					case 2: m_type = array_size > 1 ? TextureType::Tex1DArray : TextureType::Tex1D; break;
+					case 3:
+						if(misc & 0x4) m_type = array_size > 1 ? TextureType::CubeMapArray : TextureType::CubeMap;
+						else m_type = array_size > 1 ? TextureType::Tex2DArray : TextureType::Tex2D;
+						break;
+					case 4: m_type = TextureType::Tex3D; break;
+					default: return fail("invalid DDS resource dimension");
+				}
+			} else {
+				if(!legacy_format(pf_flags, code, read<uint32_t>(88), read<uint32_t>(92), read<uint32_t>(104))) return fail("unsupported DDS pixel format");
+				if(caps2 & cube_map){
+					if((caps2 & all_faces) != all_faces) return fail("DDS cube maps must have every face");
+					m_type = TextureType::CubeMap;
+				} else if(caps2 & volume) m_type = TextureType::Tex3D;
+				else m_type = TextureType::Tex2D;
+			}
+
+			if(width == 0) return fail("invalid DDS dimensions");
+			m_width = width;
+			m_height = m_type == TextureType::Tex1D || m_type == TextureType::Tex1DArray ? 1 : std::max<uint32_t>(height, 1);
+			m_depth = m_type == TextureType::Tex3D ? std::max<uint32_t>(depth, 1) : 1;
+			m_layers = m_type == TextureType::Tex3D ? 1 : array_size;
+			m_faces = m_type == TextureType::CubeMap || m_type == TextureType::CubeMapArray ? 6 : 1;
+			m_levels = levels;
+			if(m_levels > mip_levels(m_width, m_height, m_depth)) return fail("too many DDS levels");
+
+			//each layer-face holds its whole mip chain
+			for(size_t layer_face = 0; layer_face < m_layers * m_faces; layer_face++){
+				for(uint32_t level = 0; level < m_levels; level++){
+					size_t size;
+					if(!level_size(level, 1, size)) return fail("invalid DDS level " + std::to_string(level));
+					if(!in_bounds(offset, size)) return fail("truncated DDS data");
+					m_images.push_back({ .level = (int)level, .first = layer_face, .count = 1, .data = p_data + offset, .size = size });
+					offset += size;
+				}
+			}
+
+			m_kind = Kind::DDS;
+			return true;
+		}
+};
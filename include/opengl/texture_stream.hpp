@@ -0,0 +1,306 @@
+#pragma once
+#include "texture.hpp"
+#include "buffer.hpp"
+#include "sync.hpp"
+#include "utils/thread_pool.hpp"
+#include <atomic>
+#include <deque>
+#include <list>
+
+/**
+ * @brief one streamed texture region
+ *
+ * `decode` runs on a worker thread and writes `bytes` tightly packed pixels (unpack alignment 1)
+ * straight into pixel unpack buffer memory, it must not touch GL. `on_complete` runs on the render
+ * thread once the upload is issued (true) or the decode failed (false).
+*/
+struct TextureUpload {
+	TextureInstance* texture = nullptr;
+	TextureRegion region;
+	size_t bytes = 0;
+	int32_t priority = 0; //orders uploads of the same level, higher first
+	std::function<bool(void* destination, size_t bytes)> decode;
+	std::function<void(bool uploaded)> on_complete;
+};
+
+/**
+ * @brief streams texture data through a persistently mapped pixel unpack ring
+ *
+ * requests wait in a queue ordered by mip level, coarsest (highest level) first, so a low resolution
+ * version of every texture shows up before the detail. each `update()`:
+ * - releases ring space whose uploads the GPU finished (tracked by fences)
+ * - issues `glTexSubImage*` from the ring for decoded requests until the per frame byte budget is spent
+ * - hands queued requests that fit in the ring to the thread pool for decoding
+ *
+ * the render thread never decodes nor copies pixels and never waits on the GPU.
+*/
+class TextureStreamer {
+	public:
+		struct Stats {
+			uint64_t requested = 0;
+			uint64_t uploaded = 0;
+			uint64_t failed = 0;
+			uint64_t cancelled = 0;
+			uint64_t bytes_uploaded = 0;
+			uint64_t budget_limited_frames = 0; //updates that left decoded uploads for the next ones
+			size_t frame_bytes = 0; //uploaded by the last update
+			size_t max_frame_bytes = 0;
+		};
+
+		/**
+		 * @param capacity bytes of the pixel unpack ring, bounds the data being decoded or uploaded at once
+		 * @param frame_budget bytes uploaded per `update()`, at least one upload is always issued
+		*/
+		TextureStreamer(ThreadPool& pool, size_t capacity = 64 << 20, size_t frame_budget = 8 << 20)
+			:m_pool(pool),m_buffer(BufferDescriptor{
+				.target = BufferTarget::PixelUnpack,
+				.usage = BufferUsage::StreamDraw,
+				.access = BufferAccess::WriteOnly
+			}),m_capacity(capacity),m_frame_budget(frame_budget){
+			if(capacity == 0) throw std::invalid_argument("TextureStreamer: capacity must not be zero");
+
+			m_buffer.immutable_storage(capacity, BufferStorageFlags::Write | BufferStorageFlags::Persistent | BufferStorageFlags::Coherent);
+			p_data = (uint8_t*)m_buffer.map_range(0, capacity, BufferMapFlags::Write | BufferMapFlags::Persistent | BufferMapFlags::Coherent);
+			if(!p_data) throw GLError("TextureStreamer", "could not map the pixel unpack buffer");
+			//allocating binds it without DSA, client memory uploads must not read from it
+			m_buffer.unbind();
+		}
+
+		TextureStreamer(const TextureStreamer& other) = delete;
+
+		~TextureStreamer(){
+			//workers write into the mapping, it must outlive them
+			while(m_decoding.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+			m_regions.clear();
+			if(m_buffer.is_valid()) m_buffer.unmap_memory();
+		}
+
+		/**
+		 * @brief queues an upload, the texture must outlive it or be passed to `cancel`
+		*/
+		void request(TextureUpload upload){
+			if(!upload.texture || !upload.decode || upload.bytes == 0) throw std::invalid_argument("TextureStreamer: upload needs a texture, a decoder and a size");
+			auto job = std::make_shared<Job>();
+			job->upload = std::move(upload);
+			job->sequence = m_sequence++;
+			m_queued.push_back(std::move(job));
+			b_sorted = false;
+			m_stats.requested++;
+		}
+
+		/**
+		 * @brief advances the pipeline, call once per frame on the render thread
+		 * @return uploads issued
+		*/
+		size_t update(){
+			retire();
+			size_t issued = upload();
+			dispatch();
+			return issued;
+		}
+
+		/**
+		 * @brief drops every upload of `texture` not issued yet, their `on_complete` is not called
+		 * @return uploads dropped
+		*/
+		size_t cancel(const TextureInstance& texture){
+			size_t cancelled = 0;
+			for(auto it = m_queued.begin(); it != m_queued.end();){
+				if((*it)->upload.texture == &texture){
+					it = m_queued.erase(it);
+					cancelled++;
+				} else ++it;
+			}
+			for(auto it = m_in_flight.begin(); it != m_in_flight.end();){
+				Job& job = **it;
+				if(job.upload.texture != &texture){
+					++it;
+					continue;
+				}
+				cancelled++;
+				if(job.state.load(std::memory_order_acquire) == JobState::Decoding){
+					//the worker still writes into its region, released once it's done
+					job.cancelled = true;
+					++it;
+				} else {
+					job.region->released = true;
+					it = m_in_flight.erase(it);
+				}
+			}
+			m_stats.cancelled += cancelled;
+			return cancelled;
+		}
+
+		inline size_t pending() const { return m_queued.size() + m_in_flight.size(); }
+		inline size_t used() const { return m_used; }
+		inline size_t capacity() const { return m_capacity; }
+
+		inline void set_frame_budget(size_t bytes){ m_frame_budget = bytes; }
+		inline size_t frame_budget() const { return m_frame_budget; }
+
+		inline const Stats& stats() const { return m_stats; }
+		inline void reset_stats(){ m_stats = {}; }
+
+	private:
+		static constexpr size_t alignment = 16;
+
+		enum class JobState: uint8_t {
+			Queued,
+			Decoding,
+			Decoded,
+			Failed
+		};
+
+		//ring space of one job, in allocation order
+		struct Region {
+			size_t size = 0; //includes alignment padding and wrap tails
+			std::shared_ptr<Fence> fence; //set once uploaded
+			bool released = false; //freed without upload
+		};
+
+		struct Job {
+			TextureUpload upload;
+			uint64_t sequence = 0;
+			size_t offset = 0;
+			Region* region = nullptr;
+			std::atomic<JobState> state = JobState::Queued;
+			bool cancelled = false;
+		};
+
+		ThreadPool& m_pool;
+		BufferInstance m_buffer;
+		uint8_t* p_data = nullptr;
+		size_t m_capacity = 0;
+		size_t m_frame_budget = 0;
+
+		size_t m_head = 0;
+		size_t m_used = 0;
+		std::deque<Region> m_regions;
+
+		std::deque<std::shared_ptr<Job>> m_queued;
+		std::list<std::shared_ptr<Job>> m_in_flight; //decoding or decoded, in dispatch order
+		std::atomic<size_t> m_decoding = 0;
+		uint64_t m_sequence = 0;
+		bool b_sorted = true;
+		Stats m_stats;
+
+		bool reserve(size_t size, size_t& offset, size_t& consumed){
+			size_t start = (m_head + alignment - 1) / alignment * alignment;
+			if(start + size > m_capacity) start = 0; //the tail of the ring is wasted
+			consumed = (start >= m_head ? start - m_head : m_capacity - m_head) + size;
+			if(m_used + consumed > m_capacity) return false;
+			offset = start;
+			m_head = start + size;
+			m_used += consumed;
+			return true;
+		}
+
+		void retire(){
+			while(!m_regions.empty()){
+				Region& region = m_regions.front();
+				if(!region.released && !region.fence) break;
+				if(region.fence && !region.fence->signaled()) break;
+				m_used -= region.size;
+				m_regions.pop_front();
+			}
+			if(m_regions.empty()) m_head = m_used = 0;
+		}
+
+		size_t upload(){
+			std::shared_ptr<Fence> fence;
+			int32_t unpack_alignment = 4;
+			size_t bytes = 0, issued = 0;
+
+			for(auto it = m_in_flight.begin(); it != m_in_flight.end();){
+				Job& job = **it;
+				JobState state = job.state.load(std::memory_order_acquire);
+				if(state == JobState::Decoding){
+					++it;
+					continue;
+				}
+				if(job.cancelled){
+					job.region->released = true;
+					it = m_in_flight.erase(it);
+					continue;
+				}
+				if(state == JobState::Failed){
+					job.region->released = true;
+					m_stats.failed++;
+					if(job.upload.on_complete) job.upload.on_complete(false);
+					it = m_in_flight.erase(it);
+					continue;
+				}
+
+				if(issued > 0 && bytes + job.upload.bytes > m_frame_budget){
+					m_stats.budget_limited_frames++;
+					break;
+				}
+				if(!fence){
+					fence = std::make_shared<Fence>();
+					SAFE_CALL( TextureStreamerUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment) );
+					SAFE_CALL( TextureStreamerUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+					m_buffer.bind();
+				}
+				job.upload.texture->update(job.upload.region, (const void*)(uintptr_t)job.offset);
+				job.region->fence = fence;
+				bytes += job.upload.bytes;
+				issued++;
+				if(job.upload.on_complete) job.upload.on_complete(true);
+				it = m_in_flight.erase(it);
+			}
+
+			if(fence){
+				//a bound unpack buffer would turn later client memory uploads into offsets
+				m_buffer.unbind();
+				SAFE_CALL( TextureStreamerUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment) );
+				fence->insert();
+			}
+
+			m_stats.uploaded += issued;
+			m_stats.bytes_uploaded += bytes;
+			m_stats.frame_bytes = bytes;
+			m_stats.max_frame_bytes = std::max(m_stats.max_frame_bytes, bytes);
+			return issued;
+		}
+
+		void dispatch(){
+			if(!b_sorted){
+				std::stable_sort(m_queued.begin(), m_queued.end(), [](const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b){
+					if(a->upload.region.level != b->upload.region.level) return a->upload.region.level > b->upload.region.level;
+					if(a->upload.priority != b->upload.priority) return a->upload.priority > b->upload.priority;
+					return a->sequence < b->sequence;
+				});
+				b_sorted = true;
+			}
+
+			while(!m_queued.empty()){
+				std::shared_ptr<Job> job = m_queued.front();
+				if(job->upload.bytes > m_capacity){
+					LOG_ERROR( TextureStreamer, "upload of " << job->upload.bytes << " bytes doesn't fit in the ring" );
+					m_queued.pop_front();
+					m_stats.failed++;
+					if(job->upload.on_complete) job->upload.on_complete(false);
+					continue;
+				}
+
+				size_t offset, consumed;
+				if(!reserve(job->upload.bytes, offset, consumed)) break;
+				m_queued.pop_front();
+				m_regions.push_back({ .size = consumed, .fence = nullptr, .released = false });
+				job->region = &m_regions.back();
+				job->offset = offset;
+				job->state.store(JobState::Decoding, std::memory_order_relaxed);
+				m_in_flight.push_back(job);
+
+				m_decoding.fetch_add(1, std::memory_order_relaxed);
+				m_pool.submit([job, destination = p_data + offset, decoding = &m_decoding](){
+					bool decoded = false;
+					try {
+						decoded = job->upload.decode(destination, job->upload.bytes);
+					} catch(...){}
+					job->state.store(decoded ? JobState::Decoded : JobState::Failed, std::memory_order_release);
+					decoding->fetch_sub(1, std::memory_order_release);
+				});
+			}
+		}
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include "texture.hpp"
+#include <unordered_map>
+
+/**
+ * @brief assigns texture units per draw and binds whole sets at once
+ *
+ * textures keep the unit they got until it's the least recently used one and another draw
+ * needs it, so textures shared by consecutive draws stay bound. each `bind` issues at most one
+ * glBindTextures and one glBindSamplers call (over the units that changed), falling back to
+ * per unit calls when multi bind isn't available. the assigned unit is written to the texture
+ * slot, read it back with `slot()` to set the sampler uniforms.
+*/
+class TextureUnitManager {
+	public:
+		static constexpr uint8_t no_unit = 0xff;
+
+		struct FrameStats {
+			uint64_t draws = 0;
+			uint64_t textures = 0;
+			uint64_t resident = 0; //textures found already bound to their unit
+			uint64_t evictions = 0;
+			uint64_t calls = 0; //driver calls issued
+			uint64_t naive_calls = 0; //calls binding every texture on its own would have issued
+
+			inline double calls_per_draw() const { return draws ? (double)calls / draws : 0.0; }
+			inline double naive_calls_per_draw() const { return draws ? (double)naive_calls / draws : 0.0; }
+		};
+
+		/**
+		 * @param first_unit units below it are left to other code
+		 * @param units amount of units managed, 0 takes every unit up to `max_texture_slots`
+		*/
+		TextureUnitManager(uint8_t first_unit = 0, uint8_t units = 0):m_first(first_unit){
+			size_t available = GlobalContextConfig.max_texture_slots > first_unit ? GlobalContextConfig.max_texture_slots - first_unit : 0;
+			m_units.resize(units ? std::min<size_t>(units, available) : available);
+		}
+
+		/**
+		 * @brief makes every texture of a draw resident on some unit and binds what changed
+		 * @throw TextureError when there are more textures than managed units
+		*/
+		void bind(TextureInstance* const* textures, size_t count){
+			if(count > m_units.size()) throw TextureError(TextureErrorType::UnitsExhausted);
+			m_draw++;
+			m_frame.draws++;
+			m_frame.textures += count;
+
+			size_t low = m_units.size(), high = 0;
+			auto place = [&](TextureInstance* texture, size_t unit){
+				Unit& u = m_units[unit];
+				u.texture = texture->id();
+				u.target = texture->target();
+				u.sampler = texture->sampler();
+				u.last_use = m_draw;
+				texture->setSlot((uint8_t)(m_first + unit));
+				low = std::min(low, unit);
+				high = std::max(high, unit + 1);
+				m_frame.naive_calls += texture->sampler() ? 3 : 2;
+			};
+
+			//resident textures first, so a miss can't evict a unit this draw still needs
+			m_pending.clear();
+			for(size_t i = 0; i < count; i++){
+				TextureInstance* texture = textures[i];
+				auto it = m_resident.find(texture->id());
+				if(it != m_resident.end() && m_units[it->second].texture == texture->id()){
+					m_frame.resident += m_units[it->second].last_use != m_draw;
+					place(texture, it->second);
+				} else m_pending.push_back(texture);
+			}
+
+			for(TextureInstance* texture: m_pending){
+				//repeated textures of the same draw were placed by an earlier iteration
+				auto it = m_resident.find(texture->id());
+				if(it != m_resident.end() && m_units[it->second].texture == texture->id()){
+					place(texture, it->second);
+					continue;
+				}
+				size_t unit = least_recently_used();
+				if(m_units[unit].texture){
+					m_resident.erase(m_units[unit].texture);
+					m_frame.evictions++;
+				}
+				m_resident[texture->id()] = unit;
+				place(texture, unit);
+			}
+			if(low >= high) return;
+
+			m_targets.resize(high - low);
+			m_ids.resize(high - low);
+			m_samplers.resize(high - low);
+			for(size_t unit = low; unit < high; unit++){
+				m_targets[unit - low] = m_units[unit].target;
+				m_ids[unit - low] = m_units[unit].texture;
+				m_samplers[unit - low] = m_units[unit].sampler;
+			}
+			uint8_t first = (uint8_t)(m_first + low);
+			m_frame.calls += GlobalBindingCache.bind_textures(first, high - low, m_targets.data(), m_ids.data());
+			m_frame.calls += GlobalBindingCache.bind_samplers(first, high - low, m_samplers.data());
+		}
+
+		inline void bind(std::initializer_list<TextureInstance*> textures){ bind(textures.begin(), textures.size()); }
+		inline void bind(const std::vector<TextureInstance*>& textures){ bind(textures.data(), textures.size()); }
+
+		/**
+		 * @return unit holding the texture or `no_unit`
+		*/
+		uint8_t unit_of(const TextureInstance& texture) const {
+			auto it = m_resident.find(texture.id());
+			if(it == m_resident.end() || m_units[it->second].texture != texture.id()) return no_unit;
+			return (uint8_t)(m_first + it->second);
+		}
+
+		//the units keep their textures across frames, this only rolls the counters
+		void begin_frame(){
+			m_last_frame = m_frame;
+			m_frame = {};
+		}
+
+		/**
+		 * @brief forgets every assignment, call it together with `GlobalBindingCache.invalidate()`
+		*/
+		void invalidate(){
+			for(auto& unit: m_units) unit = {};
+			m_resident.clear();
+		}
+
+		inline size_t units() const { return m_units.size(); }
+		inline uint8_t first_unit() const { return m_first; }
+		inline const FrameStats& frame() const { return m_frame; }
+		inline const FrameStats& last_frame() const { return m_last_frame; }
+
+	private:
+		struct Unit {
+			uint32_t texture = 0;
+			uint32_t target = GL_TEXTURE_2D;
+			uint32_t sampler = 0;
+			uint64_t last_use = 0;
+		};
+
+		uint8_t m_first = 0;
+		uint64_t m_draw = 0;
+		std::vector<Unit> m_units;
+		std::unordered_map<uint32_t, size_t> m_resident; //texture name -> unit index
+		std::vector<TextureInstance*> m_pending;
+		std::vector<uint32_t> m_targets, m_ids, m_samplers;
+		FrameStats m_frame, m_last_frame;
+
+		//never returns a unit used by the current draw, bind() checked there are enough of them
+		size_t least_recently_used() const {
+			size_t best = 0;
+			for(size_t i = 1; i < m_units.size(); i++){
+				if(m_units[i].last_use < m_units[best].last_use) best = i;
+			}
+			return best;
+		}
+};
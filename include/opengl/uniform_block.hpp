@@ -0,0 +1,359 @@
+#pragma once
+#include "buffer.hpp"
+#include "shader.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+enum class BlockPacking: uint8_t {
+	Std140,
+	Std430
+};
+
+/**
+ * @brief C++ mirrors of GLSL types, used to describe block layouts (and to store block members)
+ * @note matrices are column major, mat3 columns are padded to vec4 as both packings require
+*/
+namespace glsl {
+	using uint = uint32_t;
+	struct boolean { uint32_t value; };
+
+	struct vec2 { float x, y; };
+	struct vec3 { float x, y, z; };
+	struct vec4 { float x, y, z, w; };
+	struct ivec2 { int32_t x, y; };
+	struct ivec3 { int32_t x, y, z; };
+	struct ivec4 { int32_t x, y, z, w; };
+	struct uvec2 { uint32_t x, y; };
+	struct uvec3 { uint32_t x, y, z; };
+	struct uvec4 { uint32_t x, y, z, w; };
+	struct dvec2 { double x, y; };
+	struct dvec3 { double x, y, z; };
+	struct dvec4 { double x, y, z, w; };
+
+	struct mat2 { float m[4]; };
+	struct mat3 { float m[3][4]; };
+	struct mat4 { float m[16]; };
+}
+
+/**
+ * @brief base alignment and size of a member type for a given packing
+*/
+template<BlockPacking P, typename T>
+struct GlslLayout;
+
+namespace layout_detail {
+	constexpr size_t round_up(size_t value, size_t alignment){ return (value + alignment - 1) / alignment * alignment; }
+
+	template<size_t A, size_t S>
+	struct Basic {
+		static constexpr size_t alignment = A;
+		static constexpr size_t size = S;
+	};
+}
+
+template<BlockPacking P> struct GlslLayout<P, float>: layout_detail::Basic<4,4> {};
+template<BlockPacking P> struct GlslLayout<P, int32_t>: layout_detail::Basic<4,4> {};
+template<BlockPacking P> struct GlslLayout<P, uint32_t>: layout_detail::Basic<4,4> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::boolean>: layout_detail::Basic<4,4> {};
+template<BlockPacking P> struct GlslLayout<P, double>: layout_detail::Basic<8,8> {};
+
+template<BlockPacking P> struct GlslLayout<P, glsl::vec2>: layout_detail::Basic<8,8> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::vec3>: layout_detail::Basic<16,12> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::vec4>: layout_detail::Basic<16,16> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::ivec2>: layout_detail::Basic<8,8> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::ivec3>: layout_detail::Basic<16,12> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::ivec4>: layout_detail::Basic<16,16> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::uvec2>: layout_detail::Basic<8,8> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::uvec3>: layout_detail::Basic<16,12> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::uvec4>: layout_detail::Basic<16,16> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::dvec2>: layout_detail::Basic<16,16> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::dvec3>: layout_detail::Basic<32,24> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::dvec4>: layout_detail::Basic<32,32> {};
+
+//matrices are arrays of column vectors
+template<> struct GlslLayout<BlockPacking::Std140, glsl::mat2>: layout_detail::Basic<16,32> {};
+template<> struct GlslLayout<BlockPacking::Std430, glsl::mat2>: layout_detail::Basic<8,16> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::mat3>: layout_detail::Basic<16,48> {};
+template<BlockPacking P> struct GlslLayout<P, glsl::mat4>: layout_detail::Basic<16,64> {};
+
+//arrays: std140 rounds the element stride and alignment up to a vec4
+template<BlockPacking P, typename T, size_t N>
+struct GlslLayout<P, T[N]> {
+	static constexpr size_t element_alignment = P == BlockPacking::Std140 ? layout_detail::round_up(GlslLayout<P,T>::alignment, 16) : GlslLayout<P,T>::alignment;
+	static constexpr size_t stride = layout_detail::round_up(GlslLayout<P,T>::size, element_alignment);
+	static constexpr size_t alignment = element_alignment;
+	static constexpr size_t size = stride * N;
+};
+
+namespace layout_detail {
+	template<size_t N>
+	struct Computed {
+		std::array<size_t, N> offsets{};
+		size_t end = 0;
+		size_t alignment = 0;
+	};
+
+	template<BlockPacking P, typename... Members>
+	constexpr Computed<sizeof...(Members)> compute(){
+		Computed<sizeof...(Members)> computed;
+		size_t cursor = 0, index = 0;
+		((cursor = round_up(cursor, GlslLayout<P,Members>::alignment),
+		  computed.offsets[index++] = cursor,
+		  cursor += GlslLayout<P,Members>::size,
+		  computed.alignment = std::max(computed.alignment, GlslLayout<P,Members>::alignment)), ...);
+		computed.end = cursor;
+		if(P == BlockPacking::Std140) computed.alignment = round_up(computed.alignment, 16);
+		return computed;
+	}
+}
+
+/**
+ * @brief compile time offsets of a GLSL block (or struct) made of `Members` in declaration order
+ *
+ * ```cpp
+ * using CameraLayout = BlockLayout<BlockPacking::Std140, glsl::mat4, glsl::mat4, glsl::vec3, float>;
+ * static_assert(CameraLayout::offset(3) == 140);
+ * ```
+ * a BlockLayout can be used as member type to describe nested structs
+*/
+template<BlockPacking P, typename... Members>
+struct BlockLayout {
+	static_assert(sizeof...(Members) > 0, "BlockLayout needs at least one member");
+
+	static constexpr BlockPacking packing = P;
+	static constexpr size_t count = sizeof...(Members);
+
+	private:
+		static constexpr auto computed = layout_detail::compute<P, Members...>();
+
+	public:
+		static constexpr std::array<size_t, sizeof...(Members)> offsets = computed.offsets;
+		static constexpr size_t alignment = computed.alignment;
+		static constexpr size_t size = layout_detail::round_up(computed.end, computed.alignment);
+
+		static constexpr size_t offset(size_t index){ return offsets[index]; }
+};
+
+template<BlockPacking P, BlockPacking Q, typename... Members>
+struct GlslLayout<P, BlockLayout<Q, Members...>> {
+	static_assert(P == Q, "nested struct layouts must use the packing of the block");
+	static constexpr size_t alignment = BlockLayout<Q, Members...>::alignment;
+	static constexpr size_t size = BlockLayout<Q, Members...>::size;
+};
+
+/**
+ * @brief checks at compile time that a C++ struct member sits where the GLSL layout expects it
+*/
+#define UNIFORM_BLOCK_MEMBER(Type, Layout, Index, Member) \
+	static_assert(offsetof(Type, Member) == Layout::offset(Index), "offset of "#Type"::"#Member" doesn't match the GLSL layout")
+
+/**
+ * @brief type erased part of a block: CPU shadow copy, dirty range and placement in the manager buffer
+*/
+class UniformBlockBase {
+	public:
+		UniformBlockBase(const UniformBlockBase& other) = delete;
+		virtual ~UniformBlockBase() = default;
+
+		inline uint32_t binding() const { return m_binding; }
+		inline size_t size() const { return m_size; }
+		inline bool dirty() const { return m_dirty_end > m_dirty_begin; }
+		inline BlockPacking packing() const { return m_packing; }
+
+		/**
+		 * @brief compares the layout against the one the linked program reflects for `block_name`
+		 * @return false (and a message in `error`) when sizes or member offsets differ
+		*/
+		bool validate(const ShaderProgramInstance& program, const std::string& block_name, std::string* error = nullptr) const {
+			bool storage = m_packing == BlockPacking::Std430;
+			uint32_t block_interface = storage ? GL_SHADER_STORAGE_BLOCK : GL_UNIFORM_BLOCK;
+			uint32_t member_interface = storage ? GL_BUFFER_VARIABLE : GL_UNIFORM;
+
+			uint32_t index = GL_INVALID_INDEX;
+			SAFE_CALL( BlockResourceIndex, index = glGetProgramResourceIndex(program.id(), block_interface, block_name.c_str()) );
+			if(index == GL_INVALID_INDEX) return fail(error, "block '" + block_name + "' is not active in the program");
+
+			const uint32_t properties[2] = { GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+			int32_t values[2] = { 0, 0 };
+			SAFE_CALL( BlockResource, glGetProgramResourceiv(program.id(), block_interface, index, 2, properties, 2, nullptr, values) );
+			if((size_t)values[0] != m_size){
+				return fail(error, "block '" + block_name + "' is " + std::to_string(values[0]) + " bytes in GLSL and " + std::to_string(m_size) + " bytes in C++");
+			}
+
+			std::vector<int32_t> variables(values[1]);
+			const uint32_t active = GL_ACTIVE_VARIABLES;
+			if(!variables.empty()){
+				SAFE_CALL( BlockVariables, glGetProgramResourceiv(program.id(), block_interface, index, 1, &active, (int32_t)variables.size(), nullptr, variables.data()) );
+			}
+			std::vector<size_t> reflected;
+			const uint32_t offset_property = GL_OFFSET;
+			for(int32_t variable: variables){
+				int32_t offset = 0;
+				SAFE_CALL( BlockVariableOffset, glGetProgramResourceiv(program.id(), member_interface, variable, 1, &offset_property, 1, nullptr, &offset) );
+				reflected.push_back((size_t)offset);
+			}
+			std::sort(reflected.begin(), reflected.end());
+
+			//nested structs are flattened by the reflection, only plain members can be compared one to one
+			if(reflected.size() != m_offsets.size()) return true;
+			for(size_t i = 0; i < reflected.size(); i++){
+				if(reflected[i] != m_offsets[i]){
+					return fail(error, "member " + std::to_string(i) + " of block '" + block_name + "' is at offset " + std::to_string(reflected[i]) + " in GLSL and " + std::to_string(m_offsets[i]) + " in C++");
+				}
+			}
+			return true;
+		}
+
+	protected:
+		UniformBlockBase(uint32_t binding, size_t size, BlockPacking packing, const size_t* offsets, size_t count)
+			:m_binding(binding),m_size(size),m_packing(packing),m_offsets(offsets, offsets + count){
+			std::sort(m_offsets.begin(), m_offsets.end());
+		}
+
+		uint32_t m_binding = 0;
+		size_t m_size = 0;
+		BlockPacking m_packing;
+		std::vector<size_t> m_offsets;
+
+		size_t m_dirty_begin = 0;
+		size_t m_dirty_end = 0;
+
+		//placement inside the manager buffer
+		size_t m_offset = 0;
+
+		inline void mark_dirty(size_t begin, size_t end){
+			if(!dirty()){
+				m_dirty_begin = begin;
+				m_dirty_end = end;
+			} else {
+				m_dirty_begin = std::min(m_dirty_begin, begin);
+				m_dirty_end = std::max(m_dirty_end, end);
+			}
+		}
+		inline void clean(){ m_dirty_begin = m_dirty_end = 0; }
+
+		virtual const uint8_t* bytes() const = 0;
+
+		static bool fail(std::string* error, const std::string& message){
+			if(error) *error = message;
+			return false;
+		}
+
+		friend class UniformBlockManager;
+};
+
+/**
+ * @brief CPU copy of a block described by `Layout`, only the changed bytes are uploaded
+*/
+template<typename T, typename Layout>
+class UniformBlock: public UniformBlockBase {
+	static_assert(std::is_trivially_copyable<T>::value && std::is_standard_layout<T>::value, "block type must be a plain struct");
+	static_assert(sizeof(T) == Layout::size, "size of the C++ struct doesn't match the GLSL layout (missing padding?)");
+
+	public:
+		UniformBlock(uint32_t binding, const T& data = T{})
+			:UniformBlockBase(binding, Layout::size, Layout::packing, Layout::offsets.data(), Layout::count),m_data(data){
+			mark_dirty(0, sizeof(T));
+		}
+
+		inline const T& get() const { return m_data; }
+
+		void set(const T& data){
+			if(memcmp(&m_data, &data, sizeof(T)) == 0) return;
+			m_data = data;
+			mark_dirty(0, sizeof(T));
+		}
+
+		/**
+		 * @brief changes a single member, marking only its bytes
+		*/
+		template<typename M>
+		void set(M T::* member, const M& value){
+			M& field = m_data.*member;
+			if(memcmp(&field, &value, sizeof(M)) == 0) return;
+			field = value;
+			size_t begin = (size_t)((const uint8_t*)&field - (const uint8_t*)&m_data);
+			mark_dirty(begin, begin + sizeof(M));
+		}
+
+		/**
+		 * @brief direct access, the whole block is uploaded on the next frame
+		*/
+		T& edit(){
+			mark_dirty(0, sizeof(T));
+			return m_data;
+		}
+
+	protected:
+		T m_data;
+
+		const uint8_t* bytes() const override { return (const uint8_t*)&m_data; }
+};
+
+/**
+ * @brief places blocks into a single uniform (std140) or shader storage (std430) buffer
+ *
+ * blocks must outlive the manager, `upload()` once per frame sends the dirty ranges
+ * and binds every block range to its binding point
+*/
+class UniformBlockManager {
+	public:
+		UniformBlockManager(BlockPacking packing = BlockPacking::Std140)
+			:m_packing(packing),
+			m_buffer(BufferDescriptor{
+				.target = packing == BlockPacking::Std140 ? BufferTarget::Uniform : BufferTarget::ShaderStorage,
+				.usage = BufferUsage::DynamicDraw,
+				.access = BufferAccess::WriteOnly
+			}){}
+
+		void add(UniformBlockBase& block){
+			if(block.packing() != m_packing) throw std::invalid_argument("UniformBlockManager: block packing doesn't match the buffer target");
+			size_t alignment = (size_t)(m_packing == BlockPacking::Std140 ? GlobalContextConfig.uniform_offset_alignment : GlobalContextConfig.storage_offset_alignment);
+			block.m_offset = layout_detail::round_up(m_size, alignment ? alignment : 1);
+			block.mark_dirty(0, block.size());
+			m_size = block.m_offset + block.size();
+			m_blocks.push_back(&block);
+			b_resized = true;
+		}
+
+		/**
+		 * @brief uploads the changed bytes of every block and binds their ranges
+		 * @return amount of bytes uploaded
+		*/
+		size_t upload(){
+			if(m_blocks.empty()) return 0;
+			if(b_resized){
+				m_buffer.storage(m_size);
+				b_resized = false;
+				for(auto* block: m_blocks) block->mark_dirty(0, block->size());
+			}
+
+			size_t uploaded = 0;
+			for(auto* block: m_blocks){
+				if(!block->dirty()) continue;
+				size_t length = block->m_dirty_end - block->m_dirty_begin;
+				m_buffer.sub_data((void*)(block->bytes() + block->m_dirty_begin), length, block->m_offset + block->m_dirty_begin);
+				block->clean();
+				uploaded += length;
+			}
+
+			for(auto* block: m_blocks) m_buffer.bind_range(block->binding(), block->m_offset, block->size());
+			m_uploaded += uploaded;
+			return uploaded;
+		}
+
+		inline BufferInstance& buffer(){ return m_buffer; }
+		inline size_t size() const { return m_size; }
+		inline size_t uploaded_bytes() const { return m_uploaded; }
+
+	private:
+		BlockPacking m_packing;
+		BufferInstance m_buffer;
+		std::vector<UniformBlockBase*> m_blocks;
+		size_t m_size = 0;
+		size_t m_uploaded = 0;
+		bool b_resized = false;
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief read only memory mapping of a whole file
+*/
+class MappedFile {
+	public:
+		MappedFile() = default;
+		MappedFile(const std::filesystem::path& path){ open(path); }
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile(MappedFile&& other){ *this = std::move(other); }
+
+		MappedFile& operator=(MappedFile&& other){
+			if(this != &other){
+				close();
+				m_data = other.m_data;
+				m_size = other.m_size;
+				#ifdef _WIN32
+				m_file = other.m_file;
+				m_mapping = other.m_mapping;
+				other.m_file = INVALID_HANDLE_VALUE;
+				other.m_mapping = nullptr;
+				#endif
+				other.m_data = nullptr;
+				other.m_size = 0;
+			}
+			return *this;
+		}
+
+		~MappedFile(){ close(); }
+
+		/**
+		 * @return false if the file doesn't exist, is empty or can't be mapped
+		*/
+		bool open(const std::filesystem::path& path){
+			close();
+			#ifdef _WIN32
+			m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if(m_file == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER sz;
+			if(!GetFileSizeEx(m_file, &sz) || sz.QuadPart == 0){ close(); return false; }
+			m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if(!m_mapping){ close(); return false; }
+			m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			if(!m_data){ close(); return false; }
+			m_size = (size_t)sz.QuadPart;
+			#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if(fd < 0) return false;
+			struct stat info;
+			if(fstat(fd, &info) != 0 || info.st_size == 0){ ::close(fd); return false; }
+			void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);//the mapping keeps the file alive
+			if(data == MAP_FAILED) return false;
+			m_data = (const uint8_t*)data;
+			m_size = (size_t)info.st_size;
+			#endif
+			return true;
+		}
+
+		void close(){
+			#ifdef _WIN32
+			if(m_data) UnmapViewOfFile(m_data);
+			if(m_mapping) CloseHandle(m_mapping);
+			if(m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+			m_mapping = nullptr;
+			m_file = INVALID_HANDLE_VALUE;
+			#else
+			if(m_data) munmap((void*)m_data, m_size);
+			#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		inline const uint8_t* data() const { return m_data; }
+		inline size_t size() const { return m_size; }
+		inline bool is_open() const { return m_data != nullptr; }
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		#ifdef _WIN32
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+		#endif
+};
+
+/**
+ * @brief writes `parts` into a temporary file next to `path` and renames it over `path`,
+ * readers see either the old or the whole new file
+*/
+inline bool write_file_atomic(const std::filesystem::path& path, std::initializer_list<std::pair<const void*, size_t>> parts){
+	//unique per process and per call, threads saving at the same time don't share a temporary file
+	static std::atomic<uint32_t> s_counter = 0;
+	std::filesystem::path temp = path;
+	#ifdef _WIN32
+	temp += ".tmp" + std::to_string(GetCurrentProcessId());
+	#else
+	temp += ".tmp" + std::to_string(getpid());
+	#endif
+	temp += "." + std::to_string(s_counter.fetch_add(1, std::memory_order_relaxed));
+
+	FILE* file = fopen(temp.string().c_str(), "wb");
+	if(!file) return false;
+	bool ok = true;
+	for(auto& [data, sz]: parts) ok = ok && fwrite(data, 1, sz, file) == sz;
+	ok = fclose(file) == 0 && ok;
+
+	std::error_code error;
+	if(ok) std::filesystem::rename(temp, path, error);
+	if(!ok || error){
+		std::filesystem::remove(temp, error);
+		return false;
+	}
+	return true;
+}
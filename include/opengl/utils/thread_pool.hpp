@@ -0,0 +1,124 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief fixed set of worker threads running queued tasks in submission order
+ * @note tasks must not touch GL, workers have no context current
+*/
+class ThreadPool {
+	public:
+		ThreadPool(size_t threads = default_threads()){
+			threads = std::max<size_t>(threads, 1);
+			for(size_t i = 0; i < threads; i++) m_workers.emplace_back([this](){ worker_loop(); });
+		}
+
+		ThreadPool(const ThreadPool& other) = delete;
+
+		/**
+		 * @brief runs every queued task before joining the workers
+		*/
+		~ThreadPool(){
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_condition.notify_all();
+			for(auto& worker: m_workers) worker.join();
+		}
+
+		void submit(std::function<void()> task){
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_tasks.push_back(std::move(task));
+			}
+			m_condition.notify_one();
+		}
+
+		/**
+		 * @brief blocks until the queue is empty and no task is running
+		*/
+		void wait_idle(){
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_idle.wait(lock, [this](){ return m_tasks.empty() && m_running == 0; });
+		}
+
+		inline size_t size() const { return m_workers.size(); }
+
+		static size_t default_threads(){
+			unsigned int hardware = std::thread::hardware_concurrency();
+			//one core is left to the render thread
+			return hardware > 1 ? hardware - 1 : 1;
+		}
+
+	private:
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::condition_variable m_idle;
+		size_t m_running = 0;
+		bool m_stop = false;
+
+		void worker_loop(){
+			while(true){
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_condition.wait(lock, [this](){ return m_stop || !m_tasks.empty(); });
+					if(m_tasks.empty()) return;
+					task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+					m_running++;
+				}
+
+				try {
+					task();
+				} catch(...){
+					//tasks report their own failures, an escaping exception must not kill the worker
+				}
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_running--;
+				if(m_tasks.empty() && m_running == 0) m_idle.notify_all();
+			}
+		}
+};
+
+/**
+ * @brief runs `f(begin, end)` over `[0, count)` in chunks, on the pool and the calling thread
+ * @note the caller takes chunks as well, so it's safe to call from a task of the same pool
+*/
+template<typename F>
+void parallel_for(ThreadPool* pool, size_t count, size_t chunk, F&& f){
+	chunk = std::max<size_t>(chunk, 1);
+	size_t chunks = (count + chunk - 1) / chunk;
+	if(!pool || chunks < 2){
+		if(count) f(0, count);
+		return;
+	}
+
+	struct Shared {
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+	};
+	auto shared = std::make_shared<Shared>();
+	//helpers only touch `f` after claiming a chunk, which can't happen once every chunk is done
+	auto work = [shared, chunks, chunk, count, &f](){
+		for(size_t i = shared->next.fetch_add(1); i < chunks; i = shared->next.fetch_add(1)){
+			f(i * chunk, std::min(count, (i + 1) * chunk));
+			shared->done.fetch_add(1, std::memory_order_release);
+		}
+	};
+	size_t helpers = std::min(pool->size(), chunks - 1);
+	for(size_t i = 0; i < helpers; i++) pool->submit(work);
+	work();
+	while(shared->done.load(std::memory_order_acquire) < chunks) std::this_thread::yield();
+}
@@ -0,0 +1,716 @@
+#pragma once
+#include "texture_stream.hpp"
+#include "shader.hpp"
+#include "utils/mapped_file.hpp"
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief one page of a virtual texture, `x` and `y` count pages of `level`
+*/
+struct VirtualPage {
+	static constexpr uint32_t max_pages = 1u << 13; //per side
+	static constexpr uint32_t max_levels = 1u << 5;
+
+	uint32_t level = 0;
+	uint32_t x = 0, y = 0;
+
+	//same layout the feedback shader writes, without the valid bit
+	inline uint32_t pack() const { return level << 26 | y << 13 | x; }
+	static inline VirtualPage unpack(uint32_t key){ return { (key >> 26) & 31, key & 8191, (key >> 13) & 8191 }; }
+
+	inline VirtualPage parent() const { return { level + 1, x >> 1, y >> 1 }; }
+	bool operator==(const VirtualPage& other) const = default;
+};
+
+/**
+ * @brief layout of a virtual texture
+ *
+ * the page grid of level 0 is rounded up to powers of two so every level halves it exactly, pages
+ * past the image edge are never sampled. each page is stored with `border` texels of its neighbours
+ * on every side, so bilinear filtering never reads another page of the cache.
+*/
+struct VirtualTextureDesc {
+	uint64_t width = 0, height = 0; //texels of level 0
+	uint32_t page_size = 128; //texels of a page without its border
+	uint32_t border = 4;
+	uint32_t internal_format = GL_RGBA8;
+	uint32_t format = GL_RGBA;
+	uint32_t datatype = GL_UNSIGNED_BYTE;
+	uint32_t cache_size = 4096; //texels per side of each cache layer, rounded down to whole pages
+	uint32_t cache_layers = 4;
+	uint32_t feedback_scale = 8; //one feedback entry per `feedback_scale` x `feedback_scale` pixels
+	uint32_t max_requests = 64; //page loads started per frame
+	uint32_t retry_frames = 120; //frames before a page that failed to load is requested again
+
+	inline uint32_t padded_page() const { return page_size + 2 * border; }
+	inline size_t page_bytes() const { return (size_t)padded_page() * padded_page() * pixel_size(format, datatype); }
+
+	inline uint32_t pages_x() const { return std::bit_ceil((uint32_t)((width + page_size - 1) / page_size)); }
+	inline uint32_t pages_y() const { return std::bit_ceil((uint32_t)((height + page_size - 1) / page_size)); }
+	inline uint32_t levels() const { return mip_levels(pages_x(), pages_y()); }
+
+	inline uint32_t pages_x(uint32_t level) const { return std::max(pages_x() >> level, 1u); }
+	inline uint32_t pages_y(uint32_t level) const { return std::max(pages_y() >> level, 1u); }
+};
+
+/**
+ * @brief fills `bytes` of `destination` with the padded texels of `page`, runs on a worker thread
+*/
+using VirtualPageLoader = std::function<bool(const VirtualPage& page, void* destination, size_t bytes)>;
+
+/**
+ * @brief memory mapped file holding every page of a virtual texture, uncompressed
+ *
+ * layout (little endian): a header, one 64 bit offset per page (0 for missing pages) ordered by level
+ * then row then column, and the pages themselves. loading a page is a copy out of the mapping.
+*/
+class VirtualTileFile {
+	public:
+		VirtualTileFile() = default;
+		VirtualTileFile(const std::filesystem::path& path){ open(path); }
+		VirtualTileFile(const VirtualTileFile& other) = delete;
+
+		/**
+		 * @return false if the file can't be mapped or isn't a valid tile file, see `error()`
+		*/
+		bool open(const std::filesystem::path& path){
+			close();
+			m_error.clear();
+			if(!m_file.open(path)) return fail("could not map " + path.string());
+			if(m_file.size() < sizeof(Header)) return fail("file too small");
+			Header header;
+			memcpy(&header, m_file.data(), sizeof(Header));
+			if(memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version) return fail("not a tile file");
+
+			m_desc.width = header.width;
+			m_desc.height = header.height;
+			m_desc.page_size = header.page_size;
+			m_desc.border = header.border;
+			m_desc.internal_format = header.internal_format;
+			m_desc.format = header.format;
+			m_desc.datatype = header.datatype;
+			if(!m_desc.width || !m_desc.height || !m_desc.page_size || !m_desc.page_bytes()) return fail("invalid layout");
+			if(m_desc.pages_x() > VirtualPage::max_pages || m_desc.pages_y() > VirtualPage::max_pages) return fail("too many pages");
+
+			size_t pages = page_count(m_desc);
+			if(m_file.size() < sizeof(Header) + pages * sizeof(uint64_t)) return fail("truncated page table");
+			p_offsets = m_file.data() + sizeof(Header);
+			return true;
+		}
+
+		void close(){
+			m_file.close();
+			p_offsets = nullptr;
+			m_desc = {};
+		}
+
+		/**
+		 * @return mapped texels of the page, nullptr when it's missing
+		*/
+		const uint8_t* page(const VirtualPage& page) const {
+			if(!p_offsets || page.level >= m_desc.levels() || page.x >= m_desc.pages_x(page.level) || page.y >= m_desc.pages_y(page.level)) return nullptr;
+			uint64_t offset;
+			memcpy(&offset, p_offsets + page_index(m_desc, page) * sizeof(uint64_t), sizeof(offset));
+			//a corrupt offset near 2^64 must not wrap the end of the page around
+			if(offset == 0 || offset > m_file.size() || m_desc.page_bytes() > m_file.size() - offset) return nullptr;
+			return m_file.data() + offset;
+		}
+
+		bool load(const VirtualPage& page, void* destination, size_t bytes) const {
+			const uint8_t* texels = this->page(page);
+			if(!texels || bytes != m_desc.page_bytes()) return false;
+			memcpy(destination, texels, bytes);
+			return true;
+		}
+
+		/**
+		 * @brief loader reading this file, which must outlive every load
+		*/
+		VirtualPageLoader loader() const {
+			return [this](const VirtualPage& page, void* destination, size_t bytes){ return load(page, destination, bytes); };
+		}
+
+		/**
+		 * @brief writes a tile file page by page, `fetch` fills the padded texels of a page or returns false to leave it missing
+		*/
+		static bool write(const std::filesystem::path& path, const VirtualTextureDesc& desc, const std::function<bool(const VirtualPage& page, void* destination)>& fetch){
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if(!file) return false;
+
+			Header header = {
+				.magic = { magic[0], magic[1], magic[2], magic[3] },
+				.version = version,
+				.width = desc.width,
+				.height = desc.height,
+				.page_size = desc.page_size,
+				.border = desc.border,
+				.internal_format = desc.internal_format,
+				.format = desc.format,
+				.datatype = desc.datatype,
+				.reserved = 0
+			};
+			std::vector<uint64_t> offsets(page_count(desc), 0);
+			file.write((const char*)&header, sizeof(header));
+			file.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+
+			std::vector<uint8_t> texels(desc.page_bytes());
+			uint64_t offset = sizeof(header) + offsets.size() * sizeof(uint64_t);
+			for(uint32_t level = 0; level < desc.levels(); level++){
+				for(uint32_t y = 0; y < desc.pages_y(level); y++){
+					for(uint32_t x = 0; x < desc.pages_x(level); x++){
+						VirtualPage page = { level, x, y };
+						if(!fetch(page, texels.data())) continue;
+						file.write((const char*)texels.data(), texels.size());
+						offsets[page_index(desc, page)] = offset;
+						offset += texels.size();
+					}
+				}
+			}
+			file.seekp(sizeof(header));
+			file.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+			return (bool)file;
+		}
+
+		inline bool is_open() const { return p_offsets != nullptr; }
+		inline const VirtualTextureDesc& descriptor() const { return m_desc; }
+		inline const std::string& error() const { return m_error; }
+
+	private:
+		static constexpr char magic[4] = { 'G', 'V', 'T', 'F' };
+		static constexpr uint32_t version = 1;
+
+		struct Header {
+			char magic[4];
+			uint32_t version = VirtualTileFile::version;
+			uint64_t width = 0, height = 0;
+			uint32_t page_size = 0, border = 0;
+			uint32_t internal_format = 0, format = 0, datatype = 0;
+			uint32_t reserved = 0;
+		};
+
+		MappedFile m_file;
+		const uint8_t* p_offsets = nullptr;
+		VirtualTextureDesc m_desc;
+		std::string m_error;
+
+		static size_t page_count(const VirtualTextureDesc& desc){
+			size_t pages = 0;
+			for(uint32_t level = 0; level < desc.levels(); level++) pages += (size_t)desc.pages_x(level) * desc.pages_y(level);
+			return pages;
+		}
+
+		static size_t page_index(const VirtualTextureDesc& desc, const VirtualPage& page){
+			size_t index = 0;
+			for(uint32_t level = 0; level < page.level; level++) index += (size_t)desc.pages_x(level) * desc.pages_y(level);
+			return index + (size_t)page.y * desc.pages_x(page.level) + page.x;
+		}
+
+		bool fail(const std::string& message){
+			m_error = message;
+			close();
+			return false;
+		}
+};
+
+/**
+ * @brief software virtual texturing, no sparse texture extension needed
+ *
+ * - the page cache is a `Tex2DArray` whose layers hold a grid of padded pages
+ * - the indirection texture (RGBA8UI, one texel per page and one level per virtual level) maps
+ *   every page to the cache slot of its finest resident ancestor: x, y, layer and that level
+ * - shaders using `glsl()` write the pages they need into a feedback storage buffer, read back
+ *   a few frames later through persistently mapped memory without stalling
+ * - missing pages are loaded on the streamer workers, coarser ones first, and replace the least
+ *   recently requested pages when the cache is full. the coarsest page is always resident.
+ * - a page that failed to load falls back to its ancestors until `retry_frames` passed or `retry_failed()`
+ *
+ * each frame: `begin_frame()`, `bind()` and `set_uniforms()` before drawing, `end_frame()` after.
+ * the streamer must be updated every frame too, it's where the pages are uploaded.
+*/
+class VirtualTexture {
+	public:
+		static constexpr uint32_t no_page = 0xff000000u; //indirection entry with no resident ancestor
+		static constexpr size_t feedback_frames = 3;
+
+		struct Stats {
+			uint64_t requested = 0;
+			uint64_t loaded = 0;
+			uint64_t failed = 0;
+			uint64_t evicted = 0;
+			uint64_t cache_full = 0; //pages not requested because every slot was in use
+			uint64_t feedback_stalls = 0; //frames that waited for the GPU to reuse a feedback buffer
+			uint64_t indirection_texels = 0; //texels uploaded to the indirection texture
+			size_t feedback_pages = 0; //distinct pages (and their ancestors) in the last feedback read
+			size_t resident = 0;
+		};
+
+		VirtualTexture(TextureStreamer& streamer, const VirtualTextureDesc& desc, VirtualPageLoader loader)
+			:m_streamer(streamer),m_desc(desc),m_loader(std::move(loader)),
+			m_cache(TextureType::Tex2DArray),m_indirection(TextureType::Tex2D){
+			if(!m_loader) throw std::invalid_argument("VirtualTexture: a page loader is required");
+			if(m_desc.pages_x() > VirtualPage::max_pages || m_desc.pages_y() > VirtualPage::max_pages) throw std::invalid_argument("VirtualTexture: too many pages");
+
+			m_cache_pages = std::min<uint32_t>(m_desc.cache_size / m_desc.padded_page(), 255);
+			m_desc.cache_layers = std::min<uint32_t>(m_desc.cache_layers, 255);
+			if(m_cache_pages == 0 || m_desc.cache_layers == 0) throw std::invalid_argument("VirtualTexture: the cache can't hold a page");
+			m_desc.cache_size = m_cache_pages * m_desc.padded_page();
+
+			m_cache.storage(1, m_desc.internal_format, m_desc.cache_size, m_desc.cache_size, m_desc.cache_layers);
+			m_cache.set_sampler(SamplerDesc{
+				.mipmap = SamplerMipmap::None,
+				.wrap_s = SamplerWrap::ClampToEdge,
+				.wrap_t = SamplerWrap::ClampToEdge
+			});
+			m_indirection.storage(m_desc.levels(), GL_RGBA8UI, m_desc.pages_x(), m_desc.pages_y());
+			m_indirection.set_sampler(SamplerDesc{
+				.min_filter = SamplerFilter::Nearest,
+				.mag_filter = SamplerFilter::Nearest,
+				.mipmap = SamplerMipmap::Nearest,
+				.wrap_s = SamplerWrap::ClampToEdge,
+				.wrap_t = SamplerWrap::ClampToEdge
+			});
+
+			m_slots.resize((size_t)m_cache_pages * m_cache_pages * m_desc.cache_layers);
+			for(size_t slot = m_slots.size(); slot > 0; slot--) m_free.push_back((uint32_t)slot - 1);
+
+			m_mirror.resize(m_desc.levels());
+			m_dirty.resize(m_desc.levels());
+			for(uint32_t level = 0; level < m_desc.levels(); level++){
+				m_mirror[level].assign((size_t)m_desc.pages_x(level) * m_desc.pages_y(level), no_page);
+				m_dirty[level] = { { 0, 0, m_desc.pages_x(level), m_desc.pages_y(level) } };
+			}
+
+			//the fallback of every other page
+			VirtualPage top = { m_desc.levels() - 1, 0, 0 };
+			m_requests.push_back(top);
+			request_pages();
+			m_slots[m_resident[top.pack()]].pinned = true;
+		}
+
+		VirtualTexture(const VirtualTexture& other) = delete;
+
+		~VirtualTexture(){
+			m_streamer.cancel(m_cache);
+			for(auto& frame: m_feedback) if(frame.buffer && frame.data) frame.buffer->unmap_memory();
+		}
+
+		/**
+		 * @brief sizes the feedback buffers for a framebuffer, must be called before the first frame
+		*/
+		void resize_feedback(size_t width, size_t height){
+			for(auto& frame: m_feedback){
+				frame.fence.wait();
+				frame.fence.reset();
+				if(frame.buffer && frame.data) frame.buffer->unmap_memory();
+				frame = {};
+			}
+			m_feedback_width = (uint32_t)std::max<size_t>((width + m_desc.feedback_scale - 1) / m_desc.feedback_scale, 1);
+			m_feedback_height = (uint32_t)std::max<size_t>((height + m_desc.feedback_scale - 1) / m_desc.feedback_scale, 1);
+			size_t bytes = (size_t)m_feedback_width * m_feedback_height * sizeof(uint32_t);
+
+			for(auto& frame: m_feedback){
+				frame.buffer = std::make_unique<BufferInstance>(BufferDescriptor{
+					.target = BufferTarget::ShaderStorage,
+					.usage = BufferUsage::StreamRead,
+					.access = BufferAccess::ReadOnly
+				});
+				frame.buffer->immutable_storage(bytes, BufferStorageFlags::Read | BufferStorageFlags::Persistent | BufferStorageFlags::Coherent);
+				frame.data = (const uint32_t*)frame.buffer->map_range(0, bytes, BufferMapFlags::Read | BufferMapFlags::Persistent | BufferMapFlags::Coherent);
+				if(!frame.data) throw GLError("VirtualTexture", "could not map the feedback buffer");
+				frame.buffer->clear();
+			}
+		}
+
+		/**
+		 * @brief reads the finished feedback, starts page loads and updates the indirection texture
+		*/
+		void begin_frame(){
+			if(m_feedback[0].buffer){
+				FeedbackFrame& current = m_feedback[m_frame % feedback_frames];
+				if(current.pending && !current.fence.signaled()){
+					m_stats.feedback_stalls++;
+					current.fence.wait();
+				}
+				//older frames first, their requests are the stalest
+				for(size_t i = 1; i <= feedback_frames; i++){
+					FeedbackFrame& frame = m_feedback[(m_frame + i) % feedback_frames];
+					if(frame.pending && frame.fence.signaled()) read_feedback(frame);
+				}
+				current.buffer->clear();
+			}
+			request_pages();
+			update_indirection();
+		}
+
+		/**
+		 * @brief binds the cache and the indirection texture to two units and the feedback buffer to a storage binding
+		*/
+		void bind(uint8_t cache_unit, uint8_t indirection_unit, uint32_t feedback_binding = 0){
+			m_cache.setSlot(cache_unit);
+			m_cache.bind();
+			m_indirection.setSlot(indirection_unit);
+			m_indirection.bind();
+			if(m_feedback[0].buffer) m_feedback[m_frame % feedback_frames].buffer->bind_base(feedback_binding);
+		}
+
+		/**
+		 * @brief sets the uniforms declared by `glsl()`, after `bind`
+		*/
+		void set_uniforms(ShaderProgramInstance& program){
+			int32_t cache_unit = m_cache.slot(), indirection_unit = m_indirection.slot();
+			uint32_t info[4] = { m_desc.pages_x(), m_desc.pages_y(), m_desc.levels(), m_feedback_width };
+			float layout[4] = { (float)m_desc.page_size, (float)m_desc.border, (float)m_desc.padded_page(), (float)m_desc.cache_size };
+			float size[2] = { (float)m_desc.width, (float)m_desc.height };
+			uint32_t feedback[2] = { m_feedback[0].buffer ? m_desc.feedback_scale : 0, m_feedback_height };
+			program.get_uniform("vt_cache", UniformType::Int).set_data(&cache_unit, 1);
+			program.get_uniform("vt_indirection", UniformType::Int).set_data(&indirection_unit, 1);
+			program.get_uniform("vt_info", UniformType::UVec4).set_data(info, 1);
+			program.get_uniform("vt_layout", UniformType::FVec4).set_data(layout, 1);
+			program.get_uniform("vt_size", UniformType::FVec2).set_data(size, 1);
+			program.get_uniform("vt_feedback_info", UniformType::UVec2).set_data(feedback, 1);
+		}
+
+		/**
+		 * @brief fences the feedback written this frame, call after the last draw sampling the texture
+		*/
+		void end_frame(){
+			if(m_feedback[0].buffer){
+				//shader writes reach persistently mapped memory only after this barrier
+				memory_barrier(MemoryBarrier::ClientMappedBuffer);
+				FeedbackFrame& current = m_feedback[m_frame % feedback_frames];
+				current.fence.insert();
+				current.pending = true;
+			}
+			m_frame++;
+		}
+
+		/**
+		 * @brief marks a page as needed without feedback (prefetching around the camera for example)
+		*/
+		inline void request(const VirtualPage& page){ want(page); }
+
+		/**
+		 * @brief lets every page that failed to load be requested again right away, once its source is available again for example
+		*/
+		inline void retry_failed(){ m_failed.clear(); }
+
+		inline bool resident(const VirtualPage& page) const {
+			auto it = m_resident.find(page.pack());
+			return it != m_resident.end() && m_slots[it->second].state == SlotState::Resident;
+		}
+
+		/**
+		 * @brief GLSL declarations and `vec4 vt_sample(vec2 uv)`, define VT_FEEDBACK_BINDING before it to move the feedback buffer
+		*/
+		static const char* glsl(){
+			return R"(
+#ifndef VT_FEEDBACK_BINDING
+#define VT_FEEDBACK_BINDING 0
+#endif
+uniform sampler2DArray vt_cache;
+uniform usampler2D vt_indirection;
+uniform uvec4 vt_info; //pages x, pages y, levels, feedback width
+uniform vec4 vt_layout; //page size, border, padded page size, cache layer size
+uniform vec2 vt_size; //texels of level 0
+uniform uvec2 vt_feedback_info; //feedback scale (0 disables it), feedback height
+layout(std430, binding = VT_FEEDBACK_BINDING) buffer vt_feedback_buffer { uint vt_feedback[]; };
+
+void vt_request(uvec2 page, uint level){
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	if(vt_feedback_info.x == 0u || any(notEqual(pixel % vt_feedback_info.x, uvec2(0u)))) return;
+	uvec2 cell = pixel / vt_feedback_info.x;
+	if(cell.x >= vt_info.w || cell.y >= vt_feedback_info.y) return;
+	vt_feedback[cell.y * vt_info.w + cell.x] = 0x80000000u | (level << 26) | (page.y << 13) | page.x;
+}
+
+vec4 vt_sample(vec2 uv){
+	uv = clamp(uv, vec2(0.0), vec2(0.99999));
+	vec2 texels = uv * vt_size;
+	vec2 dx = dFdx(texels), dy = dFdy(texels);
+	float lod = max(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0);
+	uint level = min(uint(lod), vt_info.z - 1u);
+
+	uvec2 pages = max(vt_info.xy >> level, uvec2(1u));
+	uvec2 page = min(uvec2(texels / (exp2(float(level)) * vt_layout.x)), pages - 1u);
+	vt_request(page, level);
+
+	uvec4 entry = texelFetch(vt_indirection, ivec2(page), int(level));
+	if(entry.w == 255u) return vec4(0.0);
+	vec2 in_page = fract(texels / (exp2(float(entry.w)) * vt_layout.x));
+	vec2 texel = vec2(entry.xy) * vt_layout.z + vt_layout.y + in_page * vt_layout.x;
+	return textureLod(vt_cache, vec3(texel / vt_layout.w, float(entry.z)), 0.0);
+}
+)";
+		}
+
+		inline TextureInstance& cache(){ return m_cache; }
+		inline TextureInstance& indirection(){ return m_indirection; }
+		inline const VirtualTextureDesc& descriptor() const { return m_desc; }
+		inline size_t capacity() const { return m_slots.size(); }
+		inline const Stats& stats() const { return m_stats; }
+
+	private:
+		enum class SlotState: uint8_t {
+			Free,
+			Loading,
+			Resident
+		};
+
+		struct Slot {
+			uint32_t page = 0; //packed page
+			uint64_t last_use = 0;
+			SlotState state = SlotState::Free;
+			bool pinned = false;
+		};
+
+		struct FeedbackFrame {
+			std::unique_ptr<BufferInstance> buffer;
+			const uint32_t* data = nullptr;
+			Fence fence;
+			bool pending = false;
+		};
+
+		struct Rect {
+			uint32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+			inline size_t area() const { return (size_t)(x1 - x0) * (y1 - y0); }
+			inline Rect merged(const Rect& other) const {
+				return { std::min(x0, other.x0), std::min(y0, other.y0), std::max(x1, other.x1), std::max(y1, other.y1) };
+			}
+		};
+
+		TextureStreamer& m_streamer;
+		VirtualTextureDesc m_desc;
+		VirtualPageLoader m_loader;
+		TextureInstance m_cache;
+		TextureInstance m_indirection;
+		uint32_t m_cache_pages = 0; //per side of a layer
+
+		std::vector<Slot> m_slots;
+		std::vector<uint32_t> m_free;
+		std::unordered_map<uint32_t, uint32_t> m_resident; //packed page -> slot, loading pages included
+		std::unordered_map<uint32_t, uint64_t> m_failed; //packed page -> frame it failed
+		std::unordered_set<uint32_t> m_wanted;
+		std::vector<VirtualPage> m_requests;
+
+		std::vector<std::vector<uint32_t>> m_mirror; //indirection texels per level
+		std::vector<std::vector<Rect>> m_dirty; //per level, merged only while it doesn't waste much
+		std::vector<uint32_t> m_upload;
+
+		std::array<FeedbackFrame, feedback_frames> m_feedback;
+		uint32_t m_feedback_width = 0, m_feedback_height = 0;
+		uint64_t m_frame = 1;
+		Stats m_stats;
+
+		void read_feedback(FeedbackFrame& frame){
+			frame.pending = false;
+			size_t before = m_wanted.size();
+			size_t count = (size_t)m_feedback_width * m_feedback_height;
+			for(size_t i = 0; i < count; i++){
+				uint32_t entry = frame.data[i];
+				if(!(entry & 0x80000000u)) continue;
+				VirtualPage page = VirtualPage::unpack(entry & 0x7fffffffu);
+				if(page.level >= m_desc.levels() || page.x >= m_desc.pages_x(page.level) || page.y >= m_desc.pages_y(page.level)) continue;
+				want(page);
+			}
+			m_stats.feedback_pages = m_wanted.size() - before;
+		}
+
+		/**
+		 * @brief keeps the page and all its ancestors (the fallbacks of its neighbours) alive, queues the missing ones
+		*/
+		void want(VirtualPage page){
+			while(true){
+				uint32_t key = page.pack();
+				if(!m_wanted.insert(key).second) return; //already walked from here
+				auto it = m_resident.find(key);
+				if(it != m_resident.end()) m_slots[it->second].last_use = m_frame;
+				else if(retry(key)) m_requests.push_back(page);
+				if(page.level + 1 >= m_desc.levels()) return;
+				page = page.parent();
+			}
+		}
+
+		bool retry(uint32_t key){
+			auto it = m_failed.find(key);
+			if(it == m_failed.end()) return true;
+			if(m_frame - it->second < m_desc.retry_frames) return false;
+			m_failed.erase(it);
+			return true;
+		}
+
+		void request_pages(){
+			//coarse pages first, they stand in for everything below them
+			std::stable_sort(m_requests.begin(), m_requests.end(), [](const VirtualPage& a, const VirtualPage& b){ return a.level > b.level; });
+			size_t started = 0;
+			for(const VirtualPage& page: m_requests){
+				if(started >= m_desc.max_requests) break;
+				uint32_t key = page.pack();
+				if(m_resident.count(key)) continue;
+				uint32_t slot;
+				if(!allocate(slot)){
+					m_stats.cache_full++;
+					break;
+				}
+				m_slots[slot] = { .page = key, .last_use = m_frame, .state = SlotState::Loading };
+				m_resident[key] = slot;
+				load(page, slot);
+				started++;
+			}
+			m_requests.clear();
+			m_wanted.clear();
+		}
+
+		bool allocate(uint32_t& slot){
+			if(!m_free.empty()){
+				slot = m_free.back();
+				m_free.pop_back();
+				return true;
+			}
+			//least recently requested resident page not needed this frame
+			size_t best = m_slots.size();
+			for(size_t i = 0; i < m_slots.size(); i++){
+				const Slot& candidate = m_slots[i];
+				if(candidate.state != SlotState::Resident || candidate.pinned || candidate.last_use >= m_frame) continue;
+				if(best == m_slots.size() || candidate.last_use < m_slots[best].last_use) best = i;
+			}
+			if(best == m_slots.size()) return false;
+			evict((uint32_t)best);
+			slot = m_free.back();
+			m_free.pop_back();
+			return true;
+		}
+
+		void evict(uint32_t slot){
+			VirtualPage page = VirtualPage::unpack(m_slots[slot].page);
+			m_resident.erase(m_slots[slot].page);
+			m_slots[slot] = {};
+			m_free.push_back(slot);
+			mark_dirty(page);
+			m_stats.evicted++;
+			m_stats.resident--;
+		}
+
+		void load(const VirtualPage& page, uint32_t slot){
+			uint32_t per_layer = m_cache_pages * m_cache_pages;
+			uint32_t padded = m_desc.padded_page();
+			TextureUpload upload = {
+				.texture = &m_cache,
+				.region = {
+					.level = 0,
+					.x = (size_t)(slot % m_cache_pages) * padded,
+					.y = (size_t)(slot % per_layer / m_cache_pages) * padded,
+					.z = slot / per_layer,
+					.width = padded,
+					.height = padded,
+					.depth = 1,
+					.format = m_desc.format,
+					.datatype = m_desc.datatype
+				},
+				.bytes = m_desc.page_bytes(),
+				.priority = (int32_t)page.level,
+				.decode = [loader = m_loader, page](void* destination, size_t bytes){ return loader(page, destination, bytes); },
+				.on_complete = [this, page, slot](bool uploaded){ loaded(page, slot, uploaded); }
+			};
+			m_streamer.request(std::move(upload));
+			m_stats.requested++;
+		}
+
+		void loaded(const VirtualPage& page, uint32_t slot, bool uploaded){
+			if(!uploaded){
+				m_resident.erase(page.pack());
+				m_failed[page.pack()] = m_frame;
+				m_slots[slot] = {};
+				m_free.push_back(slot);
+				m_stats.failed++;
+				return;
+			}
+			m_slots[slot].state = SlotState::Resident;
+			mark_dirty(page);
+			m_stats.loaded++;
+			m_stats.resident++;
+		}
+
+		//the page and every entry below it may change their resident ancestor
+		inline void mark_dirty(const VirtualPage& page){
+			add_dirty(m_dirty[page.level], { page.x, page.y, page.x + 1, page.y + 1 });
+		}
+
+		static void add_dirty(std::vector<Rect>& rects, const Rect& rect){
+			for(Rect& other: rects){
+				Rect merged = other.merged(rect);
+				if(merged.area() <= 2 * (other.area() + rect.area())){
+					other = merged;
+					return;
+				}
+			}
+			rects.push_back(rect);
+		}
+
+		void update_indirection(){
+			int32_t alignment = 4;
+			bool uploading = false;
+			std::vector<Rect> inherited, current;
+			for(uint32_t level = m_desc.levels(); level-- > 0;){
+				uint32_t width = m_desc.pages_x(level), height = m_desc.pages_y(level);
+				current.swap(m_dirty[level]);
+				m_dirty[level].clear();
+				for(const Rect& rect: inherited){
+					add_dirty(current, {
+						std::min(rect.x0 * 2, width), std::min(rect.y0 * 2, height),
+						std::min(rect.x1 * 2, width), std::min(rect.y1 * 2, height)
+					});
+				}
+				if(!current.empty() && !uploading){
+					SAFE_CALL( VirtualTextureUnpackAlignment, glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment) );
+					SAFE_CALL( VirtualTextureUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, 4) );
+					uploading = true;
+				}
+				for(const Rect& rect: current) rebuild(level, rect);
+				inherited.swap(current);
+				current.clear();
+			}
+			if(uploading) SAFE_CALL( VirtualTextureUnpackAlignment, glPixelStorei(GL_UNPACK_ALIGNMENT, alignment) );
+		}
+
+		/**
+		 * @brief points every entry of `rect` at its page or at the entry of its parent, coarser levels must be up to date
+		*/
+		void rebuild(uint32_t level, const Rect& rect){
+			uint32_t per_layer = m_cache_pages * m_cache_pages;
+			uint32_t width = m_desc.pages_x(level);
+			std::vector<uint32_t>& mirror = m_mirror[level];
+			const std::vector<uint32_t>* coarser = level + 1 < m_desc.levels() ? &m_mirror[level + 1] : nullptr;
+			uint32_t coarser_width = coarser ? m_desc.pages_x(level + 1) : 0;
+
+			m_upload.resize(rect.area());
+			size_t i = 0;
+			for(uint32_t y = rect.y0; y < rect.y1; y++){
+				for(uint32_t x = rect.x0; x < rect.x1; x++){
+					uint32_t entry = coarser ? (*coarser)[(size_t)(y >> 1) * coarser_width + (x >> 1)] : no_page;
+					auto it = m_resident.find(VirtualPage{ level, x, y }.pack());
+					if(it != m_resident.end() && m_slots[it->second].state == SlotState::Resident){
+						uint32_t slot = it->second;
+						entry = (slot % m_cache_pages) | (slot % per_layer / m_cache_pages) << 8 | (slot / per_layer) << 16 | level << 24;
+					}
+					mirror[(size_t)y * width + x] = entry;
+					m_upload[i++] = entry;
+				}
+			}
+
+			m_indirection.update({
+				.level = (int)level,
+				.x = rect.x0,
+				.y = rect.y0,
+				.width = rect.x1 - rect.x0,
+				.height = rect.y1 - rect.y0,
+				.format = GL_RGBA_INTEGER,
+				.datatype = GL_UNSIGNED_BYTE
+			}, m_upload.data());
+			m_stats.indirection_texels += m_upload.size();
+		}
+};
@@ -0,0 +1,64 @@
+#include "gl_test.hpp"
+#include "opengl/culling.hpp"
+#include <algorithm>
+
+static CullObject object_at(float x, float y, float z, float radius, uint32_t count){
+	CullObject object = {};
+	for(size_t i = 0; i < 4; i++) object.model[i * 5] = 1.0f;
+	object.model[12] = x;
+	object.model[13] = y;
+	object.model[14] = z;
+	object.radius = radius;
+	object.command = { .count = count, .instance_count = 1 };
+	return object;
+}
+
+//an identity view projection makes the frustum the [-1, 1] cube
+static void frustum_culling(){
+	CullingPipeline pipeline;
+	pipeline.set_objects({
+		object_at(0.0f, 0.0f, 0.0f, 0.1f, 3),    //inside
+		object_at(5.0f, 0.0f, 0.0f, 0.1f, 6),    //right of the cube
+		object_at(1.05f, 0.0f, 0.0f, 0.1f, 9),   //crosses the right plane
+		object_at(0.0f, -3.0f, 0.0f, 1.0f, 12),  //below
+		object_at(0.0f, 0.0f, 3.0f, 0.5f, 15),   //past the far plane
+		object_at(-0.5f, 0.5f, -0.9f, 0.2f, 18)  //inside, next to the near plane
+	});
+	const float identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+	pipeline.cull(identity);
+	glFinish();
+
+	uint32_t visible = 0;
+	glGetNamedBufferSubData(pipeline.counter().id(), 0, sizeof(visible), &visible);
+	CHECK(visible == 3);
+	CHECK(pipeline.stats().objects == 6);
+	CHECK(pipeline.stats().visible == 3);
+
+	//slots are taken in any order, the base instance is the index of the object
+	std::vector<DrawElementsIndirectCommand> commands(std::min<uint32_t>(visible, 6));
+	glGetNamedBufferSubData(pipeline.commands().id(), 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	std::sort(commands.begin(), commands.end(), [](auto& a, auto& b){ return a.base_instance < b.base_instance; });
+	if(commands.size() == 3){
+		CHECK(commands[0].base_instance == 0 && commands[0].count == 3);
+		CHECK(commands[1].base_instance == 2 && commands[1].count == 9);
+		CHECK(commands[2].base_instance == 5 && commands[2].count == 18);
+		for(auto& command: commands) CHECK(command.instance_count == 1);
+	}
+
+	//moving the camera right brings the second object in and pushes the first out
+	const float shifted[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, -4.5f,0,0,1 };
+	pipeline.cull(shifted);
+	glFinish();
+	glGetNamedBufferSubData(pipeline.counter().id(), 0, sizeof(visible), &visible);
+	CHECK(visible == 1);
+	DrawElementsIndirectCommand command;
+	glGetNamedBufferSubData(pipeline.commands().id(), 0, sizeof(command), &command);
+	CHECK(command.base_instance == 1 && command.count == 6);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main(){
+	create_test_context();
+	frustum_culling();
+	return test_result("culling");
+}
@@ -0,0 +1,38 @@
+#include "gl_test.hpp"
+#include "opengl/framebuffer.hpp"
+
+//texture and renderbuffer names are allocated separately, in a fresh context both start at 1
+static void same_name_different_kind(){
+	RenderTargetPool pool;
+	RenderTarget& texture = pool.acquire({ .width = 64, .height = 64, .internal_format = GL_RGBA8 });
+	RenderTarget& renderbuffer = pool.acquire({ .width = 64, .height = 64, .internal_format = GL_RGBA8, .sampled = false });
+	CHECK(texture.texture && renderbuffer.renderbuffer);
+	CHECK(texture.id() == renderbuffer.id());
+	CHECK(!(texture.object() == renderbuffer.object()));
+
+	FramebufferInstance& sampled = pool.framebuffer({ &texture });
+	FramebufferInstance& stored = pool.framebuffer({ &renderbuffer });
+	CHECK(&sampled != &stored);
+	CHECK(pool.stats().framebuffers == 2);
+	CHECK(&pool.framebuffer({ &texture }) == &sampled);
+	CHECK(stored.attachments().front().second.kind == AttachedObject::Kind::Renderbuffer);
+
+	//freeing the texture only drops the framebuffer holding it
+	pool.release(texture);
+	pool.trim();
+	CHECK(pool.stats().targets == 1);
+	CHECK(pool.stats().framebuffers == 1);
+	CHECK(&pool.framebuffer({ &renderbuffer }) == &stored);
+
+	pool.release(renderbuffer);
+	pool.trim();
+	CHECK(pool.stats().targets == 0);
+	CHECK(pool.stats().framebuffers == 0);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main(){
+	create_test_context();
+	same_name_different_kind();
+	return test_result("framebuffer");
+}
@@ -0,0 +1,81 @@
+#pragma once
+/**
+ * @brief minimal harness of the tests: a headless GL context and a check macro
+ *
+ * tests run without a window through EGL (Mesa's surfaceless platform works on CI machines with no GPU):
+ *   g++ -std=c++20 -fpermissive -Iinclude tests/heap.cpp -o heap_test -lGLEW -lEGL -lGL && ./heap_test
+ * a test returns non zero when a check failed
+*/
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstdio>
+#include <cstdlib>
+#include "opengl/core.hpp"
+
+inline int g_test_failures = 0;
+
+#define CHECK(X) do { if(!(X)){ std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #X); g_test_failures++; } } while(0)
+
+#define CHECK_THROWS(E, X) do { \
+	bool thrown = false; \
+	try { X; } catch(const E&){ thrown = true; } \
+	if(!thrown){ std::fprintf(stderr, "%s:%d: expected %s from: %s\n", __FILE__, __LINE__, #E, #X); g_test_failures++; } \
+} while(0)
+
+/**
+ * @brief makes a GL 4.5 core context current on the calling thread
+ * @return false, after printing why, when none can be created
+*/
+inline bool try_create_test_context(){
+	EGLDisplay display = EGL_NO_DISPLAY;
+	auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(get_platform_display) display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if(display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if(!eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)){
+		std::fprintf(stderr, "no EGL display (0x%x)\n", eglGetError());
+		return false;
+	}
+
+	const EGLint config_attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = nullptr;
+	EGLint configs = 0;
+	eglChooseConfig(display, config_attributes, &config, 1, &configs);
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, configs ? config : nullptr, EGL_NO_CONTEXT, context_attributes);
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+		std::fprintf(stderr, "no GL 4.5 context (0x%x)\n", eglGetError());
+		return false;
+	}
+
+	glewExperimental = GL_TRUE;
+	GLenum error = glewInit();
+	#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+		if(error == GLEW_ERROR_NO_GLX_DISPLAY) error = GLEW_OK; //headless, the entry points are loaded anyway
+	#endif
+	if(error != GLEW_OK){
+		std::fprintf(stderr, "glewInit: %s\n", glewGetErrorString(error));
+		return false;
+	}
+	GlobalContextConfig.load();
+	return true;
+}
+
+//exits when there's no context, tests can't run without one
+inline void create_test_context(){
+	if(!try_create_test_context()) std::exit(2);
+}
+
+inline int test_result(const char* name){
+	if(g_test_failures) std::fprintf(stderr, "%s: %d check(s) failed\n", name, g_test_failures);
+	else std::printf("%s: ok\n", name);
+	return g_test_failures ? 1 : 0;
+}
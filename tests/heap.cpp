@@ -0,0 +1,61 @@
+#include "gl_test.hpp"
+#include "opengl/heap.hpp"
+
+static void exact_capacity(){
+	for(uint32_t capacity: { 1u, 31u, 32u, 101u, 1000u, 1001u, 65535u, 1u << 20 }){
+		TlsfAllocator allocator(capacity);
+		uint32_t block = allocator.allocate(capacity);
+		CHECK(block != TlsfAllocator::invalid);
+		if(block == TlsfAllocator::invalid) continue;
+		CHECK(allocator.offset(block) == 0);
+		CHECK(allocator.size(block) == capacity);
+		CHECK(allocator.allocate(1) == TlsfAllocator::invalid);
+
+		//the freed block merges back and fits again
+		allocator.free(block);
+		CHECK(allocator.allocate(capacity) != TlsfAllocator::invalid);
+	}
+}
+
+static void exact_fit_after_free(){
+	TlsfAllocator allocator(4096);
+	uint32_t a = allocator.allocate(1000);
+	uint32_t b = allocator.allocate(1000);
+	uint32_t c = allocator.allocate(2096);
+	CHECK(a != TlsfAllocator::invalid && b != TlsfAllocator::invalid && c != TlsfAllocator::invalid);
+	allocator.free(b);
+	//the only hole is exactly the size asked for
+	uint32_t d = allocator.allocate(1000);
+	CHECK(d != TlsfAllocator::invalid);
+	if(d != TlsfAllocator::invalid) CHECK(allocator.offset(d) == 1000);
+}
+
+static void oversized_allocation(){
+	BufferHeap heap(BufferDescriptor{
+		.target = BufferTarget::Array,
+		.usage = BufferUsage::StaticDraw,
+		.access = BufferAccess::ReadWrite
+	}, 64 << 10, 16);
+
+	for(size_t bytes: { (size_t)64 << 10, ((size_t)64 << 10) + 16, (size_t)1 << 20, ((size_t)1 << 20) + 48 }){
+		size_t pages = heap.page_count();
+		HeapAllocation allocation = heap.allocate(bytes);
+		CHECK(allocation.valid());
+		if(!allocation.valid()) continue;
+		BufferRange range = heap.range(allocation);
+		CHECK(range.size >= bytes);
+		CHECK(heap.page(allocation).size() >= range.offset + range.size);
+		CHECK(heap.page_count() <= pages + 1);
+		heap.free(allocation);
+	}
+	CHECK(heap.stats().used == 0);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main(){
+	exact_capacity();
+	exact_fit_after_free();
+	create_test_context();
+	oversized_allocation();
+	return test_result("heap");
+}
@@ -0,0 +1,58 @@
+#include "gl_test.hpp"
+#include "opengl/render_graph.hpp"
+
+static constexpr size_t page_bytes = 64 << 10;
+
+//writer and reader of a transient buffer, returns the size the reader saw
+static size_t storage_pair(RenderGraph& graph, size_t bytes){
+	RenderResource buffer = graph.create_buffer("particles", bytes);
+	graph.add_pass("simulate").write(buffer, ResourceAccess::Storage);
+	size_t seen = 0;
+	graph.add_pass("draw").read(buffer, ResourceAccess::Storage).side_effects().execute([&](RenderGraph::Context& context){
+		BufferRange range = context.buffer(buffer);
+		seen = range.size;
+		context.bind_buffer(buffer, BufferTarget::ShaderStorage, 0);
+	});
+	graph.execute();
+	return seen;
+}
+
+static void page_sized_buffers(){
+	RenderTargetPool targets;
+	RenderGraph graph(targets, page_bytes);
+	for(size_t bytes: { page_bytes, page_bytes + 1, (size_t)1 << 20, ((size_t)1 << 20) + 48 }){
+		CHECK(storage_pair(graph, bytes) == bytes);
+		CHECK(graph.stats().transient_buffers == 1);
+	}
+	CHECK(graph.buffers().stats().used == 0);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+static void impossible_buffer(){
+	RenderTargetPool targets;
+	RenderGraph graph(targets, page_bytes);
+	RenderResource buffer = graph.create_buffer("too large", (size_t)1 << 44);
+	graph.add_pass("write").write(buffer, ResourceAccess::Storage).side_effects();
+	CHECK_THROWS(std::length_error, graph.execute());
+}
+
+//transient ranges of every size are reused frame after frame, the writes tracked for barriers must not pile up
+static void pending_writes_stay_bounded(){
+	RenderTargetPool targets;
+	RenderGraph graph(targets, page_bytes);
+	size_t most = 0;
+	for(size_t frame = 0; frame < 64; frame++){
+		storage_pair(graph, 256 * (64 - frame));
+		most = std::max(most, graph.stats().pending_writes);
+	}
+	CHECK(most <= 2);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main(){
+	create_test_context();
+	page_sized_buffers();
+	impossible_buffer();
+	pending_writes_stay_bounded();
+	return test_result("render_graph");
+}
@@ -0,0 +1,33 @@
+#include "gl_test.hpp"
+#include "opengl/stream.hpp"
+
+//once every frame retired the ring restarts at the front instead of wrapping around the old head
+static void empty_ring_restarts_at_front(){
+	const size_t capacity = 1 << 20, size = capacity * 6 / 10;
+	StreamingRingBuffer ring(BufferTarget::Array, capacity, 2);
+
+	StreamAllocation first = ring.allocate(size);
+	CHECK(first.valid() && first.offset == 0);
+	ring.end_frame();
+	glFinish();
+
+	StreamAllocation second = ring.try_allocate(size);
+	CHECK(second.valid());
+	CHECK(second.offset == 0);
+	CHECK(ring.stats().wasted_bytes == 0);
+	ring.end_frame();
+	glFinish();
+
+	//a bigger allocation would not fit past the stale head even in an empty ring
+	StreamAllocation third = ring.try_allocate(capacity * 7 / 10, 256);
+	CHECK(third.valid());
+	CHECK(third.offset == 0);
+	CHECK(ring.stats().waits == 0);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main(){
+	create_test_context();
+	empty_ring_restarts_at_front();
+	return test_result("stream");
+}
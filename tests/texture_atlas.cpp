@@ -0,0 +1,98 @@
+#include "gl_test.hpp"
+#include "opengl/texture_atlas.hpp"
+#include <chrono>
+
+static uint32_t g_seed = 12345;
+static uint32_t random_size(uint32_t low, uint32_t high){
+	g_seed = g_seed * 1664525u + 1013904223u;
+	return low + (g_seed >> 8) % (high - low + 1);
+}
+
+static bool disjoint(const std::vector<AtlasRect>& rects){
+	for(size_t i = 0; i < rects.size(); i++){
+		for(size_t j = i + 1; j < rects.size(); j++) if(rects[i].intersects(rects[j])) return false;
+	}
+	return true;
+}
+
+static std::vector<AtlasRect> fill(MaxRectsPacker& packer){
+	std::vector<AtlasRect> rects;
+	AtlasRect rect;
+	for(int failures = 0; failures < 64;){
+		if(packer.insert(random_size(4, 40), random_size(4, 40), rect)) rects.push_back(rect);
+		else failures++;
+	}
+	return rects;
+}
+
+static void emptied_packer_is_whole(){
+	MaxRectsPacker packer(256, 256);
+	std::vector<AtlasRect> rects = fill(packer);
+	CHECK(rects.size() > 50);
+	CHECK(disjoint(rects));
+	for(auto& rect: rects) packer.remove(rect);
+	CHECK(packer.empty());
+	AtlasRect whole;
+	CHECK(packer.insert(256, 256, whole));
+	CHECK(whole.x == 0 && whole.y == 0);
+}
+
+static void partial_removal_frees_the_space(){
+	MaxRectsPacker packer(256, 256);
+	std::vector<AtlasRect> rects = fill(packer);
+
+	//free a 128x128 quadrant, it must fit again as a single rectangle
+	std::vector<AtlasRect> kept;
+	AtlasRect quadrant = { 0, 0, 128, 128 };
+	for(auto& rect: rects){
+		if(quadrant.intersects(rect)) packer.remove(rect);
+		else kept.push_back(rect);
+	}
+	//largest square the kept rectangles leave free in the corner
+	uint32_t side = 256;
+	for(auto& rect: kept){
+		if(rect.y < 128) side = std::min(side, rect.x);
+		if(rect.x < 128) side = std::min(side, rect.y);
+	}
+	AtlasRect corner;
+	CHECK(side >= 128);
+	CHECK(packer.insert(side, side, corner));
+	kept.push_back(corner);
+	CHECK(disjoint(kept));
+}
+
+//removing and inserting in a full atlas stays cheap, a removal only touches the free space around it
+static void churn(){
+	MaxRectsPacker packer(2048, 2048);
+	std::vector<AtlasRect> rects;
+	AtlasRect rect;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < 4000; i++){
+		if(packer.insert(random_size(8, 32), random_size(8, 32), rect)) rects.push_back(rect);
+	}
+	CHECK(rects.size() == 4000);
+
+	size_t reinserted = 0;
+	for(size_t step = 0; step < 1000; step++){
+		size_t index = random_size(0, (uint32_t)rects.size() - 1);
+		packer.remove(rects[index]);
+		rects[index] = rects.back();
+		rects.pop_back();
+		if(packer.insert(random_size(8, 32), random_size(8, 32), rect)){
+			rects.push_back(rect);
+			reinserted++;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	CHECK(reinserted == 1000);
+	CHECK(disjoint(rects));
+	CHECK(seconds < 10.0); //rebuilding the free list on removal took minutes
+	std::printf("churn: 4000 inserts, 1000 removals and inserts in %.0f ms\n", seconds * 1e3);
+}
+
+int main(){
+	emptied_packer_is_whole();
+	partial_removal_frees_the_space();
+	churn();
+	return test_result("texture_atlas");
+}
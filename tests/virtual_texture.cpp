@@ -0,0 +1,163 @@
+#include "gl_test.hpp"
+#include "opengl/virtual_texture.hpp"
+#include "opengl/framebuffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//512 x 512 texels in 64 texel pages: 8 x 8 pages on level 0, 4 levels, 16 slots in the cache
+static VirtualTextureDesc test_desc(uint32_t retry_frames){
+	return {
+		.width = 512,
+		.height = 512,
+		.page_size = 64,
+		.border = 2,
+		.cache_size = 272,
+		.cache_layers = 1,
+		.feedback_scale = 1,
+		.retry_frames = retry_frames
+	};
+}
+
+//every page is a flat color telling which page it is
+static uint32_t page_color(uint32_t level, uint32_t x, uint32_t y){
+	return (40 + level * 50) | (40 + x * 60) << 8 | (40 + y * 60) << 16 | 255u << 24;
+}
+
+static VirtualPageLoader flat_loader(std::atomic<bool>& failing){
+	return [&failing](const VirtualPage& page, void* destination, size_t bytes){
+		if(failing && page == VirtualPage{ 0, 1, 1 }) return false;
+		uint32_t color = page_color(page.level, page.x, page.y);
+		for(size_t i = 0; i < bytes / 4; i++) memcpy((uint8_t*)destination + i * 4, &color, 4);
+		return true;
+	};
+}
+
+//draws a 128 x 128 target sampling level 0 texel for pixel, pages (0, 0) to (1, 1) of level 0 are wanted
+class VirtualTextureScene {
+	public:
+		VirtualTextureScene(VirtualTexture& texture, TextureStreamer& streamer):m_texture(texture),m_streamer(streamer),m_color(TextureType::Tex2D){
+			m_color.storage(1, GL_RGBA8, size, size);
+			m_framebuffer.attach(GL_COLOR_ATTACHMENT0, m_color);
+			m_texture.resize_feedback(size, size);
+
+			ShaderInstance vertex(ShaderType::Vertex), fragment(ShaderType::Fragment);
+			vertex << std::string("#version 450\nvoid main(){ gl_Position = vec4(vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0, 0.0, 1.0); }\n");
+			fragment << std::string("#version 450\n") + VirtualTexture::glsl() + "out vec4 color;\nvoid main(){ color = vt_sample(gl_FragCoord.xy / 512.0); }\n";
+			CHECK(vertex.compile() && vertex.check_compile_status());
+			CHECK(fragment.compile() && fragment.check_compile_status());
+			m_program << vertex;
+			m_program << fragment;
+			CHECK(m_program.link() && m_program.check_link_status());
+		}
+
+		void frame(){
+			m_texture.begin_frame();
+			m_framebuffer.bind_draw();
+			glViewport(0, 0, size, size);
+			m_program.bind();
+			m_vertex_array.bind();
+			m_texture.bind(0, 1);
+			m_texture.set_uniforms(m_program);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			m_texture.end_frame();
+			m_streamer.update();
+			glFinish();
+			//gives the workers time to decode the pages requested this frame
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+
+		uint32_t pixel(uint32_t x, uint32_t y){
+			std::vector<uint32_t> pixels((size_t)size * size);
+			glGetTextureImage(m_color.id(), 0, GL_RGBA, GL_UNSIGNED_BYTE, (int32_t)(pixels.size() * 4), pixels.data());
+			return pixels[(size_t)y * size + x];
+		}
+
+	private:
+		static constexpr uint32_t size = 128;
+
+		VirtualTexture& m_texture;
+		TextureStreamer& m_streamer;
+		TextureInstance m_color;
+		FramebufferInstance m_framebuffer;
+		ShaderProgramInstance m_program;
+		VertexArrayInstance m_vertex_array;
+};
+
+static uint32_t indirection_entry(VirtualTexture& texture, uint32_t x, uint32_t y){
+	std::vector<uint32_t> entries(64);
+	glGetTextureImage(texture.indirection().id(), 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, (int32_t)(entries.size() * 4), entries.data());
+	return entries[(size_t)y * 8 + x];
+}
+
+//feedback from the draw requests the pages, the streamer uploads them and the page table points at them
+static void feedback_loads_pages(){
+	ThreadPool pool(2);
+	TextureStreamer streamer(pool, 4 << 20);
+	std::atomic<bool> failing = true;
+	VirtualTexture texture(streamer, test_desc(1000), flat_loader(failing));
+	VirtualTextureScene scene(texture, streamer);
+	CHECK(texture.descriptor().levels() == 4 && texture.capacity() == 16);
+
+	for(int i = 0; i < 20; i++) scene.frame();
+	CHECK(texture.resident({ 3, 0, 0 }) && texture.resident({ 2, 0, 0 }) && texture.resident({ 1, 0, 0 }));
+	CHECK(texture.resident({ 0, 0, 0 }) && texture.resident({ 0, 1, 0 }) && texture.resident({ 0, 0, 1 }));
+	CHECK(!texture.resident({ 0, 2, 0 }));
+	CHECK(indirection_entry(texture, 1, 0) >> 24 == 0);
+	CHECK(scene.pixel(10, 10) == page_color(0, 0, 0));
+	CHECK(scene.pixel(100, 10) == page_color(0, 1, 0));
+	CHECK(scene.pixel(10, 100) == page_color(0, 0, 1));
+
+	//the failed page samples its parent and isn't requested again before the retry interval
+	CHECK(!texture.resident({ 0, 1, 1 }));
+	CHECK(texture.stats().failed == 1);
+	CHECK(indirection_entry(texture, 1, 1) >> 24 == 1);
+	CHECK(scene.pixel(100, 100) == page_color(1, 0, 0));
+	uint64_t requested = texture.stats().requested;
+	for(int i = 0; i < 5; i++) scene.frame();
+	CHECK(texture.stats().requested == requested);
+
+	failing = false;
+	texture.retry_failed();
+	for(int i = 0; i < 20; i++) scene.frame();
+	CHECK(texture.resident({ 0, 1, 1 }));
+	CHECK(texture.stats().failed == 1);
+	CHECK(indirection_entry(texture, 1, 1) >> 24 == 0);
+	CHECK(scene.pixel(100, 100) == page_color(0, 1, 1));
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+//without feedback, a page that failed is requested again once `retry_frames` passed
+static void failed_pages_retry(){
+	ThreadPool pool(2);
+	TextureStreamer streamer(pool, 4 << 20);
+	std::atomic<bool> failing = true;
+	VirtualTexture texture(streamer, test_desc(4), flat_loader(failing));
+	auto frame = [&](){
+		texture.request({ 0, 1, 1 });
+		texture.begin_frame();
+		texture.end_frame();
+		streamer.update();
+		glFinish();
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	};
+
+	for(int i = 0; i < 20 && texture.stats().failed == 0; i++) frame();
+	CHECK(texture.stats().failed == 1);
+	uint64_t requested = texture.stats().requested;
+	frame();
+	CHECK(texture.stats().requested == requested);
+
+	failing = false;
+	for(int i = 0; i < 20 && !texture.resident({ 0, 1, 1 }); i++) frame();
+	CHECK(texture.resident({ 0, 1, 1 }));
+	CHECK(texture.stats().requested > requested);
+	CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main(){
+	create_test_context();
+	feedback_loads_pages();
+	failed_pages_retry();
+	return test_result("virtual_texture");
+}